@@ -895,18 +895,102 @@ float TriggerMatch::value() const
 	return _structure->value;
 }
 
+PacketPool::PacketPool()
+{
+}
+
+PacketPool::~PacketPool()
+{
+	for (auto packet : _packets)
+		delete packet;
+}
+
+shared_ptr<Packet> PacketPool::get(shared_ptr<Device> device,
+	const struct sr_datafeed_packet *structure)
+{
+	Packet *packet = nullptr;
+	{
+		lock_guard<mutex> lock(_mutex);
+		if (!_packets.empty()) {
+			packet = _packets.back();
+			_packets.pop_back();
+		}
+	}
+	if (packet)
+		packet->set_structure(move(device), structure);
+	else
+		packet = new Packet{move(device), structure};
+
+	/* The pool outlives the packets which the application holds. */
+	auto pool = shared_from_this();
+	return shared_ptr<Packet>{packet,
+		[pool](Packet *p) { pool->put(p); }};
+}
+
+void PacketPool::put(Packet *packet)
+{
+	/* Keep a few packets, applications may hold on to many. */
+	static const size_t max_packets = 16;
+
+	packet->release();
+	{
+		lock_guard<mutex> lock(_mutex);
+		if (_packets.size() < max_packets) {
+			_packets.push_back(packet);
+			return;
+		}
+	}
+	delete packet;
+}
+
 DatafeedCallbackData::DatafeedCallbackData(Session *session,
 		DatafeedCallbackFunction callback) :
 	_callback(move(callback)),
-	_session(session)
+	_session(session),
+	_cached_sdi(nullptr),
+	_cached_owned_device(nullptr),
+	_packet_pool(make_shared<PacketPool>())
+{
+}
+
+shared_ptr<Device> DatafeedCallbackData::get_device(
+	const struct sr_dev_inst *sdi)
+{
+	if (sdi != _cached_sdi) {
+		auto owned = _session->_owned_devices.find(sdi);
+		if (owned != _session->_owned_devices.end()) {
+			_cached_owned_device = owned->second.get();
+			_cached_other_device.reset();
+		} else {
+			auto other = _session->_other_devices.find(sdi);
+			if (other == _session->_other_devices.end())
+				throw Error(SR_ERR_BUG);
+			_cached_owned_device = nullptr;
+			_cached_other_device = other->second;
+		}
+		_cached_sdi = sdi;
+	}
+
+	if (_cached_owned_device)
+		return static_pointer_cast<Device>(
+			_cached_owned_device->share_owned_by(
+				_session->shared_from_this()));
+	else
+		return _cached_other_device;
+}
+
+void DatafeedCallbackData::clear_device_cache()
 {
+	_cached_sdi = nullptr;
+	_cached_owned_device = nullptr;
+	_cached_other_device.reset();
 }
 
 void DatafeedCallbackData::run(const struct sr_dev_inst *sdi,
 	const struct sr_datafeed_packet *pkt)
 {
-	auto device = _session->get_device(sdi);
-	shared_ptr<Packet> packet {new Packet{device, pkt}, default_delete<Packet>{}};
+	auto device = get_device(sdi);
+	auto packet = _packet_pool->get(device, pkt);
 	_callback(move(device), move(packet));
 }
 
@@ -970,6 +1054,8 @@ void Session::add_device(shared_ptr<Device> device)
 	const auto dev_struct = device->_structure;
 	check(sr_session_dev_add(_structure, dev_struct));
 	_other_devices[dev_struct] = move(device);
+	for (auto &cb_data : _datafeed_callbacks)
+		cb_data->clear_device_cache();
 }
 
 vector<shared_ptr<Device>> Session::devices()
@@ -987,6 +1073,8 @@ vector<shared_ptr<Device>> Session::devices()
 
 void Session::remove_devices()
 {
+	for (auto &cb_data : _datafeed_callbacks)
+		cb_data->clear_device_cache();
 	_other_devices.clear();
 	check(sr_session_dev_remove_all(_structure));
 }
@@ -1079,37 +1167,82 @@ shared_ptr<Context> Session::context()
 }
 
 Packet::Packet(shared_ptr<Device> device,
-	const struct sr_datafeed_packet *structure) :
-	_structure(structure),
-	_device(move(device))
+	const struct sr_datafeed_packet *structure)
+{
+	set_structure(move(device), structure);
+}
+
+Packet::~Packet()
+{
+}
+
+/* Wrap another packet, re-use the payload object if the type matches. */
+void Packet::set_structure(shared_ptr<Device> device,
+	const struct sr_datafeed_packet *structure)
 {
+	_structure = structure;
+	_device = move(device);
+
 	switch (structure->type)
 	{
 		case SR_DF_HEADER:
-			_payload.reset(new Header{
-				static_cast<const struct sr_datafeed_header *>(
-					structure->payload)});
+		{
+			auto payload = static_cast<const struct sr_datafeed_header *>(
+				structure->payload);
+			if (auto header = dynamic_cast<Header *>(_payload.get()))
+				header->_structure = payload;
+			else
+				_payload.reset(new Header{payload});
 			break;
+		}
 		case SR_DF_META:
-			_payload.reset(new Meta{
-				static_cast<const struct sr_datafeed_meta *>(
-					structure->payload)});
+		{
+			auto payload = static_cast<const struct sr_datafeed_meta *>(
+				structure->payload);
+			if (auto meta = dynamic_cast<Meta *>(_payload.get()))
+				meta->_structure = payload;
+			else
+				_payload.reset(new Meta{payload});
 			break;
+		}
 		case SR_DF_LOGIC:
-			_payload.reset(new Logic{
-				static_cast<const struct sr_datafeed_logic *>(
-					structure->payload)});
+		{
+			auto payload = static_cast<const struct sr_datafeed_logic *>(
+				structure->payload);
+			if (auto logic = dynamic_cast<Logic *>(_payload.get()))
+				logic->_structure = payload;
+			else
+				_payload.reset(new Logic{payload});
 			break;
+		}
 		case SR_DF_ANALOG:
-			_payload.reset(new Analog{
-				static_cast<const struct sr_datafeed_analog *>(
-					structure->payload)});
+		{
+			auto payload = static_cast<const struct sr_datafeed_analog *>(
+				structure->payload);
+			if (auto analog = dynamic_cast<Analog *>(_payload.get())) {
+				analog->_structure = payload;
+				analog->_channels.clear();
+			} else {
+				_payload.reset(new Analog{payload});
+			}
+			break;
+		}
+		default:
+			_payload.reset();
 			break;
 	}
 }
 
-Packet::~Packet()
+/*
+ * Drop references to other objects while the packet is unused. The
+ * wrapped structure is no longer valid at this point.
+ */
+void Packet::release()
 {
+	_structure = nullptr;
+	_device.reset();
+	if (auto analog = dynamic_cast<Analog *>(_payload.get()))
+		analog->_channels.clear();
 }
 
 const PacketType *Packet::type() const
@@ -1251,12 +1384,13 @@ unsigned int Analog::num_samples() const
 
 vector<shared_ptr<Channel>> Analog::channels()
 {
-	vector<shared_ptr<Channel>> result;
-	for (auto l = _structure->meaning->channels; l; l = l->next) {
-		auto *const ch = static_cast<struct sr_channel *>(l->data);
-		result.push_back(_parent->_device->get_channel(ch));
+	if (_channels.empty()) {
+		for (auto l = _structure->meaning->channels; l; l = l->next) {
+			auto *const ch = static_cast<struct sr_channel *>(l->data);
+			_channels.push_back(_parent->_device->get_channel(ch));
+		}
 	}
-	return result;
+	return _channels;
 }
 
 unsigned int Analog::unitsize() const
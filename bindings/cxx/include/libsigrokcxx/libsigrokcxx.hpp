@@ -81,6 +81,7 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 #include <functional>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <map>
 #include <set>
@@ -121,6 +122,8 @@ class SR_API Output;
 class SR_API DataType;
 class SR_API Option;
 class SR_API UserDevice;
+class SR_API SessionDevice;
+class SR_PRIV PacketPool;
 
 /** Exception thrown when an error code is returned by any libsigrok call. */
 class SR_API Error: public std::exception
@@ -578,6 +581,20 @@ typedef std::function<void()> SessionStoppedCallback;
 typedef std::function<void(std::shared_ptr<Device>, std::shared_ptr<Packet>)>
 	DatafeedCallbackFunction;
 
+/* Recycles the Packet objects which are handed to datafeed callbacks */
+class SR_PRIV PacketPool : public std::enable_shared_from_this<PacketPool>
+{
+public:
+	PacketPool();
+	~PacketPool();
+	std::shared_ptr<Packet> get(std::shared_ptr<Device> device,
+		const struct sr_datafeed_packet *structure);
+private:
+	void put(Packet *packet);
+	std::mutex _mutex;
+	std::vector<Packet *> _packets;
+};
+
 /* Data required for C callback function to call a C++ datafeed callback */
 class SR_PRIV DatafeedCallbackData
 {
@@ -588,7 +605,14 @@ private:
 	DatafeedCallbackFunction _callback;
 	DatafeedCallbackData(Session *session,
 		DatafeedCallbackFunction callback);
+	std::shared_ptr<Device> get_device(const struct sr_dev_inst *sdi);
+	void clear_device_cache();
 	Session *_session;
+	/* Most recently seen device, saves the session's lookups. */
+	const struct sr_dev_inst *_cached_sdi;
+	SessionDevice *_cached_owned_device;
+	std::shared_ptr<Device> _cached_other_device;
+	std::shared_ptr<PacketPool> _packet_pool;
 	friend class Session;
 };
 
@@ -603,6 +627,7 @@ private:
 	std::shared_ptr<Device> get_shared_from_this();
 
 	friend class Session;
+	friend class DatafeedCallbackData;
 	friend struct std::default_delete<SessionDevice>;
 };
 
@@ -673,6 +698,9 @@ private:
 	Packet(std::shared_ptr<Device> device,
 		const struct sr_datafeed_packet *structure);
 	~Packet();
+	void set_structure(std::shared_ptr<Device> device,
+		const struct sr_datafeed_packet *structure);
+	void release();
 	const struct sr_datafeed_packet *_structure;
 	std::shared_ptr<Device> _device;
 	std::unique_ptr<PacketPayload> _payload;
@@ -680,6 +708,7 @@ private:
 	friend class Session;
 	friend class Output;
 	friend class DatafeedCallbackData;
+	friend class PacketPool;
 	friend class Header;
 	friend class Meta;
 	friend class Logic;
@@ -842,6 +871,7 @@ private:
 	std::shared_ptr<PacketPayload> share_owned_by(std::shared_ptr<Packet> parent);
 
 	const struct sr_datafeed_analog *_structure;
+	std::vector<std::shared_ptr<Channel> > _channels;
 
 	friend class Packet;
 };
@@ -175,6 +175,8 @@ enum sr_packettype {
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Payload is struct sr_datafeed_logic_rle. */
+	SR_DF_LOGIC_RLE,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
@@ -482,6 +484,34 @@ struct sr_context;
  */
 struct sr_session;
 
+/**
+ * @struct sr_session_summary
+ * Opaque structure representing the summary of a session file's data.
+ *
+ * None of the fields of this structure are meant to be accessed directly.
+ *
+ * @see sr_session_summary_load(), sr_session_summary_free().
+ */
+struct sr_session_summary;
+
+/**
+ * Statistics of a session's datafeed thread.
+ *
+ * @see sr_session_feed_thread_set(), sr_session_feed_stats_get().
+ */
+struct sr_session_feed_stats {
+	/** Number of ring slots. */
+	uint64_t ring_size;
+	/** Number of packets which passed the ring. */
+	uint64_t packets;
+	/** Number of times the acquisition side found the ring full. */
+	uint64_t overflows;
+	/** Time the acquisition side spent waiting for free slots. */
+	uint64_t wait_usec;
+	/** Highest number of packets in the ring at the same time. */
+	uint64_t max_fill;
+};
+
 struct sr_rational {
 	/** Numerator of the rational number. */
 	int64_t p;
@@ -513,6 +543,21 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Run length encoded logic datafeed payload for type SR_DF_LOGIC_RLE.
+ *
+ * Holds run_count runs of identical samples. Run i is the sample at
+ * offset i * unitsize in values, repeated lengths[i] times. Consumers
+ * which only handle SR_DF_LOGIC receive expanded data instead, see
+ * sr_session_datafeed_callback_add_rle() and sr_logic_rle_expand().
+ */
+struct sr_datafeed_logic_rle {
+	uint64_t run_count;
+	uint16_t unitsize;
+	void *values;
+	uint32_t *lengths;
+};
+
 /** Analog datafeed payload for type SR_DF_ANALOG. */
 struct sr_datafeed_analog {
 	void *data;
@@ -592,6 +637,13 @@ struct sr_resource {
 enum sr_output_flag {
 	/** If set, this output module writes the output itself. */
 	SR_OUTPUT_INTERNAL_IO_HANDLING = 0x01,
+	/**
+	 * If set, this output module accepts SR_DF_LOGIC_RLE packets.
+	 * Other modules take the data expanded to SR_DF_LOGIC packets,
+	 * as the session passes them to sr_session_datafeed_callback_add()
+	 * callbacks.
+	 */
+	SR_OUTPUT_LOGIC_RLE = 0x02,
 };
 
 struct sr_input;
@@ -1119,6 +1171,20 @@ enum sr_configkey {
 	/** Number of powerline cycles for ADC integration time. */
 	SR_CONF_ADC_POWERLINE_CYCLES,
 
+	/**
+	 * The device supports replaying a capturefile from the given
+	 * sample number on. Combine with SR_CONF_LIMIT_SAMPLES to
+	 * replay a range of samples.
+	 */
+	SR_CONF_CAPTURE_START,
+
+	/**
+	 * Number of data blocks which get read ahead in the background
+	 * while previously read data gets sent to the session. Zero reads
+	 * in the session's thread.
+	 */
+	SR_CONF_PREFETCH_DEPTH,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Acquisition modes, sample limiting ----------------------------*/
@@ -1158,6 +1224,13 @@ enum sr_configkey {
 	/** Self test mode. */
 	SR_CONF_TEST_MODE,
 
+	/**
+	 * Generate data as fast as the session accepts it, regardless
+	 * of the samplerate. Allows to measure the throughput of the
+	 * data processing pipeline.
+	 */
+	SR_CONF_FREE_RUNNING,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 };
 
@@ -30,6 +30,8 @@
 
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *buf);
+SR_API int sr_analog_to_double(const struct sr_datafeed_analog *analog,
+		double *buf);
 SR_API const char *sr_analog_si_prefix(float *value, int *digits);
 SR_API gboolean sr_analog_si_prefix_friendly(enum sr_unit unit);
 SR_API int sr_analog_unit_to_string(const struct sr_datafeed_analog *analog,
@@ -57,6 +59,15 @@ SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
 		uint64_t count);
+SR_API int sr_a2l_threshold_bits(const struct sr_datafeed_analog *analog,
+		float threshold, uint8_t *output, size_t unitsize,
+		size_t bitpos, uint64_t count);
+SR_API int sr_a2l_schmitt_trigger_bits(const struct sr_datafeed_analog *analog,
+		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
+		size_t unitsize, size_t bitpos, uint64_t count);
+SR_API uint64_t sr_logic_rle_length(const struct sr_datafeed_logic_rle *rle);
+SR_API uint64_t sr_logic_rle_expand(const struct sr_datafeed_logic_rle *rle,
+		uint64_t *run, uint64_t *offset, uint8_t *buffer, uint64_t count);
 
 /*--- log.c -----------------------------------------------------------------*/
 
@@ -131,6 +142,18 @@ SR_API struct sr_trigger *sr_session_trigger_get(struct sr_session *session);
 /* Session setup */
 SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	struct sr_session **session);
+SR_API int sr_session_summary_load(const char *filename, const char *name,
+	struct sr_session_summary **summary);
+SR_API void sr_session_summary_free(struct sr_session_summary *summary);
+SR_API int sr_session_summary_info_get(const struct sr_session_summary *summary,
+	uint64_t *total_samples, uint64_t *block_samples, size_t *unitsize);
+SR_API int sr_session_summary_logic(const struct sr_session_summary *summary,
+	uint64_t start, uint64_t count, uint64_t *transitions,
+	uint8_t *or_mask, uint8_t *and_mask);
+SR_API int sr_session_summary_analog(const struct sr_session_summary *summary,
+	uint64_t start, uint64_t count, float *min, float *max, float *mean);
+SR_API int sr_session_summary_find_edge(const struct sr_session_summary *summary,
+	unsigned int channel, uint64_t from, uint64_t *block_start);
 SR_API int sr_session_new(struct sr_context *ctx, struct sr_session **session);
 SR_API int sr_session_destroy(struct sr_session *session);
 SR_API int sr_session_dev_remove_all(struct sr_session *session);
@@ -145,6 +168,8 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_datafeed_callback_add_rle(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data);
 
 /* Session control */
 SR_API int sr_session_start(struct sr_session *session);
@@ -153,10 +178,18 @@ SR_API int sr_session_stop(struct sr_session *session);
 SR_API int sr_session_is_running(struct sr_session *session);
 SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 		sr_session_stopped_callback cb, void *cb_data);
+SR_API int sr_session_feed_thread_set(struct sr_session *session,
+		size_t ring_size);
+SR_API int sr_session_feed_stats_get(struct sr_session *session,
+		struct sr_session_feed_stats *stats);
 
 SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy);
 SR_API void sr_packet_free(struct sr_datafeed_packet *packet);
+SR_API gboolean sr_packet_is_shared(const struct sr_datafeed_packet *packet);
+SR_API struct sr_datafeed_packet *sr_packet_ref(
+		const struct sr_datafeed_packet *packet);
+SR_API void sr_packet_unref(struct sr_datafeed_packet *packet);
 
 /*--- input/input.c ---------------------------------------------------------*/
 
@@ -176,6 +209,8 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
 SR_API const struct sr_input_module *sr_input_module_get(const struct sr_input *in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
+SR_API int sr_input_send_mapped(const struct sr_input *in, void *data,
+		size_t length, size_t *consumed);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API int sr_input_reset(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
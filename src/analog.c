@@ -23,6 +23,9 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -157,38 +160,143 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
-/**
- * Convert an analog datafeed payload to an array of floats.
- *
- * The caller must provide the #outbuf space for the conversion result,
- * and is expected to free allocated space after use.
- *
- * @param[in] analog The analog payload to convert. Must not be NULL.
- *                   analog->data, analog->meaning, and analog->encoding
- *                   must not be NULL.
- * @param[out] outbuf Memory where to store the result. Must not be NULL.
- *
- * @retval SR_OK Success.
- * @retval SR_ERR Unsupported encoding.
- * @retval SR_ERR_ARG Invalid argument.
- *
- * @since 0.4.0
+#ifdef __SSE2__
+/* Scale four 32bit integers in double precision, store them as floats. */
+static inline void convert_i32x4(float *outbuf, __m128i values,
+		__m128d scale, __m128d offset)
+{
+	__m128d lo, hi;
+
+	lo = _mm_cvtepi32_pd(values);
+	hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(values, 0xee));
+	lo = _mm_add_pd(_mm_mul_pd(lo, scale), offset);
+	hi = _mm_add_pd(_mm_mul_pd(hi, scale), offset);
+	_mm_storeu_ps(outbuf, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+}
+
+/* Scale four floats in double precision, store them as floats. */
+static inline void convert_f32x4(float *outbuf, __m128 values,
+		__m128d scale, __m128d offset)
+{
+	__m128d lo, hi;
+
+	lo = _mm_cvtps_pd(values);
+	hi = _mm_cvtps_pd(_mm_movehl_ps(values, values));
+	lo = _mm_add_pd(_mm_mul_pd(lo, scale), offset);
+	hi = _mm_add_pd(_mm_mul_pd(hi, scale), offset);
+	_mm_storeu_ps(outbuf, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+}
+
+/*
+ * Convert the leading part of little endian input data, eight values
+ * at a time. Calculations are done in double precision like in the
+ * scalar code path, results are identical. Returns the number of
+ * values which were converted, the caller handles the remainder.
  */
-SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
+static size_t analog_to_float_sse2(const struct sr_analog_encoding *encoding,
+		const uint8_t *data8, size_t count, double scale, double offset,
 		float *outbuf)
 {
-	size_t count;
+	__m128d vscale, voffset;
+	__m128i raw, zero;
+	size_t done, unitsize;
+
+	if (encoding->is_bigendian)
+		return 0;
+	unitsize = encoding->unitsize;
+	vscale = _mm_set1_pd(scale);
+	voffset = _mm_set1_pd(offset);
+	zero = _mm_setzero_si128();
+
+	for (done = 0; done + 8 <= count; done += 8) {
+		if (encoding->is_float && unitsize == sizeof(float)) {
+			convert_f32x4(&outbuf[done],
+				_mm_loadu_ps((const float *)data8), vscale, voffset);
+			convert_f32x4(&outbuf[done + 4],
+				_mm_loadu_ps((const float *)(data8 + 16)), vscale, voffset);
+			data8 += 32;
+			continue;
+		}
+		if (encoding->is_float)
+			return done;
+		if (unitsize == sizeof(uint32_t) && encoding->is_signed) {
+			convert_i32x4(&outbuf[done],
+				_mm_loadu_si128((const __m128i *)data8), vscale, voffset);
+			convert_i32x4(&outbuf[done + 4],
+				_mm_loadu_si128((const __m128i *)(data8 + 16)), vscale, voffset);
+			data8 += 32;
+			continue;
+		}
+		/* Widen 8bit values to 16bit, then handle them like those. */
+		if (unitsize == sizeof(uint8_t)) {
+			raw = _mm_loadl_epi64((const __m128i *)data8);
+			if (encoding->is_signed)
+				raw = _mm_srai_epi16(_mm_unpacklo_epi8(raw, raw), 8);
+			else
+				raw = _mm_unpacklo_epi8(raw, zero);
+			data8 += 8;
+		} else if (unitsize == sizeof(uint16_t)) {
+			raw = _mm_loadu_si128((const __m128i *)data8);
+			data8 += 16;
+		} else {
+			return done;
+		}
+		if (encoding->is_signed) {
+			convert_i32x4(&outbuf[done], _mm_srai_epi32(
+				_mm_unpacklo_epi16(raw, raw), 16), vscale, voffset);
+			convert_i32x4(&outbuf[done + 4], _mm_srai_epi32(
+				_mm_unpackhi_epi16(raw, raw), 16), vscale, voffset);
+		} else {
+			convert_i32x4(&outbuf[done],
+				_mm_unpacklo_epi16(raw, zero), vscale, voffset);
+			convert_i32x4(&outbuf[done + 4],
+				_mm_unpackhi_epi16(raw, zero), vscale, voffset);
+		}
+	}
+
+	return done;
+}
+#endif
+
+/*
+ * Convert sample values with a specific reader routine. The readers are
+ * inlined, which allows compilers to optimize (and vectorize) the loop.
+ */
+/** @cond PRIVATE */
+#define CONVERT_VALUES(reader, width) do { \
+	if (fout) { \
+		for (idx = 0; idx < count; idx++, data8 += (width)) \
+			fout[idx] = reader(data8) * scale + offset; \
+	} else { \
+		for (idx = 0; idx < count; idx++, data8 += (width)) \
+			dout[idx] = reader(data8) * scale + offset; \
+	} \
+	return SR_OK; \
+} while (0)
+/** @endcond */
+
+/*
+ * Common implementation of the float and double conversion. Exactly
+ * one of the output buffers is provided by the caller.
+ */
+static int analog_convert(const struct sr_datafeed_analog *analog,
+		float *fout, double *dout)
+{
+	size_t count, idx;
 	gboolean host_bigendian;
 	gboolean input_float, input_signed, input_bigendian;
 	size_t input_unitsize;
-	double scale, offset, value;
+	double scale, offset;
 	const uint8_t *data8;
 	gboolean input_is_native;
 	char type_text[10];
+#ifdef __SSE2__
+	size_t done;
+#endif
 
 	if (!analog || !analog->data || !analog->meaning || !analog->encoding)
 		return SR_ERR_ARG;
-	if (!outbuf)
+	if (!fout && !dout)
 		return SR_ERR_ARG;
 
 	count = analog->num_samples * g_slist_length(analog->meaning->channels);
@@ -228,61 +336,50 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 	 * native format. Do apply scale/offset though when applicable
 	 * on our way out.
 	 */
-	input_is_native = input_float &&
-		input_unitsize == sizeof(outbuf[0]) &&
+	input_is_native = fout && input_float &&
+		input_unitsize == sizeof(fout[0]) &&
 		input_bigendian == host_bigendian;
 	if (input_is_native) {
-		memcpy(outbuf, data8, count * sizeof(outbuf[0]));
+		memcpy(fout, data8, count * sizeof(fout[0]));
 		if (scale != 1.0 || offset != 0.0) {
 			while (count--) {
-				*outbuf *= scale;
-				*outbuf += offset;
-				outbuf++;
+				*fout *= scale;
+				*fout += offset;
+				fout++;
 			}
 		}
 		return SR_OK;
 	}
 
+#ifdef __SSE2__
+	if (fout) {
+		done = analog_to_float_sse2(analog->encoding, data8, count,
+			scale, offset, fout);
+		data8 += done * input_unitsize;
+		fout += done;
+		count -= done;
+	}
+#endif
+
 	/*
 	 * Accept sample values in different widths and data types and
 	 * endianess formats (floating point or signed or unsigned
 	 * integer, in either endianess, for a set of supported widths).
 	 * Common scale/offset factors apply to all sample values.
 	 *
-	 * Do most internal calculations on double precision values.
-	 * Only trim the result data to single precision, since that's
-	 * the routine's result data type in its public API which needs
-	 * to be kept for compatibility. It remains an option for later
-	 * to add another public routine which returns double precision
-	 * result data, call sites could migrate at their own pace.
+	 * Do all internal calculations on double precision values.
+	 * The float variant only trims the result data to single
+	 * precision.
 	 */
 	if (input_float && input_unitsize == sizeof(float)) {
-		float (*reader)(const uint8_t **p);
 		if (input_bigendian)
-			reader = read_fltbe_inc;
-		else
-			reader = read_fltle_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
+			CONVERT_VALUES(read_fltbe, sizeof(float));
+		CONVERT_VALUES(read_fltle, sizeof(float));
 	}
 	if (input_float && input_unitsize == sizeof(double)) {
-		double (*reader)(const uint8_t **p);
 		if (input_bigendian)
-			reader = read_dblbe_inc;
-		else
-			reader = read_dblle_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
+			CONVERT_VALUES(read_dblbe, sizeof(double));
+		CONVERT_VALUES(read_dblle, sizeof(double));
 	}
 	if (input_float) {
 		snprintf(type_text, sizeof(type_text), "%c%zu%s",
@@ -292,83 +389,29 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		return SR_ERR;
 	}
 
-	if (input_unitsize == sizeof(uint8_t) && input_signed) {
-		int8_t (*reader)(const uint8_t **p);
-		reader = read_i8_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
-	if (input_unitsize == sizeof(uint8_t)) {
-		uint8_t (*reader)(const uint8_t **p);
-		reader = read_u8_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
-	}
+	if (input_unitsize == sizeof(uint8_t) && input_signed)
+		CONVERT_VALUES(read_i8, sizeof(int8_t));
+	if (input_unitsize == sizeof(uint8_t))
+		CONVERT_VALUES(read_u8, sizeof(uint8_t));
 	if (input_unitsize == sizeof(uint16_t) && input_signed) {
-		int16_t (*reader)(const uint8_t **p);
 		if (input_bigendian)
-			reader = read_i16be_inc;
-		else
-			reader = read_i16le_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
+			CONVERT_VALUES(read_i16be, sizeof(int16_t));
+		CONVERT_VALUES(read_i16le, sizeof(int16_t));
 	}
 	if (input_unitsize == sizeof(uint16_t)) {
-		uint16_t (*reader)(const uint8_t **p);
 		if (input_bigendian)
-			reader = read_u16be_inc;
-		else
-			reader = read_u16le_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
+			CONVERT_VALUES(read_u16be, sizeof(uint16_t));
+		CONVERT_VALUES(read_u16le, sizeof(uint16_t));
 	}
 	if (input_unitsize == sizeof(uint32_t) && input_signed) {
-		int32_t (*reader)(const uint8_t **p);
 		if (input_bigendian)
-			reader = read_i32be_inc;
-		else
-			reader = read_i32le_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
+			CONVERT_VALUES(read_i32be, sizeof(int32_t));
+		CONVERT_VALUES(read_i32le, sizeof(int32_t));
 	}
 	if (input_unitsize == sizeof(uint32_t)) {
-		uint32_t (*reader)(const uint8_t **p);
 		if (input_bigendian)
-			reader = read_u32be_inc;
-		else
-			reader = read_u32le_inc;
-		while (count--) {
-			value = reader(&data8);
-			value *= scale;
-			value += offset;
-			*outbuf++ = value;
-		}
-		return SR_OK;
+			CONVERT_VALUES(read_u32be, sizeof(uint32_t));
+		CONVERT_VALUES(read_u32le, sizeof(uint32_t));
 	}
 	snprintf(type_text, sizeof(type_text), "%c%zu%s",
 		input_float ? 'f' : input_signed ? 'i' : 'u',
@@ -378,6 +421,59 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 	return SR_ERR;
 }
 
+/**
+ * Convert an analog datafeed payload to an array of floats.
+ *
+ * The caller must provide the #outbuf space for the conversion result,
+ * and is expected to free allocated space after use.
+ *
+ * @param[in] analog The analog payload to convert. Must not be NULL.
+ *                   analog->data, analog->meaning, and analog->encoding
+ *                   must not be NULL.
+ * @param[out] outbuf Memory where to store the result. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.4.0
+ */
+SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
+		float *outbuf)
+{
+	if (!outbuf)
+		return SR_ERR_ARG;
+
+	return analog_convert(analog, outbuf, NULL);
+}
+
+/**
+ * Convert an analog datafeed payload to an array of doubles.
+ *
+ * Like sr_analog_to_float(), but keeps the double precision of the
+ * internal calculation, which is useful for wide integer data or large
+ * offsets.
+ *
+ * @param[in] analog The analog payload to convert. Must not be NULL.
+ *                   analog->data, analog->meaning, and analog->encoding
+ *                   must not be NULL.
+ * @param[out] outbuf Memory where to store the result. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_to_double(const struct sr_datafeed_analog *analog,
+		double *outbuf)
+{
+	if (!outbuf)
+		return SR_ERR_ARG;
+
+	return analog_convert(analog, NULL, outbuf);
+}
+
 /**
  * Scale a float value to the appropriate SI prefix.
  *
@@ -0,0 +1,322 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Asynchronous job queue. Modules can hand blocks of work (parsing,
+ * compression, file I/O) to a bounded queue which gets drained by
+ * worker threads. Completed jobs get retired in submission order, from
+ * within the caller's thread (which typically is the session thread).
+ * Submission blocks when the queue is full, which is how back-pressure
+ * is applied. The number of blocking submissions and the time spent
+ * waiting are tracked and can be queried or get logged.
+ *
+ * A thread count of zero runs the work synchronously within the
+ * submit call. Callers can use the same code path regardless of
+ * whether the asynchronous mode was requested.
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "async"
+
+struct async_slot {
+	void *job;
+	int status;
+	gboolean done;
+};
+
+struct sr_async {
+	sr_async_work_cb work_cb;
+	sr_async_done_cb done_cb;
+	void *cb_data;
+	GThreadPool *pool;
+	GMutex mutex;
+	GCond cond;
+	struct async_slot *slots;
+	size_t depth;
+	size_t head;
+	size_t count;
+	struct sr_async_stats stats;
+};
+
+static void async_worker(gpointer data, gpointer user_data)
+{
+	struct async_slot *slot;
+	struct sr_async *q;
+	int ret;
+
+	slot = data;
+	q = user_data;
+
+	ret = q->work_cb(slot->job, q->cb_data);
+
+	g_mutex_lock(&q->mutex);
+	slot->status = ret;
+	slot->done = TRUE;
+	g_cond_broadcast(&q->cond);
+	g_mutex_unlock(&q->mutex);
+}
+
+/**
+ * Create an asynchronous job queue.
+ *
+ * @param[in] threads Number of worker threads, zero for synchronous mode.
+ * @param[in] depth Maximum number of jobs in flight (queue depth).
+ * @param[in] work_cb Processes a job, runs in a worker thread.
+ * @param[in] done_cb Retires a job, runs in the submitter's thread.
+ * @param[in] cb_data Caller provided context for the callbacks.
+ *
+ * @returns The queue instance, or NULL on error.
+ *
+ * Jobs get retired in the order of their submission, regardless of
+ * the order in which the worker threads complete them.
+ */
+SR_PRIV struct sr_async *sr_async_new(size_t threads, size_t depth,
+	sr_async_work_cb work_cb, sr_async_done_cb done_cb, void *cb_data)
+{
+	struct sr_async *q;
+	GError *error;
+
+	if (!work_cb || !done_cb)
+		return NULL;
+	if (!depth)
+		depth = 1;
+
+	q = g_malloc0(sizeof(*q));
+	q->work_cb = work_cb;
+	q->done_cb = done_cb;
+	q->cb_data = cb_data;
+	q->depth = depth;
+	q->slots = g_malloc0(q->depth * sizeof(q->slots[0]));
+	g_mutex_init(&q->mutex);
+	g_cond_init(&q->cond);
+
+	if (threads) {
+		error = NULL;
+		q->pool = g_thread_pool_new(async_worker, q,
+			threads, TRUE, &error);
+		if (!q->pool) {
+			sr_err("Cannot create worker threads: %s",
+				error ? error->message : "unknown error");
+			g_clear_error(&error);
+			g_mutex_clear(&q->mutex);
+			g_cond_clear(&q->cond);
+			g_free(q->slots);
+			g_free(q);
+			return NULL;
+		}
+	}
+
+	return q;
+}
+
+/* Retire the oldest job. Optionally wait for its completion. */
+static int async_retire(struct sr_async *q, gboolean wait,
+	gboolean *retired)
+{
+	struct async_slot *slot;
+	gint64 start;
+	void *job;
+	int status;
+
+	*retired = FALSE;
+
+	g_mutex_lock(&q->mutex);
+	if (!q->count) {
+		g_mutex_unlock(&q->mutex);
+		return SR_OK;
+	}
+	slot = &q->slots[q->head];
+	if (!slot->done) {
+		if (!wait) {
+			g_mutex_unlock(&q->mutex);
+			return SR_OK;
+		}
+		start = g_get_monotonic_time();
+		while (!slot->done)
+			g_cond_wait(&q->cond, &q->mutex);
+		q->stats.wait_usec += g_get_monotonic_time() - start;
+	}
+	job = slot->job;
+	status = slot->status;
+	slot->job = NULL;
+	q->head = (q->head + 1) % q->depth;
+	q->count--;
+	g_mutex_unlock(&q->mutex);
+
+	*retired = TRUE;
+	q->stats.completed++;
+
+	return q->done_cb(job, status, q->cb_data);
+}
+
+/**
+ * Submit a job to an asynchronous job queue.
+ *
+ * @param[in] q The queue instance.
+ * @param[in] job The job, opaque to the queue.
+ *
+ * @returns SR_OK upon success, or the first error code which either
+ *   the work or the done callback of retired jobs returned.
+ *
+ * Blocks when the maximum number of jobs already is in flight, until
+ * the oldest job has completed. Completed jobs are retired in order.
+ * The queue takes ownership of the job in any case, it eventually gets
+ * passed to the done callback, even when errors are returned here.
+ */
+SR_PRIV int sr_async_submit(struct sr_async *q, void *job)
+{
+	struct async_slot *slot;
+	gboolean retired;
+	GError *error;
+	size_t idx;
+	int ret, first_ret;
+
+	if (!q)
+		return SR_ERR_ARG;
+
+	q->stats.submitted++;
+
+	/* Synchronous mode, process and retire the job immediately. */
+	if (!q->pool) {
+		ret = q->work_cb(job, q->cb_data);
+		q->stats.completed++;
+		return q->done_cb(job, ret, q->cb_data);
+	}
+
+	/* Retire what already completed, wait if the queue is full. */
+	first_ret = SR_OK;
+	do {
+		ret = async_retire(q, FALSE, &retired);
+		if (first_ret == SR_OK)
+			first_ret = ret;
+	} while (retired);
+	if (q->count == q->depth) {
+		q->stats.stalls++;
+		ret = async_retire(q, TRUE, &retired);
+		if (first_ret == SR_OK)
+			first_ret = ret;
+	}
+
+	g_mutex_lock(&q->mutex);
+	idx = (q->head + q->count) % q->depth;
+	slot = &q->slots[idx];
+	slot->job = job;
+	slot->status = SR_OK;
+	slot->done = FALSE;
+	q->count++;
+	if (q->count > q->stats.max_depth)
+		q->stats.max_depth = q->count;
+	g_mutex_unlock(&q->mutex);
+
+	error = NULL;
+	if (!g_thread_pool_push(q->pool, slot, &error)) {
+		sr_err("Cannot queue job: %s",
+			error ? error->message : "unknown error");
+		g_clear_error(&error);
+		g_mutex_lock(&q->mutex);
+		slot->status = SR_ERR;
+		slot->done = TRUE;
+		g_mutex_unlock(&q->mutex);
+	}
+
+	return first_ret;
+}
+
+/**
+ * Wait for all submitted jobs, and retire them.
+ *
+ * @param[in] q The queue instance.
+ *
+ * @returns SR_OK upon success, or the first error code of retired jobs.
+ *
+ * All jobs get retired even in the presence of errors, such that the
+ * caller regains ownership of all job resources.
+ */
+SR_PRIV int sr_async_flush(struct sr_async *q)
+{
+	gboolean retired;
+	int ret, first_ret;
+
+	if (!q)
+		return SR_ERR_ARG;
+
+	first_ret = SR_OK;
+	do {
+		ret = async_retire(q, TRUE, &retired);
+		if (first_ret == SR_OK)
+			first_ret = ret;
+	} while (retired);
+
+	return first_ret;
+}
+
+/**
+ * Get the statistics of an asynchronous job queue.
+ *
+ * @param[in] q The queue instance.
+ * @param[out] stats The caller's storage for the statistics.
+ *
+ * @returns SR_OK upon success, SR_ERR_ARG for invalid arguments.
+ *
+ * A non-zero stall count means that the worker threads could not
+ * keep up with the data rate, and the submitter had to wait.
+ */
+SR_PRIV int sr_async_stats_get(struct sr_async *q,
+	struct sr_async_stats *stats)
+{
+	if (!q || !stats)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&q->mutex);
+	*stats = q->stats;
+	g_mutex_unlock(&q->mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Release an asynchronous job queue.
+ *
+ * @param[in] q The queue instance.
+ *
+ * Pending jobs get completed and retired before the worker threads
+ * terminate. Callers which need to see errors should use
+ * sr_async_flush() before.
+ */
+SR_PRIV void sr_async_free(struct sr_async *q)
+{
+	if (!q)
+		return;
+
+	sr_async_flush(q);
+	if (q->stats.stalls) {
+		sr_info("Job queue stalled %" PRIu64 " of %" PRIu64 " times,"
+			" waited %" PRIu64 " ms in total.",
+			q->stats.stalls, q->stats.submitted,
+			q->stats.wait_usec / 1000);
+	}
+	if (q->pool)
+		g_thread_pool_free(q->pool, FALSE, TRUE);
+	g_mutex_clear(&q->mutex);
+	g_cond_clear(&q->cond);
+	g_free(q->slots);
+	g_free(q);
+}
@@ -23,6 +23,12 @@
  * Conversion helper functions.
  */
 
+#include <config.h>
+#include <math.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -30,6 +36,493 @@
 #define LOG_PREFIX "conv"
 /** @endcond */
 
+/*
+ * Input data gets processed in blocks of up to 64 samples, comparison
+ * results are kept in bit masks. Encodings which are not handled in
+ * their raw form get converted to floats in chunks, using stack space.
+ */
+#define A2L_BLOCK	64
+#define A2L_CHUNK	(16 * A2L_BLOCK)
+
+enum a2l_kind {
+	A2L_FLOAT,
+	A2L_I8,
+	A2L_U8,
+	A2L_I16,
+	A2L_U16,
+	A2L_I32,
+	A2L_U32,
+};
+
+/* Input samples, either in their raw form, or converted to floats. */
+struct a2l_input {
+	const struct sr_datafeed_analog *analog;
+	enum a2l_kind kind;
+	size_t unitsize;
+	const uint8_t *data;
+	uint64_t count;
+	gboolean convert;
+	size_t chunk_start;
+	size_t chunk_count;
+	float chunk[A2L_CHUNK];
+};
+
+/*
+ * A comparison "value >= threshold" (or "value > threshold" when strict),
+ * optionally inverted. Integer input gets compared in the raw domain,
+ * the threshold was translated by the encoding's scale and offset.
+ * Inverted float comparisons use the opposite relation ("value <
+ * threshold" or "value <= threshold"), so that NaN never matches.
+ */
+struct a2l_cond {
+	gboolean is_const;
+	gboolean const_result;
+	gboolean invert;
+	int64_t raw;
+	float value;
+	gboolean strict;
+};
+
+/*
+ * The legacy API compares floats. Float data was used as is (without
+ * scaling), other data was converted to floats first.
+ */
+static int a2l_input_init(struct a2l_input *in,
+		const struct sr_datafeed_analog *analog, uint64_t count,
+		gboolean legacy)
+{
+	const struct sr_analog_encoding *enc;
+	gboolean host_float;
+
+	if (!analog || !analog->data || !analog->encoding)
+		return SR_ERR_ARG;
+
+	enc = analog->encoding;
+	in->analog = analog;
+	in->data = analog->data;
+	in->count = count;
+	in->unitsize = enc->unitsize;
+	in->convert = FALSE;
+	in->chunk_start = 0;
+	in->chunk_count = 0;
+
+	if (enc->is_float) {
+		in->kind = A2L_FLOAT;
+		if (legacy)
+			return SR_OK;
+#ifdef WORDS_BIGENDIAN
+		host_float = enc->is_bigendian;
+#else
+		host_float = !enc->is_bigendian;
+#endif
+		host_float &= enc->unitsize == sizeof(float);
+		in->convert = !host_float ||
+			enc->scale.p != enc->scale.q || enc->offset.p != 0;
+		return SR_OK;
+	}
+	/* Raw integer comparison for single byte and little endian data. */
+	if (legacy || (enc->is_bigendian && enc->unitsize != 1)) {
+		in->kind = A2L_FLOAT;
+		in->convert = TRUE;
+		return SR_OK;
+	}
+	switch (enc->unitsize) {
+	case sizeof(uint8_t):
+		in->kind = enc->is_signed ? A2L_I8 : A2L_U8;
+		break;
+	case sizeof(uint16_t):
+		in->kind = enc->is_signed ? A2L_I16 : A2L_U16;
+		break;
+	case sizeof(uint32_t):
+		in->kind = enc->is_signed ? A2L_I32 : A2L_U32;
+		break;
+	default:
+		in->kind = A2L_FLOAT;
+		in->convert = TRUE;
+		break;
+	}
+
+	return SR_OK;
+}
+
+/* Make sure that floats for the samples at [start, start + count) exist. */
+static int a2l_input_fetch(struct a2l_input *in, size_t start, size_t count)
+{
+	struct sr_datafeed_analog chunk_analog;
+	struct sr_analog_meaning chunk_meaning;
+	GSList chunk_channel;
+	int ret;
+
+	if (!in->convert)
+		return SR_OK;
+	if (!in->analog->meaning)
+		return SR_ERR_ARG;
+	if (start >= in->chunk_start &&
+			start + count <= in->chunk_start + in->chunk_count)
+		return SR_OK;
+
+	/* Convert a chunk of single channel data, starting at 'start'. */
+	chunk_analog = *in->analog;
+	chunk_meaning = *in->analog->meaning;
+	chunk_channel.data = NULL;
+	chunk_channel.next = NULL;
+	chunk_meaning.channels = &chunk_channel;
+	chunk_analog.meaning = &chunk_meaning;
+	chunk_analog.data = (void *)(in->data + start * in->unitsize);
+	chunk_analog.num_samples = MIN(A2L_CHUNK, in->count - start);
+	ret = sr_analog_to_float(&chunk_analog, in->chunk);
+	if (ret != SR_OK)
+		return ret;
+	in->chunk_start = start;
+	in->chunk_count = chunk_analog.num_samples;
+
+	return SR_OK;
+}
+
+static void a2l_cond_init(struct a2l_cond *c, const struct a2l_input *in,
+		float threshold, gboolean strict, gboolean invert)
+{
+	const struct sr_analog_encoding *enc;
+	double scale, offset, raw;
+
+	memset(c, 0, sizeof(*c));
+	c->value = threshold;
+	c->strict = strict;
+	c->invert = invert;
+	if (in->kind == A2L_FLOAT)
+		return;
+
+	/*
+	 * Translate the threshold to the raw integer domain. For positive
+	 * scale factors, "value >= thr" becomes "raw >= ceil(x)" and
+	 * "value > thr" becomes "raw >= floor(x) + 1". Negative factors
+	 * turn the comparison around, which inverts the result.
+	 */
+	enc = in->analog->encoding;
+	scale = (double)enc->scale.p / enc->scale.q;
+	offset = (double)enc->offset.p / enc->offset.q;
+	if (scale == 0.0 || isnan(threshold)) {
+		c->is_const = TRUE;
+		c->const_result = strict ? offset > threshold : offset >= threshold;
+		c->const_result ^= invert;
+		return;
+	}
+	raw = (threshold - offset) / scale;
+	raw = CLAMP(raw, -(double)(1LL << 40), (double)(1LL << 40));
+	if (scale > 0) {
+		c->raw = strict ? (int64_t)floor(raw) + 1 : (int64_t)ceil(raw);
+	} else {
+		c->raw = strict ? (int64_t)ceil(raw) : (int64_t)floor(raw) + 1;
+		c->invert = !invert;
+	}
+}
+
+static inline int64_t a2l_read_int(const struct a2l_input *in, size_t idx)
+{
+	const uint8_t *p;
+
+	p = in->data + idx * in->unitsize;
+	switch (in->kind) {
+	case A2L_I8:
+		return read_i8(p);
+	case A2L_U8:
+		return read_u8(p);
+	case A2L_I16:
+		return read_i16le(p);
+	case A2L_U16:
+		return read_u16le(p);
+	case A2L_I32:
+		return read_i32le(p);
+	default:
+		return read_u32le(p);
+	}
+}
+
+#ifdef __SSE2__
+/*
+ * Compare 16 raw samples at idx against the threshold, return a mask
+ * with one bit per sample. The threshold must be within the type's
+ * range, the caller checked for constant results. Unsigned data gets
+ * biased, since SSE2 only has signed compares.
+ */
+static inline int a2l_cmp16(const struct a2l_input *in, size_t idx,
+		int64_t raw)
+{
+	const uint8_t *p;
+	__m128i v0, v1, v2, v3, t, bias;
+
+	p = in->data + idx * in->unitsize;
+	switch (in->kind) {
+	case A2L_I8:
+	case A2L_U8:
+		bias = _mm_set1_epi8(in->kind == A2L_U8 ? (char)0x80 : 0);
+		if (in->kind == A2L_U8)
+			raw -= 0x80;
+		t = _mm_set1_epi8((char)(raw - 1));
+		v0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p), bias);
+		return _mm_movemask_epi8(_mm_cmpgt_epi8(v0, t));
+	case A2L_I16:
+	case A2L_U16:
+		bias = _mm_set1_epi16(in->kind == A2L_U16 ? (short)0x8000 : 0);
+		if (in->kind == A2L_U16)
+			raw -= 0x8000;
+		t = _mm_set1_epi16((short)(raw - 1));
+		v0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p), bias);
+		v1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + 16)), bias);
+		v0 = _mm_packs_epi16(_mm_cmpgt_epi16(v0, t), _mm_cmpgt_epi16(v1, t));
+		return _mm_movemask_epi8(v0);
+	default:
+		bias = _mm_set1_epi32(in->kind == A2L_U32 ? (int)0x80000000 : 0);
+		if (in->kind == A2L_U32)
+			raw -= 0x80000000LL;
+		t = _mm_set1_epi32((int)(raw - 1));
+		v0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p), bias);
+		v1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + 16)), bias);
+		v2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + 32)), bias);
+		v3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + 48)), bias);
+		v0 = _mm_packs_epi32(_mm_cmpgt_epi32(v0, t), _mm_cmpgt_epi32(v1, t));
+		v2 = _mm_packs_epi32(_mm_cmpgt_epi32(v2, t), _mm_cmpgt_epi32(v3, t));
+		return _mm_movemask_epi8(_mm_packs_epi16(v0, v2));
+	}
+}
+
+static inline int a2l_cmp16_float(const float *values, float thr,
+		gboolean strict, gboolean invert)
+{
+	__m128 t, c0, c1, c2, c3;
+	__m128i p0, p1;
+
+	t = _mm_set1_ps(thr);
+	if (invert && strict) {
+		c0 = _mm_cmple_ps(_mm_loadu_ps(&values[0]), t);
+		c1 = _mm_cmple_ps(_mm_loadu_ps(&values[4]), t);
+		c2 = _mm_cmple_ps(_mm_loadu_ps(&values[8]), t);
+		c3 = _mm_cmple_ps(_mm_loadu_ps(&values[12]), t);
+	} else if (invert) {
+		c0 = _mm_cmplt_ps(_mm_loadu_ps(&values[0]), t);
+		c1 = _mm_cmplt_ps(_mm_loadu_ps(&values[4]), t);
+		c2 = _mm_cmplt_ps(_mm_loadu_ps(&values[8]), t);
+		c3 = _mm_cmplt_ps(_mm_loadu_ps(&values[12]), t);
+	} else if (strict) {
+		c0 = _mm_cmpgt_ps(_mm_loadu_ps(&values[0]), t);
+		c1 = _mm_cmpgt_ps(_mm_loadu_ps(&values[4]), t);
+		c2 = _mm_cmpgt_ps(_mm_loadu_ps(&values[8]), t);
+		c3 = _mm_cmpgt_ps(_mm_loadu_ps(&values[12]), t);
+	} else {
+		c0 = _mm_cmpge_ps(_mm_loadu_ps(&values[0]), t);
+		c1 = _mm_cmpge_ps(_mm_loadu_ps(&values[4]), t);
+		c2 = _mm_cmpge_ps(_mm_loadu_ps(&values[8]), t);
+		c3 = _mm_cmpge_ps(_mm_loadu_ps(&values[12]), t);
+	}
+	p0 = _mm_packs_epi32(_mm_castps_si128(c0), _mm_castps_si128(c1));
+	p1 = _mm_packs_epi32(_mm_castps_si128(c2), _mm_castps_si128(c3));
+
+	return _mm_movemask_epi8(_mm_packs_epi16(p0, p1));
+}
+#endif
+
+/* Type range of raw integer samples. */
+static void a2l_int_range(enum a2l_kind kind, int64_t *min, int64_t *max)
+{
+	switch (kind) {
+	case A2L_I8:
+		*min = INT8_MIN;
+		*max = INT8_MAX;
+		break;
+	case A2L_U8:
+		*min = 0;
+		*max = UINT8_MAX;
+		break;
+	case A2L_I16:
+		*min = INT16_MIN;
+		*max = INT16_MAX;
+		break;
+	case A2L_U16:
+		*min = 0;
+		*max = UINT16_MAX;
+		break;
+	case A2L_I32:
+		*min = INT32_MIN;
+		*max = INT32_MAX;
+		break;
+	default:
+		*min = 0;
+		*max = UINT32_MAX;
+		break;
+	}
+}
+
+static inline gboolean a2l_cmp_float(float value, const struct a2l_cond *c)
+{
+	if (c->invert)
+		return c->strict ? value <= c->value : value < c->value;
+
+	return c->strict ? value > c->value : value >= c->value;
+}
+
+/* Evaluate the condition for up to 64 samples, starting at idx. */
+static int a2l_eval(struct a2l_input *in, const struct a2l_cond *c,
+		size_t idx, size_t count, uint64_t *mask)
+{
+	const float *values;
+	uint64_t bits;
+	int64_t min, max;
+	size_t i;
+	int ret;
+
+	bits = 0;
+	if (c->is_const) {
+		*mask = c->const_result ? ~(uint64_t)0 : 0;
+		return SR_OK;
+	}
+
+	i = 0;
+	if (in->kind == A2L_FLOAT) {
+		ret = a2l_input_fetch(in, idx, count);
+		if (ret != SR_OK)
+			return ret;
+		if (in->convert)
+			values = &in->chunk[idx - in->chunk_start];
+		else
+			values = (const float *)(const void *)in->data + idx;
+#ifdef __SSE2__
+		for (; i + 16 <= count; i += 16)
+			bits |= (uint64_t)a2l_cmp16_float(&values[i],
+				c->value, c->strict, c->invert) << i;
+#endif
+		for (; i < count; i++) {
+			if (a2l_cmp_float(values[i], c))
+				bits |= (uint64_t)1 << i;
+		}
+	} else {
+		a2l_int_range(in->kind, &min, &max);
+		if (c->raw <= min) {
+			bits = ~(uint64_t)0;
+			i = count;
+		} else if (c->raw > max) {
+			i = count;
+		}
+#ifdef __SSE2__
+		for (; i + 16 <= count; i += 16)
+			bits |= (uint64_t)a2l_cmp16(in, idx + i, c->raw) << i;
+#endif
+		for (; i < count; i++) {
+			if (a2l_read_int(in, idx + i) >= c->raw)
+				bits |= (uint64_t)1 << i;
+		}
+		if (c->invert)
+			bits = ~bits;
+	}
+	*mask = bits;
+
+	return SR_OK;
+}
+
+/*
+ * Store comparison results. Either as individual bits at a position
+ * within logic samples of 'unitsize' bytes, or (when unitsize is zero)
+ * as bytes with values 0 and 1.
+ */
+static void a2l_store(uint8_t *output, size_t unitsize, size_t bitpos,
+		size_t idx, uint64_t mask, size_t count)
+{
+	uint8_t *p, bit;
+	size_t i;
+
+	if (!unitsize) {
+		for (i = 0; i < count; i++)
+			output[idx + i] = (mask >> i) & 1;
+		return;
+	}
+
+	p = output + idx * unitsize + bitpos / 8;
+	bit = 1 << (bitpos % 8);
+	for (i = 0; i < count; i++, p += unitsize) {
+		if ((mask >> i) & 1)
+			*p |= bit;
+		else
+			*p &= ~bit;
+	}
+}
+
+static int a2l_threshold(const struct sr_datafeed_analog *analog,
+		float threshold, uint8_t *output, size_t unitsize,
+		size_t bitpos, uint64_t count, gboolean legacy)
+{
+	struct a2l_input in;
+	struct a2l_cond cond;
+	uint64_t idx, mask;
+	size_t block;
+	int ret;
+
+	ret = a2l_input_init(&in, analog, count, legacy);
+	if (ret != SR_OK)
+		return ret;
+	a2l_cond_init(&cond, &in, threshold, FALSE, FALSE);
+
+	for (idx = 0; idx < count; idx += block) {
+		block = MIN(count - idx, A2L_BLOCK);
+		ret = a2l_eval(&in, &cond, idx, block, &mask);
+		if (ret != SR_OK)
+			return ret;
+		a2l_store(output, unitsize, bitpos, idx, mask, block);
+	}
+
+	return SR_OK;
+}
+
+static int a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
+		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
+		size_t unitsize, size_t bitpos, uint64_t count, gboolean legacy)
+{
+	struct a2l_input in;
+	struct a2l_cond below, above;
+	uint64_t idx, lo_mask, hi_mask, mask;
+	size_t block, i;
+	int ret;
+
+	ret = a2l_input_init(&in, analog, count, legacy);
+	if (ret != SR_OK)
+		return ret;
+	/*
+	 * "Below" is "value < lo", "above" is "value > hi". NaN is neither,
+	 * and keeps the previous state.
+	 */
+	a2l_cond_init(&below, &in, lo_thr, FALSE, TRUE);
+	a2l_cond_init(&above, &in, hi_thr, TRUE, FALSE);
+
+	for (idx = 0; idx < count; idx += block) {
+		block = MIN(count - idx, A2L_BLOCK);
+		ret = a2l_eval(&in, &below, idx, block, &lo_mask);
+		if (ret != SR_OK)
+			return ret;
+		ret = a2l_eval(&in, &above, idx, block, &hi_mask);
+		if (ret != SR_OK)
+			return ret;
+		if (block < A2L_BLOCK) {
+			lo_mask &= ((uint64_t)1 << block) - 1;
+			hi_mask &= ((uint64_t)1 << block) - 1;
+		}
+
+		/* Most blocks don't cross a threshold, keep the state. */
+		if (!lo_mask && !hi_mask) {
+			mask = *state ? ~(uint64_t)0 : 0;
+		} else {
+			mask = 0;
+			for (i = 0; i < block; i++) {
+				if ((lo_mask >> i) & 1)
+					*state = 0;
+				else if ((hi_mask >> i) & 1)
+					*state = 1;
+				mask |= (uint64_t)*state << i;
+			}
+		}
+		a2l_store(output, unitsize, bitpos, idx, mask, block);
+	}
+
+	return SR_OK;
+}
+
 /**
  * Convert analog values to logic values by using a fixed threshold.
  *
@@ -44,24 +537,7 @@
 SR_API int sr_a2l_threshold(const struct sr_datafeed_analog *analog,
 		float threshold, uint8_t *output, uint64_t count)
 {
-	float *input;
-
-	if (!analog->encoding->is_float) {
-		input = g_try_malloc(sizeof(float) * count);
-		if (!input)
-			return SR_ERR;
-
-		sr_analog_to_float(analog, input);
-	} else
-		input = analog->data;
-
-	for (uint64_t i = 0; i < count; i++)
-		output[i] = (input[i] >= threshold) ? 1 : 0;
-
-	if (!analog->encoding->is_float)
-		g_free(input);
-
-	return SR_OK;
+	return a2l_threshold(analog, threshold, output, 0, 0, count, TRUE);
 }
 
 /**
@@ -82,28 +558,331 @@ SR_API int sr_a2l_schmitt_trigger(const struct sr_datafeed_analog *analog,
 		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
 		uint64_t count)
 {
-	float *input;
+	return a2l_schmitt_trigger(analog, lo_thr, hi_thr, state, output,
+		0, 0, count, TRUE);
+}
 
-	if (!analog->encoding->is_float) {
-		input = g_try_malloc(sizeof(float) * count);
-		if (!input)
-			return SR_ERR;
+/**
+ * Convert analog values to bits in logic samples by using a fixed threshold.
+ *
+ * Other bits of the logic samples are not modified. Several analog
+ * channels can be converted into one stream of logic samples that way.
+ * Integer input is compared in its raw form, the threshold gets
+ * translated by the encoding's scale and offset. No memory gets
+ * allocated.
+ *
+ * @param[in] analog The analog input values, of a single channel.
+ * @param[in] threshold The threshold to use.
+ * @param[in,out] output The logic samples. Must provide space for count
+ *                       samples of unitsize bytes.
+ * @param[in] unitsize The size of a logic sample in bytes.
+ * @param[in] bitpos The bit position within a logic sample.
+ * @param[in] count The number of samples to process.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Unsupported encoding.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_a2l_threshold_bits(const struct sr_datafeed_analog *analog,
+		float threshold, uint8_t *output, size_t unitsize,
+		size_t bitpos, uint64_t count)
+{
+	if (!output || !unitsize || bitpos >= unitsize * 8)
+		return SR_ERR_ARG;
 
-		sr_analog_to_float(analog, input);
-	} else
-		input = analog->data;
+	return a2l_threshold(analog, threshold, output, unitsize, bitpos,
+		count, FALSE);
+}
 
-	for (uint64_t i = 0; i < count; i++) {
-		if (input[i] < lo_thr)
-			*state = 0;
-		else if (input[i] > hi_thr)
-			*state = 1;
+/**
+ * Convert analog values to bits in logic samples by using a Schmitt-trigger
+ * algorithm.
+ *
+ * See sr_a2l_schmitt_trigger() for the algorithm, and
+ * sr_a2l_threshold_bits() for the output format.
+ *
+ * @param[in] analog The analog input values, of a single channel.
+ * @param[in] lo_thr The low threshold - result becomes 0 below it.
+ * @param[in] hi_thr The high threshold - result becomes 1 above it.
+ * @param[in,out] state The internal converter state.
+ * @param[in,out] output The logic samples. Must provide space for count
+ *                       samples of unitsize bytes.
+ * @param[in] unitsize The size of a logic sample in bytes.
+ * @param[in] bitpos The bit position within a logic sample.
+ * @param[in] count The number of samples to process.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR Unsupported encoding.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_a2l_schmitt_trigger_bits(const struct sr_datafeed_analog *analog,
+		float lo_thr, float hi_thr, uint8_t *state, uint8_t *output,
+		size_t unitsize, size_t bitpos, uint64_t count)
+{
+	if (!state || !output || !unitsize || bitpos >= unitsize * 8)
+		return SR_ERR_ARG;
 
-		output[i] = *state;
+	return a2l_schmitt_trigger(analog, lo_thr, hi_thr, state, output,
+		unitsize, bitpos, count, FALSE);
+}
+
+/*
+ * Bit matrix transposition: bit j of row i becomes bit i of row j.
+ *
+ * Logic analyzers which transfer one word per channel, with subsequent
+ * samples of that channel in subsequent bits of the word, need this to
+ * get the usual representation of one unit per sample. Callers put the
+ * channel words in the rows which correspond to the channels' bit
+ * positions in the logic data, and zero the rows of disabled channels.
+ * The transposed row j then is the sample of bit position j in the
+ * input words.
+ *
+ * The scalar version swaps off-diagonal blocks of halving size, the
+ * SSE2 version gathers bytes of all rows into registers and extracts
+ * one column at a time with the movemask instruction.
+ */
+
+/**
+ * Transpose a 16x16 bit matrix in place.
+ *
+ * @param[in,out] m The matrix rows.
+ *
+ * @private
+ */
+SR_PRIV void sr_bits_transpose_16x16(uint16_t m[16])
+{
+#ifdef __SSE2__
+	__m128i a, b, lo, hi, low_bytes;
+	int bit;
+
+	a = _mm_loadu_si128((const __m128i *)&m[0]);
+	b = _mm_loadu_si128((const __m128i *)&m[8]);
+	low_bytes = _mm_set1_epi16(0x00ff);
+	lo = _mm_packus_epi16(_mm_and_si128(a, low_bytes),
+		_mm_and_si128(b, low_bytes));
+	hi = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+	for (bit = 7; bit >= 0; bit--) {
+		m[bit] = _mm_movemask_epi8(lo);
+		m[8 + bit] = _mm_movemask_epi8(hi);
+		lo = _mm_slli_epi64(lo, 1);
+		hi = _mm_slli_epi64(hi, 1);
 	}
+#else
+	unsigned int j, k;
+	uint16_t mask, t;
 
-	if (!analog->encoding->is_float)
-		g_free(input);
+	for (j = 8, mask = 0x00ff; j; j >>= 1, mask ^= mask << j) {
+		for (k = 0; k < 16; k = (k + j + 1) & ~j) {
+			t = ((m[k] >> j) ^ m[k + j]) & mask;
+			m[k] ^= t << j;
+			m[k + j] ^= t;
+		}
+	}
+#endif
+}
 
-	return SR_OK;
+/**
+ * Transpose a 32x32 bit matrix in place.
+ *
+ * @param[in,out] m The matrix rows.
+ *
+ * @private
+ */
+SR_PRIV void sr_bits_transpose_32x32(uint32_t m[32])
+{
+#ifdef __SSE2__
+	__m128i v[8], s[8], b0, b1, low_byte;
+	uint32_t t[32];
+	int i, byte, bit;
+
+	for (i = 0; i < 8; i++)
+		v[i] = _mm_loadu_si128((const __m128i *)&m[4 * i]);
+	low_byte = _mm_set1_epi32(0xff);
+	for (byte = 0; byte < 4; byte++) {
+		for (i = 0; i < 8; i++)
+			s[i] = _mm_and_si128(_mm_srli_epi32(v[i], 8 * byte),
+				low_byte);
+		b0 = _mm_packus_epi16(_mm_packs_epi32(s[0], s[1]),
+			_mm_packs_epi32(s[2], s[3]));
+		b1 = _mm_packus_epi16(_mm_packs_epi32(s[4], s[5]),
+			_mm_packs_epi32(s[6], s[7]));
+		for (bit = 7; bit >= 0; bit--) {
+			t[8 * byte + bit] = (uint32_t)_mm_movemask_epi8(b0) |
+				(uint32_t)_mm_movemask_epi8(b1) << 16;
+			b0 = _mm_slli_epi64(b0, 1);
+			b1 = _mm_slli_epi64(b1, 1);
+		}
+	}
+	memcpy(m, t, sizeof(t));
+#else
+	unsigned int j, k;
+	uint32_t mask, t;
+
+	for (j = 16, mask = 0x0000ffff; j; j >>= 1, mask ^= mask << j) {
+		for (k = 0; k < 32; k = (k + j + 1) & ~j) {
+			t = ((m[k] >> j) ^ m[k + j]) & mask;
+			m[k] ^= t << j;
+			m[k + j] ^= t;
+		}
+	}
+#endif
+}
+
+/**
+ * Replicate one logic sample to fill a range of samples.
+ *
+ * @param[out] wrptr The output buffer, count * unitsize bytes.
+ * @param[in] value The sample value, unitsize bytes.
+ * @param[in] unitsize The size of a logic sample in bytes.
+ * @param[in] count The number of samples to write.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_fill_repeat(uint8_t *wrptr, const uint8_t *value,
+	size_t unitsize, size_t count)
+{
+	size_t done, copy;
+
+	if (!count)
+		return;
+	if (unitsize == 1) {
+		memset(wrptr, value[0], count);
+		return;
+	}
+
+	/* Double the filled range in each step, until complete. */
+	memcpy(wrptr, value, unitsize);
+	done = 1;
+	while (done < count) {
+		copy = MIN(done, count - done);
+		memcpy(&wrptr[done * unitsize], wrptr, copy * unitsize);
+		done += copy;
+	}
+}
+
+/**
+ * Get the number of samples in run length encoded logic data.
+ *
+ * @param[in] rle The run length encoded logic data.
+ *
+ * @returns The sum of all runs' lengths.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_logic_rle_length(const struct sr_datafeed_logic_rle *rle)
+{
+	uint64_t run, length;
+
+	if (!rle)
+		return 0;
+
+	length = 0;
+	for (run = 0; run < rle->run_count; run++)
+		length += rle->lengths[run];
+
+	return length;
+}
+
+/**
+ * Expand run length encoded logic data to individual samples.
+ *
+ * Consumers which only handle SR_DF_LOGIC data can convert SR_DF_LOGIC_RLE
+ * payloads in chunks of a size of their choice. Start with @a run and
+ * @a offset set to zero, and call this routine until it returns zero.
+ *
+ * @param[in] rle The run length encoded logic data.
+ * @param[in,out] run The index of the run to continue with.
+ * @param[in,out] offset The number of the run's samples which were
+ *                       expanded before.
+ * @param[out] buffer The logic samples. Must provide space for count
+ *                    samples of the payload's unitsize.
+ * @param[in] count The maximum number of samples to expand.
+ *
+ * @returns The number of samples which were written to the buffer.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_logic_rle_expand(const struct sr_datafeed_logic_rle *rle,
+	uint64_t *run, uint64_t *offset, uint8_t *buffer, uint64_t count)
+{
+	const uint8_t *values;
+	uint64_t done, copy;
+
+	if (!rle || !run || !offset || !buffer)
+		return 0;
+
+	values = rle->values;
+	done = 0;
+	while (done < count && *run < rle->run_count) {
+		if (*offset >= rle->lengths[*run]) {
+			(*run)++;
+			*offset = 0;
+			continue;
+		}
+		copy = MIN(count - done, rle->lengths[*run] - *offset);
+		sr_logic_fill_repeat(&buffer[done * rle->unitsize],
+			&values[*run * rle->unitsize], rle->unitsize, copy);
+		*offset += copy;
+		done += copy;
+	}
+
+	return done;
+}
+
+/**
+ * Expand run length encoded logic data to SR_DF_LOGIC packets.
+ *
+ * @param[in] rle The run length encoded logic data.
+ * @param[in] cb Gets invoked for each packet of expanded data.
+ * @param[in] cb_data Caller provided context for the callback.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_MALLOC Out of memory.
+ * @retval other The first error which the callback returned.
+ *
+ * The packets hold up to SR_LOGIC_RLE_CHUNK bytes each, regardless of
+ * the number of samples which the payload represents.
+ *
+ * @private
+ */
+SR_PRIV int sr_logic_rle_unpack(const struct sr_datafeed_logic_rle *rle,
+	sr_logic_rle_chunk_cb cb, void *cb_data)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint64_t run, offset, total, chunk, count;
+	uint8_t *buffer;
+	int ret;
+
+	if (!rle || !cb || !rle->unitsize)
+		return SR_ERR_ARG;
+
+	total = sr_logic_rle_length(rle);
+	if (!total)
+		return SR_OK;
+	chunk = MIN(total, MAX(SR_LOGIC_RLE_CHUNK / rle->unitsize, 1));
+	buffer = g_try_malloc(chunk * rle->unitsize);
+	if (!buffer)
+		return SR_ERR_MALLOC;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = rle->unitsize;
+	logic.data = buffer;
+	run = offset = 0;
+	ret = SR_OK;
+	while (ret == SR_OK) {
+		count = sr_logic_rle_expand(rle, &run, &offset, buffer, chunk);
+		if (!count)
+			break;
+		logic.length = count * rle->unitsize;
+		ret = cb(&packet, cb_data);
+	}
+	g_free(buffer);
+
+	return ret;
 }
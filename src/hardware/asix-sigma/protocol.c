@@ -1260,34 +1260,62 @@ static int flush_submit_buffer(struct dev_context *devc)
 	return SR_OK;
 }
 
+/*
+ * Check whether the user specified sample count limit was reached.
+ * Does not apply when triggers are involved, all of the capture
+ * gets submitted then.
+ */
+static gboolean submit_limit_reached(struct dev_context *devc,
+	uint64_t *remain)
+{
+	gboolean exceeded;
+
+	*remain = 0;
+	if (devc->use_triggers)
+		return FALSE;
+	sr_sw_limits_get_remain(&devc->limit.submit,
+		remain, NULL, NULL, &exceeded);
+
+	return exceeded;
+}
+
 static int addto_submit_buffer(struct dev_context *devc,
 	uint16_t sample, size_t count)
 {
 	struct submit_buffer *buffer;
-	struct sr_sw_limits *limits;
+	uint8_t value[sizeof(sample)];
+	uint64_t remain;
+	size_t space;
 	int ret;
 
 	buffer = devc->buffer;
-	limits = &devc->limit.submit;
-	if (!devc->use_triggers && sr_sw_limits_check(limits))
-		count = 0;
 
 	/*
-	 * Individually accumulate and check each sample, such that
-	 * accumulation between flushes won't exceed local storage, and
-	 * enforcement of user specified limits is exact.
+	 * Clip the count to the remainder of the sample count limit,
+	 * such that enforcement of user specified limits is exact.
+	 * Then fill the buffer in blocks which won't exceed its space
+	 * until the next flush, and account the block's samples at once.
 	 */
-	while (count--) {
-		write_u16le_inc(&buffer->write_pointer, sample);
-		buffer->curr_samples++;
+	if (submit_limit_reached(devc, &remain))
+		return SR_OK;
+	if (remain && count > remain)
+		count = remain;
+
+	write_u16le(value, sample);
+	while (count) {
+		space = buffer->max_samples - buffer->curr_samples;
+		space = MIN(space, count);
+		sr_logic_fill_repeat(buffer->write_pointer, value,
+			buffer->unit_size, space);
+		buffer->write_pointer += space * buffer->unit_size;
+		buffer->curr_samples += space;
+		sr_sw_limits_update_samples_read(&devc->limit.submit, space);
+		count -= space;
 		if (buffer->curr_samples == buffer->max_samples) {
 			ret = flush_submit_buffer(devc);
 			if (ret != SR_OK)
 				return ret;
 		}
-		sr_sw_limits_update_samples_read(limits, 1);
-		if (!devc->use_triggers && sr_sw_limits_check(limits))
-			break;
 	}
 
 	return SR_OK;
@@ -1932,6 +1960,11 @@ static int decode_chunk_ts(struct dev_context *devc,
 	size_t clusters_in_line;
 	size_t events_in_cluster;
 	size_t cluster;
+	uint64_t remain;
+
+	/* Nothing left to do when the sample count limit was reached. */
+	if (submit_limit_reached(devc, &remain))
+		return SR_OK;
 
 	clusters_in_line = events_in_line;
 	clusters_in_line += EVENTS_PER_CLUSTER - 1;
@@ -69,6 +69,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_FREE_RUNNING | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const uint32_t devopts_cg_logic[] = {
@@ -93,6 +94,8 @@ static const int32_t trigger_matches[] = {
 	SR_TRIGGER_RISING,
 	SR_TRIGGER_FALLING,
 	SR_TRIGGER_EDGE,
+	SR_TRIGGER_OVER,
+	SR_TRIGGER_UNDER,
 };
 
 static const uint64_t samplerates[] = {
@@ -148,6 +151,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	devc->limit_frames = limit_frames;
 	devc->capture_ratio = 20;
 	devc->stl = NULL;
+	devc->sta = NULL;
 
 	if (num_logic_channels > 0) {
 		/* Logic channels, all in one channel group. */
@@ -265,6 +269,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_AVG_SAMPLES:
 		*data = g_variant_new_uint64(devc->avg_samples);
 		break;
+	case SR_CONF_FREE_RUNNING:
+		*data = g_variant_new_boolean(devc->free_running);
+		break;
 	case SR_CONF_MEASURED_QUANTITY:
 		if (!cg)
 			return SR_ERR_CHANNEL_GROUP;
@@ -357,6 +364,10 @@ static int config_set(uint32_t key, GVariant *data,
 		devc->avg_samples = g_variant_get_uint64(data);
 		sr_dbg("Setting averaging rate to %" PRIu64, devc->avg_samples);
 		break;
+	case SR_CONF_FREE_RUNNING:
+		devc->free_running = g_variant_get_boolean(data);
+		sr_dbg("%s free running mode", devc->free_running ? "Enabling" : "Disabling");
+		break;
 	case SR_CONF_MEASURED_QUANTITY:
 		if (!cg)
 			return SR_ERR_CHANNEL_GROUP;
@@ -489,6 +500,56 @@ static int config_list(uint32_t key, GVariant **data,
 	return SR_OK;
 }
 
+/* The channel of the trigger's first match. */
+static struct sr_channel *trigger_first_channel(struct sr_trigger *trigger)
+{
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+
+	if (!trigger->stages)
+		return NULL;
+	stage = trigger->stages->data;
+	if (!stage->matches)
+		return NULL;
+	match = stage->matches->data;
+
+	return match->channel;
+}
+
+static int setup_analog_trigger(const struct sr_dev_inst *sdi,
+		struct sr_trigger *trigger, struct sr_channel *trigger_ch,
+		int pre_trigger_samples)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	if (devc->avg) {
+		sr_err("Analog triggers don't support averaging.");
+		return SR_ERR_NA;
+	}
+	if (!trigger_ch->enabled) {
+		sr_err("Analog trigger channel %s is disabled.",
+			trigger_ch->name);
+		return SR_ERR_ARG;
+	}
+
+	devc->sta_queue = feed_queue_analog_alloc(sdi, ANALOG_BUFSIZE,
+			DEFAULT_ANALOG_ENCODING_DIGITS, trigger_ch);
+	if (!devc->sta_queue)
+		return SR_ERR_MALLOC;
+	devc->sta = soft_trigger_analog_new(sdi, trigger,
+			pre_trigger_samples, devc->sta_queue);
+	if (!devc->sta) {
+		feed_queue_analog_free(devc->sta_queue);
+		devc->sta_queue = NULL;
+		return SR_ERR_ARG;
+	}
+	devc->sta_ch = trigger_ch;
+
+	return SR_OK;
+}
+
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -497,13 +558,28 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	int bitpos;
 	uint8_t mask;
 	struct sr_trigger *trigger;
+	struct sr_channel *trigger_ch;
+	int ret;
 
 	devc = sdi->priv;
 	devc->sent_samples = 0;
 	devc->sent_frame_samples = 0;
+	devc->skipped_samples = 0;
+	devc->round_skipped = 0;
+	devc->trigger_pre_samples = 0;
 
 	/* Setup triggers */
-	if ((trigger = sr_session_trigger_get(sdi->session))) {
+	trigger = sr_session_trigger_get(sdi->session);
+	trigger_ch = trigger ? trigger_first_channel(trigger) : NULL;
+	if (trigger_ch && trigger_ch->type == SR_CHANNEL_ANALOG) {
+		int pre_trigger_samples = 0;
+		if (devc->limit_samples > 0)
+			pre_trigger_samples = (devc->capture_ratio * devc->limit_samples) / 100;
+		ret = setup_analog_trigger(sdi, trigger, trigger_ch,
+				pre_trigger_samples);
+		if (ret != SR_OK)
+			return ret;
+	} else if (trigger) {
 		int pre_trigger_samples = 0;
 		if (devc->limit_samples > 0)
 			pre_trigger_samples = (devc->capture_ratio * devc->limit_samples) / 100;
@@ -534,6 +610,13 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		ch = l->data;
 		if (!ch->enabled)
 			continue;
+		/*
+		 * Only the analog trigger channel has pre-trigger data.
+		 * Leave the other channels out of the acquisition, but
+		 * keep the user's channel configuration.
+		 */
+		if (devc->sta && ch != devc->sta_ch)
+			continue;
 		if (ch->type == SR_CHANNEL_ANALOG) {
 			devc->enabled_analog_channels++;
 			continue;
@@ -561,7 +644,13 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		devc->first_partial_logic_index,
 		devc->first_partial_logic_mask);
 
-	sr_session_source_add(sdi->session, -1, 0, 100,
+	/* Free running mode sends from a precomputed pattern. */
+	if (devc->free_running && devc->num_logic_channels > 0
+			&& devc->enabled_logic_channels)
+		demo_generate_logic_table((struct sr_dev_inst *)sdi);
+
+	sr_session_source_add(sdi->session, -1, 0,
+			devc->free_running ? 0 : 100,
 			demo_prepare_data, (struct sr_dev_inst *)sdi);
 
 	std_session_send_df_header(sdi);
@@ -572,6 +661,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	/* We use this timestamp to decide how many more samples to send. */
 	devc->start_us = g_get_monotonic_time();
 	devc->spent_us = 0;
+	devc->sent_bytes = 0;
 	devc->step = 0;
 
 	return SR_OK;
@@ -580,10 +670,23 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
+	double elapsed;
 
 	sr_session_source_remove(sdi->session, -1);
 
 	devc = sdi->priv;
+	if (devc->free_running) {
+		elapsed = (g_get_monotonic_time() - devc->start_us) / 1e6;
+		if (elapsed > 0) {
+			sr_info("Free running: %" PRIu64 " samples, %" PRIu64
+				" bytes in %.3f s, %.0f samples/s, %.0f bytes/s.",
+				devc->sent_samples, devc->sent_bytes, elapsed,
+				devc->sent_samples / elapsed,
+				devc->sent_bytes / elapsed);
+		}
+	}
+	demo_free_logic_table(devc);
+
 	if (devc->limit_frames > 0)
 		std_session_send_df_frame_end(sdi);
 
@@ -593,6 +696,13 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 		soft_trigger_logic_free(devc->stl);
 		devc->stl = NULL;
 	}
+	if (devc->sta) {
+		soft_trigger_analog_free(devc->sta);
+		devc->sta = NULL;
+		feed_queue_analog_free(devc->sta_queue);
+		devc->sta_queue = NULL;
+		devc->sta_ch = NULL;
+	}
 
 	return SR_OK;
 }
@@ -310,7 +310,7 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 		break;
 	case PATTERN_WALKING_ONE:
 		/* j contains the value of the highest bit */
-		j = 1 << (devc->num_logic_channels - 1);
+		j = (uint64_t)1 << (devc->num_logic_channels - 1);
 		for (i = 0; i < size; i++) {
 			devc->logic_data[i] = devc->step;
 			if (devc->step == 0)
@@ -325,7 +325,7 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 	case PATTERN_WALKING_ZERO:
 		/* Same as walking one, only with inverted output */
 		/* j contains the value of the highest bit */
-		j = 1 << (devc->num_logic_channels - 1);
+		j = (uint64_t)1 << (devc->num_logic_channels - 1);
 		for (i = 0; i < size; i++) {
 			devc->logic_data[i] = ~devc->step;
 			if (devc->step == 0)
@@ -399,6 +399,176 @@ static void logic_fixup_feed(struct dev_context *devc,
 	}
 }
 
+static size_t gcd(size_t a, size_t b)
+{
+	size_t t;
+
+	while (b) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/*
+ * Determine after how many samples the logic pattern repeats. Some
+ * patterns advance per byte rather than per sample, their period in
+ * samples depends on the unit size.
+ */
+static uint64_t logic_pattern_period(struct dev_context *devc)
+{
+	size_t unitsize;
+	uint64_t bytes;
+
+	unitsize = devc->logic_unitsize;
+
+	switch (devc->logic_pattern) {
+	case PATTERN_SIGROK:
+		return sizeof(pattern_sigrok);
+	case PATTERN_RANDOM:
+		return FREE_RUNNING_RANDOM_SAMPLES;
+	case PATTERN_INC:
+		bytes = 256;
+		return bytes / gcd(bytes, unitsize);
+	case PATTERN_WALKING_ONE:
+	case PATTERN_WALKING_ZERO:
+		bytes = devc->num_logic_channels + 1;
+		return bytes / gcd(bytes, unitsize);
+	case PATTERN_SQUID:
+		return ARRAY_SIZE(pattern_squid);
+	case PATTERN_GRAYCODE:
+		if (devc->all_logic_channels_mask >= FREE_RUNNING_TABLE_MAX)
+			return FREE_RUNNING_TABLE_MAX;
+		return devc->all_logic_channels_mask + 1;
+	default:
+		return 1;
+	}
+}
+
+/*
+ * Precompute the logic pattern for free running mode. The table holds
+ * one period of the pattern plus one chunk, such that each chunk can
+ * get sent from the table directly, starting at any position within
+ * the period. Data of disabled channels is masked out upfront. Very
+ * long periods get truncated, this is acceptable for load generation.
+ */
+SR_PRIV void demo_generate_logic_table(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_logic logic;
+	size_t unitsize, period, total, done, count, gen_count;
+
+	devc = sdi->priv;
+	unitsize = devc->logic_unitsize;
+
+	period = MIN(logic_pattern_period(devc),
+		FREE_RUNNING_TABLE_MAX / unitsize);
+	devc->logic_table_chunk = MAX(1, FREE_RUNNING_BUFSIZE / unitsize);
+	devc->logic_table_period = MAX(1, period);
+	devc->logic_table_pos = 0;
+	total = devc->logic_table_period + devc->logic_table_chunk;
+	devc->logic_table = g_malloc(total * unitsize);
+
+	/* Some patterns write up to one unit beyond the requested size. */
+	gen_count = MAX(1, LOGIC_BUFSIZE / unitsize - 1);
+	devc->step = 0;
+	for (done = 0; done < total; done += count) {
+		count = MIN(total - done, gen_count);
+		logic_generator(sdi, count * unitsize);
+		memcpy(&devc->logic_table[done * unitsize],
+			devc->logic_data, count * unitsize);
+	}
+	devc->step = 0;
+
+	logic.unitsize = unitsize;
+	logic.length = total * unitsize;
+	logic.data = devc->logic_table;
+	logic_fixup_feed(devc, &logic);
+
+	sr_dbg("Logic table: period %zu, chunk %zu samples.",
+		devc->logic_table_period, devc->logic_table_chunk);
+}
+
+SR_PRIV void demo_free_logic_table(struct dev_context *devc)
+{
+	g_free(devc->logic_table);
+	devc->logic_table = NULL;
+}
+
+/* Get the next chunk of samples from the precomputed logic pattern. */
+static uint8_t *logic_table_next(struct dev_context *devc, uint64_t count)
+{
+	uint8_t *data;
+
+	data = &devc->logic_table[devc->logic_table_pos * devc->logic_unitsize];
+	devc->logic_table_pos += count;
+	devc->logic_table_pos %= devc->logic_table_period;
+
+	return data;
+}
+
+/*
+ * Check the analog packet for the trigger condition. Samples before the
+ * trigger are not sent but counted as skipped, the pre-trigger samples
+ * are sent from the trigger's own buffer when it fires.
+ */
+static void analog_trigger_check(struct sr_dev_inst *sdi,
+		struct analog_gen *ag)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_packet packet;
+	struct sr_analog_meaning *meaning;
+	float *data;
+	uint64_t count, post, room;
+	int offset, pre_trigger_samples, ret;
+
+	devc = sdi->priv;
+	meaning = ag->packet.meaning;
+	data = ag->packet.data;
+	count = ag->packet.num_samples;
+
+	devc->round_skipped += count;
+	ret = feed_queue_analog_mq_unit(devc->sta_queue,
+			meaning->mq, meaning->mqflags, meaning->unit);
+	if (ret != SR_OK) {
+		sr_err("Cannot set up pre-trigger queue: %s.", sr_strerror(ret));
+		return;
+	}
+	offset = soft_trigger_analog_check(devc->sta, data, count,
+			&pre_trigger_samples);
+	if (offset == -1)
+		return;
+	if (offset < 0) {
+		sr_err("Analog trigger check failed: %s.", sr_strerror(offset));
+		return;
+	}
+
+	devc->trigger_fired = TRUE;
+	devc->trigger_pre_samples = pre_trigger_samples;
+	devc->sent_bytes += pre_trigger_samples * sizeof(float);
+
+	/* Pre-trigger data from earlier rounds counts towards the limit. */
+	post = count - offset;
+	if (devc->limit_samples > 0) {
+		room = devc->sent_samples + pre_trigger_samples;
+		room = devc->limit_samples - MIN(devc->limit_samples, room);
+		post = MIN(post, room);
+	}
+	devc->round_skipped -= post;
+	if (!post)
+		return;
+
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &ag->packet;
+	ag->packet.data = data + offset;
+	ag->packet.num_samples = post;
+	sr_session_send(sdi, &packet);
+	devc->sent_bytes += post * sizeof(float);
+	ag->packet.data = data;
+}
+
 static void send_analog_packet(struct analog_gen *ag,
 		struct sr_dev_inst *sdi, uint64_t *analog_sent,
 		uint64_t analog_pos, uint64_t analog_todo)
@@ -416,6 +586,8 @@ static void send_analog_packet(struct analog_gen *ag,
 		return;
 
 	devc = sdi->priv;
+	if (devc->sta && ag->ch != devc->sta_ch)
+		return;
 	packet.type = SR_DF_ANALOG;
 	packet.payload = &ag->packet;
 
@@ -524,7 +696,12 @@ static void send_analog_packet(struct analog_gen *ag,
 			ag->packet.data = pattern->data + ag_pattern_pos;
 		}
 		ag->packet.num_samples = sending_now;
-		sr_session_send(sdi, &packet);
+		if (devc->sta && !devc->trigger_fired) {
+			analog_trigger_check(sdi, ag);
+		} else {
+			sr_session_send(sdi, &packet);
+			devc->sent_bytes += sending_now * sizeof(float);
+		}
 
 		/* Whichever channel group gets there first. */
 		*analog_sent = MAX(*analog_sent, sending_now);
@@ -565,6 +742,7 @@ do_send:
 		ag->packet.num_samples = 1;
 
 		sr_session_send(sdi, &packet);
+		devc->sent_bytes += sizeof(float);
 		*analog_sent = ag->num_avgs;
 
 		ag->num_avgs = 0;
@@ -584,8 +762,10 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	void *value;
 	uint64_t samples_todo, logic_done, analog_done, analog_sent, sending_now;
 	int64_t elapsed_us, limit_us, todo_us;
+	uint8_t *logic_data;
 	int64_t trigger_offset;
 	int pre_trigger_samples;
+	gboolean trigger_was_fired;
 
 	(void)fd;
 	(void)revents;
@@ -610,8 +790,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 		todo_us = MAX(0, elapsed_us - devc->spent_us);
 
 	/* How many samples are outstanding since the last round? */
-	samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
-			/ G_USEC_PER_SEC;
+	if (devc->free_running)
+		samples_todo = FREE_RUNNING_SAMPLES;
+	else
+		samples_todo = (todo_us * devc->cur_samplerate + G_USEC_PER_SEC - 1)
+				/ G_USEC_PER_SEC;
 
 	if (devc->limit_samples > 0) {
 		if (devc->limit_samples < devc->sent_samples)
@@ -634,8 +817,10 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	/* Calculate the actual time covered by this run back from the sample
 	 * count, rounded towards zero. This avoids getting stuck on a too-low
 	 * time delta with no samples being sent due to round-off.
+	 * In free running mode the wall clock time is what counts.
 	 */
-	todo_us = samples_todo * G_USEC_PER_SEC / devc->cur_samplerate;
+	if (!devc->free_running)
+		todo_us = samples_todo * G_USEC_PER_SEC / devc->cur_samplerate;
 
 	logic_done = devc->num_logic_channels > 0 ? 0 : samples_todo;
 	if (!devc->enabled_logic_channels)
@@ -645,16 +830,24 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	if (!devc->enabled_analog_channels)
 		analog_done = samples_todo;
 
+	trigger_was_fired = devc->trigger_fired;
 	while (logic_done < samples_todo || analog_done < samples_todo) {
 		/* Logic */
 		if (logic_done < samples_todo) {
-			sending_now = MIN(samples_todo - logic_done,
-					LOGIC_BUFSIZE / devc->logic_unitsize);
-			logic_generator(sdi, sending_now * devc->logic_unitsize);
+			if (devc->logic_table) {
+				sending_now = MIN(samples_todo - logic_done,
+						devc->logic_table_chunk);
+				logic_data = logic_table_next(devc, sending_now);
+			} else {
+				sending_now = MIN(samples_todo - logic_done,
+						LOGIC_BUFSIZE / devc->logic_unitsize);
+				logic_generator(sdi, sending_now * devc->logic_unitsize);
+				logic_data = devc->logic_data;
+			}
 			/* Check for trigger and send pre-trigger data if needed */
 			if (devc->stl && (!devc->trigger_fired)) {
 				trigger_offset = soft_trigger_logic_check(devc->stl,
-						devc->logic_data, sending_now * devc->logic_unitsize,
+						logic_data, sending_now * devc->logic_unitsize,
 						&pre_trigger_samples);
 				if (trigger_offset > -1) {
 					devc->trigger_fired = TRUE;
@@ -672,9 +865,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 				if (devc->trigger_fired && (trigger_offset < (int)sending_now)) {
 					/* Send after-trigger data */
 					logic.length = (sending_now - trigger_offset) * devc->logic_unitsize;
-					logic.data = devc->logic_data + trigger_offset * devc->logic_unitsize;
-					logic_fixup_feed(devc, &logic);
+					logic.data = logic_data + trigger_offset * devc->logic_unitsize;
+					if (!devc->logic_table)
+						logic_fixup_feed(devc, &logic);
 					sr_session_send(sdi, &packet);
+					devc->sent_bytes += logic.length;
 					logic_done += sending_now - trigger_offset;
 					/* End acquisition */
 					sr_dbg("Triggered, stopping acquisition.");
@@ -687,9 +882,11 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			} else if (!devc->stl) {
 				/* No trigger defined, send logic samples */
 				logic.length = sending_now * devc->logic_unitsize;
-				logic.data = devc->logic_data;
-				logic_fixup_feed(devc, &logic);
+				logic.data = logic_data;
+				if (!devc->logic_table)
+					logic_fixup_feed(devc, &logic);
 				sr_session_send(sdi, &packet);
+				devc->sent_bytes += logic.length;
 				logic_done += sending_now;
 			}
 		}
@@ -701,17 +898,39 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			g_hash_table_iter_init(&iter, devc->ch_ag);
 			while (g_hash_table_iter_next(&iter, NULL, &value)) {
 				send_analog_packet(value, sdi, &analog_sent,
-						devc->sent_samples + analog_done,
+						devc->sent_samples + devc->skipped_samples
+						+ analog_done,
 						samples_todo - analog_done);
 			}
 			analog_done += analog_sent;
+
+			/* The sample limit includes pre-trigger data, recheck it. */
+			if (devc->sta && devc->trigger_fired && !trigger_was_fired) {
+				samples_todo = analog_done;
+				if (!devc->free_running)
+					todo_us = samples_todo * G_USEC_PER_SEC
+						/ devc->cur_samplerate;
+				break;
+			}
 		}
 	}
 
 	uint64_t min = MIN(logic_done, analog_done);
+	if (devc->sta) {
+		/* Only count what was sent, keep the pattern position. */
+		min -= devc->round_skipped;
+		min += devc->trigger_pre_samples;
+		devc->skipped_samples += devc->round_skipped;
+		devc->skipped_samples -= devc->trigger_pre_samples;
+		devc->round_skipped = 0;
+		devc->trigger_pre_samples = 0;
+	}
 	devc->sent_samples += min;
 	devc->sent_frame_samples += min;
-	devc->spent_us += todo_us;
+	if (devc->free_running)
+		devc->spent_us = g_get_monotonic_time() - devc->start_us;
+	else
+		devc->spent_us += todo_us;
 
 	if (devc->limit_frames && devc->sent_frame_samples >= SAMPLES_PER_FRAME) {
 		std_session_send_df_frame_end(sdi);
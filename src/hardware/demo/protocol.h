@@ -34,6 +34,12 @@
 #define LOGIC_BUFSIZE			4096
 /* Size of the analog pattern space per channel. */
 #define ANALOG_BUFSIZE			4096
+/* Chunk size and samples per round in free running mode. */
+#define FREE_RUNNING_BUFSIZE		(64 * 1024)
+#define FREE_RUNNING_SAMPLES		(1024 * 1024)
+/* Limits the logic pattern table of free running mode. */
+#define FREE_RUNNING_TABLE_MAX		(16 * 1024 * 1024)
+#define FREE_RUNNING_RANDOM_SAMPLES	(64 * 1024)
 /* This is a development feature: it starts a new frame every n samples. */
 #define SAMPLES_PER_FRAME		1000UL
 #define DEFAULT_LIMIT_FRAMES		0
@@ -118,9 +124,11 @@ struct dev_context {
 	uint64_t limit_frames;
 	uint64_t sent_samples;
 	uint64_t sent_frame_samples; /* Number of samples that were sent for current frame. */
+	uint64_t sent_bytes;
 	int64_t start_us;
 	int64_t spent_us;
 	uint64_t step;
+	gboolean free_running;
 	/* Logic */
 	int32_t num_logic_channels;
 	size_t logic_unitsize;
@@ -128,6 +136,11 @@ struct dev_context {
 	/* There is only ever one logic channel group, so its pattern goes here. */
 	enum logic_pattern_type logic_pattern;
 	uint8_t logic_data[LOGIC_BUFSIZE];
+	/* Precomputed pattern for free running mode, one period plus a chunk. */
+	uint8_t *logic_table;
+	size_t logic_table_period;
+	size_t logic_table_chunk;
+	size_t logic_table_pos;
 	/* Analog */
 	struct analog_pattern *analog_patterns[ARRAY_SIZE(analog_pattern_str)];
 	int32_t num_analog_channels;
@@ -142,6 +155,13 @@ struct dev_context {
 	uint64_t capture_ratio;
 	gboolean trigger_fired;
 	struct soft_trigger_logic *stl;
+	struct soft_trigger_analog *sta;
+	struct feed_queue_analog *sta_queue;
+	struct sr_channel *sta_ch;
+	/* Analog samples which were generated but not sent before the trigger. */
+	uint64_t skipped_samples;
+	uint64_t round_skipped;
+	uint64_t trigger_pre_samples;
 };
 
 struct analog_gen {
@@ -162,6 +182,8 @@ struct analog_gen {
 
 SR_PRIV void demo_generate_analog_pattern(struct dev_context *devc);
 SR_PRIV void demo_free_analog_pattern(struct dev_context *devc);
+SR_PRIV void demo_generate_logic_table(struct sr_dev_inst *sdi);
+SR_PRIV void demo_free_logic_table(struct dev_context *devc);
 SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data);
 
 #endif
@@ -302,6 +302,12 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 		soft_trigger_logic_free(devc->stl);
 		devc->stl = NULL;
 	}
+
+	/* Packets which consumers still hold keep their own reference. */
+	if (devc->buffer_pool) {
+		g_async_queue_unref(devc->buffer_pool);
+		devc->buffer_pool = NULL;
+	}
 }
 
 static void free_transfer(struct libusb_transfer *transfer)
@@ -410,6 +416,51 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &packet);
 }
 
+static void release_transfer_buffer(void *buffer, void *cb_data)
+{
+	GAsyncQueue *pool;
+
+	pool = cb_data;
+	g_async_queue_push(pool, buffer);
+	g_async_queue_unref(pool);
+}
+
+/*
+ * Hand a complete transfer's buffer over to the session bus. Consumers
+ * can retain the shared packet without copying the sample data. The
+ * transfer continues with a buffer which is not referenced by packets.
+ */
+static int la_send_transfer(struct sr_dev_inst *sdi,
+	struct libusb_transfer *transfer, size_t length, size_t sample_width)
+{
+	struct dev_context *devc;
+	struct sr_datafeed_packet *packet;
+	struct sr_datafeed_logic logic;
+	unsigned char *buf;
+
+	devc = sdi->priv;
+
+	logic.length = length;
+	logic.unitsize = sample_width;
+	logic.data = transfer->buffer;
+	packet = sr_packet_logic_new(&logic, transfer->buffer,
+		release_transfer_buffer, g_async_queue_ref(devc->buffer_pool));
+	sr_session_send(sdi, packet);
+	sr_packet_unref(packet);
+
+	/* Typically gets the very same buffer back. */
+	buf = g_async_queue_try_pop(devc->buffer_pool);
+	if (!buf)
+		buf = g_try_malloc(transfer->length);
+	transfer->buffer = buf;
+	if (!buf) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+
+	return SR_OK;
+}
+
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
@@ -477,8 +528,18 @@ check_trigger:
 			if (devc->limit_samples && devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer + processed_samples * unitsize,
-				num_samples * unitsize, unitsize);
+			if (devc->send_data_proc == la_send_data_proc &&
+					num_samples == (unsigned int)cur_sample_count) {
+				if (la_send_transfer(sdi, transfer,
+						num_samples * unitsize, unitsize) != SR_OK) {
+					fx2lafw_abort_acquisition(devc);
+					free_transfer(transfer);
+					return;
+				}
+			} else {
+				devc->send_data_proc(sdi, (uint8_t *)transfer->buffer + processed_samples * unitsize,
+					num_samples * unitsize, unitsize);
+			}
 			devc->sent_samples += num_samples;
 			processed_samples += num_samples;
 		}
@@ -662,6 +723,7 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 
 	size = get_buffer_size(devc);
 	devc->submitted_transfers = 0;
+	devc->buffer_pool = g_async_queue_new_full(g_free);
 
 	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
 	if (!devc->transfers) {
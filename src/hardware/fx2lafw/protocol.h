@@ -123,6 +123,8 @@ struct dev_context {
 		uint8_t *data, size_t length, size_t sample_width);
 	uint8_t *logic_buffer;
 	float *analog_buffer;
+	/* Transfer buffers released by consumers of shared packets. */
+	GAsyncQueue *buffer_pool;
 };
 
 SR_PRIV int fx2lafw_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di);
@@ -1054,6 +1054,16 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		devc->packets_per_chunk /= unitsize + sizeof(uint8_t);
 	}
 
+	/*
+	 * Captures in the device's memory are run length encoded, pass
+	 * the runs on as they are. Stream mode data is not compressed.
+	 */
+	ret = feed_queue_logic_rle_set(devc->feed_queue, !devc->continuous);
+	if (ret != SR_OK) {
+		sr_err("Cannot allocate buffer for session feed.");
+		return ret;
+	}
+
 	sr_sw_limits_acquisition_start(&devc->sw_limits);
 
 	voltage = threshold_voltage(sdi, NULL);
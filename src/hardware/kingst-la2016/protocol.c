@@ -578,7 +578,7 @@ static void la2016_prepare_stream(const struct sr_dev_inst *sdi)
 			continue;
 		channel_mask = 1UL << ch->index;
 		stream->enabled_mask |= channel_mask;
-		stream->channel_masks[stream->enabled_count++] = channel_mask;
+		stream->channel_rows[stream->enabled_count++] = ch->index;
 	}
 	stream->channel_index = 0;
 }
@@ -1023,16 +1023,9 @@ SR_PRIV int la2016_upload_firmware(const struct sr_dev_inst *sdi,
 	return SR_OK;
 }
 
-static void LIBUSB_CALL receive_transfer(struct libusb_transfer *xfer);
-
-static void la2016_usbxfer_release_cb(gpointer p)
-{
-	struct libusb_transfer *xfer;
-
-	xfer = p;
-	g_free(xfer->buffer);
-	libusb_free_transfer(xfer);
-}
+static gboolean receive_transfer(const uint8_t *data, size_t length,
+	void *cb_data);
+static void receive_done(int status, void *cb_data);
 
 static int la2016_usbxfer_release(const struct sr_dev_inst *sdi)
 {
@@ -1042,9 +1035,9 @@ static int la2016_usbxfer_release(const struct sr_dev_inst *sdi)
 	if (!devc)
 		return SR_ERR_ARG;
 
-	/* Release all USB transfers. */
-	g_slist_free_full(devc->transfers, la2016_usbxfer_release_cb);
-	devc->transfers = NULL;
+	/* Release all USB transfers, cancels those still in flight. */
+	sr_usb_stream_free(devc->usb_stream);
+	devc->usb_stream = NULL;
 
 	return SR_OK;
 }
@@ -1052,16 +1045,14 @@ static int la2016_usbxfer_release(const struct sr_dev_inst *sdi)
 static int la2016_usbxfer_allocate(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
-	size_t bufsize, xfercount;
-	uint8_t *buffer;
-	struct libusb_transfer *xfer;
+	struct sr_usb_stream_config cfg;
 
 	devc = sdi ? sdi->priv : NULL;
 	if (!devc)
 		return SR_ERR_ARG;
 
 	/* Transfers were already allocated before? */
-	if (devc->transfers)
+	if (devc->usb_stream)
 		return SR_OK;
 
 	/*
@@ -1073,100 +1064,23 @@ static int la2016_usbxfer_allocate(const struct sr_dev_inst *sdi)
 	 * Implementation detail: The LA2016_USB_BUFSZ value happens
 	 * to match all those constraints. No additional arithmetics is
 	 * required in this location.
+	 *
+	 * Timeouts are not fatal, see stream_data(). The driver's own
+	 * event source polls the device as well, and handles the USB
+	 * events of the stream.
 	 */
-	bufsize = LA2016_USB_BUFSZ;
-	xfercount = LA2016_USB_XFER_COUNT;
-	while (xfercount--) {
-		buffer = g_try_malloc(bufsize);
-		if (!buffer) {
-			sr_err("Cannot allocate USB transfer buffer.");
-			return SR_ERR_MALLOC;
-		}
-		xfer = libusb_alloc_transfer(0);
-		if (!xfer) {
-			sr_err("Cannot allocate USB transfer.");
-			g_free(buffer);
-			return SR_ERR_MALLOC;
-		}
-		xfer->buffer = buffer;
-		devc->transfers = g_slist_append(devc->transfers, xfer);
-	}
-	devc->transfer_bufsize = bufsize;
-
-	return SR_OK;
-}
-
-static int la2016_usbxfer_cancel_all(const struct sr_dev_inst *sdi)
-{
-	struct dev_context *devc;
-	GSList *l;
-	struct libusb_transfer *xfer;
-
-	devc = sdi ? sdi->priv : NULL;
-	if (!devc)
-		return SR_ERR_ARG;
-
-	/* Unconditionally cancel the transfer. Ignore errors. */
-	for (l = devc->transfers; l; l = l->next) {
-		xfer = l->data;
-		if (!xfer)
-			continue;
-		libusb_cancel_transfer(xfer);
-	}
-
-	return SR_OK;
-}
-
-static int la2016_usbxfer_resubmit(const struct sr_dev_inst *sdi,
-	struct libusb_transfer *xfer)
-{
-	struct dev_context *devc;
-	struct sr_usb_dev_inst *usb;
-	libusb_transfer_cb_fn cb;
-	int ret;
-
-	devc = sdi ? sdi->priv : NULL;
-	usb = sdi ? sdi->conn : NULL;
-	if (!devc || !usb)
-		return SR_ERR_ARG;
-
-	if (!xfer)
-		return SR_ERR_ARG;
-
-	cb = receive_transfer;
-	libusb_fill_bulk_transfer(xfer, usb->devhdl,
-		USB_EP_CAPTURE_DATA | LIBUSB_ENDPOINT_IN,
-		xfer->buffer, devc->transfer_bufsize,
-		cb, (void *)sdi, CAPTURE_TIMEOUT_MS);
-	ret = libusb_submit_transfer(xfer);
-	if (ret != 0) {
-		sr_err("Cannot submit USB transfer: %s.",
-			libusb_error_name(ret));
-		return SR_ERR_IO;
-	}
-
-	return SR_OK;
-}
-
-static int la2016_usbxfer_submit_all(const struct sr_dev_inst *sdi)
-{
-	struct dev_context *devc;
-	GSList *l;
-	struct libusb_transfer *xfer;
-	int ret;
-
-	devc = sdi ? sdi->priv : NULL;
-	if (!devc)
-		return SR_ERR_ARG;
-
-	for (l = devc->transfers; l; l = l->next) {
-		xfer = l->data;
-		if (!xfer)
-			return SR_ERR_ARG;
-		ret = la2016_usbxfer_resubmit(sdi, xfer);
-		if (ret != SR_OK)
-			return ret;
-	}
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.endpoint = USB_EP_CAPTURE_DATA | LIBUSB_ENDPOINT_IN;
+	cfg.buffer_size = LA2016_USB_BUFSZ;
+	cfg.granularity = LA2016_USB_BUFSZ;
+	cfg.buffer_count = LA2016_USB_XFER_COUNT;
+	cfg.timeout = CAPTURE_TIMEOUT_MS;
+	cfg.max_empty = G_MAXUINT;
+	cfg.driver_source = TRUE;
+	devc->usb_stream = sr_usb_stream_new(sdi, &cfg,
+		receive_transfer, receive_done, (void *)sdi);
+	if (!devc->usb_stream)
+		return SR_ERR_MALLOC;
 
 	return SR_OK;
 }
@@ -1218,7 +1132,7 @@ SR_PRIV int la2016_start_acquisition(const struct sr_dev_inst *sdi)
 		if (ret != SR_OK)
 			return ret;
 
-		ret = la2016_usbxfer_submit_all(sdi);
+		ret = sr_usb_stream_start(devc->usb_stream);
 		if (ret != SR_OK)
 			return ret;
 
@@ -1254,13 +1168,15 @@ static int la2016_stop_acquisition(const struct sr_dev_inst *sdi)
 
 SR_PRIV int la2016_abort_acquisition(const struct sr_dev_inst *sdi)
 {
+	struct dev_context *devc;
 	int ret;
 
 	ret = la2016_stop_acquisition(sdi);
 	if (ret != SR_OK)
 		return ret;
 
-	(void)la2016_usbxfer_cancel_all(sdi);
+	devc = sdi->priv;
+	sr_usb_stream_stop(devc->usb_stream);
 
 	return SR_OK;
 }
@@ -1304,7 +1220,7 @@ static int la2016_start_download(const struct sr_dev_inst *sdi)
 		return ret;
 	}
 
-	ret = la2016_usbxfer_submit_all(sdi);
+	ret = sr_usb_stream_start(devc->usb_stream);
 	if (ret != SR_OK) {
 		sr_err("Cannot submit USB bulk transfers.");
 		return ret;
@@ -1431,10 +1347,13 @@ static void send_chunk(struct sr_dev_inst *sdi,
  * Implementor's note: This routine is inspired by convert_sample_data()
  * in the https://github.com/AlexUg/sigrok implementation. Which in turn
  * appears to have been derived from the saleae-logic16 sigrok driver.
- * The code is phrased conservatively to verify the layout as discussed
- * above, performance was not a priority. Operation was verified with an
- * LA2016 device. The memory layout of 32 channel models is yet to get
- * determined.
+ * Operation was verified with an LA2016 device. The memory layout of
+ * 32 channel models is yet to get determined.
+ *
+ * The cells of all enabled channels are kept in the rows of a bit matrix
+ * which correspond to the channels' bit positions, rows of disabled
+ * channels remain zero. Transposing the matrix results in one sample
+ * per row, in the order of their acquisition.
  */
 static void stream_data(struct sr_dev_inst *sdi,
 	const uint8_t *data_buffer, size_t data_length)
@@ -1444,9 +1363,10 @@ static void stream_data(struct sr_dev_inst *sdi,
 	size_t bit_count;
 	const uint8_t *rp;
 	uint32_t sample_value;
-	uint8_t sample_buff[sizeof(sample_value)];
+	uint16_t rows16[16];
+	uint8_t sample_buff[32 * sizeof(sample_value)];
+	uint8_t *wp;
 	size_t bit_idx;
-	uint32_t ch_mask;
 
 	devc = sdi->priv;
 	stream = &devc->stream;
@@ -1484,12 +1404,8 @@ static void stream_data(struct sr_dev_inst *sdi,
 		else if (bit_count == 16)
 			sample_value = read_u16le_inc(&rp);
 
-		/* Map the entity's bits to a channel's samples. */
-		ch_mask = stream->channel_masks[stream->channel_index];
-		for (bit_idx = 0; bit_idx < bit_count; bit_idx++) {
-			if (sample_value & (1UL << bit_idx))
-				stream->sample_data[bit_idx] |= ch_mask;
-		}
+		/* Keep the entity in the channel's matrix row. */
+		stream->sample_data[stream->channel_rows[stream->channel_index]] = sample_value;
 
 		/*
 		 * Advance to the next channel. Submit a block of
@@ -1498,11 +1414,20 @@ static void stream_data(struct sr_dev_inst *sdi,
 		stream->channel_index++;
 		if (stream->channel_index != stream->enabled_count)
 			continue;
-		for (bit_idx = 0; bit_idx < bit_count; bit_idx++) {
-			sample_value = stream->sample_data[bit_idx];
-			write_u32le(sample_buff, sample_value);
-			feed_queue_logic_submit(devc->feed_queue, sample_buff, 1);
+		wp = sample_buff;
+		if (bit_count == 32) {
+			sr_bits_transpose_32x32(stream->sample_data);
+			for (bit_idx = 0; bit_idx < bit_count; bit_idx++)
+				write_u32le_inc(&wp, stream->sample_data[bit_idx]);
+		} else {
+			for (bit_idx = 0; bit_idx < bit_count; bit_idx++)
+				rows16[bit_idx] = stream->sample_data[bit_idx];
+			sr_bits_transpose_16x16(rows16);
+			for (bit_idx = 0; bit_idx < bit_count; bit_idx++)
+				write_u16le_inc(&wp, rows16[bit_idx]);
 		}
+		feed_queue_logic_submit_many(devc->feed_queue,
+			sample_buff, bit_count);
 		sr_sw_limits_update_samples_read(&devc->sw_limits, bit_count);
 		devc->total_samples += bit_count;
 		memset(stream->sample_data, 0, sizeof(stream->sample_data));
@@ -1532,49 +1457,41 @@ static void stream_data(struct sr_dev_inst *sdi,
 	sr_dbg("Total samples after chunk: %" PRIu64 ".", devc->total_samples);
 }
 
-static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
+/*
+ * Implementation detail: A USB transfer timeout is not fatal here. The
+ * stream resubmits the transfer, empty input is perfectly acceptable.
+ * Reaching (or exceeding) the sw limits or exhausting the device's
+ * captured data will complete the sample data download.
+ */
+static gboolean receive_transfer(const uint8_t *data, size_t length,
+	void *cb_data)
 {
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	gboolean was_cancelled, device_gone;
-	int ret;
 
-	sdi = transfer->user_data;
+	sdi = cb_data;
 	devc = sdi->priv;
 
-	was_cancelled = transfer->status == LIBUSB_TRANSFER_CANCELLED;
-	device_gone = transfer->status == LIBUSB_TRANSFER_NO_DEVICE;
-	sr_dbg("receive_transfer(): status %s received %d bytes.",
-		libusb_error_name(transfer->status), transfer->actual_length);
-	if (device_gone) {
-		sr_warn("Lost communication to USB device.");
-		devc->download_finished = TRUE;
-		return;
-	}
-
-	/*
-	 * Implementation detail: A USB transfer timeout is not fatal
-	 * here. We just process whatever was received, empty input is
-	 * perfectly acceptable. Reaching (or exceeding) the sw limits
-	 * or exhausting the device's captured data will complete the
-	 * sample data download.
-	 */
+	sr_dbg("receive_transfer(): received %zu bytes.", length);
 	if (devc->continuous)
-		stream_data(sdi, transfer->buffer, transfer->actual_length);
+		stream_data(sdi, data, length);
 	else
-		send_chunk(sdi, transfer->buffer, transfer->actual_length);
+		send_chunk(sdi, data, length);
 
-	/*
-	 * Re-submit completed transfers (regardless of timeout or
-	 * data reception), unless the transfer was cancelled when
-	 * the acquisition was terminated or has completed.
-	 */
-	if (!was_cancelled && !devc->download_finished) {
-		ret = la2016_usbxfer_resubmit(sdi, transfer);
-		if (ret == SR_OK)
-			return;
-		devc->download_finished = TRUE;
-	}
+	return !devc->download_finished;
+}
+
+static void receive_done(int status, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+
+	sdi = cb_data;
+	devc = sdi->priv;
+
+	if (status == SR_ERR_DEV_CLOSED)
+		sr_warn("Lost communication to USB device.");
+	devc->download_finished = TRUE;
 }
 
 SR_PRIV int la2016_receive_data(int fd, int revents, void *cb_data)
@@ -1582,7 +1499,6 @@ SR_PRIV int la2016_receive_data(int fd, int revents, void *cb_data)
 	const struct sr_dev_inst *sdi;
 	struct dev_context *devc;
 	struct drv_context *drvc;
-	struct timeval tv;
 	int ret;
 
 	(void)fd;
@@ -1653,8 +1569,15 @@ SR_PRIV int la2016_receive_data(int fd, int revents, void *cb_data)
 	}
 
 	/* Handle USB reception. Drives sample data download. */
-	memset(&tv, 0, sizeof(tv));
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	sr_usb_stream_poll(devc->usb_stream);
+
+	/* Empty transfers don't reach stream_data(), check time limits. */
+	if (devc->continuous && !devc->download_finished &&
+			sr_sw_limits_check(&devc->sw_limits)) {
+		sr_dbg("Acquisition end reached (sw limits).");
+		devc->download_finished = TRUE;
+		feed_queue_logic_flush(devc->feed_queue);
+	}
 
 	/*
 	 * Periodically flush acquisition data in streaming mode.
@@ -1682,9 +1605,7 @@ SR_PRIV int la2016_receive_data(int fd, int revents, void *cb_data)
 		la2016_stop_acquisition(sdi);
 		usb_source_remove(sdi->session, drvc->sr_ctx);
 
-		la2016_usbxfer_cancel_all(sdi);
-		memset(&tv, 0, sizeof(tv));
-		libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+		(void)la2016_usbxfer_release(sdi);
 
 		feed_queue_logic_flush(devc->feed_queue);
 		feed_queue_logic_free(devc->feed_queue);
@@ -156,12 +156,11 @@ struct dev_context {
 	uint32_t read_pos;
 
 	struct feed_queue_logic *feed_queue;
-	GSList *transfers;
-	size_t transfer_bufsize;
+	struct sr_usb_stream *usb_stream;
 	struct stream_state_t {
 		size_t enabled_count;
 		uint32_t enabled_mask;
-		uint32_t channel_masks[32];
+		uint8_t channel_rows[32];
 		size_t channel_index;
 		uint32_t sample_data[32];
 		uint64_t flush_period_ms;
@@ -24,7 +24,6 @@
 
 #define BUF_COUNT 512
 #define BUF_SIZE (16 * 1024)
-#define BUF_TIMEOUT 1000
 
 static const uint32_t scanopts[] = {
 	SR_CONF_CONN,
@@ -365,78 +364,43 @@ static int config_list(uint32_t key, GVariant **data,
 	return SR_OK;
 }
 
-static void dev_acquisition_abort(const struct sr_dev_inst *sdi)
-{
-	struct dev_context *devc = sdi->priv;
-	unsigned int i;
-
-	for (i = 0; i < devc->num_transfers; i++) {
-		if (devc->transfers[i])
-			libusb_cancel_transfer(devc->transfers[i]);
-	}
-}
-
-static int dev_acquisition_handle(int fd, int revents, void *cb_data)
-{
-	struct sr_dev_inst *sdi = cb_data;
-	struct drv_context *drvc = sdi->driver->context;
-	struct timeval tv = ALL_ZERO;
-
-	(void)fd;
-
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
-
-	/* Handle timeout */
-	if (!revents)
-		sr_dev_acquisition_stop(sdi);
-
-	return TRUE;
-}
-
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc = sdi->priv;
-	struct drv_context *drvc = sdi->driver->context;
-	struct libusb_transfer *transfer;
-	struct sr_usb_dev_inst *usb;
-	uint8_t *buf;
-	unsigned int i, ret;
+	struct sr_usb_stream_config cfg = ALL_ZERO;
+	int ret;
 
 	ret = saleae_logic_pro_prepare(sdi);
 	if (ret != SR_OK)
 		return ret;
 
-	usb = sdi->conn;
+	/* The conversion buffer holds one packet's worth of data. */
+	cfg.endpoint = 2 | LIBUSB_ENDPOINT_IN;
+	cfg.buffer_size = BUF_SIZE;
+	cfg.granularity = BUF_SIZE;
+	cfg.buffer_count = BUF_COUNT;
+	cfg.timeout = SR_USB_STREAM_NO_TIMEOUT;
+	devc->stream = sr_usb_stream_new(sdi, &cfg,
+		saleae_logic_pro_receive_data, saleae_logic_pro_finish,
+		(void *)sdi);
+	if (!devc->stream)
+		return SR_ERR_MALLOC;
 
 	devc->conv_buffer = g_malloc(CONV_BUFFER_SIZE);
 
-	devc->num_transfers = BUF_COUNT;
-	devc->transfers = g_malloc0(sizeof(*devc->transfers) * BUF_COUNT);
-	for (i = 0; i < devc->num_transfers; i++) {
-		buf = g_malloc(BUF_SIZE);
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-			2 | LIBUSB_ENDPOINT_IN, buf, BUF_SIZE,
-			saleae_logic_pro_receive_data, (void *)sdi, 0);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
-			dev_acquisition_abort(sdi);
-			return SR_ERR;
-		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
-	}
-
-	usb_source_add(sdi->session, drvc->sr_ctx, BUF_TIMEOUT, dev_acquisition_handle, (void *)sdi);
-
 	std_session_send_df_header(sdi);
 
-	saleae_logic_pro_start(sdi);
-	if (ret != SR_OK)
+	ret = sr_usb_stream_start(devc->stream);
+	if (ret == SR_OK)
+		ret = saleae_logic_pro_start(sdi);
+	if (ret != SR_OK) {
+		sr_usb_stream_free(devc->stream);
+		devc->stream = NULL;
+		g_free(devc->conv_buffer);
+		devc->conv_buffer = NULL;
+		std_session_send_df_end(sdi);
 		return ret;
+	}
 
 	return SR_OK;
 }
@@ -444,15 +408,9 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc = sdi->priv;
-	struct drv_context *drvc = sdi->driver->context;
-
-	saleae_logic_pro_stop(sdi);
-
-	std_session_send_df_end(sdi);
-
-	usb_source_remove(sdi->session, drvc->sr_ctx);
 
-	g_free(devc->conv_buffer);
+	/* Device shutdown and cleanup happen after transfers returned. */
+	sr_usb_stream_stop(devc->stream);
 
 	return SR_OK;
 }
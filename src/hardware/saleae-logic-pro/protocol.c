@@ -578,7 +578,7 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 			continue;
 
 		mask = 1 << c->index;
-		devc->dig_channel_masks[devc->dig_channel_cnt++] = mask;
+		devc->dig_channel_rows[devc->dig_channel_cnt++] = c->index;
 		devc->dig_channel_mask |= mask;
 
 	}
@@ -797,6 +797,7 @@ SR_PRIV int saleae_logic_pro_start(const struct sr_dev_inst *sdi)
 
 	devc->conv_size = 0;
 	devc->batch_index = 0;
+	memset(devc->batch_rows, 0, sizeof(devc->batch_rows));
 
 	write_reg(sdi, 0x00, 0x01);
 
@@ -844,68 +845,72 @@ static void saleae_logic_pro_send_data(const struct sr_dev_inst *sdi,
 /*
  * One batch from the device consists of 32 samples per active digital channel.
  * This stream of batches is packed into USB packets with 16384 bytes each.
+ *
+ * The channels' words are kept in the rows of a bit matrix (the rows of
+ * disabled channels remain zero), the first sample is in the MSB. The
+ * transposition has one sample per row. It's done in two 16x16 halves
+ * since there are only 16 channels.
  */
 static void saleae_logic_pro_convert_data(const struct sr_dev_inst *sdi,
 					 const uint32_t *src, size_t srccnt)
 {
 	struct dev_context *devc = sdi->priv;
-	uint8_t *dst = devc->conv_buffer;
-	uint32_t samples;
-	uint16_t channel_mask;
-	unsigned int sample_index, batch_index;
-	uint16_t *dst_batch;
-
-	/* Copy partial batch to the beginning. */
-	memcpy(dst, dst + devc->conv_size, CONV_BATCH_SIZE);
+	uint16_t *dst_batch = (uint16_t *)devc->conv_buffer;
+	uint16_t first[16], second[16];
+	unsigned int i, batch_index;
+
 	/* Reset converted size. */
 	devc->conv_size = 0;
 
 	batch_index = devc->batch_index;
 	while (srccnt--) {
-		samples = *src++;
-		dst_batch = (uint16_t*)dst;
-
-		/* First index of the batch. */
-		if (batch_index == 0)
-			memset(dst, 0, CONV_BATCH_SIZE);
-
-		/* Convert one channel. */
-		channel_mask = devc->dig_channel_masks[batch_index];
-		for (sample_index = 0; sample_index <= 31; sample_index++)
-			if ((samples >> (31 - sample_index)) & 1)
-				dst_batch[sample_index] |= channel_mask;
+		devc->batch_rows[devc->dig_channel_rows[batch_index]] = *src++;
 
 		/* Last index of the batch. */
-		if (++batch_index == devc->dig_channel_cnt) {
-			devc->conv_size += CONV_BATCH_SIZE;
-			batch_index = 0;
-			dst += CONV_BATCH_SIZE;
+		if (++batch_index < devc->dig_channel_cnt)
+			continue;
+		batch_index = 0;
+
+		for (i = 0; i < 16; i++) {
+			first[i] = devc->batch_rows[i] >> 16;
+			second[i] = devc->batch_rows[i] & 0xffff;
+		}
+		sr_bits_transpose_16x16(first);
+		sr_bits_transpose_16x16(second);
+		for (i = 0; i < 16; i++) {
+			dst_batch[i] = first[15 - i];
+			dst_batch[16 + i] = second[15 - i];
 		}
+		devc->conv_size += CONV_BATCH_SIZE;
+		dst_batch += CONV_BATCH_SIZE / sizeof(*dst_batch);
 	}
 	devc->batch_index = batch_index;
 }
 
-SR_PRIV void LIBUSB_CALL saleae_logic_pro_receive_data(struct libusb_transfer *transfer)
+SR_PRIV gboolean saleae_logic_pro_receive_data(const uint8_t *data,
+	size_t length, void *cb_data)
 {
-	const struct sr_dev_inst *sdi = transfer->user_data;
+	const struct sr_dev_inst *sdi = cb_data;
 	struct dev_context *devc = sdi->priv;
-	int ret;
 
-	switch (transfer->status) {
-	case LIBUSB_TRANSFER_NO_DEVICE:
-		sr_dbg("FIXME no device");
-		return;
-	case LIBUSB_TRANSFER_COMPLETED:
-	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
-		break;
-	default:
-		/* FIXME */
-		return;
-	}
-
-	saleae_logic_pro_convert_data(sdi, (uint32_t*)transfer->buffer, 16 * 1024 / 4);
+	saleae_logic_pro_convert_data(sdi, (const uint32_t *)data, length / 4);
 	saleae_logic_pro_send_data(sdi, devc->conv_buffer, devc->conv_size, 2);
 
-	if ((ret = libusb_submit_transfer(transfer)) != LIBUSB_SUCCESS)
-		sr_dbg("FIXME resubmit failed");
+	return TRUE;
+}
+
+SR_PRIV void saleae_logic_pro_finish(int status, void *cb_data)
+{
+	const struct sr_dev_inst *sdi = cb_data;
+	struct dev_context *devc = sdi->priv;
+
+	if (status != SR_ERR_DEV_CLOSED)
+		saleae_logic_pro_stop(sdi);
+
+	std_session_send_df_end(sdi);
+
+	sr_usb_stream_free(devc->stream);
+	devc->stream = NULL;
+	g_free(devc->conv_buffer);
+	devc->conv_buffer = NULL;
 }
@@ -31,32 +31,34 @@
 #define CONV_BATCH_SIZE (2 * 32)
 
 /*
- * One packet + one partial conversion: Worst case is only one active
- * channel converted to 2 bytes per sample, with 8 * 16384 samples per packet.
+ * One packet: Worst case is only one active channel converted to
+ * 2 bytes per sample, with 8 * 16384 samples per packet. Partial
+ * batches are kept in the device context.
  */
-#define CONV_BUFFER_SIZE (2 * 8 * 16384 + CONV_BATCH_SIZE)
+#define CONV_BUFFER_SIZE (2 * 8 * 16384)
 
 struct dev_context {
 	unsigned int dig_channel_cnt;
 	uint16_t dig_channel_mask;
-	uint16_t dig_channel_masks[16];
+	uint8_t dig_channel_rows[16];
 	uint64_t dig_samplerate;
 
 	uint32_t lfsr;
 
-	unsigned int num_transfers;
-	unsigned int submitted_transfers;
-	struct libusb_transfer **transfers;
+	struct sr_usb_stream *stream;
 
 	uint8_t *conv_buffer;
 	unsigned int conv_size;
 	unsigned int batch_index;
+	uint32_t batch_rows[16];
 };
 
 SR_PRIV int saleae_logic_pro_init(const struct sr_dev_inst *sdi);
 SR_PRIV int saleae_logic_pro_prepare(const struct sr_dev_inst *sdi);
 SR_PRIV int saleae_logic_pro_start(const struct sr_dev_inst *sdi);
 SR_PRIV int saleae_logic_pro_stop(const struct sr_dev_inst *sdi);
-SR_PRIV void LIBUSB_CALL saleae_logic_pro_receive_data(struct libusb_transfer *transfer);
+SR_PRIV gboolean saleae_logic_pro_receive_data(const uint8_t *data,
+	size_t length, void *cb_data);
+SR_PRIV void saleae_logic_pro_finish(int status, void *cb_data);
 
 #endif
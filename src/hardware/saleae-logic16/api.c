@@ -37,7 +37,7 @@
 #define FX2_FIRMWARE		"saleae-logic16-fx2.fw"
 
 #define MAX_RENUM_DELAY_MS	3000
-#define NUM_SIMUL_TRANSFERS	32
+#define MAX_EMPTY_TRANSFERS	64
 
 static const uint32_t scanopts[] = {
 	SR_CONF_CONN,
@@ -507,58 +507,6 @@ static int config_list(uint32_t key, GVariant **data,
 	return SR_OK;
 }
 
-static void abort_acquisition(struct dev_context *devc)
-{
-	int i;
-
-	devc->sent_samples = -1;
-
-	for (i = devc->num_transfers - 1; i >= 0; i--) {
-		if (devc->transfers[i])
-			libusb_cancel_transfer(devc->transfers[i]);
-	}
-}
-
-static unsigned int bytes_per_ms(struct dev_context *devc)
-{
-	return devc->cur_samplerate * devc->num_channels / 8000;
-}
-
-static size_t get_buffer_size(struct dev_context *devc)
-{
-	size_t s;
-
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of 512.
-	 */
-	s = 10 * bytes_per_ms(devc);
-	return (s + 511) & ~511;
-}
-
-static unsigned int get_number_of_transfers(struct dev_context *devc)
-{
-	unsigned int n;
-
-	/* Total buffer size should be able to hold about 500ms of data. */
-	n = 500 * bytes_per_ms(devc) / get_buffer_size(devc);
-
-	if (n > NUM_SIMUL_TRANSFERS)
-		return NUM_SIMUL_TRANSFERS;
-
-	return n;
-}
-
-static unsigned int get_timeout(struct dev_context *devc)
-{
-	size_t total_size;
-	unsigned int timeout;
-
-	total_size = get_buffer_size(devc) * get_number_of_transfers(devc);
-	timeout = total_size / bytes_per_ms(devc);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
-}
-
 static int configure_channels(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
@@ -583,60 +531,27 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 		/*
 		 * Output logic data should be stored in little endian format.
 		 * To speed things up during conversion, do the switcharoo
-		 * here instead.
+		 * here instead, by picking the row of the transposed bit
+		 * matrix which ends up in the proper byte.
 		 */
-		channel_bit = 1 << (ch->index ^ 8);
+		devc->channel_rows[devc->num_channels++] = ch->index ^ 8;
+#else
+		devc->channel_rows[devc->num_channels++] = ch->index;
 #endif
-
-		devc->channel_masks[devc->num_channels++] = channel_bit;
 	}
 
 	return SR_OK;
 }
 
-static int receive_data(int fd, int revents, void *cb_data)
-{
-	struct timeval tv;
-	struct dev_context *devc;
-	struct drv_context *drvc;
-	const struct sr_dev_inst *sdi;
-	struct sr_dev_driver *di;
-
-	(void)fd;
-	(void)revents;
-
-	sdi = cb_data;
-	di = sdi->driver;
-	drvc = di->context;
-	devc = sdi->priv;
-
-	tv.tv_sec = tv.tv_usec = 0;
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
-
-	if (devc->sent_samples == -2) {
-		logic16_abort_acquisition(sdi);
-		abort_acquisition(devc);
-	}
-
-	return TRUE;
-}
-
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
-	struct sr_dev_driver *di = sdi->driver;
 	struct dev_context *devc;
-	struct drv_context *drvc;
-	struct sr_usb_dev_inst *usb;
 	struct sr_trigger *trigger;
-	struct libusb_transfer *transfer;
-	unsigned int i, timeout, num_transfers;
+	struct sr_usb_stream_config cfg;
 	int ret;
-	unsigned char *buf;
-	size_t size, convsize;
+	size_t convsize;
 
-	drvc = di->context;
 	devc = sdi->priv;
-	usb = sdi->conn;
 
 	/* Configures devc->cur_channels. */
 	if (configure_channels(sdi) != SR_OK) {
@@ -645,98 +560,80 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	}
 
 	devc->sent_samples = 0;
-	devc->empty_transfer_count = 0;
 	devc->cur_channel = 0;
 	memset(devc->channel_data, 0, sizeof(devc->channel_data));
 
+	/* The device sends 16 bit words per channel, one after another. */
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.endpoint = 2 | LIBUSB_ENDPOINT_IN;
+	cfg.samplerate = devc->cur_samplerate;
+	cfg.sample_bits = devc->num_channels;
+	cfg.max_empty = MAX_EMPTY_TRANSFERS;
+	devc->stream = sr_usb_stream_new(sdi, &cfg, logic16_receive_data,
+		logic16_finish_acquisition, (void *)sdi);
+	if (!devc->stream)
+		return SR_ERR_MALLOC;
+
+	convsize = (cfg.buffer_size / devc->num_channels + 2) * 16;
+	devc->convbuffer_size = convsize;
+	if (!(devc->convbuffer = g_try_malloc(convsize))) {
+		sr_err("Conversion buffer malloc failed.");
+		sr_usb_stream_free(devc->stream);
+		devc->stream = NULL;
+		return SR_ERR_MALLOC;
+	}
+
 	if ((trigger = sr_session_trigger_get(sdi->session))) {
 		int pre_trigger_samples = 0;
 		if (devc->limit_samples > 0)
 			pre_trigger_samples = (devc->capture_ratio * devc->limit_samples) / 100;
 		devc->stl = soft_trigger_logic_new(sdi, trigger, pre_trigger_samples);
-		if (!devc->stl)
-			return SR_ERR_MALLOC;
+		if (!devc->stl) {
+			ret = SR_ERR_MALLOC;
+			goto err_free;
+		}
 		devc->trigger_fired = FALSE;
 	} else
 		devc->trigger_fired = TRUE;
 
-	timeout = get_timeout(devc);
-	num_transfers = get_number_of_transfers(devc);
-	size = get_buffer_size(devc);
-	convsize = (size / devc->num_channels + 2) * 16;
-	devc->submitted_transfers = 0;
-
-	devc->convbuffer_size = convsize;
-	if (!(devc->convbuffer = g_try_malloc(convsize))) {
-		sr_err("Conversion buffer malloc failed.");
-		return SR_ERR_MALLOC;
-	}
-
-	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
-	if (!devc->transfers) {
-		sr_err("USB transfers malloc failed.");
-		g_free(devc->convbuffer);
-		return SR_ERR_MALLOC;
-	}
-
 	if ((ret = logic16_setup_acquisition(sdi, devc->cur_samplerate,
-					     devc->cur_channels)) != SR_OK) {
-		g_free(devc->transfers);
-		g_free(devc->convbuffer);
-		return ret;
-	}
+					     devc->cur_channels)) != SR_OK)
+		goto err_free;
 
-	devc->num_transfers = num_transfers;
-	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
-			sr_err("USB transfer buffer malloc failed.");
-			if (devc->submitted_transfers)
-				abort_acquisition(devc);
-			else {
-				g_free(devc->transfers);
-				g_free(devc->convbuffer);
-			}
-			return SR_ERR_MALLOC;
-		}
-		transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
-				logic16_receive_transfer, (void *)sdi, timeout);
-		if ((ret = libusb_submit_transfer(transfer)) != 0) {
-			sr_err("Failed to submit transfer: %s.",
-			       libusb_error_name(ret));
-			libusb_free_transfer(transfer);
-			g_free(buf);
-			abort_acquisition(devc);
-			return SR_ERR;
-		}
-		devc->transfers[i] = transfer;
-		devc->submitted_transfers++;
-	}
+	std_session_send_df_header(sdi);
 
-	devc->ctx = drvc->sr_ctx;
+	if ((ret = sr_usb_stream_start(devc->stream)) != SR_OK)
+		goto err_end;
 
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, (void *)sdi);
+	if ((ret = logic16_start_acquisition(sdi)) != SR_OK)
+		goto err_end;
 
-	std_session_send_df_header(sdi);
+	return SR_OK;
 
-	if ((ret = logic16_start_acquisition(sdi)) != SR_OK) {
-		abort_acquisition(devc);
-		return ret;
+err_end:
+	std_session_send_df_end(sdi);
+err_free:
+	sr_usb_stream_free(devc->stream);
+	devc->stream = NULL;
+	g_free(devc->convbuffer);
+	devc->convbuffer = NULL;
+	if (devc->stl) {
+		soft_trigger_logic_free(devc->stl);
+		devc->stl = NULL;
 	}
-
-	return SR_OK;
+	return ret;
 }
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 {
-	int ret;
+	struct dev_context *devc;
 
-	ret = logic16_abort_acquisition(sdi);
+	devc = sdi->priv;
 
-	abort_acquisition(sdi->priv);
+	/* The device gets aborted after all transfers have returned. */
+	sr_usb_stream_stop(devc->stream);
 
-	return ret;
+	return SR_OK;
 }
 
 static struct sr_dev_driver saleae_logic16_driver_info = {
@@ -60,8 +60,6 @@
 #define READ_EEPROM_COOKIE2		0x81
 #define ABORT_ACQUISITION_SYNC_PATTERN	0x55
 
-#define MAX_EMPTY_TRANSFERS		64
-
 /* Register mappings for old and new bitstream versions */
 
 enum fpga_register_id {
@@ -746,93 +744,36 @@ SR_PRIV int logic16_init_device(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
-static void finish_acquisition(struct sr_dev_inst *sdi)
-{
-	struct dev_context *devc;
-
-	devc = sdi->priv;
-
-	std_session_send_df_end(sdi);
-
-	usb_source_remove(sdi->session, devc->ctx);
-
-	devc->num_transfers = 0;
-	g_free(devc->transfers);
-	g_free(devc->convbuffer);
-	if (devc->stl) {
-		soft_trigger_logic_free(devc->stl);
-		devc->stl = NULL;
-	}
-}
-
-static void free_transfer(struct libusb_transfer *transfer)
-{
-	struct sr_dev_inst *sdi;
-	struct dev_context *devc;
-	unsigned int i;
-
-	sdi = transfer->user_data;
-	devc = sdi->priv;
-
-	g_free(transfer->buffer);
-	transfer->buffer = NULL;
-	libusb_free_transfer(transfer);
-
-	for (i = 0; i < devc->num_transfers; i++) {
-		if (devc->transfers[i] == transfer) {
-			devc->transfers[i] = NULL;
-			break;
-		}
-	}
-
-	devc->submitted_transfers--;
-	if (devc->submitted_transfers == 0)
-		finish_acquisition(sdi);
-}
-
-static void resubmit_transfer(struct libusb_transfer *transfer)
-{
-	int ret;
-
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
-		return;
-
-	free_transfer(transfer);
-	/* TODO: Stop session? */
-
-	sr_err("%s: %s", __func__, libusb_error_name(ret));
-}
-
 static size_t convert_sample_data(struct dev_context *devc,
 		uint8_t *dest, size_t destcnt, const uint8_t *src, size_t srccnt)
 {
 	uint16_t *channel_data;
 	int i, cur_channel;
 	size_t ret = 0;
-	uint16_t sample, channel_mask;
 
 	srccnt /= 2;
 
 	channel_data = devc->channel_data;
 	cur_channel = devc->cur_channel;
 
+	/*
+	 * Each word holds 16 samples of one channel, the first sample in
+	 * the MSB. Collect the words of all enabled channels in the rows
+	 * of a bit matrix, its transposition has one sample per row.
+	 */
 	while (srccnt--) {
-		sample = src[0] | (src[1] << 8);
+		channel_data[devc->channel_rows[cur_channel]] = read_u16le(src);
 		src += 2;
 
-		channel_mask = devc->channel_masks[cur_channel];
-
-		for (i = 15; i >= 0; --i, sample >>= 1)
-			if (sample & 1)
-				channel_data[i] |= channel_mask;
-
 		if (++cur_channel == devc->num_channels) {
 			cur_channel = 0;
 			if (destcnt < 16 * 2) {
 				sr_err("Conversion buffer too small!");
 				break;
 			}
-			memcpy(dest, channel_data, 16 * 2);
+			sr_bits_transpose_16x16(channel_data);
+			for (i = 0; i < 16; i++)
+				memcpy(&dest[i * 2], &channel_data[15 - i], 2);
 			memset(channel_data, 0, 16 * 2);
 			dest += 16 * 2;
 			ret += 16;
@@ -845,77 +786,34 @@ static size_t convert_sample_data(struct dev_context *devc,
 	return ret;
 }
 
-SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transfer)
+SR_PRIV gboolean logic16_receive_data(const uint8_t *data, size_t length,
+		void *cb_data)
 {
-	gboolean packet_has_error = FALSE;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	struct sr_dev_inst *sdi;
+	const struct sr_dev_inst *sdi;
 	struct dev_context *devc;
 	size_t new_samples, num_samples;
 	int trigger_offset;
 	int pre_trigger_samples;
 
-	sdi = transfer->user_data;
+	sdi = cb_data;
 	devc = sdi->priv;
 
-	/*
-	 * If acquisition has already ended, just free any queued up
-	 * transfer that come in.
-	 */
-	if (devc->sent_samples < 0) {
-		free_transfer(transfer);
-		return;
-	}
+	sr_spew("Received %zu bytes.", length);
 
-	sr_info("receive_transfer(): status %s received %d bytes.",
-		libusb_error_name(transfer->status), transfer->actual_length);
-
-	switch (transfer->status) {
-	case LIBUSB_TRANSFER_NO_DEVICE:
-		devc->sent_samples = -2;
-		free_transfer(transfer);
-		return;
-	case LIBUSB_TRANSFER_COMPLETED:
-	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
-		break;
-	default:
-		packet_has_error = TRUE;
-		break;
-	}
-
-	if (transfer->actual_length & 1) {
+	if (length & 1) {
 		sr_err("Got an odd number of bytes from the device. "
 		       "This should not happen.");
 		/* Bail out right away. */
-		packet_has_error = TRUE;
-		devc->empty_transfer_count = MAX_EMPTY_TRANSFERS;
-	}
-
-	if (transfer->actual_length == 0 || packet_has_error) {
-		devc->empty_transfer_count++;
-		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
-			/*
-			 * The FX2 gave up. End the acquisition, the frontend
-			 * will work out that the samplecount is short.
-			 */
-			devc->sent_samples = -2;
-			free_transfer(transfer);
-		} else {
-			resubmit_transfer(transfer);
-		}
-		return;
-	} else {
-		devc->empty_transfer_count = 0;
+		return FALSE;
 	}
 
 	new_samples = convert_sample_data(devc, devc->convbuffer,
-			devc->convbuffer_size, transfer->buffer, transfer->actual_length);
+			devc->convbuffer_size, data, length);
 
-	if (new_samples <= 0) {
-		resubmit_transfer(transfer);
-		return;
-	}
+	if (new_samples <= 0)
+		return TRUE;
 
 	/* At least one new sample. */
 	if (devc->trigger_fired) {
@@ -951,12 +849,31 @@ SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transf
 		}
 	}
 
-	if (devc->limit_samples &&
-			(uint64_t)devc->sent_samples >= devc->limit_samples) {
-		devc->sent_samples = -2;
-		free_transfer(transfer);
-		return;
-	}
+	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples)
+		return FALSE;
+
+	return TRUE;
+}
+
+SR_PRIV void logic16_finish_acquisition(int status, void *cb_data)
+{
+	const struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+
+	sdi = cb_data;
+	devc = sdi->priv;
 
-	resubmit_transfer(transfer);
+	if (status != SR_ERR_DEV_CLOSED)
+		logic16_abort_acquisition(sdi);
+
+	std_session_send_df_end(sdi);
+
+	sr_usb_stream_free(devc->stream);
+	devc->stream = NULL;
+	g_free(devc->convbuffer);
+	devc->convbuffer = NULL;
+	if (devc->stl) {
+		soft_trigger_logic_free(devc->stl);
+		devc->stl = NULL;
+	}
 }
@@ -74,21 +74,17 @@ struct dev_context {
 	/* EEPROM data from address 8. */
 	uint8_t eeprom_data[8];
 
-	int64_t sent_samples;
-	int submitted_transfers;
-	int empty_transfer_count;
+	uint64_t sent_samples;
 	int num_channels;
 	int cur_channel;
-	uint16_t channel_masks[16];
+	uint8_t channel_rows[16];
 	uint16_t channel_data[16];
 	uint8_t *convbuffer;
 	size_t convbuffer_size;
 	struct soft_trigger_logic *stl;
 	gboolean trigger_fired;
 
-	unsigned int num_transfers;
-	struct libusb_transfer **transfers;
-	struct sr_context *ctx;
+	struct sr_usb_stream *stream;
 
 	const uint8_t *fpga_register_map;
 	const uint8_t *fpga_status_control_bit_map;
@@ -100,6 +96,8 @@ SR_PRIV int logic16_setup_acquisition(const struct sr_dev_inst *sdi,
 SR_PRIV int logic16_start_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int logic16_abort_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int logic16_init_device(const struct sr_dev_inst *sdi);
-SR_PRIV void LIBUSB_CALL logic16_receive_transfer(struct libusb_transfer *transfer);
+SR_PRIV gboolean logic16_receive_data(const uint8_t *data, size_t length,
+		void *cb_data);
+SR_PRIV void logic16_finish_acquisition(int status, void *cb_data);
 
 #endif
@@ -228,6 +228,10 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Probe factor", NULL},
 	{SR_CONF_ADC_POWERLINE_CYCLES, SR_T_FLOAT, "nplc",
 		"Number of ADC powerline cycles", NULL},
+	{SR_CONF_CAPTURE_START, SR_T_UINT64, "capture_start",
+		"Capture start sample", NULL},
+	{SR_CONF_PREFETCH_DEPTH, SR_T_UINT64, "prefetch_depth",
+		"Prefetch depth", NULL},
 
 	/* Acquisition modes, sample limiting */
 	{SR_CONF_LIMIT_MSEC, SR_T_UINT64, "limit_time",
@@ -244,6 +248,8 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Device mode", NULL},
 	{SR_CONF_TEST_MODE, SR_T_STRING, "test_mode",
 		"Test mode", NULL},
+	{SR_CONF_FREE_RUNNING, SR_T_BOOL, "free_running",
+		"Free running", NULL},
 
 	ALL_ZERO
 };
@@ -66,7 +66,26 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static void send_header(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	if (inc->started)
+		return;
+
+	std_session_send_df_header(in->sdi);
+
+	if (inc->samplerate) {
+		(void)sr_session_send_meta(in->sdi, SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(inc->samplerate));
+	}
+
+	inc->started = TRUE;
+}
+
+/* Send all whole samples from a buffer, return the consumed size. */
+static size_t send_samples(struct sr_input *in, uint8_t *data, size_t length)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
@@ -75,33 +94,33 @@ static int process_buffer(struct sr_input *in)
 	int chunk;
 
 	inc = in->priv;
-	if (!inc->started) {
-		std_session_send_df_header(in->sdi);
-
-		if (inc->samplerate) {
-			(void)sr_session_send_meta(in->sdi, SR_CONF_SAMPLERATE,
-				g_variant_new_uint64(inc->samplerate));
-		}
-
-		inc->started = TRUE;
-	}
+	send_header(in);
 
 	packet.type = SR_DF_LOGIC;
 	packet.payload = &logic;
 	logic.unitsize = inc->unitsize;
 
 	/* Cut off at multiple of unitsize. */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	chunk_size = length / logic.unitsize * logic.unitsize;
 
 	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
+		logic.data = data + i;
 		chunk = MIN(CHUNK_SIZE, chunk_size - i);
 		chunk /= logic.unitsize;
 		chunk *= logic.unitsize;
 		logic.length = chunk;
 		sr_session_send(in->sdi, &packet);
 	}
-	g_string_erase(in->buf, 0, chunk_size);
+
+	return chunk_size;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	size_t used;
+
+	used = send_samples(in, (uint8_t *)in->buf->str, in->buf->len);
+	g_string_erase(in->buf, 0, used);
 
 	return SR_OK;
 }
@@ -123,6 +142,25 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+static int receive_mapped(struct sr_input *in, uint8_t *data,
+	size_t length, size_t *consumed)
+{
+	struct context *inc;
+
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		*consumed = 0;
+		return SR_OK;
+	}
+
+	inc = in->priv;
+	sr_input_mapped_units(in, data, length, inc->unitsize, send_samples);
+	*consumed = length;
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -174,6 +212,7 @@ SR_PRIV struct sr_input_module input_binary = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_mapped = receive_mapped,
 	.end = end,
 	.reset = reset,
 };
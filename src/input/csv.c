@@ -91,6 +91,12 @@
  *     up to the end of the current text line. Can be empty to disable
  *     comment support. Defaults to semicolon.
  *
+ * threads: Specifies the number of worker threads which parse large
+ *     amounts of input text in parallel. Defaults to 0, which processes
+ *     all input in the caller's thread. Lines before the start line and
+ *     the header line, as well as lines which samplerate detection from
+ *     timestamps depends on, always get processed sequentially.
+ *
  * Typical examples of using these options:
  * - ... -I csv:column_formats=*l ...
  *   All columns are single-bit logic data. Identical to the previous
@@ -225,6 +231,7 @@ struct context {
 	const char *column_formats;
 	size_t column_want_count;
 	struct column_details *column_details;
+	char **column_texts;
 
 	/* Line number to start processing. */
 	size_t start_line;
@@ -253,6 +260,11 @@ struct context {
 	/* Current line number. */
 	size_t line_number;
 
+	/* Parallel import, worker thread count and job queue. */
+	size_t threads;
+	struct sr_async *workers;
+	gboolean workers_failed;
+
 	/* List of previously created sigrok channels. */
 	GSList *prev_sr_channels;
 	GSList **prev_df_channels;
@@ -774,6 +786,103 @@ static char **split_line(char *buf, struct context *inc)
 	return fields;
 }
 
+/**
+ * Splits a text line into a set of columns, in place.
+ *
+ * @param[in] buf	The input text line to split, gets modified.
+ * @param[in] inc	The input module's context.
+ *
+ * @returns The number of columns found, at most the number of columns
+ *   which the format spec refers to.
+ *
+ * This routine is the allocation free variant of split_line(), for
+ * the processing of data lines. Pointers to the columns' text get
+ * stored in the context's column_texts[] array. Splitting stops after
+ * the last column of interest, trailing text remains unseen.
+ */
+static size_t split_line_inplace(char *buf, struct context *inc)
+{
+	const char *delim;
+	size_t dlen, want, count, idx;
+	char *rdptr, *sep;
+
+	delim = inc->delimiter->str;
+	dlen = inc->delimiter->len;
+	want = inc->column_want_count;
+	count = 0;
+	rdptr = buf;
+	while (count < want) {
+		inc->column_texts[count++] = rdptr;
+		if (!dlen)
+			break;
+		if (dlen == 1)
+			sep = strchr(rdptr, delim[0]);
+		else
+			sep = strstr(rdptr, delim);
+		if (!sep)
+			break;
+		*sep = '\0';
+		rdptr = sep + dlen;
+	}
+	for (idx = 0; idx < count; idx++)
+		g_strchomp(inc->column_texts[idx]);
+
+	return count;
+}
+
+/*
+ * Convert simple decimal text ("-12.345") without an exponent. Only
+ * handles input where the digits fit into the double's mantissa and
+ * the power of ten is exact, which makes the division exact (correctly
+ * rounded) and matches the result of strtod(). Returns FALSE for all
+ * other input, which then takes the generic conversion path.
+ */
+static gboolean parse_decimal_fast(const char *text, double *value)
+{
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22,
+	};
+	const char *rdptr;
+	uint64_t mant;
+	size_t digits, frac;
+	gboolean neg, have_frac;
+	double result;
+
+	rdptr = text;
+	neg = *rdptr == '-';
+	if (*rdptr == '-' || *rdptr == '+')
+		rdptr++;
+	mant = 0;
+	digits = 0;
+	frac = 0;
+	have_frac = FALSE;
+	while (*rdptr) {
+		if (*rdptr >= '0' && *rdptr <= '9') {
+			if (++digits > 15)
+				return FALSE;
+			mant = mant * 10 + (*rdptr - '0');
+			if (have_frac)
+				frac++;
+		} else if (*rdptr == '.' && !have_frac) {
+			have_frac = TRUE;
+		} else {
+			return FALSE;
+		}
+		rdptr++;
+	}
+	if (!digits)
+		return FALSE;
+
+	result = (double)mant;
+	if (frac)
+		result /= pow10[frac];
+	*value = neg ? -result : result;
+
+	return TRUE;
+}
+
 /**
  * Parse a multi-bit field into several logic channels.
  *
@@ -915,7 +1024,9 @@ static int parse_analog(const char *column, struct context *inc,
 		return SR_ERR;
 	}
 	if (sizeof(value) == sizeof(double)) {
-		ret = sr_atod_ascii(column, &dvalue);
+		ret = SR_OK;
+		if (!parse_decimal_fast(column, &dvalue))
+			ret = sr_atod_ascii(column, &dvalue);
 		value = dvalue;
 	} else if (sizeof(value) == sizeof(float)) {
 		ret = sr_atof_ascii(column, &fvalue);
@@ -1220,6 +1331,7 @@ static int init(struct sr_input *in, GHashTable *options)
 		sr_err("Invalid start line %zu.", inc->start_line);
 		return SR_ERR_ARG;
 	}
+	inc->threads = g_variant_get_uint32(g_hash_table_lookup(options, "threads"));
 
 	/*
 	 * Scan flexible, to get prefered format specs which describe
@@ -1529,16 +1641,355 @@ static int initial_receive(const struct sr_input *in)
 	return ret;
 }
 
-static int process_buffer(struct sr_input *in, gboolean is_eof)
+/*
+ * Get the next text line, and terminate it in place. Returns NULL when
+ * the text is exhausted. The text must be NUL terminated at its end.
+ * A trailing termination sequence results in an empty last line.
+ */
+static char *next_line(char **rdptr, char *text_end, const char *term,
+	size_t term_len)
 {
-	struct context *inc;
-	gsize num_columns;
-	size_t line_idx, col_idx, col_nr;
+	char *line, *line_end;
+
+	line = *rdptr;
+	if (!line)
+		return NULL;
+	line_end = line;
+	do {
+		line_end = memchr(line_end, term[0], text_end - line_end);
+		if (!line_end)
+			break;
+		if ((size_t)(text_end - line_end) >= term_len &&
+		    !memcmp(line_end, term, term_len))
+			break;
+		line_end++;
+	} while (TRUE);
+	if (line_end) {
+		*line_end = '\0';
+		line_end += term_len;
+	}
+	*rdptr = line_end;
+
+	return line;
+}
+
+/*
+ * Process a text line, update the current sample set. Tells the caller
+ * whether the line contained data, or was skipped.
+ */
+static int process_line(struct context *inc, char *line, gboolean *is_data)
+{
+	size_t num_columns;
+	size_t col_idx, col_nr;
 	const struct column_details *details;
 	col_parse_cb parse_func;
+	char *column;
+	int ret;
+
+	*is_data = FALSE;
+
+	inc->line_number++;
+	if (inc->line_number < inc->start_line) {
+		sr_spew("Line %zu skipped (before start).", inc->line_number);
+		return SR_OK;
+	}
+	if (line[0] == '\0') {
+		sr_spew("Blank line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+
+	/* Remove trailing comment. */
+	strip_comment(line, inc->comment);
+	if (line[0] == '\0') {
+		sr_spew("Comment-only line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+
+	/* Skip the header line, its content was used as the channel names. */
+	if (inc->use_header && !inc->header_seen) {
+		sr_spew("Header line %zu skipped.", inc->line_number);
+		inc->header_seen = TRUE;
+		return SR_OK;
+	}
+
+	/* Split the line into columns, check for minimum length. */
+	num_columns = split_line_inplace(line, inc);
+	if (num_columns < inc->column_want_count) {
+		sr_err("Insufficient column count %zu in line %zu.",
+			num_columns, inc->line_number);
+		return SR_ERR;
+	}
+
+	/* Have the columns of the current text line processed. */
+	clear_logic_samples(inc);
+	clear_analog_samples(inc);
+	for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
+		column = inc->column_texts[col_idx];
+		col_nr = col_idx + 1;
+		details = lookup_column_details(inc, col_nr);
+		if (!details || !details->text_format)
+			continue;
+		parse_func = col_parse_funcs[details->text_format];
+		if (!parse_func)
+			continue;
+		ret = parse_func(column, inc, details);
+		if (ret != SR_OK)
+			return SR_ERR;
+	}
+	*is_data = TRUE;
+
+	return SR_OK;
+}
+
+/*
+ * Parallel import. Large amounts of buffered text get cut into chunks
+ * at line boundaries, which get parsed by worker threads. Each worker
+ * runs on a private copy of the context, which stores the samples in
+ * the chunk's buffers. The chunks' samples then get copied to the
+ * datafeed buffers in the original order, from within the receive
+ * call's thread.
+ *
+ * This only applies when each line can get processed independently,
+ * i.e. after lines before the start line and the header line were
+ * seen, and when no samplerate detection from timestamps is pending.
+ * Those leading lines get processed sequentially, the remainder of
+ * the same buffer still gets cut into chunks.
+ */
+
+#define PARALLEL_MIN_SIZE	(256 * 1024)
+
+struct csv_chunk {
+	struct context ctx;
+	char *text, *text_end;
+	size_t line_number, line_count;
+	uint8_t *logic;
+	csv_analog_t *analog;
+	size_t sample_count;
+};
+
+static int chunk_work(void *job, void *cb_data)
+{
+	struct csv_chunk *chunk;
+	struct context *wctx;
+	char *rdptr, *line;
+	size_t term_len;
+	gboolean is_data;
+	int ret;
+
+	chunk = job;
+	(void)cb_data;
+	wctx = &chunk->ctx;
+	term_len = strlen(wctx->termination);
+
+	ret = SR_OK;
+	rdptr = chunk->text;
+	while ((line = next_line(&rdptr, chunk->text_end,
+			wctx->termination, term_len))) {
+		ret = process_line(wctx, line, &is_data);
+		if (ret != SR_OK)
+			break;
+		if (!is_data)
+			continue;
+		wctx->datafeed_buf_fill += wctx->sample_unit_size;
+		wctx->analog_datafeed_buf_fill++;
+		chunk->sample_count++;
+	}
+
+	return ret;
+}
+
+/* Append a chunk's samples to the datafeed buffers, in sample order. */
+static int chunk_done(void *job, int status, void *cb_data)
+{
+	struct csv_chunk *chunk;
+	const struct sr_input *in;
+	struct context *inc;
+	size_t pos, count, ch_idx;
+	csv_analog_t *dst;
+	int ret;
+
+	chunk = job;
+	in = cb_data;
+	inc = in->priv;
+
+	/*
+	 * Samples of a failed chunk up to the erroneous line still get
+	 * sent, later chunks get discarded. Like sequential processing.
+	 */
+	ret = inc->workers_failed ? SR_ERR : SR_OK;
+	pos = 0;
+	while (ret == SR_OK && pos < chunk->sample_count) {
+		/* Copy up to the point where either buffer becomes full. */
+		count = chunk->sample_count - pos;
+		if (inc->logic_channels) {
+			count = MIN(count, (inc->datafeed_buf_size -
+				inc->datafeed_buf_fill) / inc->sample_unit_size);
+			memcpy(&inc->datafeed_buffer[inc->datafeed_buf_fill],
+				&chunk->logic[pos * inc->sample_unit_size],
+				count * inc->sample_unit_size);
+		}
+		if (inc->analog_channels) {
+			count = MIN(count, inc->analog_datafeed_buf_size -
+				inc->analog_datafeed_buf_fill);
+			dst = &inc->analog_datafeed_buffer[inc->analog_datafeed_buf_fill];
+			for (ch_idx = 0; ch_idx < inc->analog_channels; ch_idx++) {
+				memcpy(&dst[ch_idx * inc->analog_datafeed_buf_size],
+					&chunk->analog[ch_idx * chunk->line_count + pos],
+					count * sizeof(dst[0]));
+			}
+		}
+		pos += count;
+
+		/* Flush like queue_logic_samples() et al would have done. */
+		if (inc->logic_channels) {
+			inc->datafeed_buf_fill += count * inc->sample_unit_size;
+			if (inc->datafeed_buf_fill == inc->datafeed_buf_size)
+				ret = flush_logic_samples(in);
+		}
+		if (ret == SR_OK && inc->analog_channels) {
+			inc->analog_datafeed_buf_fill += count;
+			if (inc->analog_datafeed_buf_fill == inc->analog_datafeed_buf_size)
+				ret = flush_analog_samples(in);
+		}
+		if (ret != SR_OK)
+			sr_err("Sending samples failed.");
+	}
+	if (!inc->workers_failed)
+		inc->line_number = chunk->ctx.line_number;
+	if (ret == SR_OK)
+		ret = status;
+	if (ret != SR_OK)
+		inc->workers_failed = TRUE;
+
+	g_free(chunk->ctx.column_texts);
+	g_free(chunk->logic);
+	g_free(chunk->analog);
+	g_free(chunk);
+
+	return ret;
+}
+
+static gboolean can_process_parallel(struct context *inc, size_t length)
+{
+	size_t col_idx;
+
+	if (inc->threads < 2 || length < PARALLEL_MIN_SIZE)
+		return FALSE;
+	if (inc->line_number + 1 < inc->start_line)
+		return FALSE;
+	if (inc->use_header && !inc->header_seen)
+		return FALSE;
+	if (!inc->calc_samplerate) {
+		for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
+			if (format_is_timestamp(inc->column_details[col_idx].text_format))
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Count the text lines in a range, the same way next_line() does. */
+static size_t count_lines(char *text, char *text_end, const char *term,
+	size_t term_len)
+{
+	size_t count;
+
+	count = 1;
+	while ((text = memchr(text, term[0], text_end - text))) {
+		if ((size_t)(text_end - text) >= term_len &&
+		    !memcmp(text, term, term_len)) {
+			count++;
+			text += term_len;
+			continue;
+		}
+		text++;
+	}
+
+	return count;
+}
+
+static int process_parallel(const struct sr_input *in, char *text,
+	char *text_end)
+{
+	struct context *inc;
+	struct csv_chunk *chunk;
+	size_t term_len, chunk_size, line_number;
+	char *chunk_end, *next;
+	int ret, first_ret;
+
+	inc = in->priv;
+	term_len = strlen(inc->termination);
+
+	if (!inc->workers) {
+		inc->workers = sr_async_new(inc->threads,
+			2 * inc->threads, chunk_work, chunk_done, (void *)in);
+		if (!inc->workers)
+			return SR_ERR;
+	}
+
+	inc->workers_failed = FALSE;
+	chunk_size = (text_end - text) / inc->threads;
+	chunk_size = MAX(chunk_size, PARALLEL_MIN_SIZE / 4);
+	line_number = inc->line_number;
+	first_ret = SR_OK;
+	while (text) {
+		/* Cut the chunk after a line's termination sequence. */
+		next = NULL;
+		chunk_end = text_end;
+		if ((size_t)(text_end - text) > chunk_size) {
+			next = text + chunk_size;
+			(void)next_line(&next, text_end, inc->termination, term_len);
+			if (next)
+				chunk_end = next - term_len;
+		}
+
+		chunk = g_malloc0(sizeof(*chunk));
+		chunk->text = text;
+		chunk->text_end = chunk_end;
+		chunk->line_number = line_number;
+		chunk->line_count = count_lines(text, chunk_end,
+			inc->termination, term_len);
+		line_number += chunk->line_count;
+		if (inc->logic_channels) {
+			chunk->logic = g_malloc(chunk->line_count *
+				inc->sample_unit_size);
+		}
+		if (inc->analog_channels) {
+			chunk->analog = g_malloc(chunk->line_count *
+				inc->analog_channels * sizeof(chunk->analog[0]));
+		}
+
+		/* The worker's context stores samples in the chunk. */
+		chunk->ctx = *inc;
+		chunk->ctx.line_number = chunk->line_number;
+		chunk->ctx.column_texts = g_malloc0(inc->column_want_count *
+			sizeof(chunk->ctx.column_texts[0]));
+		chunk->ctx.datafeed_buffer = chunk->logic;
+		chunk->ctx.datafeed_buf_fill = 0;
+		chunk->ctx.analog_datafeed_buffer = chunk->analog;
+		chunk->ctx.analog_datafeed_buf_size = chunk->line_count;
+		chunk->ctx.analog_datafeed_buf_fill = 0;
+		ret = sr_async_submit(inc->workers, chunk);
+		if (first_ret == SR_OK)
+			first_ret = ret;
+		text = next;
+	}
+	ret = sr_async_flush(inc->workers);
+	if (first_ret == SR_OK)
+		first_ret = ret;
+
+	return first_ret == SR_OK ? SR_OK : SR_ERR;
+}
+
+static int process_buffer(struct sr_input *in, gboolean is_eof)
+{
+	struct context *inc;
+	gboolean is_data;
 	int ret;
 	char *processed_up_to;
-	char **lines, *line, **columns, *column;
+	char *rdptr, *line, *text_end;
+	size_t term_len;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -1561,94 +2012,57 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 	 */
 	if (!in->buf->len)
 		return SR_OK;
+	term_len = strlen(inc->termination);
 	if (is_eof) {
 		processed_up_to = in->buf->str + in->buf->len;
+		text_end = processed_up_to;
 	} else {
 		processed_up_to = g_strrstr_len(in->buf->str, in->buf->len,
 			inc->termination);
 		if (!processed_up_to)
 			return SR_OK;
 		*processed_up_to = '\0';
-		processed_up_to += strlen(inc->termination);
+		text_end = processed_up_to;
+		processed_up_to += term_len;
 	}
 
-	/* Split input text lines and process their columns. */
+	/*
+	 * Walk the input text lines and process their columns. The text
+	 * gets modified in place, no copies are made. Strictly speaking
+	 * an empty buffer has no lines, while a trailing termination
+	 * sequence results in an empty line.
+	 */
 	ret = SR_OK;
-	lines = g_strsplit(in->buf->str, inc->termination, 0);
-	for (line_idx = 0; (line = lines[line_idx]); line_idx++) {
-		inc->line_number++;
-		if (inc->line_number < inc->start_line) {
-			sr_spew("Line %zu skipped (before start).", inc->line_number);
-			continue;
-		}
-		if (line[0] == '\0') {
-			sr_spew("Blank line %zu skipped.", inc->line_number);
-			continue;
-		}
-
-		/* Remove trailing comment. */
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", inc->line_number);
-			continue;
+	if (!inc->column_texts) {
+		inc->column_texts = g_malloc0(inc->column_want_count *
+			sizeof(inc->column_texts[0]));
+	}
+	rdptr = in->buf->str;
+	if (!*rdptr)
+		rdptr = NULL;
+	while (rdptr) {
+		/* Leading lines are done, have the remainder parsed in parallel. */
+		if (can_process_parallel(inc, text_end - rdptr)) {
+			ret = process_parallel(in, rdptr, text_end);
+			if (ret != SR_OK)
+				return ret;
+			break;
 		}
-
-		/* Skip the header line, its content was used as the channel names. */
-		if (inc->use_header && !inc->header_seen) {
-			sr_spew("Header line %zu skipped.", inc->line_number);
-			inc->header_seen = TRUE;
+		line = next_line(&rdptr, text_end, inc->termination, term_len);
+		ret = process_line(inc, line, &is_data);
+		if (ret != SR_OK)
+			return ret;
+		if (!is_data)
 			continue;
-		}
-
-		/* Split the line into columns, check for minimum length. */
-		columns = split_line(line, inc);
-		if (!columns) {
-			sr_err("Error while parsing line %zu.", inc->line_number);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-		num_columns = g_strv_length(columns);
-		if (num_columns < inc->column_want_count) {
-			sr_err("Insufficient column count %zu in line %zu.",
-				num_columns, inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-
-		/* Have the columns of the current text line processed. */
-		clear_logic_samples(inc);
-		clear_analog_samples(inc);
-		for (col_idx = 0; col_idx < inc->column_want_count; col_idx++) {
-			column = columns[col_idx];
-			col_nr = col_idx + 1;
-			details = lookup_column_details(inc, col_nr);
-			if (!details || !details->text_format)
-				continue;
-			parse_func = col_parse_funcs[details->text_format];
-			if (!parse_func)
-				continue;
-			ret = parse_func(column, inc, details);
-			if (ret != SR_OK) {
-				g_strfreev(columns);
-				g_strfreev(lines);
-				return SR_ERR;
-			}
-		}
 
 		/* Send sample data to the session bus (buffered). */
 		ret = queue_logic_samples(in);
 		ret += queue_analog_samples(in);
 		if (ret != SR_OK) {
 			sr_err("Sending samples failed.");
-			g_strfreev(columns);
-			g_strfreev(lines);
 			return SR_ERR;
 		}
-
-		g_strfreev(columns);
 	}
-	g_strfreev(lines);
 	g_string_erase(in->buf, 0, processed_up_to - in->buf->str);
 
 	return ret;
@@ -1726,6 +2140,10 @@ static void cleanup(struct sr_input *in)
 	/* TODO Release channel names (before releasing details). */
 	g_free(inc->column_details);
 	inc->column_details = NULL;
+	g_free(inc->column_texts);
+	inc->column_texts = NULL;
+	sr_async_free(inc->workers);
+	inc->workers = NULL;
 
 	/* Clear internal state, but keep what .init() has provided. */
 	save_ctx = *inc;
@@ -1736,6 +2154,7 @@ static void cleanup(struct sr_input *in)
 	inc->column_formats = save_ctx.column_formats;
 	inc->start_line = save_ctx.start_line;
 	inc->use_header = save_ctx.use_header;
+	inc->threads = save_ctx.threads;
 	inc->prev_sr_channels = save_ctx.prev_sr_channels;
 	inc->prev_df_channels = save_ctx.prev_df_channels;
 }
@@ -1763,6 +2182,7 @@ enum option_index {
 	OPT_SAMPLERATE,
 	OPT_COL_SEP,
 	OPT_COMMENT,
+	OPT_THREADS,
 	OPT_MAX,
 };
 
@@ -1817,6 +2237,11 @@ static struct sr_option options[] = {
 		"The text which starts comments at the end of text lines, semicolon by default.",
 		NULL, NULL,
 	},
+	[OPT_THREADS] = {
+		"threads", "Worker threads",
+		"The number of threads which parse large input in parallel. Zero processes all input sequentially (default).",
+		NULL, NULL,
+	},
 	[OPT_MAX] = ALL_ZERO,
 };
 
@@ -1840,6 +2265,7 @@ static const struct sr_option *get_options(void)
 		options[OPT_SAMPLERATE].def = g_variant_ref_sink(g_variant_new_uint64(0));
 		options[OPT_COL_SEP].def = g_variant_ref_sink(g_variant_new_string(","));
 		options[OPT_COMMENT].def = g_variant_ref_sink(g_variant_new_string(";"));
+		options[OPT_THREADS].def = g_variant_ref_sink(g_variant_new_uint32(0));
 	}
 
 	return options;
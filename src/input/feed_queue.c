@@ -29,6 +29,10 @@ struct feed_queue_logic {
 	uint8_t *data_bytes;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	uint32_t *run_lengths;
+	size_t run_samples;
+	struct sr_datafeed_packet rle_packet;
+	struct sr_datafeed_logic_rle rle;
 };
 
 SR_API struct feed_queue_logic *feed_queue_logic_alloc(
@@ -57,22 +61,125 @@ SR_API struct feed_queue_logic *feed_queue_logic_alloc(
 	return q;
 }
 
+/*
+ * Append samples to the queue in run length encoded mode. The queue's
+ * data buffer holds the runs' values. Consecutive identical samples
+ * extend the last run. The queue gets sent when the runs' total length
+ * reaches the queue's sample count, so that no packet expands to more
+ * samples than a packet of the non-RLE queue would hold.
+ */
+static int submit_run(struct feed_queue_logic *q,
+	const uint8_t *data, size_t count)
+{
+	uint32_t *length;
+	size_t add;
+	int ret;
+
+	while (count) {
+		if (q->run_samples == q->alloc_count) {
+			ret = feed_queue_logic_flush(q);
+			if (ret != SR_OK)
+				return ret;
+		}
+		if (q->fill_count) {
+			length = &q->run_lengths[q->fill_count - 1];
+			if (*length < UINT32_MAX && memcmp(data,
+					&q->data_bytes[(q->fill_count - 1) * q->unit_size],
+					q->unit_size) == 0) {
+				add = MIN(count, UINT32_MAX - *length);
+				add = MIN(add, q->alloc_count - q->run_samples);
+				*length += add;
+				q->run_samples += add;
+				count -= add;
+				continue;
+			}
+		}
+		memcpy(&q->data_bytes[q->fill_count * q->unit_size],
+			data, q->unit_size);
+		q->run_lengths[q->fill_count++] = 0;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Submit one sample value, repeated count times (run length encoded
+ * input). Gets stored in the queue's buffer, which is sent whenever it
+ * is full.
+ */
 SR_API int feed_queue_logic_submit(struct feed_queue_logic *q,
 	const uint8_t *data, size_t count)
 {
-	uint8_t *wrptr;
+	size_t space;
 	int ret;
 
-	wrptr = &q->data_bytes[q->fill_count * q->unit_size];
-	while (count--) {
-		memcpy(wrptr, data, q->unit_size);
-		wrptr += q->unit_size;
-		q->fill_count++;
+	if (q->run_lengths)
+		return submit_run(q, data, count);
+
+	while (count) {
+		space = MIN(count, q->alloc_count - q->fill_count);
+		sr_logic_fill_repeat(&q->data_bytes[q->fill_count * q->unit_size],
+			data, q->unit_size, space);
+		q->fill_count += space;
+		count -= space;
+		if (q->fill_count == q->alloc_count) {
+			ret = feed_queue_logic_flush(q);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Submit a block of contiguous samples. Data gets copied to the queue's
+ * buffer in ranges up to the next flush. Blocks of at least the queue's
+ * size get sent from the caller's memory without copying them, when the
+ * queue is empty.
+ */
+SR_API int feed_queue_logic_submit_many(struct feed_queue_logic *q,
+	const uint8_t *data, size_t count)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	size_t space;
+	int ret;
+
+	if (q->run_lengths) {
+		while (count--) {
+			ret = submit_run(q, data, 1);
+			if (ret != SR_OK)
+				return ret;
+			data += q->unit_size;
+		}
+		return SR_OK;
+	}
+
+	while (count) {
+		if (!q->fill_count && count >= q->alloc_count) {
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+			logic.unitsize = q->unit_size;
+			logic.length = q->alloc_count * q->unit_size;
+			logic.data = (void *)data;
+			ret = sr_session_send(q->sdi, &packet);
+			if (ret != SR_OK)
+				return ret;
+			data += logic.length;
+			count -= q->alloc_count;
+			continue;
+		}
+		space = MIN(count, q->alloc_count - q->fill_count);
+		memcpy(&q->data_bytes[q->fill_count * q->unit_size],
+			data, space * q->unit_size);
+		q->fill_count += space;
+		data += space * q->unit_size;
+		count -= space;
 		if (q->fill_count == q->alloc_count) {
 			ret = feed_queue_logic_flush(q);
 			if (ret != SR_OK)
 				return ret;
-			wrptr = &q->data_bytes[0];
 		}
 	}
 
@@ -86,11 +193,58 @@ SR_API int feed_queue_logic_flush(struct feed_queue_logic *q)
 	if (!q->fill_count)
 		return SR_OK;
 
-	q->logic.length = q->fill_count * q->unit_size;
-	ret = sr_session_send(q->sdi, &q->packet);
+	if (q->run_lengths) {
+		q->rle.run_count = q->fill_count;
+		ret = sr_session_send(q->sdi, &q->rle_packet);
+	} else {
+		q->logic.length = q->fill_count * q->unit_size;
+		ret = sr_session_send(q->sdi, &q->packet);
+	}
 	if (ret != SR_OK)
 		return ret;
 	q->fill_count = 0;
+	q->run_samples = 0;
+
+	return SR_OK;
+}
+
+/*
+ * Have the queue send run length encoded data (SR_DF_LOGIC_RLE) instead
+ * of individual samples. The queue's sample count still bounds the number
+ * of samples which a packet expands to. Sources which receive compressed
+ * data from devices save the expansion, consumers which don't support the
+ * packet type receive expanded data from the session.
+ */
+SR_API int feed_queue_logic_rle_set(struct feed_queue_logic *q,
+	gboolean enable)
+{
+	int ret;
+
+	if (!q)
+		return SR_ERR_ARG;
+	if (enable == (q->run_lengths != NULL))
+		return SR_OK;
+
+	ret = feed_queue_logic_flush(q);
+	if (ret != SR_OK)
+		return ret;
+
+	if (!enable) {
+		g_free(q->run_lengths);
+		q->run_lengths = NULL;
+		return SR_OK;
+	}
+
+	q->run_lengths = g_try_malloc(q->alloc_count * sizeof(q->run_lengths[0]));
+	if (!q->run_lengths)
+		return SR_ERR_MALLOC;
+	memset(&q->rle_packet, 0, sizeof(q->rle_packet));
+	memset(&q->rle, 0, sizeof(q->rle));
+	q->rle_packet.type = SR_DF_LOGIC_RLE;
+	q->rle_packet.payload = &q->rle;
+	q->rle.unitsize = q->unit_size;
+	q->rle.values = q->data_bytes;
+	q->rle.lengths = q->run_lengths;
 
 	return SR_OK;
 }
@@ -117,6 +271,7 @@ SR_API void feed_queue_logic_free(struct feed_queue_logic *q)
 		return;
 
 	g_free(q->data_bytes);
+	g_free(q->run_lengths);
 	g_free(q);
 }
 
@@ -162,13 +317,93 @@ SR_API struct feed_queue_analog *feed_queue_analog_alloc(
 	return q;
 }
 
+/* Set the queue's physical quantity and unit, flushes pending data. */
+SR_API int feed_queue_analog_mq_unit(struct feed_queue_analog *q,
+	enum sr_mq mq, enum sr_mqflag mq_flag, enum sr_unit unit)
+{
+	int ret;
+
+	if (q->meaning.mq == mq && q->meaning.mqflags == mq_flag &&
+			q->meaning.unit == unit)
+		return SR_OK;
+
+	ret = feed_queue_analog_flush(q);
+	if (ret != SR_OK)
+		return ret;
+	q->meaning.mq = mq;
+	q->meaning.mqflags = mq_flag;
+	q->meaning.unit = unit;
+
+	return SR_OK;
+}
+
+/* Submit one value, repeated count times. */
 SR_API int feed_queue_analog_submit(struct feed_queue_analog *q,
 	float data, size_t count)
 {
+	float *wrptr;
+	size_t space;
+	int ret;
+
+	while (count) {
+		space = MIN(count, q->alloc_count - q->fill_count);
+		wrptr = &q->data_values[q->fill_count];
+		q->fill_count += space;
+		count -= space;
+		while (space--)
+			*wrptr++ = data;
+		if (q->fill_count == q->alloc_count) {
+			ret = feed_queue_analog_flush(q);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Submit a block of values. The stride is the distance of values in
+ * the caller's memory, in units of floats, and allows to pick one
+ * channel's values from interleaved data. Contiguous blocks of at least
+ * the queue's size get sent from the caller's memory without copying
+ * them, when the queue is empty.
+ */
+SR_API int feed_queue_analog_submit_many(struct feed_queue_analog *q,
+	const float *data, size_t count, size_t stride)
+{
+	float *wrptr;
+	size_t space, idx;
 	int ret;
 
-	while (count--) {
-		q->data_values[q->fill_count++] = data;
+	if (!stride)
+		return SR_ERR_ARG;
+
+	while (count) {
+		if (stride == 1 && !q->fill_count && count >= q->alloc_count) {
+			q->analog.data = (void *)data;
+			q->analog.num_samples = q->alloc_count;
+			ret = sr_session_send(q->sdi, &q->packet);
+			q->analog.data = q->data_values;
+			if (ret != SR_OK)
+				return ret;
+			data += q->alloc_count;
+			count -= q->alloc_count;
+			continue;
+		}
+		space = MIN(count, q->alloc_count - q->fill_count);
+		wrptr = &q->data_values[q->fill_count];
+		if (stride == 1) {
+			memcpy(wrptr, data, space * sizeof(*data));
+			data += space;
+		} else {
+			for (idx = 0; idx < space; idx++) {
+				wrptr[idx] = *data;
+				data += stride;
+			}
+		}
+		q->fill_count += space;
+		count -= space;
 		if (q->fill_count == q->alloc_count) {
 			ret = feed_queue_analog_flush(q);
 			if (ret != SR_OK)
@@ -597,6 +597,120 @@ SR_API int sr_input_send(const struct sr_input *in, GString *buf)
 	return in->module->receive((struct sr_input *)in, buf);
 }
 
+/**
+ * Send data from a memory mapped region to the specified input instance.
+ *
+ * This is an alternative to sr_input_send() for applications which have
+ * their input data in memory already, typically because they mapped the
+ * input file (see g_mapped_file_new()). Input modules which support this
+ * path hand sample data in the region to the session without copying it.
+ * Other modules receive the data through their regular receive() method,
+ * in slices which are backed by the region as well.
+ *
+ * The region needs to be valid for the duration of the call only, it is
+ * not referenced afterwards. Data which an input module needs to keep
+ * across calls (incomplete samples, headers) gets copied. The region
+ * must be writable (a private mapping is fine), since transform modules
+ * can modify sample data in place.
+ *
+ * Like sr_input_send(), this routine returns the moment when the device
+ * instance became ready. In that case fewer than @a length bytes may
+ * have been consumed. Callers are expected to examine the device
+ * instance, then send the remaining data.
+ *
+ * @param[in] in The input instance.
+ * @param[in] data The start of the region.
+ * @param[in] length The number of bytes in the region.
+ * @param[out] consumed The number of bytes which were consumed.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ * @retval other Negative error code.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_send_mapped(const struct sr_input *in, void *data,
+	size_t length, size_t *consumed)
+{
+	GString slice;
+	size_t offset;
+	gboolean was_ready;
+	int ret;
+
+	if (!in || !consumed || (!data && length))
+		return SR_ERR_ARG;
+	*consumed = 0;
+
+	sr_spew("Sending %zu mapped bytes to %s module.", length, in->module->id);
+	if (in->module->receive_mapped) {
+		return in->module->receive_mapped((struct sr_input *)in,
+			data, length, consumed);
+	}
+
+	/*
+	 * Feed modules without support for mapped input in slices. The
+	 * receive() methods only read the caller's buffer, so the slice
+	 * need not be a copy. Stop when the device instance has become
+	 * ready, to not run ahead of the application.
+	 */
+	ret = SR_OK;
+	offset = 0;
+	while (offset < length) {
+		memset(&slice, 0, sizeof(slice));
+		slice.str = (char *)data + offset;
+		slice.len = MIN(length - offset, CHUNK_SIZE);
+		slice.allocated_len = slice.len;
+		was_ready = in->sdi_ready;
+		ret = in->module->receive((struct sr_input *)in, &slice);
+		if (ret != SR_OK)
+			break;
+		offset += slice.len;
+		if (in->sdi_ready && !was_ready)
+			break;
+	}
+	*consumed = offset;
+
+	return ret;
+}
+
+/**
+ * Pass whole units of mapped input data to an input module's sender.
+ *
+ * @param[in] in The input instance.
+ * @param[in] data The start of the region.
+ * @param[in] length The number of bytes in the region.
+ * @param[in] unitsize The size of a unit (a sample), in bytes.
+ * @param[in] send_cb Sends units from a buffer, returns the number of
+ *   bytes which it has consumed.
+ *
+ * Units in the region are passed to @a send_cb in place. A unit which
+ * spans regions gets assembled in the receive buffer. Data which the
+ * sender did not consume gets kept there, too.
+ */
+SR_PRIV void sr_input_mapped_units(struct sr_input *in, uint8_t *data,
+	size_t length, size_t unitsize, sr_input_units_cb send_cb)
+{
+	size_t fill, used;
+
+	if (in->buf->len) {
+		fill = (unitsize - in->buf->len % unitsize) % unitsize;
+		fill = MIN(fill, length);
+		g_string_append_len(in->buf, (const char *)data, fill);
+		data += fill;
+		length -= fill;
+		used = send_cb(in, (uint8_t *)in->buf->str, in->buf->len);
+		g_string_erase(in->buf, 0, used);
+		if (in->buf->len) {
+			g_string_append_len(in->buf, (const char *)data, length);
+			return;
+		}
+	}
+
+	used = send_cb(in, data, length);
+	if (used < length)
+		g_string_append_len(in->buf, (const char *)data + used, length - used);
+}
+
 /**
  * Signal the input module no more data will come.
  *
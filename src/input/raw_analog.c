@@ -152,10 +152,11 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+/* Send all whole samples from a buffer, return the consumed size. */
+static size_t send_samples(struct sr_input *in, uint8_t *data, size_t length)
 {
 	struct context *inc;
-	unsigned int offset, chunk_size;
+	size_t offset, chunk_size;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -174,21 +175,29 @@ static int process_buffer(struct sr_input *in)
 	chunk_size = inc->analog.num_samples * inc->samplesize;
 	offset = 0;
 
-	while ((offset + chunk_size) < in->buf->len) {
-		inc->analog.data = in->buf->str + offset;
+	while ((offset + chunk_size) < length) {
+		inc->analog.data = data + offset;
 		sr_session_send(in->sdi, &inc->packet);
 		offset += chunk_size;
 	}
 
-	inc->analog.num_samples = (in->buf->len - offset) / inc->samplesize;
+	inc->analog.num_samples = (length - offset) / inc->samplesize;
 	chunk_size = inc->analog.num_samples * inc->samplesize;
 	if (chunk_size > 0) {
-		inc->analog.data = in->buf->str + offset;
+		inc->analog.data = data + offset;
 		sr_session_send(in->sdi, &inc->packet);
 		offset += chunk_size;
 	}
 
-	if ((unsigned int)offset < in->buf->len) {
+	return offset;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	size_t offset;
+
+	offset = send_samples(in, (uint8_t *)in->buf->str, in->buf->len);
+	if (offset < in->buf->len) {
 		/*
 		 * The incoming buffer wasn't processed completely. Stash
 		 * the leftover data for next time.
@@ -218,6 +227,25 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+static int receive_mapped(struct sr_input *in, uint8_t *data,
+	size_t length, size_t *consumed)
+{
+	struct context *inc;
+
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		*consumed = 0;
+		return SR_OK;
+	}
+
+	inc = in->priv;
+	sr_input_mapped_units(in, data, length, inc->samplesize, send_samples);
+	*consumed = length;
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -287,6 +315,7 @@ SR_PRIV struct sr_input_module input_raw_analog = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_mapped = receive_mapped,
 	.end = end,
 	.cleanup = cleanup,
 	.reset = reset,
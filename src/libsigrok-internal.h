@@ -1274,6 +1274,24 @@ struct sr_input_module {
 	 */
 	int (*receive) (struct sr_input *in, GString *buf);
 
+	/**
+	 * Send data from a memory mapped region to the specified input
+	 * instance.
+	 *
+	 * This function is optional. Modules which implement it pass
+	 * sample data from the region to the session without copying
+	 * it. The region is only valid during the call. Data which is
+	 * needed later must be kept in the receive buffer.
+	 *
+	 * Returns early with @a consumed less than @a length when the
+	 * device instance became ready, like receive() does.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_mapped) (struct sr_input *in, uint8_t *data,
+		size_t length, size_t *consumed);
+
 	/**
 	 * Signal the input module no more data will come.
 	 *
@@ -1768,6 +1786,12 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+	/** Ring size of the datafeed thread, zero to run callbacks inline. */
+	size_t feed_ring_size;
+	/** Datafeed ring and its consumer thread, while the session runs. */
+	struct session_feed *feed;
+	/** Datafeed thread statistics of the current or most recent run. */
+	struct sr_session_feed_stats feed_stats;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -1798,6 +1822,11 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 		uint32_t key, GVariant *var);
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+
+typedef void (*sr_packet_release_cb)(void *buffer, void *cb_data);
+SR_PRIV struct sr_datafeed_packet *sr_packet_logic_new(
+		const struct sr_datafeed_logic *logic, void *buffer,
+		sr_packet_release_cb release, void *cb_data);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
@@ -1813,6 +1842,43 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
 
+/*
+ * Summary entries in srzip archives ("summary-" plus the data entries'
+ * name prefix). All fields are little endian. The header holds the
+ * version, the kind, the logic unit size (zero for analog data), the
+ * fanout (all u32), the samples per block and the total sample count
+ * (both u64), the level count and a reserved field (both u32), and
+ * each level's record count (u64). The records follow, level 0 (one
+ * record per block) first.
+ * Logic records hold the number of samples which differ from their
+ * predecessor (u64), and the OR and AND masks of all samples in the
+ * block (unit size bytes each). Analog records
+ * hold the minimum, maximum and mean (float) of the block. Each record
+ * of the next level combines up to fanout records of the previous one.
+ */
+#define SR_SUMMARY_VERSION 1
+#define SR_SUMMARY_LOGIC 1
+#define SR_SUMMARY_ANALOG 2
+#define SR_SUMMARY_FANOUT 16
+#define SR_SUMMARY_HEADER_SIZE (6 * sizeof(uint32_t) + 2 * sizeof(uint64_t))
+#define SR_SUMMARY_ANALOG_RECORD_SIZE (3 * sizeof(float))
+#define SR_SUMMARY_LOGIC_RECORD_SIZE(unitsize) \
+	(sizeof(uint64_t) + 2 * (unitsize))
+
+/*--- conversion.c ----------------------------------------------------------*/
+
+/* Size in bytes of SR_DF_LOGIC packets for expanded SR_DF_LOGIC_RLE data. */
+#define SR_LOGIC_RLE_CHUNK (1024 * 1024)
+
+SR_PRIV void sr_bits_transpose_16x16(uint16_t m[16]);
+SR_PRIV void sr_bits_transpose_32x32(uint32_t m[32]);
+SR_PRIV void sr_logic_fill_repeat(uint8_t *wrptr, const uint8_t *value,
+	size_t unitsize, size_t count);
+typedef int (*sr_logic_rle_chunk_cb)(const struct sr_datafeed_packet *packet,
+	void *cb_data);
+SR_PRIV int sr_logic_rle_unpack(const struct sr_datafeed_logic_rle *rle,
+	sr_logic_rle_chunk_cb cb, void *cb_data);
+
 /*--- analog.c --------------------------------------------------------------*/
 
 SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
@@ -1929,12 +1995,16 @@ SR_PRIV void sr_hexdump_free(GString *s);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+struct soft_trigger_logic_stage;
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
-	int count;
+	gboolean have_prev;
 	int unitsize;
 	int cur_stage;
+	int num_stages;
+	struct soft_trigger_logic_stage *stages;
 	uint8_t *prev_sample;
 	uint8_t *pre_trigger_buffer;
 	uint8_t *pre_trigger_head;
@@ -1950,6 +2020,32 @@ SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
 
+struct soft_trigger_analog_stage;
+struct feed_queue_analog;
+
+struct soft_trigger_analog {
+	const struct sr_dev_inst *sdi;
+	/** The (single) analog channel which the trigger checks. */
+	struct sr_channel *channel;
+	struct feed_queue_analog *queue;
+	gboolean have_prev;
+	float prev_value;
+	int cur_stage;
+	int num_stages;
+	struct soft_trigger_analog_stage *stages;
+	float *pre_trigger_buffer;
+	int pre_trigger_size;
+	int pre_trigger_head;
+	int pre_trigger_fill;
+};
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, struct feed_queue_analog *queue);
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta);
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const float *values, int count, int *pre_trigger_samples);
+
 /*--- serial.c --------------------------------------------------------------*/
 
 #ifdef HAVE_SERIAL_COMM
@@ -2138,6 +2234,66 @@ SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 		const char *manufacturer, const char *product);
 #endif
 
+/*--- usb_stream.c ----------------------------------------------------------*/
+
+#ifdef HAVE_LIBUSB_1_0
+struct sr_usb_stream;
+
+/** Transfers wait for data indefinitely, for slow or bursty devices. */
+#define SR_USB_STREAM_NO_TIMEOUT ((unsigned int)-1)
+
+/** Bulk IN stream configuration, zero fields get derived. */
+struct sr_usb_stream_config {
+	/** Endpoint address, including LIBUSB_ENDPOINT_IN. */
+	uint8_t endpoint;
+	/** Samplerate, used to derive sizes. */
+	uint64_t samplerate;
+	/**
+	 * Bits per sample on the wire. Unitsize times 8, or the number
+	 * of enabled channels for devices which send channels serially.
+	 */
+	size_t sample_bits;
+	/** Size of a transfer in bytes. */
+	size_t buffer_size;
+	/** Transfer sizes get rounded up to a multiple of this (512). */
+	size_t granularity;
+	/** Number of transfers in the ring. */
+	size_t buffer_count;
+	/** Timeout of a transfer in ms, or SR_USB_STREAM_NO_TIMEOUT. */
+	unsigned int timeout;
+	/** Consecutive empty or failed transfers which are tolerated. */
+	unsigned int max_empty;
+	/** The driver runs the USB event source, see sr_usb_stream_poll(). */
+	gboolean driver_source;
+};
+
+struct sr_usb_stream_stats {
+	uint64_t submitted;
+	uint64_t completed;
+	uint64_t bytes;
+	uint64_t empty;
+	uint64_t overruns;
+	uint64_t latency_sum_us;
+	uint64_t latency_max_us;
+	/** Most transfers which completed within one round of events. */
+	size_t max_batch;
+};
+
+typedef gboolean (*sr_usb_stream_data_cb)(const uint8_t *data,
+	size_t length, void *cb_data);
+typedef void (*sr_usb_stream_done_cb)(int status, void *cb_data);
+
+SR_PRIV struct sr_usb_stream *sr_usb_stream_new(const struct sr_dev_inst *sdi,
+	struct sr_usb_stream_config *cfg, sr_usb_stream_data_cb data_cb,
+	sr_usb_stream_done_cb done_cb, void *cb_data);
+SR_PRIV int sr_usb_stream_start(struct sr_usb_stream *stream);
+SR_PRIV void sr_usb_stream_stop(struct sr_usb_stream *stream);
+SR_PRIV int sr_usb_stream_poll(struct sr_usb_stream *stream);
+SR_PRIV int sr_usb_stream_stats_get(struct sr_usb_stream *stream,
+	struct sr_usb_stream_stats *stats);
+SR_PRIV void sr_usb_stream_free(struct sr_usb_stream *stream);
+#endif
+
 /*--- binary_helpers.c ------------------------------------------------------*/
 
 /** Binary value type */
@@ -2761,6 +2917,37 @@ SR_PRIV void sr_sw_limits_update_frames_read(struct sr_sw_limits *limits,
 	uint64_t frames_read);
 SR_PRIV void sr_sw_limits_init(struct sr_sw_limits *limits);
 
+/*--- async.c ---------------------------------------------------------------*/
+
+struct sr_async;
+
+struct sr_async_stats {
+	uint64_t submitted;
+	uint64_t completed;
+	uint64_t stalls;
+	uint64_t wait_usec;
+	size_t max_depth;
+};
+
+typedef int (*sr_async_work_cb)(void *job, void *cb_data);
+typedef int (*sr_async_done_cb)(void *job, int status, void *cb_data);
+
+SR_PRIV struct sr_async *sr_async_new(size_t threads, size_t depth,
+	sr_async_work_cb work_cb, sr_async_done_cb done_cb, void *cb_data);
+SR_PRIV int sr_async_submit(struct sr_async *q, void *job);
+SR_PRIV int sr_async_flush(struct sr_async *q);
+SR_PRIV int sr_async_stats_get(struct sr_async *q,
+	struct sr_async_stats *stats);
+SR_PRIV void sr_async_free(struct sr_async *q);
+
+/*--- input/input.c ---------------------------------------------------------*/
+
+typedef size_t (*sr_input_units_cb)(struct sr_input *in,
+	uint8_t *data, size_t length);
+
+SR_PRIV void sr_input_mapped_units(struct sr_input *in, uint8_t *data,
+	size_t length, size_t unitsize, sr_input_units_cb send_cb);
+
 /*--- feed_queue.h ----------------------------------------------------------*/
 
 struct feed_queue_logic;
@@ -2771,15 +2958,23 @@ SR_API struct feed_queue_logic *feed_queue_logic_alloc(
 	size_t sample_count, size_t unit_size);
 SR_API int feed_queue_logic_submit(struct feed_queue_logic *q,
 	const uint8_t *data, size_t count);
+SR_API int feed_queue_logic_submit_many(struct feed_queue_logic *q,
+	const uint8_t *data, size_t count);
 SR_API int feed_queue_logic_flush(struct feed_queue_logic *q);
+SR_API int feed_queue_logic_rle_set(struct feed_queue_logic *q,
+	gboolean enable);
 SR_API int feed_queue_logic_send_trigger(struct feed_queue_logic *q);
 SR_API void feed_queue_logic_free(struct feed_queue_logic *q);
 
 SR_API struct feed_queue_analog *feed_queue_analog_alloc(
 	const struct sr_dev_inst *sdi,
 	size_t sample_count, int digits, struct sr_channel *ch);
+SR_API int feed_queue_analog_mq_unit(struct feed_queue_analog *q,
+	enum sr_mq mq, enum sr_mqflag mq_flag, enum sr_unit unit);
 SR_API int feed_queue_analog_submit(struct feed_queue_analog *q,
 	float data, size_t count);
+SR_API int feed_queue_analog_submit_many(struct feed_queue_analog *q,
+	const float *data, size_t count, size_t stride);
 SR_API int feed_queue_analog_flush(struct feed_queue_analog *q);
 SR_API void feed_queue_analog_free(struct feed_queue_analog *q);
 
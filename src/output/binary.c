@@ -34,10 +34,12 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	(void)o;
 
 	*out = NULL;
-	if (packet->type != SR_DF_LOGIC)
-		return SR_OK;
-	logic = packet->payload;
-	*out = g_string_new_len(logic->data, logic->length);
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		*out = g_string_new_len(logic->data, logic->length);
+		break;
+	}
 
 	return SR_OK;
 }
@@ -55,6 +55,7 @@
 
 #include <config.h>
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <glib.h>
@@ -67,6 +68,14 @@ struct ctx_channel {
 	struct sr_channel *ch;
 	char *label;
 	float min, max;
+	/* Analog channels: column of sample values, last formatted value. */
+	float *column;
+	size_t column_size;
+	gboolean column_valid;
+	gboolean text_valid;
+	float text_value;
+	size_t text_len;
+	char text[32];
 };
 
 struct context {
@@ -97,8 +106,16 @@ struct context {
 	uint64_t sample_scale;
 	uint64_t out_sample_count;
 	uint8_t *previous_sample;
-	float *analog_samples;
+	uint8_t *current_sample;
+	gboolean have_analog, have_logic;
+	float *analog_scratch;
+	size_t analog_scratch_size;
 	uint8_t *logic_samples;
+	size_t logic_samples_size;
+	size_t logic_stride;
+	int *channel_map;
+	size_t channel_map_size;
+	size_t value_len;
 	const char *xlabel;	/* Don't free: will point to a static string. */
 	const char *title;	/* Don't free: will point into the driver struct. */
 
@@ -184,14 +201,33 @@ static int init(struct sr_output *o, GHashTable *options)
 		sr_info("Outputting %d logic values", logic_channels);
 		ctx->num_logic_channels = logic_channels;
 	}
-	ctx->channels = g_malloc(sizeof(struct ctx_channel)
+	ctx->channels = g_malloc0(sizeof(struct ctx_channel)
 		* (ctx->num_analog_channels + ctx->num_logic_channels));
+	ctx->value_len = strlen(ctx->value);
 
-	/* Once more to map the enabled channels. */
+	/*
+	 * Once more to map the enabled channels. Keep a lookup table
+	 * from sigrok channel indices to output columns, and determine
+	 * the width of the unpacked logic data.
+	 */
 	ctx->channel_count = g_slist_length(o->sdi->channels);
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->index >= 0 && (size_t)ch->index >= ctx->channel_map_size)
+			ctx->channel_map_size = ch->index + 1;
+	}
+	ctx->channel_map = g_malloc(ctx->channel_map_size * sizeof(int));
+	for (i = 0; i < ctx->channel_map_size; i++)
+		ctx->channel_map[i] = -1;
 	for (i = 0, l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
 		if (ch->enabled) {
+			if (ch->index >= 0)
+				ctx->channel_map[ch->index] = i;
+			if (ch->type == SR_CHANNEL_LOGIC && ch->index >= 0) {
+				if ((size_t)ch->index / 8 + 1 > ctx->logic_stride)
+					ctx->logic_stride = ch->index / 8 + 1;
+			}
 			if (ch->type == SR_CHANNEL_ANALOG) {
 				ctx->channels[i].min = FLT_MAX;
 				ctx->channels[i].max = FLT_MIN;
@@ -206,6 +242,7 @@ static int init(struct sr_output *o, GHashTable *options)
 			ctx->channels[i++].ch = ch;
 		}
 	}
+	ctx->logic_stride *= 8;
 
 	return SR_OK;
 }
@@ -290,6 +327,16 @@ static GString *gen_header(const struct sr_output *o,
 	return header;
 }
 
+/* Make sure an analog channel's column can hold the given sample count. */
+static void reserve_column(struct ctx_channel *chan, size_t count)
+{
+	if (count <= chan->column_size)
+		return;
+	g_free(chan->column);
+	chan->column = g_malloc0(count * sizeof(chan->column[0]));
+	chan->column_size = count;
+}
+
 /*
  * Analog devices can have samples of different types. Since each
  * packet has only one meaning, it is restricted to having at most one
@@ -312,95 +359,221 @@ static GString *gen_header(const struct sr_output *o,
  * All of the data for a channel is assumed to be in one frame;
  * otherwise the data in the second packet will overwrite the data in
  * the first packet.
+ *
+ * Values get kept in per channel columns which persist across frames.
+ * Received channels get mapped to columns by their index.
  */
 static void process_analog(struct context *ctx,
 			   const struct sr_datafeed_analog *analog)
 {
-	int ret;
-	size_t num_rcvd_ch, num_have_ch;
-	size_t idx_have, idx_smpl, idx_rcvd;
-	size_t idx_send;
+	size_t num_rcvd_ch, num_samples, size;
+	size_t idx_smpl, idx_rcvd;
 	struct sr_analog_meaning *meaning;
-	GSList *l;
-	float *fdata = NULL;
+	struct ctx_channel *chan;
 	struct sr_channel *ch;
+	GSList *l;
+	float *fdata;
+	int idx;
 
-	if (!ctx->analog_samples) {
-		ctx->analog_samples = g_malloc(analog->num_samples
-			* sizeof(float) * ctx->num_analog_channels);
+	num_samples = analog->num_samples;
+	if (!ctx->have_analog) {
+		ctx->have_analog = TRUE;
 		if (!ctx->num_samples)
-			ctx->num_samples = analog->num_samples;
+			ctx->num_samples = num_samples;
 	}
-	if (ctx->num_samples != analog->num_samples)
-		sr_warn("Expecting %u analog samples, got %u.",
-			ctx->num_samples, analog->num_samples);
+	if (ctx->num_samples != num_samples)
+		sr_warn("Expecting %u analog samples, got %zu.",
+			ctx->num_samples, num_samples);
 
 	meaning = analog->meaning;
 	num_rcvd_ch = g_slist_length(meaning->channels);
 	ctx->channels_seen += num_rcvd_ch;
 	sr_dbg("Processing packet of %zu analog channels", num_rcvd_ch);
-	fdata = g_malloc(analog->num_samples * num_rcvd_ch * sizeof(float));
-	if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
-		sr_warn("Problems converting data to floating point values.");
-
-	num_have_ch = ctx->num_analog_channels + ctx->num_logic_channels;
-	idx_send = 0;
-	for (idx_have = 0; idx_have < num_have_ch; idx_have++) {
-		if (ctx->channels[idx_have].ch->type != SR_CHANNEL_ANALOG)
+
+	/* Single channel packets get converted into the column. */
+	fdata = NULL;
+	if (num_rcvd_ch > 1) {
+		size = num_samples * num_rcvd_ch;
+		if (size > ctx->analog_scratch_size) {
+			g_free(ctx->analog_scratch);
+			ctx->analog_scratch = g_malloc(size * sizeof(float));
+			ctx->analog_scratch_size = size;
+		}
+		fdata = ctx->analog_scratch;
+		if (sr_analog_to_float(analog, fdata) != SR_OK)
+			sr_warn("Problems converting data to floating point values.");
+	}
+
+	for (l = meaning->channels, idx_rcvd = 0; l; l = l->next, idx_rcvd++) {
+		ch = l->data;
+		idx = -1;
+		if (ch->index >= 0 && (size_t)ch->index < ctx->channel_map_size)
+			idx = ctx->channel_map[ch->index];
+		if (idx < 0)
+			continue;
+		chan = &ctx->channels[idx];
+		if (chan->ch != ch || ch->type != SR_CHANNEL_ANALOG)
+			continue;
+		if (ctx->label_do && !ctx->label_names) {
+			g_free(chan->label);
+			chan->label = NULL;
+			sr_analog_unit_to_string(analog, &chan->label);
+		}
+		reserve_column(chan, MAX(num_samples, ctx->num_samples));
+		chan->column_valid = TRUE;
+		if (!fdata) {
+			if (sr_analog_to_float(analog, chan->column) != SR_OK)
+				sr_warn("Problems converting data to floating point values.");
 			continue;
-		sr_dbg("Looking for channel %s",
-		       ctx->channels[idx_have].ch->name);
-		for (l = meaning->channels, idx_rcvd = 0; l; l = l->next, idx_rcvd++) {
-			ch = l->data;
-			sr_dbg("Checking %s", ch->name);
-			if (ctx->channels[idx_have].ch != ch)
-				continue;
-			if (ctx->label_do && !ctx->label_names) {
-				sr_analog_unit_to_string(analog,
-					&ctx->channels[idx_have].label);
-			}
-			for (idx_smpl = 0; idx_smpl < analog->num_samples; idx_smpl++)
-				ctx->analog_samples[idx_smpl * ctx->num_analog_channels + idx_send] = fdata[idx_smpl * num_rcvd_ch + idx_rcvd];
-			break;
 		}
-		idx_send++;
+		for (idx_smpl = 0; idx_smpl < num_samples; idx_smpl++)
+			chan->column[idx_smpl] = fdata[idx_smpl * num_rcvd_ch + idx_rcvd];
 	}
-	g_free(fdata);
+}
+
+/*
+ * Spread the bits of a byte to the bytes of a 64bit word, in memory
+ * order. Bit 0 ends up in the first byte, each byte is either 0 or 1.
+ */
+static uint64_t expand_bits(uint8_t b)
+{
+	uint64_t bits;
+
+	bits = b * UINT64_C(0x0101010101010101);
+	bits &= UINT64_C(0x8040201008040201);
+	bits += UINT64_C(0x7f7f7f7f7f7f7f7f);
+	bits = (bits >> 7) & UINT64_C(0x0101010101010101);
+
+	return GUINT64_TO_LE(bits);
 }
 
 /*
  * We treat logic packets the same as analog packets, though it's not
  * strictly required. This allows us to process mixed signals properly.
+ *
+ * Logic data gets unpacked to one byte per bit position. Channels then
+ * are looked up by their index in a sample's unpacked row.
  */
 static void process_logic(struct context *ctx,
 			  const struct sr_datafeed_logic *logic)
 {
-	unsigned int i, j, ch, num_samples;
-	int idx;
-	uint8_t *sample;
+	size_t i, b, num_samples, bytes, size;
+	const uint8_t *sample;
+	uint8_t *row;
+	uint64_t bits;
 
 	num_samples = logic->length / logic->unitsize;
 	ctx->channels_seen += ctx->logic_channel_count;
 	sr_dbg("Logic packet had %d channels", logic->unitsize * 8);
-	if (!ctx->logic_samples) {
-		ctx->logic_samples = g_malloc(num_samples * ctx->num_logic_channels);
+	if (!ctx->have_logic) {
+		ctx->have_logic = TRUE;
 		if (!ctx->num_samples)
 			ctx->num_samples = num_samples;
 	}
 	if (ctx->num_samples != num_samples)
-		sr_warn("Expecting %u samples, got %u",
+		sr_warn("Expecting %u samples, got %zu",
 			ctx->num_samples, num_samples);
 
-	for (j = ch = 0; ch < ctx->num_logic_channels; j++) {
-		if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-			for (i = 0; i < num_samples; i++) {
-				sample = logic->data + i * logic->unitsize;
-				idx = ctx->channels[j].ch->index;
-				if (ctx->label_do && !ctx->label_names)
-					ctx->channels[j].label = "logic";
-				ctx->logic_samples[i * ctx->num_logic_channels + ch] = sample[idx / 8] & (1 << (idx % 8));
-			}
-			ch++;
+	if (ctx->label_do && !ctx->label_names) {
+		for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
+			if (ctx->channels[i].ch->type == SR_CHANNEL_LOGIC)
+				ctx->channels[i].label = "logic";
+		}
+	}
+
+	size = MAX(num_samples, ctx->num_samples) * ctx->logic_stride;
+	if (size > ctx->logic_samples_size) {
+		g_free(ctx->logic_samples);
+		ctx->logic_samples = g_malloc0(size);
+		ctx->logic_samples_size = size;
+	}
+
+	bytes = MIN((size_t)logic->unitsize, ctx->logic_stride / 8);
+	sample = logic->data;
+	row = ctx->logic_samples;
+	for (i = 0; i < num_samples; i++) {
+		for (b = 0; b < bytes; b++) {
+			bits = expand_bits(sample[b]);
+			memcpy(&row[8 * b], &bits, sizeof(bits));
+		}
+		if (8 * bytes < ctx->logic_stride)
+			memset(&row[8 * bytes], 0, ctx->logic_stride - 8 * bytes);
+		sample += logic->unitsize;
+		row += ctx->logic_stride;
+	}
+}
+
+static void append_uint(GString *s, uint64_t value)
+{
+	char buf[24], *p;
+
+	p = &buf[sizeof(buf)];
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	g_string_append_len(s, p, &buf[sizeof(buf)] - p);
+}
+
+/*
+ * Append an analog value in "%g" format. Integral values which need no
+ * exponent get formatted here, everything else goes through printf.
+ * Keeps the text of the channel's last value, which often repeats.
+ */
+static void append_analog(GString *s, struct ctx_channel *chan, float value)
+{
+	double dval;
+	int64_t ival;
+	char *p;
+
+	if (chan->text_valid && !memcmp(&value, &chan->text_value, sizeof(value))) {
+		g_string_append_len(s, chan->text, chan->text_len);
+		return;
+	}
+
+	dval = value;
+	if (fabs(dval) < 1e6 && dval == floor(dval) && !(dval == 0 && signbit(dval))) {
+		ival = dval;
+		p = &chan->text[sizeof(chan->text)];
+		if (ival < 0)
+			ival = -ival;
+		do {
+			*--p = '0' + ival % 10;
+			ival /= 10;
+		} while (ival);
+		if (dval < 0)
+			*--p = '-';
+		chan->text_len = &chan->text[sizeof(chan->text)] - p;
+		memmove(chan->text, p, chan->text_len);
+	} else {
+		chan->text_len = snprintf(chan->text, sizeof(chan->text), "%g", dval);
+	}
+	chan->text_value = value;
+	chan->text_valid = TRUE;
+	g_string_append_len(s, chan->text, chan->text_len);
+}
+
+/* Collect a row's values in their binary form, to check for duplicates. */
+static void gather_row(struct context *ctx, size_t i, uint8_t *dest)
+{
+	size_t j, num_channels;
+	struct ctx_channel *chan;
+	uint8_t *logic_dest, *analog_dest;
+	const uint8_t *row;
+
+	logic_dest = dest;
+	analog_dest = dest + ctx->num_logic_channels;
+	row = NULL;
+	if (ctx->logic_samples)
+		row = &ctx->logic_samples[i * ctx->logic_stride];
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+	for (j = 0; j < num_channels; j++) {
+		chan = &ctx->channels[j];
+		if (chan->ch->type == SR_CHANNEL_ANALOG) {
+			memcpy(analog_dest, &chan->column[i], sizeof(float));
+			analog_dest += sizeof(float);
+		} else if (chan->ch->type == SR_CHANNEL_LOGIC) {
+			*logic_dest++ = row[chan->ch->index];
 		}
 	}
 }
@@ -410,12 +583,13 @@ static void dump_saved_values(struct context *ctx, GString **out)
 	unsigned int i, j, analog_size, num_channels;
 	double sample_time_dbl;
 	uint64_t sample_time_u64;
-	float *analog_sample, value;
-	uint8_t *logic_sample;
+	struct ctx_channel *chan;
+	const uint8_t *row;
+	float value;
 
 	/* If we haven't seen samples we're expecting, skip them. */
-	if ((ctx->num_analog_channels && !ctx->analog_samples) ||
-	    (ctx->num_logic_channels && !ctx->logic_samples)) {
+	if ((ctx->num_analog_channels && !ctx->have_analog) ||
+	    (ctx->num_logic_channels && !ctx->have_logic)) {
 		sr_warn("Discarding partial packet");
 	} else {
 		sr_info("Dumping %u samples", ctx->num_samples);
@@ -434,8 +608,10 @@ static void dump_saved_values(struct context *ctx, GString **out)
 				g_string_append_printf(*out, "%s%s",
 					ctx->channels[i].label, ctx->value);
 				if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
-						&& ctx->label_names)
+						&& !ctx->label_names) {
 					g_free(ctx->channels[i].label);
+					ctx->channels[i].label = NULL;
+				}
 			}
 			if (ctx->do_trigger)
 				g_string_append_printf(*out, "Trigger%s",
@@ -447,64 +623,75 @@ static void dump_saved_values(struct context *ctx, GString **out)
 			ctx->label_do = FALSE;
 		}
 
+		/*
+		 * Channels which were not received read as zero. Columns
+		 * are kept across frames, don't repeat previous values.
+		 */
+		for (j = 0; j < num_channels; j++) {
+			chan = &ctx->channels[j];
+			if (chan->ch->type != SR_CHANNEL_ANALOG)
+				continue;
+			reserve_column(chan, ctx->num_samples);
+			if (!chan->column_valid) {
+				memset(chan->column, 0,
+					ctx->num_samples * sizeof(chan->column[0]));
+			}
+		}
+
 		analog_size = ctx->num_analog_channels * sizeof(float);
-		if (ctx->dedup && !ctx->previous_sample)
+		if (ctx->dedup && !ctx->previous_sample) {
 			ctx->previous_sample = g_malloc0(analog_size + ctx->num_logic_channels);
+			ctx->current_sample = g_malloc0(analog_size + ctx->num_logic_channels);
+		}
 
 		for (i = 0; i < ctx->num_samples; i++) {
-			analog_sample =
-			    &ctx->analog_samples[i * ctx->num_analog_channels];
-			logic_sample =
-			    &ctx->logic_samples[i * ctx->num_logic_channels];
-
 			if (ctx->dedup) {
+				gather_row(ctx, i, ctx->current_sample);
 				if (i > 0 && i < ctx->num_samples - 1 &&
-				    !memcmp(logic_sample, ctx->previous_sample,
-					    ctx->num_logic_channels) &&
-				    !memcmp(analog_sample,
-					    ctx->previous_sample +
-					    ctx->num_logic_channels,
-					    analog_size))
+				    !memcmp(ctx->current_sample,
+					    ctx->previous_sample,
+					    analog_size + ctx->num_logic_channels))
 					continue;
-				memcpy(ctx->previous_sample, logic_sample,
-				       ctx->num_logic_channels);
-				memcpy(ctx->previous_sample
-				       + ctx->num_logic_channels,
-				       analog_sample, analog_size);
+				memcpy(ctx->previous_sample, ctx->current_sample,
+				       analog_size + ctx->num_logic_channels);
 			}
 
 			if (ctx->time && !ctx->sample_rate) {
-				g_string_append_printf(*out, "0%s", ctx->value);
+				g_string_append_c(*out, '0');
+				g_string_append_len(*out, ctx->value, ctx->value_len);
 			} else if (ctx->time) {
 				sample_time_dbl = ctx->out_sample_count++;
 				sample_time_dbl /= ctx->sample_rate;
 				sample_time_dbl *= ctx->sample_scale;
 				sample_time_u64 = sample_time_dbl;
-				g_string_append_printf(*out, "%" PRIu64 "%s",
-					sample_time_u64, ctx->value);
+				append_uint(*out, sample_time_u64);
+				g_string_append_len(*out, ctx->value, ctx->value_len);
 			}
 
+			row = NULL;
+			if (ctx->logic_samples)
+				row = &ctx->logic_samples[i * ctx->logic_stride];
 			for (j = 0; j < num_channels; j++) {
-				if (ctx->channels[j].ch->type == SR_CHANNEL_ANALOG) {
-					value = ctx->analog_samples[i * ctx->num_analog_channels + j];
-					ctx->channels[j].max =
-					    fmax(value, ctx->channels[j].max);
-					ctx->channels[j].min =
-					    fmin(value, ctx->channels[j].min);
-					g_string_append_printf(*out, "%g%s",
-						value, ctx->value);
-				} else if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-					g_string_append_printf(*out, "%c%s",
-							       ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0', ctx->value);
+				chan = &ctx->channels[j];
+				if (chan->ch->type == SR_CHANNEL_ANALOG) {
+					value = chan->column[i];
+					chan->max = fmax(value, chan->max);
+					chan->min = fmin(value, chan->min);
+					append_analog(*out, chan, value);
+				} else if (chan->ch->type == SR_CHANNEL_LOGIC) {
+					g_string_append_c(*out,
+						row[chan->ch->index] ? '1' : '0');
 				} else {
 					sr_warn("Unexpected channel type: %d",
-						ctx->channels[i].ch->type);
+						chan->ch->type);
+					continue;
 				}
+				g_string_append_len(*out, ctx->value, ctx->value_len);
 			}
 
 			if (ctx->do_trigger) {
-				g_string_append_printf(*out, "%d%s",
-					ctx->trigger, ctx->value);
+				g_string_append_c(*out, ctx->trigger ? '1' : '0');
+				g_string_append_len(*out, ctx->value, ctx->value_len);
 				ctx->trigger = FALSE;
 			}
 			g_string_truncate(*out, (*out)->len - 1);
@@ -512,15 +699,14 @@ static void dump_saved_values(struct context *ctx, GString **out)
 		}
 	}
 
-	/* Discard all of the working space. */
-	g_free(ctx->previous_sample);
-	g_free(ctx->analog_samples);
-	g_free(ctx->logic_samples);
+	/* Start over with the next set of values. Keep the buffers. */
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+	for (j = 0; j < num_channels; j++)
+		ctx->channels[j].column_valid = FALSE;
 	ctx->channels_seen = 0;
 	ctx->num_samples = 0;
-	ctx->previous_sample = NULL;
-	ctx->analog_samples = NULL;
-	ctx->logic_samples = NULL;
+	ctx->have_analog = FALSE;
+	ctx->have_logic = FALSE;
 }
 
 static void save_gnuplot(struct context *ctx)
@@ -717,12 +903,26 @@ static int receive(const struct sr_output *o,
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
+	struct ctx_channel *chan;
+	unsigned int i;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 
 	if (o->priv) {
 		ctx = o->priv;
+		for (i = 0; i < ctx->num_analog_channels + ctx->num_logic_channels; i++) {
+			chan = &ctx->channels[i];
+			if (chan->ch->type != SR_CHANNEL_ANALOG)
+				continue;
+			g_free(chan->column);
+			if (!ctx->label_names)
+				g_free(chan->label);
+		}
+		g_free(ctx->analog_scratch);
+		g_free(ctx->logic_samples);
+		g_free(ctx->current_sample);
+		g_free(ctx->channel_map);
 		g_free((gpointer)ctx->record);
 		g_free((gpointer)ctx->frame);
 		g_free((gpointer)ctx->comment);
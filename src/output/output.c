@@ -331,11 +331,25 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
  * The instance's output is returned as a newly allocated GString,
  * which must be freed by the caller.
  *
+ * SR_DF_LOGIC_RLE packets are only accepted by output modules which
+ * have the SR_OUTPUT_LOGIC_RLE flag set. Their expansion can be far
+ * larger than the packet, other modules receive the data from callbacks
+ * which were registered by sr_session_datafeed_callback_add(), which get
+ * the samples in chunks of bounded size.
+ *
  * @since 0.4.0
  */
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
+	if (packet->type == SR_DF_LOGIC_RLE &&
+			!(o->module->flags & SR_OUTPUT_LOGIC_RLE)) {
+		sr_err("Output module '%s' doesn't accept run length "
+			"encoded data.", o->module->id);
+		*out = NULL;
+		return SR_ERR_ARG;
+	}
+
 	return o->module->receive(o, packet, out);
 }
 
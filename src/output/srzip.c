@@ -18,22 +18,73 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <zip.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/srzip"
 #define CHUNK_SIZE (4 * 1024 * 1024)
 
+/*
+ * Optional summary of a logic data stream or an analog channel, which
+ * gets stored in the archive next to the sample data. Blocks of samples
+ * are summarized as they are received, the upper levels of the pyramid
+ * get computed when the archive is finalized. See libsigrok-internal.h
+ * for the layout of the archive entry.
+ */
+struct summary {
+	char *name;
+	uint32_t kind;
+	size_t unit_size;
+	size_t record_size;
+	uint64_t block_samples;
+	uint64_t total_samples;
+	uint64_t fill;
+	uint64_t transitions;
+	uint8_t *or_mask;
+	uint8_t *and_mask;
+	uint8_t *last;
+	float min, max;
+	double sum;
+	GByteArray *records;
+};
+
+/*
+ * The ZIP archive is kept open for the whole acquisition, and only
+ * gets written to disk (central directory, metadata) when the end of
+ * the data feed is seen. Chunk data is not kept in memory until then.
+ * Instead each chunk gets appended to a spool file next to the output
+ * file, and the archive's entries reference ranges of that spool file.
+ * This keeps the cost of each chunk constant (one sequential write),
+ * while the previous approach re-opened, re-scanned and re-wrote the
+ * complete archive for every chunk.
+ */
 struct out_context {
 	gboolean zip_created;
 	uint64_t samplerate;
 	char *filename;
+	struct zip *archive;
+	GKeyFile *meta;
+	char *spool_name;
+	FILE *spool;
+	uint64_t spool_size;
+	GMutex spool_mutex;
+	size_t writer_threads;
+	size_t writer_depth;
+	struct sr_async *writer;
+	int comp_level;
+	GSList *free_buffers;
+	GSList *free_comp_buffers;
 	size_t first_analog_index;
 	size_t analog_ch_count;
 	gint *analog_index_map;
@@ -42,20 +93,25 @@ struct out_context {
 		size_t alloc_size;
 		uint8_t *samples;
 		size_t fill_size;
+		size_t chunk_count;
 	} logic_buff;
 	struct analog_buff {
 		size_t alloc_size;
 		float *samples;
 		size_t fill_size;
+		size_t chunk_count;
 	} *analog_buff;
+	gboolean summary_enabled;
+	uint64_t summary_block;
+	struct summary *logic_summary;
+	struct summary *analog_summary;
+	GSList *summary_bufs;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 
-	(void)options;
-
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
@@ -63,16 +119,313 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	outc = g_malloc0(sizeof(*outc));
 	outc->filename = g_strdup(o->filename);
+	outc->writer_threads = g_variant_get_uint32(
+		g_hash_table_lookup(options, "threads"));
+	outc->writer_depth = g_variant_get_uint32(
+		g_hash_table_lookup(options, "queue_depth"));
+	outc->comp_level = g_variant_get_uint32(
+		g_hash_table_lookup(options, "compress_level"));
+	if (outc->comp_level > 9) {
+		sr_err("Compression level must be in the range of 0 to 9.");
+		g_free(outc->filename);
+		g_free(outc);
+		return SR_ERR_ARG;
+	}
+	outc->summary_enabled = g_variant_get_boolean(
+		g_hash_table_lookup(options, "summary"));
+	outc->summary_block = g_variant_get_uint32(
+		g_hash_table_lookup(options, "summary_block"));
+	if (outc->summary_enabled && !outc->summary_block) {
+		sr_err("Summary block size must not be zero.");
+		g_free(outc->filename);
+		g_free(outc);
+		return SR_ERR_ARG;
+	}
+	g_mutex_init(&outc->spool_mutex);
 	o->priv = outc;
 
 	return SR_OK;
 }
 
+static int zip_chunk_write(void *job, void *cb_data);
+static int zip_chunk_done(void *job, int status, void *cb_data);
+
+static void summary_init(struct summary *sum, char *name,
+	uint32_t kind, size_t unit_size, uint64_t block_samples)
+{
+	sum->name = name;
+	sum->kind = kind;
+	sum->unit_size = unit_size;
+	sum->block_samples = block_samples;
+	if (kind == SR_SUMMARY_LOGIC) {
+		sum->record_size = SR_SUMMARY_LOGIC_RECORD_SIZE(unit_size);
+		sum->or_mask = g_malloc0(unit_size);
+		sum->and_mask = g_malloc(unit_size);
+		sum->last = g_malloc0(unit_size);
+		memset(sum->and_mask, 0xff, unit_size);
+	} else {
+		sum->record_size = SR_SUMMARY_ANALOG_RECORD_SIZE;
+		sum->min = INFINITY;
+		sum->max = -INFINITY;
+	}
+	sum->records = g_byte_array_new();
+}
+
+static void summary_clear(struct summary *sum)
+{
+	if (!sum)
+		return;
+
+	g_free(sum->name);
+	g_free(sum->or_mask);
+	g_free(sum->and_mask);
+	g_free(sum->last);
+	if (sum->records)
+		g_byte_array_free(sum->records, TRUE);
+}
+
+/* Append the level 0 record of the current block, start a new block. */
+static void summary_flush_block(struct summary *sum)
+{
+	uint8_t *wrptr;
+	guint pos;
+
+	if (!sum->fill)
+		return;
+
+	pos = sum->records->len;
+	g_byte_array_set_size(sum->records, pos + sum->record_size);
+	wrptr = &sum->records->data[pos];
+	if (sum->kind == SR_SUMMARY_LOGIC) {
+		write_u64le_inc(&wrptr, sum->transitions);
+		memcpy(wrptr, sum->or_mask, sum->unit_size);
+		wrptr += sum->unit_size;
+		memcpy(wrptr, sum->and_mask, sum->unit_size);
+		sum->transitions = 0;
+		memset(sum->or_mask, 0x00, sum->unit_size);
+		memset(sum->and_mask, 0xff, sum->unit_size);
+	} else {
+		write_fltle_inc(&wrptr, sum->min);
+		write_fltle_inc(&wrptr, sum->max);
+		write_fltle_inc(&wrptr, sum->sum / sum->fill);
+		sum->min = INFINITY;
+		sum->max = -INFINITY;
+		sum->sum = 0;
+	}
+	sum->fill = 0;
+}
+
+static void summary_feed_logic(struct summary *sum,
+	const uint8_t *data, size_t count)
+{
+	size_t idx;
+	uint8_t b, diff;
+
+	while (count--) {
+		diff = 0;
+		for (idx = 0; idx < sum->unit_size; idx++) {
+			b = data[idx];
+			sum->or_mask[idx] |= b;
+			sum->and_mask[idx] &= b;
+			diff |= b ^ sum->last[idx];
+			sum->last[idx] = b;
+		}
+		if (diff && sum->total_samples)
+			sum->transitions++;
+		data += sum->unit_size;
+		sum->total_samples++;
+		if (++sum->fill == sum->block_samples)
+			summary_flush_block(sum);
+	}
+}
+
+/* Feed a run of identical samples, only its first can be a transition. */
+static void summary_feed_logic_run(struct summary *sum,
+	const uint8_t *value, uint64_t count)
+{
+	uint64_t step;
+	size_t idx;
+
+	if (!count)
+		return;
+	summary_feed_logic(sum, value, 1);
+	count--;
+	while (count) {
+		step = MIN(count, sum->block_samples - sum->fill);
+		for (idx = 0; idx < sum->unit_size; idx++) {
+			sum->or_mask[idx] |= value[idx];
+			sum->and_mask[idx] &= value[idx];
+		}
+		sum->total_samples += step;
+		sum->fill += step;
+		count -= step;
+		if (sum->fill == sum->block_samples)
+			summary_flush_block(sum);
+	}
+}
+
+static void summary_feed_analog(struct summary *sum,
+	const float *values, size_t count)
+{
+	float v;
+
+	while (count--) {
+		v = *values++;
+		if (v < sum->min)
+			sum->min = v;
+		if (v > sum->max)
+			sum->max = v;
+		sum->sum += v;
+		sum->total_samples++;
+		if (++sum->fill == sum->block_samples)
+			summary_flush_block(sum);
+	}
+}
+
+/* Combine records of the previous level into one record. */
+static void summary_combine(const struct summary *sum, uint8_t *wrptr,
+	const uint8_t *rdptr, size_t count, uint64_t first_sample,
+	uint64_t span)
+{
+	uint64_t transitions, samples, total;
+	float v, min, max;
+	double weighted;
+	size_t idx, pos;
+
+	if (sum->kind == SR_SUMMARY_LOGIC) {
+		transitions = 0;
+		memset(&wrptr[sizeof(uint64_t)], 0x00, sum->unit_size);
+		memset(&wrptr[sizeof(uint64_t) + sum->unit_size], 0xff,
+			sum->unit_size);
+		for (idx = 0; idx < count; idx++) {
+			transitions += read_u64le(rdptr);
+			for (pos = sizeof(uint64_t); pos < sum->record_size; pos++) {
+				if (pos < sizeof(uint64_t) + sum->unit_size)
+					wrptr[pos] |= rdptr[pos];
+				else
+					wrptr[pos] &= rdptr[pos];
+			}
+			rdptr += sum->record_size;
+		}
+		write_u64le_inc(&wrptr, transitions);
+		return;
+	}
+
+	/* The mean is weighted by sample count, the last block may be short. */
+	min = INFINITY;
+	max = -INFINITY;
+	weighted = 0;
+	total = 0;
+	for (idx = 0; idx < count; idx++) {
+		samples = MIN(span, sum->total_samples - first_sample);
+		first_sample += samples;
+		v = read_fltle_inc(&rdptr);
+		if (v < min)
+			min = v;
+		v = read_fltle_inc(&rdptr);
+		if (v > max)
+			max = v;
+		weighted += read_fltle_inc(&rdptr) * (double)samples;
+		total += samples;
+	}
+	write_fltle_inc(&wrptr, min);
+	write_fltle_inc(&wrptr, max);
+	write_fltle_inc(&wrptr, total ? weighted / total : 0);
+}
+
+/* Compute the upper levels, and serialize the summary's archive entry. */
+static uint8_t *summary_serialize(struct summary *sum, size_t *length)
+{
+	uint64_t counts[24];
+	uint32_t level, level_count;
+	uint64_t idx, span, first;
+	uint8_t *buf, *wrptr, *prev;
+	size_t size;
+
+	summary_flush_block(sum);
+
+	level_count = 0;
+	counts[level_count++] = sum->records->len / sum->record_size;
+	while (counts[level_count - 1] > 1 && level_count < G_N_ELEMENTS(counts)) {
+		counts[level_count] = (counts[level_count - 1] +
+			SR_SUMMARY_FANOUT - 1) / SR_SUMMARY_FANOUT;
+		level_count++;
+	}
+
+	size = SR_SUMMARY_HEADER_SIZE + level_count * sizeof(uint64_t);
+	for (level = 0; level < level_count; level++)
+		size += counts[level] * sum->record_size;
+	buf = g_try_malloc(size);
+	if (!buf)
+		return NULL;
+
+	wrptr = buf;
+	write_u32le_inc(&wrptr, SR_SUMMARY_VERSION);
+	write_u32le_inc(&wrptr, sum->kind);
+	write_u32le_inc(&wrptr,
+		sum->kind == SR_SUMMARY_LOGIC ? sum->unit_size : 0);
+	write_u32le_inc(&wrptr, SR_SUMMARY_FANOUT);
+	write_u64le_inc(&wrptr, sum->block_samples);
+	write_u64le_inc(&wrptr, sum->total_samples);
+	write_u32le_inc(&wrptr, level_count);
+	write_u32le_inc(&wrptr, 0);
+	for (level = 0; level < level_count; level++)
+		write_u64le_inc(&wrptr, counts[level]);
+
+	memcpy(wrptr, sum->records->data, sum->records->len);
+	prev = wrptr;
+	wrptr += sum->records->len;
+	span = sum->block_samples;
+	for (level = 1; level < level_count; level++) {
+		for (idx = 0; idx < counts[level]; idx++) {
+			first = idx * SR_SUMMARY_FANOUT;
+			summary_combine(sum, wrptr,
+				&prev[first * sum->record_size],
+				MIN(SR_SUMMARY_FANOUT, counts[level - 1] - first),
+				first * span, span);
+			wrptr += sum->record_size;
+		}
+		prev += counts[level - 1] * sum->record_size;
+		span *= SR_SUMMARY_FANOUT;
+	}
+
+	*length = size;
+
+	return buf;
+}
+
+/* Add a summary to the archive, its buffer gets released after zip_close(). */
+static int summary_store(struct out_context *outc, struct summary *sum)
+{
+	struct zip_source *src;
+	uint8_t *buf;
+	size_t length;
+
+	if (!sum->total_samples)
+		return SR_OK;
+
+	buf = summary_serialize(sum, &length);
+	if (!buf)
+		return SR_ERR_MALLOC;
+	src = zip_source_buffer(outc->archive, buf, length, FALSE);
+	if (!src || zip_add(outc->archive, sum->name, src) < 0) {
+		sr_err("Error saving summary '%s' into zipfile: %s",
+			sum->name, zip_strerror(outc->archive));
+		if (src)
+			zip_source_free(src);
+		g_free(buf);
+		return SR_ERR;
+	}
+	outc->summary_bufs = g_slist_prepend(outc->summary_bufs, buf);
+
+	return SR_OK;
+}
+
 static int zip_create(const struct sr_output *o)
 {
 	struct out_context *outc;
 	struct zip *zipfile;
-	struct zip_source *versrc, *metasrc;
+	struct zip_source *versrc;
 	struct sr_channel *ch;
 	size_t ch_nr;
 	size_t alloc_size;
@@ -80,8 +433,8 @@ static int zip_create(const struct sr_output *o)
 	GKeyFile *meta;
 	GSList *l;
 	const char *devgroup;
-	char *s, *metabuf;
-	gsize metalen;
+	char *s;
+	int fd;
 	guint logic_channels, enabled_logic_channels;
 	guint enabled_analog_channels;
 	guint index;
@@ -110,8 +463,42 @@ static int zip_create(const struct sr_output *o)
 		return SR_ERR;
 	}
 
-	/* init "metadata" */
+	/*
+	 * The spool file lives in the output file's directory, such that
+	 * it's on the same filesystem which is expected to hold the data.
+	 */
+	outc->spool_name = g_strconcat(outc->filename, ".XXXXXX", NULL);
+	fd = g_mkstemp(outc->spool_name);
+	if (fd < 0 || !(outc->spool = fdopen(fd, "wb"))) {
+		sr_err("Cannot create spool file '%s': %s",
+			outc->spool_name, g_strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+			g_unlink(outc->spool_name);
+		}
+		g_free(outc->spool_name);
+		outc->spool_name = NULL;
+		zip_discard(zipfile);
+		return SR_ERR_IO;
+	}
+	outc->spool_size = 0;
+
+	outc->writer = sr_async_new(outc->writer_threads,
+		outc->writer_depth, zip_chunk_write, zip_chunk_done, outc);
+	if (!outc->writer) {
+		fclose(outc->spool);
+		outc->spool = NULL;
+		g_unlink(outc->spool_name);
+		g_free(outc->spool_name);
+		outc->spool_name = NULL;
+		zip_discard(zipfile);
+		return SR_ERR;
+	}
+	outc->archive = zipfile;
+
+	/* init "metadata", gets stored when the archive is finalized */
 	meta = g_key_file_new();
+	outc->meta = meta;
 
 	g_key_file_set_string(meta, "global", "sigrok version",
 			sr_package_version_string_get());
@@ -227,159 +614,380 @@ static int zip_create(const struct sr_output *o)
 		outc->analog_buff[index].fill_size = 0;
 	}
 
-	metabuf = g_key_file_to_data(meta, &metalen, NULL);
-	g_key_file_free(meta);
+	if (outc->summary_enabled) {
+		if (enabled_logic_channels > 0) {
+			outc->logic_summary = g_malloc0(sizeof(*outc->logic_summary));
+			summary_init(outc->logic_summary,
+				g_strdup("summary-logic-1"), SR_SUMMARY_LOGIC,
+				outc->logic_buff.unit_size, outc->summary_block);
+		}
+		alloc_size = sizeof(outc->analog_summary[0]) * outc->analog_ch_count + 1;
+		outc->analog_summary = g_malloc0(alloc_size);
+		for (index = 0; index < outc->analog_ch_count; index++) {
+			s = g_strdup_printf("summary-analog-1-%zu",
+				outc->first_analog_index + index);
+			summary_init(&outc->analog_summary[index], s,
+				SR_SUMMARY_ANALOG, 0, outc->summary_block);
+		}
+	}
 
-	metasrc = zip_source_buffer(zipfile, metabuf, metalen, FALSE);
-	if (zip_add(zipfile, "metadata", metasrc) < 0) {
-		sr_err("Error saving metadata into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(metasrc);
-		zip_discard(zipfile);
-		g_free(metabuf);
+	return SR_OK;
+}
+
+/*
+ * A chunk of sample data, on its way to the spool file and the archive.
+ * The chunk's buffers are owned by the job until the job got retired.
+ * When zlib is available, writer threads deflate the chunk, and the
+ * spool file receives the compressed data which libzip then copies
+ * into the archive as is.
+ */
+struct zip_chunk {
+	char *name;
+	void *data;
+	size_t length;
+	void *comp_data;
+	size_t comp_length;
+	uint32_t crc;
+	uint64_t offset;
+};
+
+/* Get a buffer for sample data, re-use previously written chunks'. */
+static void *chunk_buffer_get(struct out_context *outc)
+{
+	void *buf;
+
+	if (!outc->free_buffers)
+		return g_try_malloc0(CHUNK_SIZE);
+
+	buf = outc->free_buffers->data;
+	outc->free_buffers = g_slist_delete_link(outc->free_buffers,
+		outc->free_buffers);
+
+	return buf;
+}
+
+#ifdef HAVE_ZLIB
+
+/* Get a buffer for compressed data, which holds a deflated chunk. */
+static void *chunk_comp_buffer_get(struct out_context *outc)
+{
+	void *buf;
+
+	if (!outc->free_comp_buffers)
+		return g_try_malloc(compressBound(CHUNK_SIZE));
+
+	buf = outc->free_comp_buffers->data;
+	outc->free_comp_buffers = g_slist_delete_link(outc->free_comp_buffers,
+		outc->free_comp_buffers);
+
+	return buf;
+}
+
+/* Raw deflate a chunk (no zlib header), and determine its CRC. */
+static int zip_chunk_deflate(struct zip_chunk *chunk, int level)
+{
+	z_stream zs;
+	int ret;
+
+	memset(&zs, 0, sizeof(zs));
+	ret = deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8,
+		Z_DEFAULT_STRATEGY);
+	if (ret != Z_OK) {
+		sr_err("Cannot setup compression for '%s'.", chunk->name);
 		return SR_ERR;
 	}
-
-	if (zip_close(zipfile) < 0) {
-		sr_err("Error saving zipfile: %s", zip_strerror(zipfile));
-		zip_discard(zipfile);
-		g_free(metabuf);
+	zs.next_in = chunk->data;
+	zs.avail_in = chunk->length;
+	zs.next_out = chunk->comp_data;
+	zs.avail_out = compressBound(CHUNK_SIZE);
+	ret = deflate(&zs, Z_FINISH);
+	chunk->comp_length = zs.total_out;
+	deflateEnd(&zs);
+	if (ret != Z_STREAM_END) {
+		sr_err("Cannot compress '%s'.", chunk->name);
 		return SR_ERR;
 	}
-	g_free(metabuf);
+
+	chunk->crc = crc32(0L, Z_NULL, 0);
+	chunk->crc = crc32(chunk->crc, chunk->data, chunk->length);
 
 	return SR_OK;
 }
 
-/**
- * Append a block of logic data to an srzip archive.
- *
- * @param[in] o Output module instance.
- * @param[in] buf Logic data samples as byte sequence.
- * @param[in] unitsize Logic data unit size (bytes per sample).
- * @param[in] length Byte sequence length (in bytes, not samples).
- *
- * @returns SR_OK et al error codes.
+/*
+ * State of a ZIP source which provides a deflated chunk from the
+ * spool file. Its stat information tells libzip that the data already
+ * is compressed, such that libzip copies it without recompression.
  */
-static int zip_append(const struct sr_output *o,
-	uint8_t *buf, size_t unitsize, size_t length)
+struct chunk_source {
+	const char *filename;
+	uint64_t offset;
+	uint64_t length;
+	uint64_t comp_length;
+	uint32_t crc;
+	uint64_t read_pos;
+	FILE *file;
+	int zip_err;
+	int sys_err;
+};
+
+static zip_int64_t chunk_source_cb(void *state, void *data,
+	zip_uint64_t len, enum zip_source_cmd cmd)
 {
-	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *logicsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	struct zip_source *metasrc;
-	GKeyFile *kf;
-	GError *error;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *metabuf;
-	gsize metalen;
-	char *chunkname;
-	unsigned int next_chunk_num;
+	struct chunk_source *src;
+	struct zip_stat *st;
+	int *errs;
+	size_t rdlen;
+
+	src = state;
+
+	switch (cmd) {
+	case ZIP_SOURCE_OPEN:
+		src->file = g_fopen(src->filename, "rb");
+		if (!src->file || fseeko(src->file, src->offset, SEEK_SET) < 0) {
+			src->zip_err = ZIP_ER_READ;
+			src->sys_err = errno;
+			return -1;
+		}
+		src->read_pos = 0;
+		return 0;
+	case ZIP_SOURCE_READ:
+		rdlen = MIN(len, src->comp_length - src->read_pos);
+		if (!rdlen)
+			return 0;
+		if (fread(data, 1, rdlen, src->file) != rdlen) {
+			src->zip_err = ZIP_ER_READ;
+			src->sys_err = errno;
+			return -1;
+		}
+		src->read_pos += rdlen;
+		return rdlen;
+	case ZIP_SOURCE_CLOSE:
+		if (src->file)
+			fclose(src->file);
+		src->file = NULL;
+		return 0;
+	case ZIP_SOURCE_STAT:
+		if (len < sizeof(*st))
+			return -1;
+		st = data;
+		zip_stat_init(st);
+		st->size = src->length;
+		st->comp_size = src->comp_length;
+		st->crc = src->crc;
+		st->comp_method = ZIP_CM_DEFLATE;
+		st->encryption_method = ZIP_EM_NONE;
+		st->valid |= ZIP_STAT_SIZE | ZIP_STAT_COMP_SIZE | ZIP_STAT_CRC |
+			ZIP_STAT_COMP_METHOD | ZIP_STAT_ENCRYPTION_METHOD;
+		return sizeof(*st);
+	case ZIP_SOURCE_ERROR:
+		if (len < 2 * sizeof(int))
+			return -1;
+		errs = data;
+		errs[0] = src->zip_err;
+		errs[1] = src->sys_err;
+		return 2 * sizeof(int);
+	case ZIP_SOURCE_FREE:
+		if (src->file)
+			fclose(src->file);
+		g_free(src);
+		return 0;
+	default:
+		return -1;
+	}
+}
 
-	if (!length)
-		return SR_OK;
+/* Create a ZIP source for a deflated chunk in the spool file. */
+static struct zip_source *chunk_source_new(struct out_context *outc,
+	const struct zip_chunk *chunk)
+{
+	struct chunk_source *state;
+	struct zip_source *src;
 
-	outc = o->priv;
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
+	state = g_malloc0(sizeof(*state));
+	state->filename = outc->spool_name;
+	state->offset = chunk->offset;
+	state->length = chunk->length;
+	state->comp_length = chunk->comp_length;
+	state->crc = chunk->crc;
 
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
+	src = zip_source_function(outc->archive, chunk_source_cb, state);
+	if (!src)
+		g_free(state);
+
+	return src;
+}
+
+#endif
+
+/*
+ * Compress a chunk (when applicable) and write it to the spool file.
+ * Runs in a writer thread in the asynchronous mode, thus must not
+ * access the ZIP archive. Chunks get compressed concurrently, only
+ * the write to the spool file is serialized.
+ */
+static int zip_chunk_write(void *job, void *cb_data)
+{
+	struct zip_chunk *chunk;
+	struct out_context *outc;
+	const void *wrdata;
+	size_t wrlen;
+	int ret;
+
+	chunk = job;
+	outc = cb_data;
+
+	wrdata = chunk->data;
+	wrlen = chunk->length;
+#ifdef HAVE_ZLIB
+	if (chunk->comp_data) {
+		ret = zip_chunk_deflate(chunk, outc->comp_level);
+		if (ret != SR_OK)
+			return ret;
+		wrdata = chunk->comp_data;
+		wrlen = chunk->comp_length;
 	}
-	kf = sr_sessionfile_read_metadata(archive, &zs);
-	if (!kf) {
-		zip_discard(archive);
-		return SR_ERR_DATA;
+#endif
+
+	ret = SR_OK;
+	g_mutex_lock(&outc->spool_mutex);
+	chunk->offset = outc->spool_size;
+	if (fwrite(wrdata, 1, wrlen, outc->spool) != wrlen ||
+			fflush(outc->spool) != 0) {
+		sr_err("Failed to write spool file '%s': %s",
+			outc->spool_name, g_strerror(errno));
+		ret = SR_ERR_IO;
+	} else {
+		outc->spool_size += wrlen;
 	}
-	/*
-	 * If the file was only initialized but doesn't yet have any
-	 * data it in, it won't have a unitsize field in metadata yet.
-	 */
-	error = NULL;
-	metabuf = NULL;
-	if (!g_key_file_has_key(kf, "device 1", "unitsize", &error)) {
-		if (error && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND) {
-			sr_err("Failed to check unitsize key: %s", error->message);
-			g_error_free(error);
-			g_key_file_free(kf);
-			zip_discard(archive);
-			return SR_ERR;
-		}
-		g_clear_error(&error);
+	g_mutex_unlock(&outc->spool_mutex);
 
-		/* Add unitsize field. */
-		g_key_file_set_integer(kf, "device 1", "unitsize", unitsize);
-		metabuf = g_key_file_to_data(kf, &metalen, NULL);
-		metasrc = zip_source_buffer(archive, metabuf, metalen, FALSE);
+	return ret;
+}
 
-		if (zip_replace(archive, zs.index, metasrc) < 0) {
-			sr_err("Failed to replace metadata: %s",
-				zip_strerror(archive));
-			g_key_file_free(kf);
-			zip_source_free(metasrc);
-			zip_discard(archive);
-			g_free(metabuf);
-			return SR_ERR;
+/*
+ * Add a written chunk to the archive, and recycle its buffers. Runs in
+ * the session thread, jobs get retired in the order of submission.
+ */
+static int zip_chunk_done(void *job, int status, void *cb_data)
+{
+	struct zip_chunk *chunk;
+	struct out_context *outc;
+	struct zip_source *src;
+	zip_int64_t idx;
+	zip_int32_t method;
+
+	chunk = job;
+	outc = cb_data;
+
+	if (status == SR_OK) {
+#ifdef HAVE_ZLIB
+		if (chunk->comp_data)
+			src = chunk_source_new(outc, chunk);
+		else
+#endif
+			src = zip_source_file(outc->archive, outc->spool_name,
+				chunk->offset, chunk->length);
+		idx = -1;
+		if (!src) {
+			sr_err("Failed to create source for '%s': %s",
+				chunk->name, zip_strerror(outc->archive));
+			status = SR_ERR;
+		} else if ((idx = zip_add(outc->archive, chunk->name, src)) < 0) {
+			sr_err("Failed to add chunk '%s': %s",
+				chunk->name, zip_strerror(outc->archive));
+			zip_source_free(src);
+			status = SR_ERR;
 		}
-	}
-	g_key_file_free(kf);
-
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, "logic-1", 7) != 0)
-			continue;
-		if (entry_name[7] == '\0') {
-			/*
-			 * This file has no extra chunks, just a single
-			 * "logic-1". Rename it to "logic-1-1" and continue
-			 * with chunk 2.
-			 */
-			if (zip_rename(archive, i, "logic-1-1") < 0) {
-				sr_err("Failed to rename 'logic-1' to 'logic-1-1': %s",
-					zip_strerror(archive));
-				zip_discard(archive);
-				g_free(metabuf);
-				return SR_ERR;
+		/*
+		 * Uncompressed spool data gets compressed by libzip (or
+		 * is stored) when the archive gets written.
+		 */
+		if (idx >= 0 && !chunk->comp_data) {
+			method = outc->comp_level ? ZIP_CM_DEFLATE : ZIP_CM_STORE;
+			if (zip_set_file_compression(outc->archive, idx,
+					method, outc->comp_level) < 0) {
+				sr_err("Failed to set compression for '%s': %s",
+					chunk->name, zip_strerror(outc->archive));
+				status = SR_ERR;
 			}
-			next_chunk_num = 2;
-			break;
-		} else if (entry_name[7] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + 8, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
 		}
 	}
 
-	if (length % unitsize != 0) {
-		sr_warn("Chunk size %zu not a multiple of the"
-			" unit size %zu.", length, unitsize);
-	}
-	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
-	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
-	i = zip_add(archive, chunkname, logicsrc);
-	g_free(chunkname);
-	if (i < 0) {
-		sr_err("Failed to add chunk 'logic-1-%u': %s",
-			next_chunk_num, zip_strerror(archive));
-		zip_source_free(logicsrc);
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
+	outc->free_buffers = g_slist_prepend(outc->free_buffers, chunk->data);
+	if (chunk->comp_data) {
+		outc->free_comp_buffers = g_slist_prepend(outc->free_comp_buffers,
+			chunk->comp_data);
 	}
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
-	}
-	g_free(metabuf);
+	g_free(chunk->name);
+	g_free(chunk);
+
+	return status;
+}
+
+/**
+ * Submit a chunk of sample data for the srzip archive.
+ *
+ * The data gets appended to the spool file, and the archive entry
+ * references that range of the spool file. The buffer is owned by
+ * the writer until the chunk was written.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] name The archive entry name, gets owned by the writer.
+ * @param[in] buf Sample data as byte sequence.
+ * @param[in] length Byte sequence length.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_submit_chunk(const struct sr_output *o,
+	char *name, void *buf, size_t length)
+{
+	struct out_context *outc;
+	struct zip_chunk *chunk;
+
+	outc = o->priv;
+
+	chunk = g_malloc0(sizeof(*chunk));
+	chunk->name = name;
+	chunk->data = buf;
+	chunk->length = length;
+#ifdef HAVE_ZLIB
+	/* Fall back to compression by libzip when memory is short. */
+	if (outc->comp_level)
+		chunk->comp_data = chunk_comp_buffer_get(outc);
+#endif
+
+	return sr_async_submit(outc->writer, chunk);
+}
+
+/**
+ * Append the queued logic data to an srzip archive.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct logic_buff *buff;
+	char *chunkname;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->logic_buff;
+	if (!buff->fill_size)
+		return SR_OK;
+
+	chunkname = g_strdup_printf("logic-1-%zu", ++buff->chunk_count);
+	ret = zip_submit_chunk(o, chunkname, buff->samples,
+		buff->fill_size * buff->unit_size);
+	buff->samples = chunk_buffer_get(outc);
+	buff->fill_size = 0;
+	if (ret != SR_OK)
+		return ret;
+	if (!buff->samples)
+		return SR_ERR_MALLOC;
 
 	return SR_OK;
 }
@@ -410,6 +1018,8 @@ static int zip_append_queue(const struct sr_output *o,
 		sr_warn("Unexpected unit size, discarding logic data.");
 		return SR_ERR_ARG;
 	}
+	if (outc->logic_summary && length)
+		summary_feed_logic(outc->logic_summary, buf, length / unitsize);
 
 	/*
 	 * Queue most recently received samples to the local buffer.
@@ -429,100 +1039,106 @@ static int zip_append_queue(const struct sr_output *o,
 			remain -= copy_size;
 		}
 		if (send_size && !remain) {
-			ret = zip_append(o, buff->samples, buff->unit_size,
-				buff->fill_size * buff->unit_size);
+			ret = zip_append(o);
 			if (ret != SR_OK)
 				return ret;
-			buff->fill_size = 0;
 			remain = buff->alloc_size - buff->fill_size;
 		}
 	}
 
 	/* Flush to the ZIP archive if the caller wants us to. */
 	if (flush && buff->fill_size) {
-		ret = zip_append(o, buff->samples, buff->unit_size,
-			buff->fill_size * buff->unit_size);
+		ret = zip_append(o);
 		if (ret != SR_OK)
 			return ret;
-		buff->fill_size = 0;
 	}
 
 	return SR_OK;
 }
 
 /**
- * Append analog data of a channel to an srzip archive.
+ * Queue run length encoded logic data, for an srzip archive.
  *
  * @param[in] o Output module instance.
- * @param[in] values Sample data as array of floating point values.
- * @param[in] count Number of samples (float items, not bytes).
- * @param[in] ch_nr 1-based channel number.
+ * @param[in] rle The runs of logic samples.
  *
  * @returns SR_OK et al error codes.
+ *
+ * Runs get expanded right into the local buffer, and are summarized
+ * without inspecting their individual samples.
  */
-static int zip_append_analog(const struct sr_output *o,
-	const float *values, size_t count, size_t ch_nr)
+static int zip_append_rle(const struct sr_output *o,
+	const struct sr_datafeed_logic_rle *rle)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *analogsrc;
-	int64_t i, num_files;
-	size_t size;
-	struct zip_stat zs;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *basename;
-	gsize baselen;
-	char *chunkname;
-	unsigned int next_chunk_num;
+	struct logic_buff *buff;
+	const uint8_t *value;
+	uint64_t run, count;
+	size_t remain, copy_size;
+	int ret;
 
 	outc = o->priv;
-
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
-
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
+	buff = &outc->logic_buff;
+	if (rle->run_count && rle->unitsize != buff->unit_size) {
+		sr_warn("Unexpected unit size, discarding logic data.");
+		return SR_ERR_ARG;
 	}
 
-	basename = g_strdup_printf("analog-1-%zu", ch_nr);
-	baselen = strlen(basename);
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, basename, baselen) != 0) {
-			continue;
-		} else if (entry_name[baselen] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + baselen + 1, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
+	for (run = 0; run < rle->run_count; run++) {
+		value = (const uint8_t *)rle->values + run * buff->unit_size;
+		count = rle->lengths[run];
+		if (outc->logic_summary)
+			summary_feed_logic_run(outc->logic_summary, value, count);
+		while (count) {
+			remain = buff->alloc_size - buff->fill_size;
+			if (!remain) {
+				ret = zip_append(o);
+				if (ret != SR_OK)
+					return ret;
+				continue;
+			}
+			copy_size = MIN(count, remain);
+			sr_logic_fill_repeat(
+				&buff->samples[buff->fill_size * buff->unit_size],
+				value, buff->unit_size, copy_size);
+			buff->fill_size += copy_size;
+			count -= copy_size;
 		}
 	}
 
-	size = sizeof(values[0]) * count;
-	analogsrc = zip_source_buffer(archive, values, size, FALSE);
-	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
-	i = zip_add(archive, chunkname, analogsrc);
-	if (i < 0) {
-		sr_err("Failed to add chunk '%s': %s", chunkname, zip_strerror(archive));
-		g_free(chunkname);
-		g_free(basename);
-		zip_source_free(analogsrc);
-		zip_discard(archive);
-		return SR_ERR;
-	}
-	g_free(chunkname);
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		g_free(basename);
-		zip_discard(archive);
-		return SR_ERR;
-	}
+	return SR_OK;
+}
 
-	g_free(basename);
+/**
+ * Append the queued analog data of a channel to an srzip archive.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] idx 0-based index of the enabled analog channel.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_analog(const struct sr_output *o, size_t idx)
+{
+	struct out_context *outc;
+	struct analog_buff *buff;
+	char *chunkname;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->analog_buff[idx];
+	if (!buff->fill_size)
+		return SR_OK;
+
+	chunkname = g_strdup_printf("analog-1-%zu-%zu",
+		outc->first_analog_index + idx, ++buff->chunk_count);
+	ret = zip_submit_chunk(o, chunkname, buff->samples,
+		buff->fill_size * sizeof(buff->samples[0]));
+	buff->samples = chunk_buffer_get(outc);
+	buff->fill_size = 0;
+	if (ret != SR_OK)
+		return ret;
+	if (!buff->samples)
+		return SR_ERR_MALLOC;
 
 	return SR_OK;
 }
@@ -541,7 +1157,7 @@ static int zip_append_analog_queue(const struct sr_output *o,
 {
 	struct out_context *outc;
 	const struct sr_channel *ch;
-	size_t idx, nr;
+	size_t idx;
 	struct analog_buff *buff;
 	float *values, *wrptr, *rdptr;
 	size_t send_size, remain, copy_size;
@@ -552,15 +1168,9 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	/* Is this the DF_END flush call without samples submission? */
 	if (!analog && flush) {
 		for (idx = 0; idx < outc->analog_ch_count; idx++) {
-			nr = outc->first_analog_index + idx;
-			buff = &outc->analog_buff[idx];
-			if (!buff->fill_size)
-				continue;
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, idx);
 			if (ret != SR_OK)
 				return ret;
-			buff->fill_size = 0;
 		}
 		return SR_OK;
 	}
@@ -578,7 +1188,6 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	}
 	if (idx == outc->analog_ch_count)
 		return SR_ERR_ARG;
-	nr = outc->first_analog_index + idx;
 	buff = &outc->analog_buff[idx];
 
 	/* Convert the analog data to an array of float values. */
@@ -590,6 +1199,10 @@ static int zip_append_analog_queue(const struct sr_output *o,
 		g_free(values);
 		return ret;
 	}
+	if (outc->analog_summary) {
+		summary_feed_analog(&outc->analog_summary[idx],
+			values, analog->num_samples);
+	}
 
 	/*
 	 * Queue most recently received samples to the local buffer.
@@ -609,13 +1222,11 @@ static int zip_append_analog_queue(const struct sr_output *o,
 			remain -= copy_size;
 		}
 		if (send_size && !remain) {
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			ret = zip_append_analog(o, idx);
 			if (ret != SR_OK) {
 				g_free(values);
 				return ret;
 			}
-			buff->fill_size = 0;
 			remain = buff->alloc_size - buff->fill_size;
 		}
 	}
@@ -623,15 +1234,97 @@ static int zip_append_analog_queue(const struct sr_output *o,
 
 	/* Flush to the ZIP archive if the caller wants us to. */
 	if (flush && buff->fill_size) {
-		ret = zip_append_analog(o, buff->samples, buff->fill_size, nr);
+		ret = zip_append_analog(o, idx);
 		if (ret != SR_OK)
 			return ret;
-		buff->fill_size = 0;
 	}
 
 	return SR_OK;
 }
 
+/**
+ * Flush pending samples and write the srzip archive to disk.
+ *
+ * Stores the metadata (which includes the logic unit size only when
+ * logic data was seen), and has libzip write the archive's data and
+ * its central directory. The spool file is removed afterwards.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_finalize(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct zip_source *metasrc;
+	char *metabuf;
+	gsize metalen;
+	size_t idx;
+	int ret;
+
+	outc = o->priv;
+	if (!outc->archive)
+		return SR_OK;
+
+	ret = SR_OK;
+	if (outc->logic_buff.samples)
+		ret = zip_append_queue(o, NULL, 0, 0, TRUE);
+	if (ret == SR_OK && outc->analog_buff)
+		ret = zip_append_analog_queue(o, NULL, TRUE);
+
+	/* Wait for pending writes, keep the first error. */
+	if (outc->writer) {
+		if (sr_async_flush(outc->writer) != SR_OK && ret == SR_OK)
+			ret = SR_ERR_IO;
+		sr_async_free(outc->writer);
+		outc->writer = NULL;
+	}
+
+	metabuf = NULL;
+	if (ret == SR_OK) {
+		if (outc->logic_buff.chunk_count) {
+			g_key_file_set_integer(outc->meta, "device 1",
+				"unitsize", outc->logic_buff.unit_size);
+		}
+		metabuf = g_key_file_to_data(outc->meta, &metalen, NULL);
+		metasrc = zip_source_buffer(outc->archive,
+			metabuf, metalen, FALSE);
+		if (zip_add(outc->archive, "metadata", metasrc) < 0) {
+			sr_err("Error saving metadata into zipfile: %s",
+				zip_strerror(outc->archive));
+			zip_source_free(metasrc);
+			ret = SR_ERR;
+		}
+	}
+	if (ret == SR_OK && outc->logic_summary)
+		ret = summary_store(outc, outc->logic_summary);
+	for (idx = 0; ret == SR_OK && outc->analog_summary &&
+			idx < outc->analog_ch_count; idx++)
+		ret = summary_store(outc, &outc->analog_summary[idx]);
+
+	if (fclose(outc->spool) != 0 && ret == SR_OK) {
+		sr_err("Failed to write spool file '%s': %s",
+			outc->spool_name, g_strerror(errno));
+		ret = SR_ERR_IO;
+	}
+	outc->spool = NULL;
+
+	if (ret == SR_OK && zip_close(outc->archive) < 0) {
+		sr_err("Error saving zipfile: %s", zip_strerror(outc->archive));
+		ret = SR_ERR;
+	}
+	if (ret != SR_OK)
+		zip_discard(outc->archive);
+	outc->archive = NULL;
+	g_free(metabuf);
+	g_slist_free_full(outc->summary_bufs, g_free);
+	outc->summary_bufs = NULL;
+
+	g_unlink(outc->spool_name);
+
+	return ret;
+}
+
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
 		GString **out)
 {
@@ -669,6 +1362,16 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		if (ret != SR_OK)
 			return ret;
 		break;
+	case SR_DF_LOGIC_RLE:
+		if (!outc->zip_created) {
+			if ((ret = zip_create(o)) != SR_OK)
+				return ret;
+			outc->zip_created = TRUE;
+		}
+		ret = zip_append_rle(o, packet->payload);
+		if (ret != SR_OK)
+			return ret;
+		break;
 	case SR_DF_ANALOG:
 		if (!outc->zip_created) {
 			if ((ret = zip_create(o)) != SR_OK)
@@ -682,10 +1385,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_END:
 		if (outc->zip_created) {
-			ret = zip_append_queue(o, NULL, 0, 0, TRUE);
-			if (ret != SR_OK)
-				return ret;
-			ret = zip_append_analog_queue(o, NULL, TRUE);
+			ret = zip_finalize(o);
 			if (ret != SR_OK)
 				return ret;
 		}
@@ -696,11 +1396,24 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
+	{"threads", "Writer threads", "Number of background writer threads (0 writes synchronously)", NULL, NULL},
+	{"queue_depth", "Queue depth", "Maximum number of chunks pending in the background writer", NULL, NULL},
+	{"compress_level", "Compression level", "Deflate level 1-9, 0 stores chunks uncompressed", NULL, NULL},
+	{"summary", "Store summary", "Store a multi-resolution summary of the sample data", NULL, NULL},
+	{"summary_block", "Summary block size", "Number of samples per summary record", NULL, NULL},
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint32(0));
+		options[1].def = g_variant_ref_sink(g_variant_new_uint32(4));
+		options[2].def = g_variant_ref_sink(g_variant_new_uint32(9));
+		options[3].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+		options[4].def = g_variant_ref_sink(g_variant_new_uint32(4096));
+	}
+
 	return options;
 }
 
@@ -711,12 +1424,27 @@ static int cleanup(struct sr_output *o)
 
 	outc = o->priv;
 
+	/* Keep what was received when the feed did not end regularly. */
+	if (outc->archive)
+		zip_finalize(o);
+	if (outc->meta)
+		g_key_file_free(outc->meta);
+	g_free(outc->spool_name);
+	g_mutex_clear(&outc->spool_mutex);
+	g_slist_free_full(outc->free_buffers, g_free);
+	g_slist_free_full(outc->free_comp_buffers, g_free);
+
 	g_free(outc->analog_index_map);
 	g_free(outc->filename);
 	g_free(outc->logic_buff.samples);
 	for (idx = 0; idx < outc->analog_ch_count; idx++)
 		g_free(outc->analog_buff[idx].samples);
 	g_free(outc->analog_buff);
+	summary_clear(outc->logic_summary);
+	g_free(outc->logic_summary);
+	for (idx = 0; outc->analog_summary && idx < outc->analog_ch_count; idx++)
+		summary_clear(&outc->analog_summary[idx]);
+	g_free(outc->analog_summary);
 
 	g_free(outc);
 	o->priv = NULL;
@@ -729,7 +1457,7 @@ SR_PRIV struct sr_output_module output_srzip = {
 	.name = "srzip",
 	.desc = "srzip session file format data",
 	.exts = (const char*[]){"sr", NULL},
-	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING,
+	.flags = SR_OUTPUT_INTERNAL_IO_HANDLING | SR_OUTPUT_LOGIC_RLE,
 	.options = get_options,
 	.init = init,
 	.receive = receive,
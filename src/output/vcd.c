@@ -33,15 +33,15 @@
 #include <glib.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/vcd"
 
-static const int with_queue_stats = 0;
-static const int with_pool_stats = 0;
-
 struct vcd_channel_desc {
 	size_t index;
 	GString *name;
@@ -59,6 +59,25 @@ struct vcd_queue_item {
 	GString *values;	/**!< text of value changes */
 };
 
+/** Queue of value changes, see queue_samplenum() for details. */
+struct vcd_queue {
+	struct vcd_queue_item *items;	/**!< arena of items */
+	size_t size;			/**!< arena capacity */
+	size_t used;			/**!< arena items ever used */
+	size_t *free_idx;		/**!< recycled items */
+	size_t free_count;
+	size_t *heap;			/**!< min-heap of queued items */
+	size_t heap_count;
+	size_t *hash;			/**!< queued items by samplenum */
+	size_t hash_mask;
+	size_t last;			/**!< current item plus one */
+	struct {
+		size_t alloced, reused, grown;
+		size_t max_depth;
+		uint64_t emitted;
+	} stats;
+};
+
 struct context {
 	size_t enabled_count;
 	size_t logic_count;
@@ -67,12 +86,13 @@ struct context {
 	uint64_t period;
 	struct vcd_channel_desc *channels;
 	uint64_t samplerate;
-	GSList *free_list, *used_list;
-	size_t alloced, freed, reused, pooled;
-	GList *vcd_queue_list;
-	GList *vcd_queue_last;
+	struct vcd_queue queue;
 	gboolean immediate_write;
 	uint8_t *last_logic;
+	size_t last_logic_size;
+	struct vcd_channel_desc **logic_map;
+	uint8_t *logic_mask;
+	size_t logic_mask_size;
 };
 
 /*
@@ -208,7 +228,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	size_t alloc_size;
 	struct sr_channel *ch;
 	GSList *l;
-	size_t num_enabled, num_logic, num_analog, desc_idx;
+	size_t num_enabled, num_logic, num_analog, desc_idx, map_bits;
 	struct vcd_channel_desc *desc;
 
 	(void)options;
@@ -297,6 +317,35 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->last_logic = g_malloc0(alloc_size);
 	if (ctx->logic_count && !ctx->last_logic)
 		return SR_ERR_MALLOC;
+	ctx->last_logic_size = alloc_size;
+
+	/*
+	 * Map bit positions in the logic data image to the logic channels'
+	 * descriptions, and keep a mask of the bits which are of interest.
+	 * Lets .receive() derive the set of changed channels from an XOR
+	 * of adjacent samples, instead of visiting every channel.
+	 */
+	map_bits = 0;
+	for (desc_idx = 0; desc_idx < ctx->enabled_count; desc_idx++) {
+		desc = &ctx->channels[desc_idx];
+		if (desc->type != SR_CHANNEL_LOGIC)
+			continue;
+		if (desc->index + 1 > map_bits)
+			map_bits = desc->index + 1;
+	}
+	ctx->logic_mask_size = (map_bits + 7) / 8;
+	if (ctx->logic_mask_size) {
+		ctx->logic_mask = g_malloc0(ctx->logic_mask_size);
+		alloc_size = ctx->logic_mask_size * 8;
+		ctx->logic_map = g_malloc0(alloc_size * sizeof(ctx->logic_map[0]));
+	}
+	for (desc_idx = 0; desc_idx < ctx->enabled_count; desc_idx++) {
+		desc = &ctx->channels[desc_idx];
+		if (desc->type != SR_CHANNEL_LOGIC)
+			continue;
+		ctx->logic_mask[desc->index / 8] |= 1 << (desc->index % 8);
+		ctx->logic_map[desc->index] = desc;
+	}
 
 	return SR_OK;
 }
@@ -443,315 +492,238 @@ static GString *chk_header(const struct sr_output *o)
  * have seen samples from all involved channels for a given samplenumber.
  * Data for a given sample number can only get emitted when we are sure
  * no other channel's data can arrive any more.
+ *
+ * Queue items live in an arena which only ever grows, and get recycled
+ * together with their text buffers. A min-heap of item indices sorted
+ * by sample number yields the items in the order of emission, a hash
+ * table of item indices keyed by sample number locates the item for a
+ * sample number which other channels already have queued text for.
+ * Insertion is O(log n), lookups are O(1) on average, there are no
+ * allocations in the steady state.
  */
 
-static struct vcd_queue_item *queue_alloc_item(struct context *ctx, uint64_t snum)
-{
-	GSList *node;
-	struct vcd_queue_item *item;
+#define VCD_QUEUE_MIN_SIZE	64
 
-	/* Get an item from the free list if available. */
-	node = ctx->free_list;
-	if (node) {
-		ctx->reused++;
-
-		/* Unlink GSList node from the free list. */
-		ctx->free_list = node->next;
-		node->next = NULL;
-		item = node->data;
-		node->data = NULL;
-
-		/* Setup content of the item. */
-		item->samplenum = snum;
-		if (!item->values)
-			item->values = g_string_sized_new(32);
-		else
-			g_string_truncate(item->values, 0);
-
-		/* Keep GSList node in the used list (avoid free/alloc). */
-		node->next = ctx->used_list;
-		ctx->used_list = node;
-
-		return item;
-	}
+static size_t queue_hash_slot(struct context *ctx, uint64_t snum)
+{
+	snum *= UINT64_C(0x9e3779b97f4a7c15);
+	return (size_t)(snum >> 32) & ctx->queue.hash_mask;
+}
 
-	/* Dynamic allocation of an item. */
-	ctx->alloced++;
-	item = g_malloc0(sizeof(*item));
-	if (!item)
-		return NULL;
-	item->samplenum = snum;
-	item->values = g_string_sized_new(32);
+static void queue_hash_insert(struct context *ctx, size_t idx)
+{
+	struct vcd_queue *q;
+	size_t slot;
+
+	q = &ctx->queue;
+	slot = queue_hash_slot(ctx, q->items[idx].samplenum);
+	while (q->hash[slot])
+		slot = (slot + 1) & q->hash_mask;
+	q->hash[slot] = idx + 1;
+}
 
-	/* Create a used list item, to later move to the free list. */
-	ctx->used_list = g_slist_prepend(ctx->used_list, item);
+/* Returns the item index plus one, or zero when not found. */
+static size_t queue_hash_lookup(struct context *ctx, uint64_t snum)
+{
+	struct vcd_queue *q;
+	size_t slot, idx;
+
+	q = &ctx->queue;
+	if (!q->hash)
+		return 0;
+	slot = queue_hash_slot(ctx, snum);
+	while ((idx = q->hash[slot]) != 0) {
+		if (q->items[idx - 1].samplenum == snum)
+			return idx;
+		slot = (slot + 1) & q->hash_mask;
+	}
 
-	return item;
+	return 0;
 }
 
-static void queue_free_item(struct context *ctx, struct vcd_queue_item *item)
+/* Remove an entry, shift following entries back (linear probing). */
+static void queue_hash_remove(struct context *ctx, size_t idx)
 {
-	GSList *node;
-
-	/*
-	 * Put item back into the free list. We can assume to find a
-	 * used list node, it got allocated when the item was acquired.
-	 */
-	node = ctx->used_list;
-	if (node) {
-		ctx->pooled++;
+	struct vcd_queue *q;
+	size_t slot, next, home;
+
+	q = &ctx->queue;
+	slot = queue_hash_slot(ctx, q->items[idx].samplenum);
+	while (q->hash[slot] != idx + 1)
+		slot = (slot + 1) & q->hash_mask;
+
+	next = slot;
+	while (TRUE) {
+		next = (next + 1) & q->hash_mask;
+		if (!q->hash[next])
+			break;
+		home = queue_hash_slot(ctx, q->items[q->hash[next] - 1].samplenum);
+		/* Keep entries which sit between their home and the gap. */
+		if (slot <= next) {
+			if (slot < home && home <= next)
+				continue;
+		} else {
+			if (slot < home || home <= next)
+				continue;
+		}
+		q->hash[slot] = q->hash[next];
+		slot = next;
+	}
+	q->hash[slot] = 0;
+}
 
-		ctx->used_list = node->next;
-		node->next = NULL;
-		node->data = item;
+static void queue_heap_push(struct context *ctx, size_t idx)
+{
+	struct vcd_queue *q;
+	size_t pos, parent;
+	uint64_t snum;
 
-		item->samplenum = 0;
-		g_string_truncate(item->values, 0);
+	q = &ctx->queue;
+	snum = q->items[idx].samplenum;
+	pos = q->heap_count++;
+	while (pos) {
+		parent = (pos - 1) / 2;
+		if (q->items[q->heap[parent]].samplenum <= snum)
+			break;
+		q->heap[pos] = q->heap[parent];
+		pos = parent;
+	}
+	q->heap[pos] = idx;
+}
 
-		node->next = ctx->free_list;
-		ctx->free_list = node;
+static size_t queue_heap_pop(struct context *ctx)
+{
+	struct vcd_queue *q;
+	size_t top, last, pos, child;
+	uint64_t snum;
 
-		return;
+	q = &ctx->queue;
+	top = q->heap[0];
+	last = q->heap[--q->heap_count];
+	snum = q->items[last].samplenum;
+	pos = 0;
+	while ((child = 2 * pos + 1) < q->heap_count) {
+		if (child + 1 < q->heap_count &&
+		    q->items[q->heap[child + 1]].samplenum <
+		    q->items[q->heap[child]].samplenum)
+			child++;
+		if (snum <= q->items[q->heap[child]].samplenum)
+			break;
+		q->heap[pos] = q->heap[child];
+		pos = child;
 	}
+	if (q->heap_count)
+		q->heap[pos] = last;
 
-	/*
-	 * Release dynamically allocated resources. Could also be used
-	 * to release free list items when the use list is empty.
-	 */
-	ctx->freed++;
-	if (item->values)
-		g_string_free(item->values, TRUE);
-	g_free(item);
+	return top;
 }
 
-static void queue_drain_pool_cb(gpointer data, gpointer cb_data)
+/* Double the capacity of the arena and its index structures. */
+static void queue_grow(struct context *ctx)
 {
-	struct context *ctx;
-	struct vcd_queue_item *item;
-
-	item = data;
-	ctx = cb_data;
-	queue_free_item(ctx, item);
+	struct vcd_queue *q;
+	size_t size, i;
+
+	q = &ctx->queue;
+	size = q->size ? 2 * q->size : VCD_QUEUE_MIN_SIZE;
+	q->items = g_realloc(q->items, size * sizeof(q->items[0]));
+	memset(&q->items[q->size], 0, (size - q->size) * sizeof(q->items[0]));
+	q->heap = g_realloc(q->heap, size * sizeof(q->heap[0]));
+	q->free_idx = g_realloc(q->free_idx, size * sizeof(q->free_idx[0]));
+	q->size = size;
+
+	/* Keep the hash table at most half full, rehash queued items. */
+	g_free(q->hash);
+	q->hash_mask = 2 * size - 1;
+	q->hash = g_malloc0(2 * size * sizeof(q->hash[0]));
+	for (i = 0; i < q->heap_count; i++)
+		queue_hash_insert(ctx, q->heap[i]);
+
+	q->stats.grown++;
 }
 
-static void queue_drain_pool(struct context *ctx)
+static size_t queue_alloc_item(struct context *ctx, uint64_t snum)
 {
-	GSList *list;
+	struct vcd_queue *q;
+	struct vcd_queue_item *item;
+	size_t idx;
 
-	/*
-	 * Grab the list and "empty" the context member. Then
-	 * iterate over the items, have dymamic memory released.
-	 * Then free the GSList nodes (but not their data parts).
-	 * Do this for the used and the free lists.
-	 */
-	list = ctx->used_list;
-	ctx->used_list = NULL;
-	g_slist_foreach(list, queue_drain_pool_cb, ctx);
-	g_slist_free(list);
-
-	list = ctx->free_list;
-	ctx->free_list = NULL;
-	g_slist_foreach(list, queue_drain_pool_cb, ctx);
-	g_slist_free(list);
+	q = &ctx->queue;
+	if (q->free_count) {
+		idx = q->free_idx[--q->free_count];
+		q->stats.reused++;
+	} else {
+		if (q->used == q->size)
+			queue_grow(ctx);
+		idx = q->used++;
+		q->stats.alloced++;
+	}
+
+	item = &q->items[idx];
+	item->samplenum = snum;
+	if (!item->values)
+		item->values = g_string_sized_new(32);
+	else
+		g_string_truncate(item->values, 0);
+
+	return idx;
 }
 
-static int cmp_snum(gconstpointer l, gconstpointer d)
+static void queue_free_item(struct context *ctx, size_t idx)
 {
-	const struct vcd_queue_item *list_item;
-	const uint64_t *snum_ptr;
-
-	list_item = l;
-	snum_ptr = d;
-	if (list_item->samplenum > *snum_ptr)
-		return +1;
-	if (list_item->samplenum < *snum_ptr)
-		return -1;
-	return 0;
+	struct vcd_queue *q;
+
+	q = &ctx->queue;
+	q->free_idx[q->free_count++] = idx;
 }
 
-static int cmp_items(gconstpointer a, gconstpointer b)
+static void queue_drain_pool(struct context *ctx)
 {
-	const struct vcd_queue_item *item_a, *item_b;
-
-	item_a = a;
-	item_b = b;
-	if (item_a->samplenum > item_b->samplenum)
-		return +1;
-	if (item_a->samplenum < item_b->samplenum)
-		return -1;
-	return 0;
+	struct vcd_queue *q;
+	size_t idx;
+
+	q = &ctx->queue;
+	for (idx = 0; idx < q->used; idx++) {
+		if (q->items[idx].values)
+			g_string_free(q->items[idx].values, TRUE);
+	}
+	g_free(q->items);
+	g_free(q->heap);
+	g_free(q->free_idx);
+	g_free(q->hash);
+	memset(q, 0, sizeof(*q));
 }
 
 /*
  * Position the current pointer of the VCD value queue to a specific
- * sample number. Create a new queue item when needed. The logic assumes
- * a specific use pattern: Reception of striped sample data for channels
- * and processing in strict order of sample numbers within a channel.
- * Lower sample numbers near the start of the queue when channels change
- * between session feed packets, before another linear sequence follows.
- *
- * Naive use of convenience glib routines would severely lose performance.
- * That's why custom code is used, which is as complex as it needs to be,
- * yet shall execute faster than a simpler implementation. For trivial
+ * sample number. Create a new queue item when needed. For trivial
  * cases (logic only, one analog channel only) this queue is bypassed.
  */
 static int queue_samplenum(struct context *ctx, uint64_t snum)
 {
-	struct vcd_queue_item *item, *add_item;
-	GList *walk_list, *after_snum, *before_snum, *add_list;
-	GList *last;
-	gboolean add_after_last, do_search;
+	struct vcd_queue *q;
+	size_t idx;
 
 	/* Already at that position? */
-	item = ctx->vcd_queue_last ? ctx->vcd_queue_last->data : NULL;
-	if (item && item->samplenum == snum)
+	q = &ctx->queue;
+	if (q->last && q->items[q->last - 1].samplenum == snum)
 		return SR_OK;
 
-	/*
-	 * Search after the current position in the remaining queue. The
-	 * custom code uses the queue's being sorted by sample number.
-	 * Narrow down a later insert position as much as possible. This
-	 * avoids linear search in huge spaces later on.
-	 */
-	last = NULL;
-	add_after_last = FALSE;
-	after_snum = NULL;
-	before_snum = NULL;
-	walk_list = ctx->vcd_queue_last;
-	while (walk_list) {
-		item = walk_list->data;
-		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		last = walk_list;
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-		if (item->samplenum > snum) {
-			after_snum = walk_list;
-			break;
-		}
-		if (!walk_list->next)
-			add_after_last = TRUE;
-		walk_list = walk_list->next;
-	}
-
-	/*
-	 * No exact match at or beyond the current position. Run another
-	 * search from the start of the queue, again restrict the space
-	 * which is searched, and narrow down the insert position when
-	 * no match is found.
-	 *
-	 * If the searched sample number is larger than any we have seen
-	 * before, or was in the above covered range but was not found,
-	 * then we know that another queue item needs to get added, and
-	 * where to put it. In that case we need not iterate the earlier
-	 * list items.
-	 */
-	walk_list = ctx->vcd_queue_list;
-	do_search = TRUE;
-	if (add_after_last)
-		do_search = FALSE;
-	if (before_snum)
-		do_search = FALSE;
-	while (do_search && walk_list && walk_list != ctx->vcd_queue_last) {
-		item = walk_list->data;
-		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-		if (item->samplenum > snum) {
-			after_snum = walk_list;
-			break;
-		}
-		walk_list = walk_list->next;
-	}
-
-	/*
-	 * The complete existing queue was exhausted, no exact match was
-	 * found. A new queue item must get inserted. Identify a good
-	 * position where to start searching for the exact position to
-	 * link the new item to the list. Assume that the combination of
-	 * the glib routine's list traversal and the sample number check
-	 * in the callback is expensive, reduce the amount of work done.
-	 *
-	 * If we have seen an item with a larger sample number than the
-	 * wanted, check its immediate predecessor. If this has a smaller
-	 * sample number, then we found a perfect location to insert the
-	 * new item. If we know that the new item must be inserted after
-	 * the last traversed queue item, start there.
-	 */
-	if (!before_snum) do {
-		if (add_after_last)
-			break;
-		if (!after_snum)
-			break;
-		walk_list = after_snum->prev;
-		if (!walk_list)
-			break;
-		item = walk_list->data;
-		if (!item)
-			break;
-		if (item->samplenum == snum) {
-			ctx->vcd_queue_last = walk_list;
-			return SR_OK;
-		}
-		if (item->samplenum < snum)
-			before_snum = walk_list;
-	} while (0);
-	add_list = add_after_last ? last : before_snum;
-	if (!add_list) {
-		walk_list = ctx->vcd_queue_list;
-		while (walk_list) {
-			item = walk_list->data;
-			if (!item)
-				break;
-			if (item->samplenum == snum) {
-				ctx->vcd_queue_last = walk_list;
-				return SR_OK;
-			}
-			if (item->samplenum > snum) {
-				after_snum = walk_list;
-				break;
-			}
-			add_list = walk_list;
-			walk_list = walk_list->next;
-		}
-	}
-	if (add_list && (item = add_list->data) && item->samplenum == snum) {
-		ctx->vcd_queue_last = add_list;
+	/* Another channel already queued text for that sample number? */
+	idx = queue_hash_lookup(ctx, snum);
+	if (idx) {
+		q->last = idx;
 		return SR_OK;
 	}
 
-	/*
-	 * Create a new queue item for the so far untracked sample
-	 * number. Immediately search for the inserted position (is
-	 * unfortunately not returned from the insert call), and
-	 * cache that position for subsequent lookups.
-	 */
-	if (with_queue_stats)
-		sr_dbg("%s(), queue nr %" PRIu64, __func__, snum);
-	add_item = queue_alloc_item(ctx, snum);
-	if (!add_item)
-		return SR_ERR_MALLOC;
-	if (!add_list)
-		add_list = ctx->vcd_queue_list;
-	if (add_list && add_list->prev)
-		add_list = add_list->prev;
-	walk_list = g_list_insert_sorted(add_list, add_item, cmp_items);
-	if (!walk_list->prev)
-		ctx->vcd_queue_list = walk_list;
-	walk_list = g_list_find_custom(walk_list, &snum, cmp_snum);
-	item = walk_list ? walk_list->data : NULL;
-	if (item && item->samplenum == snum) {
-		ctx->vcd_queue_last = walk_list;
-	}
+	/* Create a new queue item for the so far untracked number. */
+	idx = queue_alloc_item(ctx, snum);
+	queue_heap_push(ctx, idx);
+	queue_hash_insert(ctx, idx);
+	q->last = idx + 1;
+	if (q->heap_count > q->stats.max_depth)
+		q->stats.max_depth = q->heap_count;
+
 	return SR_OK;
 }
 
@@ -762,20 +734,14 @@ static int queue_samplenum(struct context *ctx, uint64_t snum)
  */
 static GString *queue_value_text_prep(struct context *ctx)
 {
-	struct vcd_queue_item *item;
+	struct vcd_queue *q;
 	GString *buff;
 
 	/* Cope with not-yet-positioned write pointers. */
-	item = ctx->vcd_queue_last ? ctx->vcd_queue_last->data : NULL;
-	if (!item)
+	q = &ctx->queue;
+	if (!q->last)
 		return NULL;
-
-	/* Create a GString if not done already. */
-	buff = item->values;
-	if (!buff) {
-		buff = g_string_sized_new(20);
-		item->values = buff;
-	}
+	buff = q->items[q->last - 1].values;
 
 	/* Separate items with spaces (if previous content is present). */
 	if (buff->len)
@@ -933,45 +899,32 @@ static uint64_t get_max_snum_flush(struct context *ctx)
  */
 static int write_completed_changes(struct context *ctx, GString *out)
 {
+	struct vcd_queue *q;
 	uint64_t upto_snum;
-	GList **listref, *node;
-	struct vcd_queue_item *item;
+	size_t idx;
 	int rc;
-	size_t dumped;
 
 	/* Determine the number which all data was received for so far. */
 	upto_snum = get_max_snum_export(ctx);
-	if (with_queue_stats)
-		sr_spew("%s(), check up to %" PRIu64, __func__, upto_snum);
 
 	/*
-	 * Forward and consume those items from the head of the list
+	 * Forward and consume those items from the head of the queue
 	 * which we completely have accumulated and are certain about.
+	 * Void cached positions. Append timestamps and values to the
+	 * caller's text.
 	 */
-	dumped = 0;
-	listref = &ctx->vcd_queue_list;
-	while (*listref) {
-		/* Find items before the targetted sample number. */
-		node = *listref;
-		item = node->data;
-		if (!item)
-			break;
-		if (item->samplenum >= upto_snum)
+	q = &ctx->queue;
+	while (q->heap_count) {
+		idx = q->heap[0];
+		if (q->items[idx].samplenum >= upto_snum)
 			break;
-
-		/*
-		 * Unlink the item from the list. Void cached positions.
-		 * Append its timestamp and values to the caller's text.
-		 */
-		dumped++;
-		if (with_queue_stats)
-			sr_dbg("%s(), dump nr %" PRIu64,
-				__func__, item->samplenum);
-		if (ctx->vcd_queue_last == node)
-			ctx->vcd_queue_last = NULL;
-		*listref = g_list_remove_link(*listref, node);
-		rc = unqueue_item(ctx, item, out);
-		queue_free_item(ctx, item);
+		queue_heap_pop(ctx);
+		queue_hash_remove(ctx, idx);
+		if (q->last == idx + 1)
+			q->last = 0;
+		rc = unqueue_item(ctx, &q->items[idx], out);
+		queue_free_item(ctx, idx);
+		q->stats.emitted++;
 		if (rc != SR_OK)
 			return rc;
 	}
@@ -979,6 +932,171 @@ static int write_completed_changes(struct context *ctx, GString *out)
 	return SR_OK;
 }
 
+/*
+ * Determine how many of the logic samples match the previously seen
+ * sample. Compares wide words against a replicated copy of the last
+ * sample, to quickly skip over idle periods.
+ */
+static size_t vcd_skip_unchanged(const uint8_t *last, const uint8_t *sample,
+	size_t unit_size, size_t count)
+{
+	size_t idx, len, pos;
+	uint8_t pattern[16];
+	uint64_t word, diff;
+	uint32_t lo, hi;
+#ifdef __SSE2__
+	__m128i want, have;
+	int mask;
+#endif
+
+	idx = 0;
+	if (unit_size && sizeof(pattern) % unit_size == 0) {
+		for (pos = 0; pos < sizeof(pattern); pos += unit_size)
+			memcpy(&pattern[pos], last, unit_size);
+		len = count * unit_size;
+		pos = 0;
+#ifdef __SSE2__
+		want = _mm_loadu_si128((const __m128i *)pattern);
+		while (pos + 16 <= len) {
+			have = _mm_loadu_si128((const __m128i *)&sample[pos]);
+			mask = _mm_movemask_epi8(_mm_cmpeq_epi8(have, want));
+			if (mask != 0xffff) {
+				pos += g_bit_nth_lsf(~mask & 0xffff, -1);
+				return pos / unit_size;
+			}
+			pos += 16;
+		}
+#endif
+		if (sizeof(word) % unit_size == 0) {
+			memcpy(&word, pattern, sizeof(word));
+			while (pos + sizeof(word) <= len) {
+				memcpy(&diff, &sample[pos], sizeof(diff));
+				diff ^= word;
+				if (diff) {
+					diff = GUINT64_FROM_LE(diff);
+					lo = diff & 0xffffffff;
+					hi = diff >> 32;
+					if (lo)
+						pos += g_bit_nth_lsf(lo, -1) / 8;
+					else
+						pos += 4 + g_bit_nth_lsf(hi, -1) / 8;
+					return pos / unit_size;
+				}
+				pos += sizeof(word);
+			}
+		}
+		idx = pos / unit_size;
+	}
+	while (idx < count && memcmp(last, &sample[idx * unit_size], unit_size) == 0)
+		idx++;
+
+	return idx;
+}
+
+/* Emit or queue the text for a logic channel's value change. */
+static int vcd_logic_change(struct context *ctx, GString *out,
+	struct vcd_channel_desc *desc, uint8_t curbit)
+{
+	GString *s_val;
+
+	desc->last.logic = curbit;
+	if (ctx->immediate_write) {
+		g_string_append_c(out, ' ');
+		s_val = out;
+	} else {
+		s_val = queue_value_text_prep(ctx);
+		if (!s_val)
+			return SR_ERR_MALLOC;
+	}
+	format_vcd_value_bit(s_val, curbit, desc->name);
+
+	return SR_OK;
+}
+
+/* Make sure the last logic sample can hold samples of a given size. */
+static void vcd_logic_prep(struct context *ctx, size_t unit_size)
+{
+	if (unit_size > ctx->last_logic_size) {
+		ctx->last_logic = g_realloc(ctx->last_logic, unit_size);
+		memset(&ctx->last_logic[ctx->last_logic_size], 0,
+			unit_size - ctx->last_logic_size);
+		ctx->last_logic_size = unit_size;
+	}
+}
+
+/*
+ * Emit or queue the changes of a logic sample which differs from the
+ * last seen sample. The very first sample dumps all channels' values.
+ */
+static void vcd_logic_sample(struct context *ctx, GString *out,
+	const uint8_t *sample, size_t unit_size, uint64_t snum)
+{
+	struct vcd_channel_desc *desc;
+	uint8_t *last_logic, curbit;
+	size_t index, p, len;
+	uint32_t diff, mask;
+	double ts;
+	int bit, rc;
+
+	last_logic = ctx->last_logic;
+
+	/*
+	 * Start or continue tracking that sample number.
+	 * Avoid string copies for logic-only setups.
+	 */
+	if (ctx->immediate_write) {
+		ts = snum_to_ts(ctx, snum);
+		append_vcd_timestamp(out, ts, FALSE);
+	} else {
+		queue_samplenum(ctx, snum);
+	}
+
+	if (snum == 0) {
+		/* Dump all logic channels' initial values. */
+		rc = SR_OK;
+		for (p = 0; rc == SR_OK && p < ctx->enabled_count; p++) {
+			desc = &ctx->channels[p];
+			if (desc->type != SR_CHANNEL_LOGIC)
+				continue;
+			index = desc->index;
+			curbit = 0;
+			if (index / 8 < unit_size)
+				curbit = (sample[index / 8] >> (index % 8)) & 1;
+			rc = vcd_logic_change(ctx, out, desc, curbit);
+		}
+	} else {
+		/*
+		 * Only visit the channels which have changed.
+		 * Take the XOR of the current and the previous
+		 * sample, and iterate over its set bits.
+		 */
+		rc = SR_OK;
+		for (p = 0; rc == SR_OK && p < unit_size; p += sizeof(diff)) {
+			if (p >= ctx->logic_mask_size)
+				break;
+			len = MIN(sizeof(diff), unit_size - p);
+			len = MIN(len, ctx->logic_mask_size - p);
+			diff = mask = 0;
+			memcpy(&diff, &sample[p], len);
+			memcpy(&mask, &last_logic[p], len);
+			diff ^= mask;
+			mask = 0;
+			memcpy(&mask, &ctx->logic_mask[p], len);
+			diff &= mask;
+			diff = GUINT32_FROM_LE(diff);
+			while (rc == SR_OK && diff) {
+				bit = g_bit_nth_lsf(diff, -1);
+				diff &= diff - 1;
+				index = p * 8 + bit;
+				desc = ctx->logic_map[index];
+				curbit = (sample[index / 8] >> (index % 8)) & 1;
+				rc = vcd_logic_change(ctx, out, desc, curbit);
+			}
+		}
+	}
+	memcpy(last_logic, sample, unit_size);
+}
+
 /* Get packets from the session feed, generate output text. */
 static int receive(const struct sr_output *o,
 	const struct sr_datafeed_packet *packet, GString **out)
@@ -986,15 +1104,16 @@ static int receive(const struct sr_output *o,
 	struct context *ctx;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *rle;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
 	GSList *l;
 	struct vcd_channel_desc *desc;
-	uint64_t snum_curr;
+	uint64_t snum_curr, run;
 	size_t count, index, p, unit_size;
 	gboolean changed;
 	GString *s_val;
-	uint8_t *sample, *last_logic, prevbit, curbit;
+	const uint8_t *sample;
 	GSList *channels;
 	struct sr_channel *channel;
 	int rc;
@@ -1026,68 +1145,56 @@ static int receive(const struct sr_output *o,
 		snum_curr = get_last_snum_logic(ctx);
 		upd_last_snum_logic(ctx, count);
 
-		last_logic = ctx->last_logic;
-		while (count--) {
-			/* Check whether any logic value has changed. */
-			changed = memcmp(last_logic, sample, unit_size) != 0;
-			changed |= snum_curr == 0;
-			if (changed)
-				memcpy(last_logic, sample, unit_size);
-
+		vcd_logic_prep(ctx, unit_size);
+		while (count) {
 			/*
-			 * Start or continue tracking that sample number.
-			 * Avoid string copies for logic-only setups.
+			 * Skip over samples which are identical to the last
+			 * seen sample. The very first sample always is taken
+			 * to dump the channels' initial values.
 			 */
-			if (changed) {
-				if (ctx->immediate_write) {
-					ts = snum_to_ts(ctx, snum_curr);
-					append_vcd_timestamp(*out, ts, FALSE);
-				} else {
-					queue_samplenum(ctx, snum_curr);
-				}
+			if (snum_curr != 0) {
+				p = vcd_skip_unchanged(ctx->last_logic, sample,
+					unit_size, count);
+				snum_curr += p;
+				sample += p * unit_size;
+				count -= p;
+				if (!count)
+					break;
 			}
 
-			/* Iterate over individual logic channels. */
-			for (p = 0; changed && p < ctx->enabled_count; p++) {
-				/*
-				 * TODO Check whether the mapping from
-				 * data image positions to channel numbers
-				 * is required. Experiments suggest that
-				 * the data image "is dense", and packs
-				 * bits of enabled channels, and leaves no
-				 * room for positions of disabled channels.
-				 */
-				desc = &ctx->channels[p];
-				if (desc->type != SR_CHANNEL_LOGIC)
-					continue;
-				index = desc->index;
-				prevbit = desc->last.logic;
-
-				/* Skip over unchanged values. */
-				curbit = sample[index / 8];
-				curbit = (curbit & (1 << (index % 8))) ? 1 : 0;
-				if (snum_curr != 0 && prevbit == curbit)
-					continue;
-				desc->last.logic = curbit;
-
-				/*
-				 * Queue, or immediately emit the text for
-				 * the observed value change.
-				 */
-				if (ctx->immediate_write) {
-					g_string_append_c(*out, ' ');
-					s_val = *out;
-				} else {
-					s_val = queue_value_text_prep(ctx);
-					if (!s_val)
-						break;
-				}
-				format_vcd_value_bit(s_val, curbit, desc->name);
-			}
+			vcd_logic_sample(ctx, *out, sample, unit_size, snum_curr);
 
 			/* Advance to next set of logic samples. */
 			snum_curr++;
 			sample += unit_size;
+			count--;
+		}
+		write_completed_changes(ctx, *out);
+		break;
+	case SR_DF_LOGIC_RLE:
+		*out = chk_header(o);
+
+		/*
+		 * Runs of identical samples need not get inspected
+		 * individually. Only the first sample of a run can be
+		 * a change.
+		 */
+		rle = packet->payload;
+		unit_size = rle->unitsize;
+		snum_curr = get_last_snum_logic(ctx);
+		upd_last_snum_logic(ctx, sr_logic_rle_length(rle));
+
+		vcd_logic_prep(ctx, unit_size);
+		sample = rle->values;
+		for (run = 0; run < rle->run_count; run++) {
+			if (!rle->lengths[run])
+				continue;
+			if (snum_curr == 0 || memcmp(ctx->last_logic,
+					&sample[run * unit_size], unit_size) != 0)
+				vcd_logic_sample(ctx, *out,
+					&sample[run * unit_size],
+					unit_size, snum_curr);
+			snum_curr += rle->lengths[run];
 		}
 		write_completed_changes(ctx, *out);
 		break;
@@ -1185,19 +1292,23 @@ static int cleanup(struct sr_output *o)
 
 	ctx = o->priv;
 
-	if (with_pool_stats)
-		sr_info("STATS: alloc/reuse %zu/%zu, pool/free %zu/%zu",
-			ctx->alloced, ctx->reused, ctx->pooled, ctx->freed);
+	if (ctx->queue.stats.alloced) {
+		sr_dbg("Change queue: %" PRIu64 " items emitted, %zu allocated,"
+			" %zu reused, %zu resizes, max depth %zu.",
+			ctx->queue.stats.emitted, ctx->queue.stats.alloced,
+			ctx->queue.stats.reused, ctx->queue.stats.grown,
+			ctx->queue.stats.max_depth);
+	}
 	queue_drain_pool(ctx);
-	if (with_pool_stats)
-		sr_info("STATS: alloc/reuse %zu/%zu, pool/free %zu/%zu",
-			ctx->alloced, ctx->reused, ctx->pooled, ctx->freed);
 
 	while (ctx->enabled_count--) {
 		desc = &ctx->channels[ctx->enabled_count];
 		g_string_free(desc->name, TRUE);
 	}
 	g_free(ctx->channels);
+	g_free(ctx->last_logic);
+	g_free(ctx->logic_map);
+	g_free(ctx->logic_mask);
 	g_free(ctx);
 
 	return SR_OK;
@@ -1208,7 +1319,7 @@ struct sr_output_module output_vcd = {
 	.name = "VCD",
 	.desc = "Value Change Dump data",
 	.exts = (const char*[]){"vcd", NULL},
-	.flags = 0,
+	.flags = SR_OUTPUT_LOGIC_RLE,
 	.options = NULL,
 	.init = init,
 	.receive = receive,
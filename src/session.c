@@ -49,6 +49,7 @@
 struct datafeed_callback {
 	sr_datafeed_callback cb;
 	void *cb_data;
+	gboolean rle;
 };
 
 /** Custom GLib event source for generic descriptor I/O.
@@ -67,6 +68,38 @@ struct fd_source {
 	GPollFD pollfd;
 };
 
+/** An entry in the datafeed ring, a retained packet and its origin. */
+struct feed_entry {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+};
+
+/** Datafeed ring between the session thread and the feed thread.
+ *
+ * The session thread (which runs the event sources and thus the drivers)
+ * is the only producer, the feed thread is the only consumer. Slots get
+ * handed over by means of the head and tail counters, without locking.
+ * The mutex and condition only get used when a side needs to sleep
+ * because the ring is empty (consumer) or full (producer).
+ */
+struct session_feed {
+	struct sr_session *session;
+	struct feed_entry *ring;
+	guint mask;
+	/* Free running counters, only written by the consumer/producer. */
+	gint head;
+	gint tail;
+	gint consumer_waiting;
+	gint producer_waiting;
+	gint quit;
+	GMutex mutex;
+	GCond cond;
+	GThread *thread;
+};
+
+static int session_dispatch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet);
+
 /** FD event source prepare() method.
  * This is called immediately before poll().
  */
@@ -505,6 +538,43 @@ SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Add a datafeed callback which handles run length encoded logic data.
+ *
+ * Callbacks which were registered by sr_session_datafeed_callback_add()
+ * receive SR_DF_LOGIC_RLE data expanded to SR_DF_LOGIC packets. This
+ * variant passes SR_DF_LOGIC_RLE packets to the callback as they are,
+ * which saves the expansion of compressed data for consumers that can
+ * handle runs of samples (like output modules which have the
+ * SR_OUTPUT_LOGIC_RLE flag set).
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb Function to call when a chunk of data is received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No session exists.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_callback_add_rle(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data)
+{
+	struct datafeed_callback *cb_struct;
+	int ret;
+
+	ret = sr_session_datafeed_callback_add(session, cb, cb_data);
+	if (ret != SR_OK)
+		return ret;
+
+	cb_struct = g_slist_last(session->datafeed_callbacks)->data;
+	cb_struct->rle = TRUE;
+
+	return SR_OK;
+}
+
 /**
  * Get the trigger assigned to this session.
  *
@@ -671,6 +741,168 @@ static unsigned int session_source_attach(struct sr_session *session,
 	return id;
 }
 
+/* Wake up the other side of the datafeed ring, if it sleeps. */
+static void session_feed_wakeup(struct session_feed *feed, gint *waiting)
+{
+	if (!g_atomic_int_get(waiting))
+		return;
+	g_mutex_lock(&feed->mutex);
+	g_cond_broadcast(&feed->cond);
+	g_mutex_unlock(&feed->mutex);
+}
+
+static gpointer session_feed_thread(gpointer data)
+{
+	struct session_feed *feed;
+	struct feed_entry *entry;
+	guint head;
+
+	feed = data;
+
+	for (;;) {
+		head = g_atomic_int_get(&feed->head);
+		if (head == (guint)g_atomic_int_get(&feed->tail)) {
+			/* Only terminate after the ring was drained. */
+			if (g_atomic_int_get(&feed->quit))
+				break;
+			g_mutex_lock(&feed->mutex);
+			g_atomic_int_set(&feed->consumer_waiting, 1);
+			while (head == (guint)g_atomic_int_get(&feed->tail) &&
+					!g_atomic_int_get(&feed->quit))
+				g_cond_wait(&feed->cond, &feed->mutex);
+			g_atomic_int_set(&feed->consumer_waiting, 0);
+			g_mutex_unlock(&feed->mutex);
+			continue;
+		}
+
+		entry = &feed->ring[head & feed->mask];
+		session_dispatch(entry->sdi, entry->packet);
+		sr_packet_unref(entry->packet);
+		entry->packet = NULL;
+		g_atomic_int_inc(&feed->head);
+
+		session_feed_wakeup(feed, &feed->producer_waiting);
+	}
+
+	return NULL;
+}
+
+/* Hand a packet to the feed thread, block while the ring is full. */
+static int session_feed_push(struct session_feed *feed,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	struct sr_session_feed_stats *stats;
+	struct feed_entry *entry;
+	struct sr_datafeed_packet *retained;
+	guint tail, fill;
+	gint64 start;
+
+	/* Packets are borrowed from the sender, retain them for the ring. */
+	retained = sr_packet_ref(packet);
+	if (!retained)
+		return SR_ERR_MALLOC;
+
+	stats = &feed->session->feed_stats;
+	tail = g_atomic_int_get(&feed->tail);
+	fill = tail - (guint)g_atomic_int_get(&feed->head);
+	if (fill > feed->mask) {
+		stats->overflows++;
+		start = g_get_monotonic_time();
+		g_mutex_lock(&feed->mutex);
+		g_atomic_int_set(&feed->producer_waiting, 1);
+		while (tail - (guint)g_atomic_int_get(&feed->head) > feed->mask)
+			g_cond_wait(&feed->cond, &feed->mutex);
+		g_atomic_int_set(&feed->producer_waiting, 0);
+		g_mutex_unlock(&feed->mutex);
+		stats->wait_usec += g_get_monotonic_time() - start;
+		fill = tail - (guint)g_atomic_int_get(&feed->head);
+	}
+
+	entry = &feed->ring[tail & feed->mask];
+	entry->sdi = sdi;
+	entry->packet = retained;
+	g_atomic_int_inc(&feed->tail);
+
+	stats->packets++;
+	if (fill + 1 > stats->max_fill)
+		stats->max_fill = fill + 1;
+
+	session_feed_wakeup(feed, &feed->consumer_waiting);
+
+	return SR_OK;
+}
+
+static int session_feed_start(struct sr_session *session)
+{
+	struct session_feed *feed;
+	GError *error;
+	size_t size;
+
+	size = 1;
+	while (size < session->feed_ring_size)
+		size <<= 1;
+
+	memset(&session->feed_stats, 0, sizeof(session->feed_stats));
+	session->feed_stats.ring_size = size;
+
+	feed = g_malloc0(sizeof(*feed));
+	feed->session = session;
+	feed->ring = g_malloc0(size * sizeof(feed->ring[0]));
+	feed->mask = size - 1;
+	g_mutex_init(&feed->mutex);
+	g_cond_init(&feed->cond);
+
+	error = NULL;
+	feed->thread = g_thread_try_new("sr-datafeed",
+		session_feed_thread, feed, &error);
+	if (!feed->thread) {
+		sr_err("Cannot create datafeed thread: %s",
+			error ? error->message : "unknown error");
+		g_clear_error(&error);
+		g_mutex_clear(&feed->mutex);
+		g_cond_clear(&feed->cond);
+		g_free(feed->ring);
+		g_free(feed);
+		return SR_ERR;
+	}
+	session->feed = feed;
+
+	sr_dbg("Datafeed thread started, ring size %zu.", size);
+
+	return SR_OK;
+}
+
+/* Drain the ring, and terminate the feed thread. */
+static void session_feed_stop(struct sr_session *session)
+{
+	struct session_feed *feed;
+	struct sr_session_feed_stats *stats;
+
+	feed = session->feed;
+	if (!feed)
+		return;
+	session->feed = NULL;
+
+	g_mutex_lock(&feed->mutex);
+	g_atomic_int_set(&feed->quit, 1);
+	g_cond_broadcast(&feed->cond);
+	g_mutex_unlock(&feed->mutex);
+	g_thread_join(feed->thread);
+
+	stats = &session->feed_stats;
+	if (stats->overflows) {
+		sr_info("Datafeed ring was full %" PRIu64 " times, waited "
+			"%" PRIu64 " ms in total.", stats->overflows,
+			stats->wait_usec / 1000);
+	}
+
+	g_mutex_clear(&feed->mutex);
+	g_cond_clear(&feed->cond);
+	g_free(feed->ring);
+	g_free(feed);
+}
+
 /* Idle handler; invoked when the number of registered event sources
  * for a running session drops to zero.
  */
@@ -689,6 +921,7 @@ static gboolean delayed_stop_check(void *data)
 	if (g_hash_table_size(session->event_sources) != 0)
 		return G_SOURCE_REMOVE;
 
+	session_feed_stop(session);
 	session->running = FALSE;
 	unset_main_context(session);
 
@@ -806,6 +1039,14 @@ SR_API int sr_session_start(struct sr_session *session)
 	if (ret != SR_OK)
 		return ret;
 
+	if (session->feed_ring_size) {
+		ret = session_feed_start(session);
+		if (ret != SR_OK) {
+			unset_main_context(session);
+			return ret;
+		}
+	}
+
 	sr_info("Starting.");
 
 	session->running = TRUE;
@@ -835,6 +1076,7 @@ SR_API int sr_session_start(struct sr_session *session)
 		}
 		/* TODO: Handle delayed stops. Need to iterate the event
 		 * sources... */
+		session_feed_stop(session);
 		session->running = FALSE;
 
 		unset_main_context(session);
@@ -1026,6 +1268,78 @@ SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Run transforms and datafeed callbacks in a separate thread.
+ *
+ * By default, transform modules and datafeed callbacks run in the thread
+ * which executes the session, and thus delay the handling of hardware
+ * events. When a datafeed thread is used, the session thread hands the
+ * packets to the datafeed thread through a ring buffer. Packets get
+ * retained by means of sr_packet_ref(), so shared packets pass without
+ * copying their data. When the ring is full, the session thread waits
+ * for a free slot.
+ *
+ * Datafeed callbacks get invoked from within the datafeed thread then,
+ * and must not assume to run in the thread which started the session.
+ * The session's stopped callback runs after all packets were processed.
+ *
+ * Must not be called while the session is running.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param ring_size The number of packets the ring can hold. Gets rounded
+ *   up to a power of two. Zero runs callbacks in the session thread.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR Session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_feed_thread_set(struct sr_session *session,
+		size_t ring_size)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (session->running) {
+		sr_err("Cannot change datafeed thread while running.");
+		return SR_ERR;
+	}
+	session->feed_ring_size = ring_size;
+
+	return SR_OK;
+}
+
+/**
+ * Get the statistics of the session's datafeed thread.
+ *
+ * The statistics cover the current session run, or the most recent run
+ * when the session is not running. While the session runs, the values
+ * are a snapshot which may be slightly inconsistent.
+ *
+ * A non-zero overflow count means that transforms and callbacks could
+ * not keep up with the acquisition, and the session thread had to wait.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param stats The caller's storage for the statistics. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_feed_stats_get(struct sr_session *session,
+		struct sr_session_feed_stats *stats)
+{
+	if (!session || !stats)
+		return SR_ERR_ARG;
+
+	*stats = session->feed_stats;
+
+	return SR_OK;
+}
+
 /**
  * Debug helper.
  *
@@ -1034,6 +1348,7 @@ SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 static void datafeed_dump(const struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *rle;
 	const struct sr_datafeed_analog *analog;
 
 	/* Please use the same order as in libsigrok.h. */
@@ -1066,6 +1381,11 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		sr_dbg("bus: Received SR_DF_LOGIC_RLE packet (%" PRIu64 " runs, "
+		       "unitsize = %d).", rle->run_count, rle->unitsize);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
@@ -1113,6 +1433,10 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
  *
  * Hardware drivers use this to send a data packet to the frontend.
  *
+ * When the session runs a datafeed thread, the packet gets retained and
+ * queued, and this function returns before the packet was processed.
+ * Errors of transform modules then get logged by the datafeed thread.
+ *
  * @param sdi TODO.
  * @param packet The datafeed packet to send to the session bus.
  *
@@ -1124,11 +1448,7 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
 {
-	GSList *l;
-	struct datafeed_callback *cb_struct;
-	struct sr_datafeed_packet *packet_in, *packet_out;
-	struct sr_transform *t;
-	int ret;
+	struct session_feed *feed;
 
 	if (!sdi) {
 		sr_err("%s: sdi was NULL", __func__);
@@ -1145,6 +1465,73 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		return SR_ERR_BUG;
 	}
 
+	/*
+	 * With a datafeed thread, transforms and callbacks run there.
+	 * Packets which the feed thread itself emits are not queued,
+	 * that would deadlock when the ring is full.
+	 */
+	feed = sdi->session->feed;
+	if (feed && g_thread_self() != feed->thread)
+		return session_feed_push(feed, sdi, packet);
+
+	return session_dispatch(sdi, packet);
+}
+
+/* Context for the expansion of run length encoded logic data. */
+struct dispatch_expand {
+	const struct sr_dev_inst *sdi;
+	gboolean transforms;
+};
+
+static int session_dispatch_chunk(const struct sr_datafeed_packet *packet,
+		void *cb_data)
+{
+	struct dispatch_expand *expand;
+	struct datafeed_callback *cb_struct;
+	GSList *l;
+
+	expand = cb_data;
+
+	/* Expanded data for the transforms takes the regular path. */
+	if (expand->transforms)
+		return session_dispatch(expand->sdi, packet);
+
+	/* Otherwise only callbacks which can't handle runs get it. */
+	for (l = expand->sdi->session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (cb_struct->rle)
+			continue;
+		if (sr_log_loglevel_get() >= SR_LOG_DBG)
+			datafeed_dump(packet);
+		cb_struct->cb(expand->sdi, packet, cb_struct->cb_data);
+	}
+
+	return SR_OK;
+}
+
+/* Run a packet through the transforms, and pass it to the callbacks. */
+static int session_dispatch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+	struct sr_datafeed_packet *packet_in, *packet_out;
+	struct sr_transform *t;
+	struct dispatch_expand expand;
+	gboolean expand_rle;
+	int ret;
+
+	/*
+	 * Transform modules don't handle run length encoded data, they
+	 * see the expanded samples, as do the callbacks in that case.
+	 */
+	if (packet->type == SR_DF_LOGIC_RLE && sdi->session->transforms) {
+		expand.sdi = sdi;
+		expand.transforms = TRUE;
+		return sr_logic_rle_unpack(packet->payload,
+			session_dispatch_chunk, &expand);
+	}
+
 	/*
 	 * Pass the packet to the first transform module. If that returns
 	 * another packet (instead of NULL), pass that packet to the next
@@ -1180,12 +1567,23 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	 * If the last transform did output a packet, pass it to all datafeed
 	 * callbacks.
 	 */
+	expand_rle = FALSE;
 	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (packet->type == SR_DF_LOGIC_RLE && !cb_struct->rle) {
+			expand_rle = TRUE;
+			continue;
+		}
 		if (sr_log_loglevel_get() >= SR_LOG_DBG)
 			datafeed_dump(packet);
-		cb_struct = l->data;
 		cb_struct->cb(sdi, packet, cb_struct->cb_data);
 	}
+	if (expand_rle) {
+		expand.sdi = sdi;
+		expand.transforms = FALSE;
+		return sr_logic_rle_unpack(packet->payload,
+			session_dispatch_chunk, &expand);
+	}
 
 	return SR_OK;
 }
@@ -1501,6 +1899,8 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	struct sr_datafeed_meta *meta_copy;
 	const struct sr_datafeed_logic *logic;
 	struct sr_datafeed_logic *logic_copy;
+	const struct sr_datafeed_logic_rle *rle;
+	struct sr_datafeed_logic_rle *rle_copy;
 	const struct sr_datafeed_analog *analog;
 	struct sr_datafeed_analog *analog_copy;
 	struct sr_analog_encoding *encoding_copy;
@@ -1514,6 +1914,8 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1524,22 +1926,27 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	case SR_DF_META:
 		meta = packet->payload;
 		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
+		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy);
 		(*copy)->payload = meta_copy;
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
 		logic_copy = g_malloc(sizeof(*logic_copy));
-		if (!logic_copy)
+		if (!logic_copy) {
+			g_free(*copy);
+			*copy = NULL;
 			return SR_ERR;
+		}
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		logic_copy->data = g_malloc(logic->length * logic->unitsize);
+		logic_copy->data = g_malloc(logic->length);
 		if (!logic_copy->data) {
 			g_free(logic_copy);
+			g_free(*copy);
+			*copy = NULL;
 			return SR_ERR;
 		}
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
+		memcpy(logic_copy->data, logic->data, logic->length);
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
@@ -1566,8 +1973,32 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		analog_copy->spec = spec_copy;
 		(*copy)->payload = analog_copy;
 		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		rle_copy = g_malloc(sizeof(*rle_copy));
+		rle_copy->run_count = rle->run_count;
+		rle_copy->unitsize = rle->unitsize;
+		rle_copy->values = g_try_malloc(rle->run_count * rle->unitsize);
+		rle_copy->lengths = g_try_malloc(
+			rle->run_count * sizeof(rle->lengths[0]));
+		if (rle->run_count && (!rle_copy->values || !rle_copy->lengths)) {
+			g_free(rle_copy->values);
+			g_free(rle_copy->lengths);
+			g_free(rle_copy);
+			g_free(*copy);
+			*copy = NULL;
+			return SR_ERR_MALLOC;
+		}
+		memcpy(rle_copy->values, rle->values,
+			rle->run_count * rle->unitsize);
+		memcpy(rle_copy->lengths, rle->lengths,
+			rle->run_count * sizeof(rle->lengths[0]));
+		(*copy)->payload = rle_copy;
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
+		g_free(*copy);
+		*copy = NULL;
 		return SR_ERR;
 	}
 
@@ -1578,6 +2009,7 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *rle;
 	const struct sr_datafeed_analog *analog;
 	struct sr_config *src;
 	GSList *l;
@@ -1585,6 +2017,8 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
@@ -1615,10 +2049,219 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 		g_free(analog->spec);
 		g_free((void *)packet->payload);
 		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		g_free(rle->values);
+		g_free(rle->lengths);
+		g_free((void *)packet->payload);
+		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
 	}
 	g_free(packet);
 }
 
+/*
+ * Reference counted datafeed packets.
+ *
+ * Packets on the session bus are borrowed, and only valid during the
+ * datafeed callback. Consumers which need the data later can retain
+ * packets by means of sr_packet_ref(). Sources can submit "shared"
+ * packets, which own their data buffer. Retaining those is cheap and
+ * does not copy sample data. All other packets get deep copied upon
+ * sr_packet_ref(), and that copy is reference counted, too.
+ *
+ * Packets are plain 'struct sr_datafeed_packet' from the consumer's
+ * perspective. Shared packets are the first member of a wrapper which
+ * holds the reference count, and which embeds the payload at a fixed
+ * offset. A payload pointer to that offset and a magic value tell them
+ * apart from borrowed packets, without a global registry or lock.
+ */
+#define SHARED_PACKET_MAGIC 0x73725043 /* "srPC" */
+
+struct shared_packet {
+	struct sr_datafeed_packet packet;
+	uint32_t magic;
+	gint refcount;
+	union {
+		struct sr_datafeed_header header;
+		struct sr_datafeed_meta meta;
+		struct sr_datafeed_logic logic;
+		struct sr_datafeed_logic_rle rle;
+		struct sr_datafeed_analog analog;
+	} payload;
+	void *buffer;
+	sr_packet_release_cb release;
+	void *cb_data;
+	struct sr_datafeed_packet *copy;
+};
+
+/* Get the wrapper of a shared packet, NULL for borrowed packets. */
+static struct shared_packet *shared_packet_get(
+	const struct sr_datafeed_packet *packet)
+{
+	struct shared_packet *sp;
+
+	sp = (struct shared_packet *)packet;
+	if (packet->payload != &sp->payload)
+		return NULL;
+	if (sp->magic != SHARED_PACKET_MAGIC)
+		return NULL;
+
+	return sp;
+}
+
+/**
+ * Create a shared logic packet, which owns the buffer holding its data.
+ *
+ * @param[in] logic The logic payload, its data pointer may point anywhere
+ *   into @a buffer.
+ * @param[in] buffer The buffer which holds the logic data.
+ * @param[in] release Gets invoked with @a buffer when the last reference
+ *   to the packet is dropped. Can run in another thread.
+ * @param[in] cb_data Caller provided context for the release callback.
+ *
+ * @returns The packet, holding one reference for the caller.
+ *
+ * Sources send the packet like any other packet, and drop their own
+ * reference afterwards. Consumers can retain the packet (and thus the
+ * buffer) by means of sr_packet_ref() without copying its data. The
+ * buffer must not be modified by the source while references exist.
+ *
+ * @private
+ */
+SR_PRIV struct sr_datafeed_packet *sr_packet_logic_new(
+	const struct sr_datafeed_logic *logic, void *buffer,
+	sr_packet_release_cb release, void *cb_data)
+{
+	struct shared_packet *sp;
+
+	sp = g_malloc0(sizeof(*sp));
+	sp->payload.logic = *logic;
+	sp->packet.type = SR_DF_LOGIC;
+	sp->packet.payload = &sp->payload;
+	sp->magic = SHARED_PACKET_MAGIC;
+	sp->refcount = 1;
+	sp->buffer = buffer;
+	sp->release = release;
+	sp->cb_data = cb_data;
+
+	return &sp->packet;
+}
+
+/**
+ * Check whether a datafeed packet is a shared (reference counted) packet.
+ *
+ * @param[in] packet The packet to check.
+ *
+ * @returns TRUE when sr_packet_ref() will not copy the packet's data.
+ *
+ * @since 0.6.0
+ */
+SR_API gboolean sr_packet_is_shared(const struct sr_datafeed_packet *packet)
+{
+	if (!packet)
+		return FALSE;
+
+	return shared_packet_get(packet) != NULL;
+}
+
+/**
+ * Retain a datafeed packet beyond the datafeed callback.
+ *
+ * @param[in] packet The packet to retain.
+ *
+ * @returns A packet which remains valid until it is released by means
+ *   of sr_packet_unref(), or NULL on error.
+ *
+ * Shared packets just get their reference count incremented, and the
+ * same packet is returned, without copying data. Other packets get
+ * copied, and the caller receives a shared copy.
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_datafeed_packet *sr_packet_ref(
+	const struct sr_datafeed_packet *packet)
+{
+	struct shared_packet *sp;
+	struct sr_datafeed_packet *copy;
+	size_t size;
+
+	if (!packet)
+		return NULL;
+
+	sp = shared_packet_get(packet);
+	if (sp) {
+		g_atomic_int_inc(&sp->refcount);
+		return &sp->packet;
+	}
+
+	/* Not a shared packet, fall back to a (shared) copy. */
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		size = sizeof(struct sr_datafeed_header);
+		break;
+	case SR_DF_META:
+		size = sizeof(struct sr_datafeed_meta);
+		break;
+	case SR_DF_LOGIC:
+		size = sizeof(struct sr_datafeed_logic);
+		break;
+	case SR_DF_LOGIC_RLE:
+		size = sizeof(struct sr_datafeed_logic_rle);
+		break;
+	case SR_DF_ANALOG:
+		size = sizeof(struct sr_datafeed_analog);
+		break;
+	default:
+		/* No payload. */
+		size = 0;
+		break;
+	}
+	if (sr_packet_copy(packet, &copy) != SR_OK)
+		return NULL;
+	sp = g_malloc0(sizeof(*sp));
+	sp->packet.type = copy->type;
+	sp->packet.payload = &sp->payload;
+	if (size)
+		memcpy(&sp->payload, copy->payload, size);
+	sp->magic = SHARED_PACKET_MAGIC;
+	sp->refcount = 1;
+	sp->copy = copy;
+
+	return &sp->packet;
+}
+
+/**
+ * Release a reference to a shared datafeed packet.
+ *
+ * @param[in] packet The packet, as returned by sr_packet_ref().
+ *
+ * The packet and its data are freed when the last reference is dropped.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_packet_unref(struct sr_datafeed_packet *packet)
+{
+	struct shared_packet *sp;
+
+	if (!packet)
+		return;
+
+	sp = shared_packet_get(packet);
+	if (!sp) {
+		sr_err("Cannot unref packet %p, it is not shared.", packet);
+		return;
+	}
+	if (!g_atomic_int_dec_and_test(&sp->refcount))
+		return;
+
+	sp->magic = 0;
+	if (sp->copy)
+		sr_packet_free(sp->copy);
+	else if (sp->release)
+		sp->release(sp->buffer, sp->cb_data);
+	g_free(sp);
+}
+
 /** @} */
@@ -34,8 +34,30 @@
 #define CHUNKSIZE (4 * 1024 * 1024)
 /** @endcond */
 
+/* Upper bound for the number of blocks which get read ahead. */
+#define MAX_PREFETCH_DEPTH 64
+
 SR_PRIV struct sr_dev_driver session_driver_info;
 
+/*
+ * A block of sample data. In the prefetch mode a pool of these gets
+ * filled by the reader thread, and gets sent by the session thread.
+ * A block without data marks the end of the replay.
+ */
+struct replay_block {
+	uint8_t *data;
+	size_t length;
+	int analog_channel;
+};
+
+/* One capture file (chunk) of a stream, in the stream's sample order. */
+struct capture_chunk {
+	uint64_t number;
+	zip_uint64_t entry;
+	uint64_t first_sample;
+	uint64_t num_samples;
+};
+
 struct session_vdev {
 	char *sessionfile;
 	char *capturefile;
@@ -48,8 +70,30 @@ struct session_vdev {
 	int num_analog_channels;
 	int cur_analog_channel;
 	GArray *analog_channels;
-	int cur_chunk;
 	gboolean finished;
+
+	/* Replay range, in samples. A count of zero replays all data. */
+	uint64_t start_sample;
+	uint64_t limit_samples;
+
+	/* Current stream (logic data, or an analog channel). */
+	int cur_stream;
+	GArray *chunks;
+	guint cur_chunk;
+	size_t sample_size;
+	uint64_t skip_bytes;
+	uint64_t remain_samples;
+	uint8_t *buf;
+
+	/*
+	 * Prefetch mode. The reader thread exclusively accesses the
+	 * archive and the replay position while it is running.
+	 */
+	uint64_t prefetch_depth;
+	GThread *reader;
+	gint reader_quit;
+	GAsyncQueue *free_blocks;
+	GAsyncQueue *ready_blocks;
 };
 
 static const uint32_t devopts[] = {
@@ -59,9 +103,249 @@ static const uint32_t devopts[] = {
 	SR_CONF_NUM_ANALOG_CHANNELS | SR_CONF_SET,
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_SESSIONFILE | SR_CONF_SET,
+	SR_CONF_CAPTURE_START | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_PREFETCH_DEPTH | SR_CONF_GET | SR_CONF_SET,
 };
 
-static gboolean stream_session_data(struct sr_dev_inst *sdi)
+static int cmp_chunk_number(const void *a, const void *b)
+{
+	const struct capture_chunk *ca, *cb;
+
+	ca = a;
+	cb = b;
+	if (ca->number < cb->number)
+		return -1;
+	if (ca->number > cb->number)
+		return 1;
+	return 0;
+}
+
+/*
+ * Build the index of a stream's capture files. The data is either kept
+ * in a single file of the stream's base name, or in chunks which have a
+ * "-<number>" suffix, counting from 1. A single pass over the archive's
+ * directory finds them all, which avoids a name lookup per chunk. Like
+ * sequential reading did, chunks after a gap in the numbering are not
+ * considered.
+ */
+static GArray *build_chunk_index(struct zip *archive, const char *basename,
+	size_t sample_size)
+{
+	GArray *chunks;
+	struct capture_chunk chunk, *c;
+	struct zip_stat zs;
+	zip_int64_t num_entries;
+	zip_uint64_t idx;
+	uint64_t expect, first_sample;
+	size_t base_len;
+	const char *suffix;
+	char *end;
+	guint i;
+
+	base_len = strlen(basename);
+	num_entries = zip_get_num_entries(archive, 0);
+	chunks = g_array_new(FALSE, FALSE, sizeof(chunk));
+	for (idx = 0; num_entries > 0 && idx < (zip_uint64_t)num_entries; idx++) {
+		if (zip_stat_index(archive, idx, 0, &zs) < 0)
+			continue;
+		if (!(zs.valid & ZIP_STAT_NAME) || !(zs.valid & ZIP_STAT_SIZE))
+			continue;
+		if (strncmp(zs.name, basename, base_len) != 0)
+			continue;
+		suffix = &zs.name[base_len];
+		if (!*suffix) {
+			/* No chunks, just a single capture file. */
+			chunk.number = 0;
+		} else if (suffix[0] == '-' && g_ascii_isdigit(suffix[1])) {
+			chunk.number = g_ascii_strtoull(&suffix[1], &end, 10);
+			if (*end || !chunk.number)
+				continue;
+		} else {
+			continue;
+		}
+		chunk.entry = idx;
+		chunk.first_sample = 0;
+		chunk.num_samples = zs.size / sample_size;
+		g_array_append_val(chunks, chunk);
+	}
+	g_array_sort(chunks, cmp_chunk_number);
+
+	/* A single capture file takes precedence over chunks. */
+	expect = (chunks->len && g_array_index(chunks,
+		struct capture_chunk, 0).number == 0) ? 0 : 1;
+	first_sample = 0;
+	for (i = 0; i < chunks->len; i++) {
+		c = &g_array_index(chunks, struct capture_chunk, i);
+		if (c->number != expect)
+			break;
+		c->first_sample = first_sample;
+		first_sample += c->num_samples;
+		if (!expect++) {
+			i++;
+			break;
+		}
+	}
+	g_array_set_size(chunks, i);
+
+	return chunks;
+}
+
+/* Find the chunk which contains a sample, or the end of the index. */
+static guint find_chunk(GArray *chunks, uint64_t sample)
+{
+	const struct capture_chunk *chunk;
+	guint lo, hi, mid;
+
+	lo = 0;
+	hi = chunks->len;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		chunk = &g_array_index(chunks, struct capture_chunk, mid);
+		if (chunk->first_sample + chunk->num_samples <= sample)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Setup the next stream for replay. Logic data comes first (when the
+ * session has any), analog channels follow in the order of their index.
+ * Returns FALSE when all streams have been replayed, or upon error.
+ */
+static gboolean open_next_stream(struct session_vdev *vdev)
+{
+	const struct capture_chunk *chunk;
+	char *basename;
+
+	if (vdev->chunks) {
+		g_array_free(vdev->chunks, TRUE);
+		vdev->chunks = NULL;
+	}
+
+	if (vdev->cur_stream == 0 && vdev->capturefile && vdev->unitsize) {
+		basename = g_strdup(vdev->capturefile);
+		vdev->sample_size = vdev->unitsize;
+	} else {
+		if (vdev->cur_stream == 0)
+			vdev->cur_stream++;
+		if (vdev->cur_stream > vdev->num_analog_channels)
+			return FALSE;
+		basename = g_strdup_printf("analog-1-%d",
+			vdev->num_logic_channels + vdev->cur_stream);
+		vdev->sample_size = sizeof(float);
+	}
+	vdev->cur_analog_channel = vdev->cur_stream;
+	vdev->cur_stream++;
+
+	vdev->chunks = build_chunk_index(vdev->archive, basename,
+		vdev->sample_size);
+	if (!vdev->chunks->len) {
+		sr_err("No capture file '%s' in session file '%s'.",
+			basename, vdev->sessionfile);
+		g_free(basename);
+		return FALSE;
+	}
+	sr_dbg("Capture file %s has %u chunk(s).", basename, vdev->chunks->len);
+	g_free(basename);
+
+	/* Seek to the chunk which contains the range's first sample. */
+	vdev->cur_chunk = find_chunk(vdev->chunks, vdev->start_sample);
+	vdev->skip_bytes = 0;
+	if (vdev->cur_chunk < vdev->chunks->len) {
+		chunk = &g_array_index(vdev->chunks, struct capture_chunk,
+			vdev->cur_chunk);
+		vdev->skip_bytes = vdev->start_sample - chunk->first_sample;
+		vdev->skip_bytes *= vdev->sample_size;
+	}
+	vdev->remain_samples = vdev->limit_samples ? vdev->limit_samples : UINT64_MAX;
+
+	return TRUE;
+}
+
+/*
+ * Open the stream's next chunk. Advances to the next stream when the
+ * current one is exhausted. Compressed archive members cannot seek, so
+ * the start of the range within its chunk gets read and discarded. This
+ * is bounded by the chunk size, not by the capture's size.
+ */
+static gboolean open_next_chunk(struct session_vdev *vdev)
+{
+	const struct capture_chunk *chunk;
+	zip_int64_t ret;
+
+	while (!vdev->chunks || vdev->cur_chunk >= vdev->chunks->len ||
+			!vdev->remain_samples) {
+		if (!open_next_stream(vdev))
+			return FALSE;
+	}
+
+	chunk = &g_array_index(vdev->chunks, struct capture_chunk, vdev->cur_chunk);
+	vdev->cur_chunk++;
+	vdev->capfile = zip_fopen_index(vdev->archive, chunk->entry, 0);
+	if (!vdev->capfile) {
+		sr_err("Cannot open capture file in '%s'.", vdev->sessionfile);
+		return FALSE;
+	}
+	sr_dbg("Opened %s.", zip_get_name(vdev->archive, chunk->entry, 0));
+
+	while (vdev->skip_bytes) {
+		ret = zip_fread(vdev->capfile, vdev->buf,
+			MIN(vdev->skip_bytes, CHUNKSIZE));
+		if (ret <= 0)
+			break;
+		vdev->skip_bytes -= ret;
+	}
+	vdev->skip_bytes = 0;
+
+	return TRUE;
+}
+
+/*
+ * Read the next block of sample data into the caller's buffer, which
+ * holds CHUNKSIZE bytes. Returns FALSE when all data has been read, or
+ * upon error.
+ */
+static gboolean read_session_data(struct session_vdev *vdev,
+	struct replay_block *block)
+{
+	uint64_t length;
+	zip_int64_t ret;
+
+	while (TRUE) {
+		if (!vdev->capfile && !open_next_chunk(vdev))
+			return FALSE;
+
+		length = CHUNKSIZE / vdev->sample_size;
+		length = MIN(length, vdev->remain_samples);
+		length *= vdev->sample_size;
+		ret = zip_fread(vdev->capfile, block->data, length);
+		if (ret > 0)
+			break;
+
+		/* Done with this capture file, there may be more chunks. */
+		zip_fclose(vdev->capfile);
+		vdev->capfile = NULL;
+	}
+
+	block->length = ret;
+	block->analog_channel = vdev->cur_analog_channel;
+	vdev->remain_samples -= ret / vdev->sample_size;
+
+	/* Close the stream's chunk when the range is complete. */
+	if (!vdev->remain_samples) {
+		zip_fclose(vdev->capfile);
+		vdev->capfile = NULL;
+	}
+
+	return TRUE;
+}
+
+static void send_session_data(const struct sr_dev_inst *sdi,
+	const struct replay_block *block)
 {
 	struct session_vdev *vdev;
 	struct sr_datafeed_packet packet;
@@ -70,134 +354,169 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
-	struct zip_stat zs;
-	int ret, got_data;
-	char capturefile[128];
-	void *buf;
 
-	got_data = FALSE;
 	vdev = sdi->priv;
 
-	if (!vdev->capfile) {
-		/* No capture file opened yet, or finished with the last
-		 * chunked one. */
-		if (vdev->capturefile && (vdev->cur_chunk == 0)) {
-			/* capturefile is always the unchunked base name. */
-			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
-				/* No chunks, just a single capture file. */
-				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", vdev->capturefile);
-			} else {
-				/* Try as first chunk filename. */
-				snprintf(capturefile, sizeof(capturefile) - 1, "%s-1", vdev->capturefile);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
-				} else {
-					sr_err("No capture file '%s' in " "session file '%s'.",
-							vdev->capturefile, vdev->sessionfile);
-					return FALSE;
-				}
-			}
-		} else {
-			/* Capture data is chunked, advance to the next chunk. */
-			vdev->cur_chunk++;
-			snprintf(capturefile, sizeof(capturefile) - 1, "%s-%d", vdev->capturefile,
-					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", capturefile);
-			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
-				vdev->capturefile = g_strdup_printf("analog-1-%d",
-						vdev->num_logic_channels + vdev->cur_analog_channel + 1);
-				vdev->cur_analog_channel++;
-				vdev->cur_chunk = 0;
-				return TRUE;
-			} else {
-				/* We got all the chunks, finish up. */
-				g_free(vdev->capturefile);
-
-				/* If the file has logic channels, the initial value for
-				 * capturefile is set by stream_session_data() - however only
-				 * once. In order to not mess this mechanism up, we simulate
-				 * this here if needed. For purely analog files, capturefile
-				 * is not set.
-				 */
-				if (vdev->num_logic_channels)
-					vdev->capturefile = g_strdup("logic-1");
-				else
-					vdev->capturefile = NULL;
-				return FALSE;
-			}
-		}
+	if (block->analog_channel != 0) {
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		/* TODO: Use proper 'digits' value for this device (and its modes). */
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+		analog.meaning->channels = g_slist_prepend(NULL,
+				g_array_index(vdev->analog_channels,
+					struct sr_channel *, block->analog_channel - 1));
+		analog.num_samples = block->length / sizeof(float);
+		analog.meaning->mq = SR_MQ_VOLTAGE;
+		analog.meaning->unit = SR_UNIT_VOLT;
+		analog.meaning->mqflags = SR_MQFLAG_DC;
+		analog.data = block->data;
+	} else {
+		if (block->length % vdev->unitsize != 0)
+			sr_warn("Read size %zu not a multiple of the"
+				" unit size %d.", block->length, vdev->unitsize);
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = block->length;
+		logic.unitsize = vdev->unitsize;
+		logic.data = block->data;
 	}
+	vdev->bytes_read += block->length;
+	sr_session_send(sdi, &packet);
+	if (packet.type == SR_DF_ANALOG)
+		g_slist_free(analog.meaning->channels);
+}
 
-	buf = g_malloc(CHUNKSIZE);
-
-	/* unitsize is not defined for purely analog session files. */
-	if (vdev->unitsize)
-		ret = zip_fread(vdev->capfile, buf,
-				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
-	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
-
-	if (ret > 0) {
-		if (vdev->cur_analog_channel != 0) {
-			got_data = TRUE;
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			/* TODO: Use proper 'digits' value for this device (and its modes). */
-			sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
-			analog.meaning->channels = g_slist_prepend(NULL,
-					g_array_index(vdev->analog_channels,
-						struct sr_channel *, vdev->cur_analog_channel - 1));
-			analog.num_samples = ret / sizeof(float);
-			analog.meaning->mq = SR_MQ_VOLTAGE;
-			analog.meaning->unit = SR_UNIT_VOLT;
-			analog.meaning->mqflags = SR_MQFLAG_DC;
-			analog.data = (float *) buf;
-		} else if (vdev->unitsize) {
-			got_data = TRUE;
-			if (ret % vdev->unitsize != 0)
-				sr_warn("Read size %d not a multiple of the"
-					" unit size %d.", ret, vdev->unitsize);
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = ret;
-			logic.unitsize = vdev->unitsize;
-			logic.data = buf;
-		} else {
-			/*
-			 * Neither analog data, nor logic which has
-			 * unitsize, must be an unexpected API use.
-			 */
-			sr_warn("Neither analog nor logic data. Ignoring.");
-		}
-		if (got_data) {
-			vdev->bytes_read += ret;
-			sr_session_send(sdi, &packet);
+static gboolean stream_session_data(struct sr_dev_inst *sdi)
+{
+	struct session_vdev *vdev;
+	struct replay_block block;
+
+	vdev = sdi->priv;
+
+	block.data = vdev->buf;
+	if (!read_session_data(vdev, &block))
+		return FALSE;
+	send_session_data(sdi, &block);
+
+	return TRUE;
+}
+
+static void replay_block_free(gpointer data)
+{
+	struct replay_block *block;
+
+	block = data;
+	g_free(block->data);
+	g_free(block);
+}
+
+/*
+ * The reader thread of the prefetch mode. Decompresses sample data
+ * into free blocks of the pool while the session thread sends the
+ * blocks which were read before. Terminates after it has queued the
+ * end marker, or when asked to quit.
+ */
+static gpointer reader_thread(gpointer data)
+{
+	struct session_vdev *vdev;
+	struct replay_block *block;
+
+	vdev = data;
+
+	while (!g_atomic_int_get(&vdev->reader_quit)) {
+		block = g_async_queue_timeout_pop(vdev->free_blocks,
+			100 * 1000);
+		if (!block)
+			continue;
+		if (!read_session_data(vdev, block)) {
+			block->length = 0;
+			g_async_queue_push(vdev->ready_blocks, block);
+			break;
 		}
-	} else {
-		/* done with this capture file */
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-		if (vdev->cur_chunk != 0) {
-			/* There might be more chunks, so don't fall through
-			 * to the SR_DF_END here. */
-			got_data = TRUE;
+		g_async_queue_push(vdev->ready_blocks, block);
+	}
+
+	return NULL;
+}
+
+static int reader_start(struct session_vdev *vdev)
+{
+	struct replay_block *block;
+	GError *error;
+	uint64_t i;
+
+	vdev->free_blocks = g_async_queue_new_full(replay_block_free);
+	vdev->ready_blocks = g_async_queue_new_full(replay_block_free);
+	for (i = 0; i <= vdev->prefetch_depth; i++) {
+		block = g_malloc0(sizeof(*block));
+		block->data = g_try_malloc(CHUNKSIZE);
+		if (!block->data) {
+			g_free(block);
+			break;
 		}
+		g_async_queue_push(vdev->free_blocks, block);
+	}
+
+	vdev->reader_quit = 0;
+	vdev->reader = NULL;
+	error = NULL;
+	if (i > 1) {
+		vdev->reader = g_thread_try_new("sr-replay",
+			reader_thread, vdev, &error);
+	}
+	if (!vdev->reader) {
+		sr_warn("Cannot prefetch session data: %s",
+			error ? error->message : "out of memory");
+		g_clear_error(&error);
+		g_async_queue_unref(vdev->free_blocks);
+		g_async_queue_unref(vdev->ready_blocks);
+		vdev->free_blocks = NULL;
+		vdev->ready_blocks = NULL;
+		return SR_ERR;
 	}
-	g_free(buf);
+	sr_dbg("Prefetching %" PRIu64 " block(s) of session data.", i - 1);
 
-	return got_data;
+	return SR_OK;
+}
+
+static void reader_stop(struct session_vdev *vdev)
+{
+	if (!vdev->reader)
+		return;
+
+	g_atomic_int_set(&vdev->reader_quit, 1);
+	g_thread_join(vdev->reader);
+	vdev->reader = NULL;
+	g_async_queue_unref(vdev->free_blocks);
+	g_async_queue_unref(vdev->ready_blocks);
+	vdev->free_blocks = NULL;
+	vdev->ready_blocks = NULL;
+}
+
+/*
+ * Send a block which the reader thread has prefetched, if available.
+ * Waits a little for the reader when it has not caught up yet, so that
+ * the (freewheeling) source does not spin while decompression is the
+ * bottleneck. The wait is short, the session thread keeps servicing its
+ * other sources and stop requests.
+ */
+static gboolean stream_prefetched_data(struct sr_dev_inst *sdi)
+{
+	struct session_vdev *vdev;
+	struct replay_block *block;
+	gboolean more;
+
+	vdev = sdi->priv;
+
+	block = g_async_queue_timeout_pop(vdev->ready_blocks, 10 * 1000);
+	if (!block)
+		return TRUE;
+	more = block->length != 0;
+	if (more)
+		send_session_data(sdi, block);
+	g_async_queue_push(vdev->free_blocks, block);
+
+	return more;
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -211,11 +530,15 @@ static int receive_data(int fd, int revents, void *cb_data)
 	sdi = cb_data;
 	vdev = sdi->priv;
 
-	if (!vdev->finished && !stream_session_data(sdi))
-		vdev->finished = TRUE;
+	if (!vdev->finished) {
+		if (vdev->reader ? !stream_prefetched_data(sdi) :
+				!stream_session_data(sdi))
+			vdev->finished = TRUE;
+	}
 	if (!vdev->finished)
 		return G_SOURCE_CONTINUE;
 
+	reader_stop(vdev);
 	if (vdev->capfile) {
 		zip_fclose(vdev->capfile);
 		vdev->capfile = NULL;
@@ -224,6 +547,16 @@ static int receive_data(int fd, int revents, void *cb_data)
 		zip_discard(vdev->archive);
 		vdev->archive = NULL;
 	}
+	if (vdev->chunks) {
+		g_array_free(vdev->chunks, TRUE);
+		vdev->chunks = NULL;
+	}
+	if (vdev->analog_channels) {
+		g_array_free(vdev->analog_channels, TRUE);
+		vdev->analog_channels = NULL;
+	}
+	g_free(vdev->buf);
+	vdev->buf = NULL;
 
 	std_session_send_df_end(sdi);
 
@@ -278,6 +611,15 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_UNITSIZE:
 		*data = g_variant_new_uint64(vdev->unitsize);
 		break;
+	case SR_CONF_CAPTURE_START:
+		*data = g_variant_new_uint64(vdev->start_sample);
+		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		*data = g_variant_new_uint64(vdev->limit_samples);
+		break;
+	case SR_CONF_PREFETCH_DEPTH:
+		*data = g_variant_new_uint64(vdev->prefetch_depth);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -289,6 +631,7 @@ static int config_set(uint32_t key, GVariant *data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
 {
 	struct session_vdev *vdev;
+	uint64_t tmp_u64;
 
 	(void)cg;
 
@@ -318,6 +661,18 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_NUM_ANALOG_CHANNELS:
 		vdev->num_analog_channels = g_variant_get_int32(data);
 		break;
+	case SR_CONF_CAPTURE_START:
+		vdev->start_sample = g_variant_get_uint64(data);
+		break;
+	case SR_CONF_LIMIT_SAMPLES:
+		vdev->limit_samples = g_variant_get_uint64(data);
+		break;
+	case SR_CONF_PREFETCH_DEPTH:
+		tmp_u64 = g_variant_get_uint64(data);
+		if (tmp_u64 > MAX_PREFETCH_DEPTH)
+			return SR_ERR_ARG;
+		vdev->prefetch_depth = tmp_u64;
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -348,8 +703,11 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		if (ch->type == SR_CHANNEL_ANALOG)
 			g_array_append_val(vdev->analog_channels, ch);
 	}
+	vdev->cur_stream = 0;
 	vdev->cur_chunk = 0;
+	vdev->capfile = NULL;
 	vdev->finished = FALSE;
+	vdev->buf = g_malloc(CHUNKSIZE);
 
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
@@ -360,6 +718,13 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
+	/*
+	 * Optionally decompress in a separate reader thread. When that
+	 * thread cannot get started, data is read in the session thread.
+	 */
+	if (vdev->prefetch_depth)
+		reader_start(vdev);
+
 	std_session_send_df_header(sdi);
 
 	/* freewheeling source */
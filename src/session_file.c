@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 #include <zip.h>
@@ -393,4 +394,504 @@ SR_API int sr_session_load(struct sr_context *ctx, const char *filename,
 	return ret;
 }
 
+/** @cond PRIVATE */
+struct sr_session_summary {
+	uint32_t kind;
+	size_t unit_size;
+	size_t record_size;
+	uint32_t fanout;
+	uint64_t block_samples;
+	uint64_t total_samples;
+	uint32_t level_count;
+	uint64_t *counts;
+	uint64_t *spans;
+	const uint8_t **levels;
+	uint8_t *data;
+};
+/** @endcond */
+
+/* Validate the summary's header, and locate the levels' records. */
+static int summary_parse(struct sr_session_summary *summary, size_t length)
+{
+	const uint8_t *rdptr;
+	uint32_t version, level;
+	uint64_t expected;
+	size_t remain;
+
+	if (length < SR_SUMMARY_HEADER_SIZE)
+		return SR_ERR_DATA;
+	rdptr = summary->data;
+	version = read_u32le_inc(&rdptr);
+	summary->kind = read_u32le_inc(&rdptr);
+	summary->unit_size = read_u32le_inc(&rdptr);
+	summary->fanout = read_u32le_inc(&rdptr);
+	summary->block_samples = read_u64le_inc(&rdptr);
+	summary->total_samples = read_u64le_inc(&rdptr);
+	summary->level_count = read_u32le_inc(&rdptr);
+	rdptr += sizeof(uint32_t); /* reserved */
+	remain = length - SR_SUMMARY_HEADER_SIZE;
+
+	if (version != SR_SUMMARY_VERSION) {
+		sr_err("Unsupported summary version %" PRIu32 ".", version);
+		return SR_ERR_DATA;
+	}
+	if (summary->kind == SR_SUMMARY_LOGIC && summary->unit_size &&
+			summary->unit_size <= 0xffff) {
+		summary->record_size = SR_SUMMARY_LOGIC_RECORD_SIZE(summary->unit_size);
+	} else if (summary->kind == SR_SUMMARY_ANALOG && !summary->unit_size) {
+		summary->record_size = SR_SUMMARY_ANALOG_RECORD_SIZE;
+	} else {
+		return SR_ERR_DATA;
+	}
+	if (summary->fanout < 2 || !summary->block_samples ||
+			!summary->total_samples || !summary->level_count ||
+			summary->level_count > 64)
+		return SR_ERR_DATA;
+	if (remain / sizeof(uint64_t) < summary->level_count)
+		return SR_ERR_DATA;
+	remain -= summary->level_count * sizeof(uint64_t);
+
+	summary->counts = g_malloc0(summary->level_count * sizeof(summary->counts[0]));
+	summary->spans = g_malloc0(summary->level_count * sizeof(summary->spans[0]));
+	summary->levels = g_malloc0(summary->level_count * sizeof(summary->levels[0]));
+	expected = (summary->total_samples - 1) / summary->block_samples + 1;
+	for (level = 0; level < summary->level_count; level++) {
+		summary->counts[level] = read_u64le_inc(&rdptr);
+		if (summary->counts[level] != expected)
+			return SR_ERR_DATA;
+		expected = (expected - 1) / summary->fanout + 1;
+	}
+	if (summary->counts[summary->level_count - 1] != 1)
+		return SR_ERR_DATA;
+
+	for (level = 0; level < summary->level_count; level++) {
+		if (remain / summary->record_size < summary->counts[level])
+			return SR_ERR_DATA;
+		summary->levels[level] = rdptr;
+		rdptr += summary->counts[level] * summary->record_size;
+		remain -= summary->counts[level] * summary->record_size;
+		if (!level)
+			summary->spans[level] = summary->block_samples;
+		else if (summary->spans[level - 1] > G_MAXUINT64 / summary->fanout)
+			summary->spans[level] = G_MAXUINT64;
+		else
+			summary->spans[level] = summary->spans[level - 1] * summary->fanout;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Load the summary of sample data from a session file.
+ *
+ * The srzip output module optionally stores a multi-resolution summary
+ * next to the sample data. It allows to get an overview of long captures,
+ * or to locate the interesting parts of the data, without inflating the
+ * sample data.
+ *
+ * @param[in] filename The name of the session file.
+ * @param[in] name The name prefix of the sample data's archive entries,
+ *   "logic-1" for logic data, or "analog-1-<index>" for an analog channel.
+ * @param[out] summary The loaded summary, to be released by the caller
+ *   with sr_session_summary_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ * @retval SR_ERR_NA The session file does not contain a summary of the data.
+ * @retval SR_ERR_DATA Malformed summary.
+ * @retval SR_ERR Other error.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_summary_load(const char *filename, const char *name,
+		struct sr_session_summary **summary)
+{
+	struct sr_session_summary *s;
+	struct zip *archive;
+	struct zip_file *zf;
+	struct zip_stat zs;
+	char *entry;
+	zip_int64_t len;
+	int ret;
+
+	if (!filename || !name || !summary)
+		return SR_ERR_ARG;
+	*summary = NULL;
+
+	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
+		return ret;
+	if (!(archive = zip_open(filename, 0, NULL)))
+		return SR_ERR;
+
+	entry = g_strdup_printf("summary-%s", name);
+	if (zip_stat(archive, entry, 0, &zs) < 0) {
+		sr_dbg("No summary '%s' in session file.", entry);
+		g_free(entry);
+		zip_discard(archive);
+		return SR_ERR_NA;
+	}
+	g_free(entry);
+
+	s = g_malloc0(sizeof(*s));
+	if (zs.size > G_MAXSIZE || !(s->data = g_try_malloc(zs.size))) {
+		sr_err("Summary buffer allocation failed.");
+		g_free(s);
+		zip_discard(archive);
+		return SR_ERR_MALLOC;
+	}
+	zf = zip_fopen_index(archive, zs.index, 0);
+	if (!zf) {
+		sr_err("Failed to open summary: %s", zip_strerror(archive));
+		sr_session_summary_free(s);
+		zip_discard(archive);
+		return SR_ERR;
+	}
+	len = zip_fread(zf, s->data, zs.size);
+	if (len < 0) {
+		sr_err("Failed to read summary: %s", zip_file_strerror(zf));
+		zip_fclose(zf);
+		sr_session_summary_free(s);
+		zip_discard(archive);
+		return SR_ERR;
+	}
+	zip_fclose(zf);
+	zip_discard(archive);
+
+	if ((ret = summary_parse(s, len)) != SR_OK) {
+		sr_err("Malformed summary in session file.");
+		sr_session_summary_free(s);
+		return ret;
+	}
+	*summary = s;
+
+	return SR_OK;
+}
+
+/**
+ * Release a summary which was loaded from a session file.
+ *
+ * @param[in] summary The summary, can be NULL.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_session_summary_free(struct sr_session_summary *summary)
+{
+	if (!summary)
+		return;
+
+	g_free(summary->counts);
+	g_free(summary->spans);
+	g_free(summary->levels);
+	g_free(summary->data);
+	g_free(summary);
+}
+
+/**
+ * Get properties of a summary.
+ *
+ * @param[in] summary The summary.
+ * @param[out] total_samples The number of samples in the data, can be NULL.
+ * @param[out] block_samples The number of samples per block (the
+ *   summary's finest resolution), can be NULL.
+ * @param[out] unitsize The logic data's unit size, zero for analog data,
+ *   can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_summary_info_get(const struct sr_session_summary *summary,
+		uint64_t *total_samples, uint64_t *block_samples, size_t *unitsize)
+{
+	if (!summary)
+		return SR_ERR_ARG;
+
+	if (total_samples)
+		*total_samples = summary->total_samples;
+	if (block_samples)
+		*block_samples = summary->block_samples;
+	if (unitsize)
+		*unitsize = summary->unit_size;
+
+	return SR_OK;
+}
+
+typedef void (*summary_visit_cb)(const struct sr_session_summary *summary,
+		uint32_t level, uint64_t idx, void *cb_data);
+
+/*
+ * Visit the fewest records which cover the blocks which overlap the
+ * requested range of samples. Returns FALSE for empty ranges.
+ */
+static gboolean summary_walk(const struct sr_session_summary *summary,
+		uint64_t start, uint64_t count, summary_visit_cb visit,
+		void *cb_data)
+{
+	uint64_t first, last, end;
+	uint32_t level;
+
+	if (!count || start >= summary->total_samples)
+		return FALSE;
+	last = MIN(count - 1, summary->total_samples - 1 - start) + start;
+	first = start / summary->block_samples;
+	end = last / summary->block_samples + 1;
+
+	for (level = 0; first < end; level++) {
+		if (level == summary->level_count - 1) {
+			while (first < end)
+				visit(summary, level, first++, cb_data);
+			break;
+		}
+		while (first < end && first % summary->fanout)
+			visit(summary, level, first++, cb_data);
+		while (first < end && end % summary->fanout)
+			visit(summary, level, --end, cb_data);
+		first /= summary->fanout;
+		end /= summary->fanout;
+	}
+
+	return TRUE;
+}
+
+static const uint8_t *summary_record(const struct sr_session_summary *summary,
+		uint32_t level, uint64_t idx)
+{
+	return &summary->levels[level][idx * summary->record_size];
+}
+
+struct summary_logic_acc {
+	uint64_t transitions;
+	uint8_t *or_mask;
+	uint8_t *and_mask;
+};
+
+static void summary_logic_visit(const struct sr_session_summary *summary,
+		uint32_t level, uint64_t idx, void *cb_data)
+{
+	struct summary_logic_acc *acc;
+	const uint8_t *rdptr;
+	size_t i;
+
+	acc = cb_data;
+	rdptr = summary_record(summary, level, idx);
+	acc->transitions += read_u64le_inc(&rdptr);
+	for (i = 0; i < summary->unit_size; i++) {
+		acc->or_mask[i] |= rdptr[i];
+		acc->and_mask[i] &= rdptr[summary->unit_size + i];
+	}
+}
+
+/**
+ * Query the summary of logic data for a range of samples.
+ *
+ * The result covers all blocks which overlap the range, and thus can
+ * include samples outside of the range. A channel which is set in the
+ * OR mask but not in the AND mask toggles within these blocks.
+ *
+ * @param[in] summary The summary.
+ * @param[in] start The first sample of the range.
+ * @param[in] count The number of samples in the range.
+ * @param[out] transitions The number of samples which differ from their
+ *   predecessor, can be NULL.
+ * @param[out] or_mask OR of all samples, unit size bytes, can be NULL.
+ * @param[out] and_mask AND of all samples, unit size bytes, can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments, or not a summary of logic data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_summary_logic(const struct sr_session_summary *summary,
+		uint64_t start, uint64_t count, uint64_t *transitions,
+		uint8_t *or_mask, uint8_t *and_mask)
+{
+	struct summary_logic_acc acc;
+
+	if (!summary || summary->kind != SR_SUMMARY_LOGIC)
+		return SR_ERR_ARG;
+
+	acc.transitions = 0;
+	acc.or_mask = g_malloc0(summary->unit_size);
+	acc.and_mask = g_malloc(summary->unit_size);
+	memset(acc.and_mask, 0xff, summary->unit_size);
+	if (!summary_walk(summary, start, count, summary_logic_visit, &acc)) {
+		g_free(acc.or_mask);
+		g_free(acc.and_mask);
+		return SR_ERR_ARG;
+	}
+
+	if (transitions)
+		*transitions = acc.transitions;
+	if (or_mask)
+		memcpy(or_mask, acc.or_mask, summary->unit_size);
+	if (and_mask)
+		memcpy(and_mask, acc.and_mask, summary->unit_size);
+	g_free(acc.or_mask);
+	g_free(acc.and_mask);
+
+	return SR_OK;
+}
+
+struct summary_analog_acc {
+	float min;
+	float max;
+	double weighted;
+	uint64_t samples;
+};
+
+static void summary_analog_visit(const struct sr_session_summary *summary,
+		uint32_t level, uint64_t idx, void *cb_data)
+{
+	struct summary_analog_acc *acc;
+	const uint8_t *rdptr;
+	uint64_t first, samples;
+	float v;
+
+	acc = cb_data;
+	rdptr = summary_record(summary, level, idx);
+	first = idx * summary->spans[level];
+	samples = MIN(summary->spans[level], summary->total_samples - first);
+
+	v = read_fltle_inc(&rdptr);
+	if (v < acc->min)
+		acc->min = v;
+	v = read_fltle_inc(&rdptr);
+	if (v > acc->max)
+		acc->max = v;
+	acc->weighted += read_fltle_inc(&rdptr) * (double)samples;
+	acc->samples += samples;
+}
+
+/**
+ * Query the summary of an analog channel for a range of samples.
+ *
+ * The result covers all blocks which overlap the range, and thus can
+ * include samples outside of the range.
+ *
+ * @param[in] summary The summary.
+ * @param[in] start The first sample of the range.
+ * @param[in] count The number of samples in the range.
+ * @param[out] min The minimum value, can be NULL.
+ * @param[out] max The maximum value, can be NULL.
+ * @param[out] mean The mean value, can be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid arguments, or not a summary of analog data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_summary_analog(const struct sr_session_summary *summary,
+		uint64_t start, uint64_t count, float *min, float *max, float *mean)
+{
+	struct summary_analog_acc acc;
+
+	if (!summary || summary->kind != SR_SUMMARY_ANALOG)
+		return SR_ERR_ARG;
+
+	acc.min = INFINITY;
+	acc.max = -INFINITY;
+	acc.weighted = 0;
+	acc.samples = 0;
+	if (!summary_walk(summary, start, count, summary_analog_visit, &acc))
+		return SR_ERR_ARG;
+
+	if (min)
+		*min = acc.min;
+	if (max)
+		*max = acc.max;
+	if (mean)
+		*mean = acc.weighted / acc.samples;
+
+	return SR_OK;
+}
+
+/* Get a channel's OR and AND bits of a logic summary record. */
+static void summary_channel_bits(const struct sr_session_summary *summary,
+		uint32_t level, uint64_t idx, unsigned int channel,
+		gboolean *or_bit, gboolean *and_bit)
+{
+	const uint8_t *rdptr;
+	size_t pos;
+	uint8_t mask;
+
+	rdptr = summary_record(summary, level, idx) + sizeof(uint64_t);
+	pos = channel / 8;
+	mask = 1 << (channel % 8);
+	*or_bit = (rdptr[pos] & mask) != 0;
+	*and_bit = (rdptr[summary->unit_size + pos] & mask) != 0;
+}
+
+/**
+ * Find the next edge of a logic channel.
+ *
+ * Locates the first block at or after the block which contains the
+ * start position, in which the channel toggles, or where it differs
+ * from the preceding blocks' level. Callers inspect the sample data
+ * of this block to find the exact position of the edge. Runs of blocks
+ * without changes are skipped at the coarsest resolution which the
+ * summary provides, and don't require access to their sample data.
+ *
+ * @param[in] summary The summary.
+ * @param[in] channel The 0-based index of the logic channel.
+ * @param[in] from The sample position to start searching from.
+ * @param[out] block_start The first sample of the block with the edge.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_NA The channel does not change after the start position.
+ * @retval SR_ERR_ARG Invalid arguments, or not a summary of logic data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_summary_find_edge(const struct sr_session_summary *summary,
+		unsigned int channel, uint64_t from, uint64_t *block_start)
+{
+	uint64_t idx;
+	uint32_t level;
+	gboolean or_bit, and_bit, value;
+
+	if (!summary || summary->kind != SR_SUMMARY_LOGIC || !block_start)
+		return SR_ERR_ARG;
+	if (channel >= summary->unit_size * 8)
+		return SR_ERR_ARG;
+	if (from >= summary->total_samples)
+		return SR_ERR_NA;
+
+	/* A change within the start block is reported immediately. */
+	idx = from / summary->block_samples;
+	summary_channel_bits(summary, 0, idx, channel, &or_bit, &and_bit);
+	if (or_bit != and_bit) {
+		*block_start = idx * summary->block_samples;
+		return SR_OK;
+	}
+	value = or_bit;
+
+	/*
+	 * Skip constant records at the highest level which is aligned to
+	 * the current position, descend into records which have changes.
+	 */
+	level = 0;
+	idx++;
+	while (TRUE) {
+		while (level + 1 < summary->level_count && !(idx % summary->fanout)) {
+			idx /= summary->fanout;
+			level++;
+		}
+		if (idx >= summary->counts[level])
+			return SR_ERR_NA;
+		summary_channel_bits(summary, level, idx, channel, &or_bit, &and_bit);
+		while (or_bit != and_bit || or_bit != value) {
+			if (!level) {
+				*block_start = idx * summary->block_samples;
+				return SR_OK;
+			}
+			level--;
+			idx *= summary->fanout;
+			summary_channel_bits(summary, level, idx, channel,
+				&or_bit, &and_bit);
+		}
+		idx++;
+	}
+}
+
 /** @} */
@@ -18,7 +18,11 @@
  */
 
 #include <config.h>
+#include <math.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -41,11 +45,117 @@ SR_PRIV int logic_channel_unitsize(GSList *channels)
 	return (number + 7) / 8;
 }
 
+/*
+ * A trigger stage, precompiled into per-byte masks. A sample matches the
+ * stage when all of these conditions hold (bit positions as in samples):
+ * - (sample ^ value) & value_mask == 0 (levels, and an edge's new state)
+ * - (prev ^ prev_value) & prev_mask == 0 (an edge's previous state)
+ * - ~(prev ^ sample) & edge_mask == 0 (any edge)
+ */
+struct soft_trigger_logic_stage {
+	gboolean has_matches;
+	gboolean uses_prev;
+	gboolean never;
+	uint8_t *value;
+	uint8_t *value_mask;
+	uint8_t *prev_value;
+	uint8_t *prev_mask;
+	uint8_t *edge_mask;
+#ifdef __SSE2__
+	/* The masks, replicated to fill a vector register. */
+	uint8_t vec[5][16];
+#endif
+};
+
+/* Expect a bit's state, detect contradicting matches on the same bit. */
+static void stage_expect(struct soft_trigger_logic_stage *cs,
+		uint8_t *value, uint8_t *mask, int idx, uint8_t bit, uint8_t state)
+{
+	if ((mask[idx] & bit) && (value[idx] & bit) != state)
+		cs->never = TRUE;
+	mask[idx] |= bit;
+	value[idx] = (value[idx] & ~bit) | state;
+}
+
+static int stage_compile(struct soft_trigger_logic *stl,
+		struct soft_trigger_logic_stage *cs,
+		const struct sr_trigger_stage *stage)
+{
+	const struct sr_trigger_match *match;
+	const GSList *l;
+	int idx;
+	uint8_t bit;
+
+	cs->value = g_malloc0(5 * stl->unitsize);
+	cs->value_mask = cs->value + stl->unitsize;
+	cs->prev_value = cs->value_mask + stl->unitsize;
+	cs->prev_mask = cs->prev_value + stl->unitsize;
+	cs->edge_mask = cs->prev_mask + stl->unitsize;
+	cs->has_matches = stage->matches != NULL;
+
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			/* Ignore disabled channels with a trigger. */
+			continue;
+		idx = match->channel->index / 8;
+		if (idx >= stl->unitsize) {
+			sr_warn("Ignoring trigger on channel %s.",
+				match->channel->name);
+			continue;
+		}
+		bit = 1 << (match->channel->index % 8);
+		switch (match->match) {
+		case SR_TRIGGER_ZERO:
+			stage_expect(cs, cs->value, cs->value_mask, idx, bit, 0);
+			break;
+		case SR_TRIGGER_ONE:
+			stage_expect(cs, cs->value, cs->value_mask, idx, bit, bit);
+			break;
+		case SR_TRIGGER_RISING:
+			stage_expect(cs, cs->value, cs->value_mask, idx, bit, bit);
+			stage_expect(cs, cs->prev_value, cs->prev_mask, idx, bit, 0);
+			break;
+		case SR_TRIGGER_FALLING:
+			stage_expect(cs, cs->value, cs->value_mask, idx, bit, 0);
+			stage_expect(cs, cs->prev_value, cs->prev_mask, idx, bit, bit);
+			break;
+		case SR_TRIGGER_EDGE:
+			cs->edge_mask[idx] |= bit;
+			break;
+		default:
+			sr_err("Unsupported trigger match %d.", match->match);
+			return SR_ERR_ARG;
+		}
+	}
+
+	for (idx = 0; idx < stl->unitsize; idx++) {
+		if (cs->prev_mask[idx] || cs->edge_mask[idx])
+			cs->uses_prev = TRUE;
+	}
+
+#ifdef __SSE2__
+	if (16 % stl->unitsize == 0) {
+		for (idx = 0; idx < 16; idx++) {
+			cs->vec[0][idx] = cs->value[idx % stl->unitsize];
+			cs->vec[1][idx] = cs->value_mask[idx % stl->unitsize];
+			cs->vec[2][idx] = cs->prev_value[idx % stl->unitsize];
+			cs->vec[3][idx] = cs->prev_mask[idx % stl->unitsize];
+			cs->vec[4][idx] = cs->edge_mask[idx % stl->unitsize];
+		}
+	}
+#endif
+
+	return SR_OK;
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
 {
 	struct soft_trigger_logic *stl;
+	GSList *l;
+	int i;
 
 	stl = g_malloc0(sizeof(struct soft_trigger_logic));
 	stl->sdi = sdi;
@@ -70,11 +180,26 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		return NULL;
 	}
 
+	/* Translate the trigger's stages and matches into masks once. */
+	stl->num_stages = g_slist_length(trigger->stages);
+	stl->stages = g_malloc0(stl->num_stages * sizeof(stl->stages[0]));
+	for (l = trigger->stages, i = 0; l; l = l->next, i++) {
+		if (stage_compile(stl, &stl->stages[i], l->data) != SR_OK) {
+			soft_trigger_logic_free(stl);
+			return NULL;
+		}
+	}
+
 	return stl;
 }
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
+	int i;
+
+	for (i = 0; i < stl->num_stages; i++)
+		g_free(stl->stages[i].value);
+	g_free(stl->stages);
 	g_free(stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
 	g_free(stl);
@@ -138,36 +263,99 @@ static void pre_trigger_send(struct soft_trigger_logic *stl,
 	}
 }
 
-static gboolean logic_check_match(struct soft_trigger_logic *stl,
-		uint8_t *sample, struct sr_trigger_match *match)
+static gboolean stage_match(const struct soft_trigger_logic_stage *cs,
+		int unitsize, const uint8_t *sample, const uint8_t *prev)
 {
-	int bit, prev_bit;
-	gboolean result;
+	int i;
 
-	stl->count++;
-	result = FALSE;
-	bit = *(sample + match->channel->index / 8)
-			& (1 << (match->channel->index % 8));
-	if (match->match == SR_TRIGGER_ZERO)
-		result = bit == 0;
-	else if (match->match == SR_TRIGGER_ONE)
-		result = bit != 0;
-	else {
-		/* Edge matches. */
-		if (stl->count == 1)
-			/* First sample, don't have enough for an edge match yet. */
+	if (cs->never)
+		return FALSE;
+	for (i = 0; i < unitsize; i++) {
+		if ((sample[i] ^ cs->value[i]) & cs->value_mask[i])
 			return FALSE;
-		prev_bit = *(stl->prev_sample + match->channel->index / 8)
-				& (1 << (match->channel->index % 8));
-		if (match->match == SR_TRIGGER_RISING)
-			result = prev_bit == 0 && bit != 0;
-		else if (match->match == SR_TRIGGER_FALLING)
-			result = prev_bit != 0 && bit == 0;
-		else if (match->match == SR_TRIGGER_EDGE)
-			result = prev_bit != bit;
+	}
+	if (!cs->uses_prev)
+		return TRUE;
+	if (!prev)
+		/* First sample, don't have enough for an edge match yet. */
+		return FALSE;
+	for (i = 0; i < unitsize; i++) {
+		if ((prev[i] ^ cs->prev_value[i]) & cs->prev_mask[i])
+			return FALSE;
+		if (~(prev[i] ^ sample[i]) & cs->edge_mask[i])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Find the first sample in buf[start..count) which matches the stage.
+ * The sample before 'start' is taken from the previous sample buffer,
+ * all later samples check against their predecessor in buf. Returns
+ * 'count' when no sample matched.
+ */
+static int stage_scan(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_logic_stage *cs,
+		const uint8_t *buf, int start, int count)
+{
+	int unitsize, i;
+#ifdef __SSE2__
+	__m128i value, value_mask, prev_value, prev_mask, edge_mask;
+	__m128i cur, prev, miss, zero, hit;
+	int step, bits;
+#endif
+
+	unitsize = stl->unitsize;
+	if (start >= count || cs->never)
+		return count;
+	if (stage_match(cs, unitsize, buf + start * unitsize,
+			stl->have_prev ? stl->prev_sample : NULL))
+		return start;
+	i = start + 1;
+
+#ifdef __SSE2__
+	/*
+	 * Check a vector of samples at a time, against the vector of
+	 * their predecessors (which starts one sample earlier). Lanes
+	 * without mismatching bits are matching samples.
+	 */
+	if (unitsize == 1 || unitsize == 2 || unitsize == 4) {
+		value = _mm_loadu_si128((const __m128i *)cs->vec[0]);
+		value_mask = _mm_loadu_si128((const __m128i *)cs->vec[1]);
+		prev_value = _mm_loadu_si128((const __m128i *)cs->vec[2]);
+		prev_mask = _mm_loadu_si128((const __m128i *)cs->vec[3]);
+		edge_mask = _mm_loadu_si128((const __m128i *)cs->vec[4]);
+		zero = _mm_setzero_si128();
+		step = 16 / unitsize;
+		for (; i + step <= count; i += step) {
+			cur = _mm_loadu_si128((const __m128i *)(buf + i * unitsize));
+			prev = _mm_loadu_si128((const __m128i *)(buf + (i - 1) * unitsize));
+			miss = _mm_and_si128(_mm_xor_si128(cur, value), value_mask);
+			miss = _mm_or_si128(miss, _mm_and_si128(
+				_mm_xor_si128(prev, prev_value), prev_mask));
+			miss = _mm_or_si128(miss, _mm_andnot_si128(
+				_mm_xor_si128(prev, cur), edge_mask));
+			if (unitsize == 1)
+				hit = _mm_cmpeq_epi8(miss, zero);
+			else if (unitsize == 2)
+				hit = _mm_cmpeq_epi16(miss, zero);
+			else
+				hit = _mm_cmpeq_epi32(miss, zero);
+			bits = _mm_movemask_epi8(hit);
+			if (bits)
+				return i + g_bit_nth_lsf(bits, -1) / unitsize;
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		if (stage_match(cs, unitsize, buf + i * unitsize,
+				buf + (i - 1) * unitsize))
+			return i;
 	}
 
-	return result;
+	return count;
 }
 
 /* Returns the offset (in samples) within buf of where the trigger
@@ -175,65 +363,74 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len, int *pre_trigger_samples)
 {
-	struct sr_trigger_stage *stage;
-	struct sr_trigger_match *match;
-	GSList *l, *l_stage;
+	const struct soft_trigger_logic_stage *cs;
 	int offset;
-	int i;
+	int i, count;
 	gboolean match_found;
 
+	if (!stl->num_stages)
+		return SR_ERR_ARG;
+
 	offset = -1;
-	for (i = 0; i < len; i += stl->unitsize) {
-		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
-		stage = l_stage->data;
-		if (!stage->matches)
+	count = len / stl->unitsize;
+	i = 0;
+	while (i < count) {
+		cs = &stl->stages[stl->cur_stage];
+		if (!cs->has_matches)
 			/* No matches supplied, client error. */
 			return SR_ERR_ARG;
 
-		match_found = TRUE;
-		for (l = stage->matches; l; l = l->next) {
-			match = l->data;
-			if (!match->channel->enabled)
-				/* Ignore disabled channels with a trigger. */
-				continue;
-			if (!logic_check_match(stl, buf + i, match)) {
-				match_found = FALSE;
+		if (stl->cur_stage == 0) {
+			/* Skip over all samples which cannot start a match. */
+			i = stage_scan(stl, cs, buf, i, count);
+			if (i == count) {
+				memcpy(stl->prev_sample,
+					buf + (count - 1) * stl->unitsize,
+					stl->unitsize);
+				stl->have_prev = TRUE;
 				break;
 			}
+			match_found = TRUE;
+		} else {
+			match_found = stage_match(cs, stl->unitsize,
+				buf + i * stl->unitsize,
+				stl->have_prev ? stl->prev_sample : NULL);
 		}
-		memcpy(stl->prev_sample, buf + i, stl->unitsize);
+		memcpy(stl->prev_sample, buf + i * stl->unitsize, stl->unitsize);
+		stl->have_prev = TRUE;
+
 		if (match_found) {
 			/* Matched on the current stage. */
-			if (l_stage->next) {
+			if (stl->cur_stage + 1 < stl->num_stages) {
 				/* Advance to next stage. */
 				stl->cur_stage++;
 			} else {
 				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
+				pre_trigger_append(stl, buf, i * stl->unitsize);
 				pre_trigger_send(stl, pre_trigger_samples);
 
 				/* Fire trigger. */
-				offset = i / stl->unitsize;
+				offset = i;
 
 				std_session_send_df_trigger(stl->sdi);
 				break;
 			}
-		} else if (stl->cur_stage > 0) {
+		} else {
 			/*
 			 * We had a match at an earlier stage, but failed on the
 			 * current stage. However, we may have a match on this
 			 * stage in the next bit -- trigger on 0001 will fail on
 			 * seeing 00001, so we need to go back to stage 0 -- but
 			 * at the next sample from the one that matched originally,
-			 * which the counter increment at the end of the loop
-			 * takes care of.
+			 * which the counter increment below takes care of.
 			 */
-			i -= stl->cur_stage * stl->unitsize;
+			i -= stl->cur_stage;
 			if (i < -1)
 				i = -1; /* Oops, went back past this buffer. */
 			/* Reset trigger stage. */
 			stl->cur_stage = 0;
 		}
+		i++;
 	}
 
 	if (offset == -1)
@@ -241,3 +438,379 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 
 	return offset;
 }
+
+/*
+ * A trigger stage for an analog channel. All matches of a stage must
+ * hold at the same time, which translates to these conditions:
+ * - value > over, value < under (levels, both for a window)
+ * - prev < rise_prev, value >= rise_value (rising across a level)
+ * - prev > fall_prev, value <= fall_value (falling across a level)
+ * - optionally crossing the edge level in either direction
+ * Unused conditions hold infinite limits, and are always true.
+ */
+struct soft_trigger_analog_stage {
+	float over;
+	float under;
+	float rise_prev;
+	float rise_value;
+	float fall_prev;
+	float fall_value;
+	gboolean uses_prev;
+	gboolean has_edge;
+	float edge;
+};
+
+static int analog_stage_compile(struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_stage *cs,
+		const struct sr_trigger_stage *stage)
+{
+	const struct sr_trigger_match *match;
+	const GSList *l;
+
+	cs->over = -INFINITY;
+	cs->under = INFINITY;
+	cs->rise_prev = INFINITY;
+	cs->rise_value = -INFINITY;
+	cs->fall_prev = -INFINITY;
+	cs->fall_value = INFINITY;
+
+	if (!stage->matches) {
+		sr_err("Trigger stage %d has no matches.", stage->stage);
+		return SR_ERR_ARG;
+	}
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (match->channel != sta->channel) {
+			sr_err("Analog soft trigger supports one channel only.");
+			return SR_ERR_ARG;
+		}
+		switch (match->match) {
+		case SR_TRIGGER_OVER:
+			cs->over = MAX(cs->over, match->value);
+			break;
+		case SR_TRIGGER_UNDER:
+			cs->under = MIN(cs->under, match->value);
+			break;
+		case SR_TRIGGER_RISING:
+			cs->rise_prev = MIN(cs->rise_prev, match->value);
+			cs->rise_value = MAX(cs->rise_value, match->value);
+			cs->uses_prev = TRUE;
+			break;
+		case SR_TRIGGER_FALLING:
+			cs->fall_prev = MAX(cs->fall_prev, match->value);
+			cs->fall_value = MIN(cs->fall_value, match->value);
+			cs->uses_prev = TRUE;
+			break;
+		case SR_TRIGGER_EDGE:
+			if (cs->has_edge && cs->edge != match->value) {
+				sr_err("Multiple edge levels in one stage.");
+				return SR_ERR_ARG;
+			}
+			cs->edge = match->value;
+			cs->has_edge = TRUE;
+			cs->uses_prev = TRUE;
+			break;
+		default:
+			sr_err("Unsupported analog trigger match %d.",
+				match->match);
+			return SR_ERR_ARG;
+		}
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Create a software trigger for an analog channel.
+ *
+ * @param sdi The device instance which sends the data.
+ * @param trigger The trigger, all matches must be on one analog channel.
+ * @param pre_trigger_samples The number of samples to keep and send
+ *   before the trigger position.
+ * @param queue The feed queue which receives pre-trigger samples.
+ *
+ * @returns The trigger instance, or NULL on error.
+ *
+ * Levels (SR_TRIGGER_OVER, SR_TRIGGER_UNDER) of one stage combine to a
+ * window. SR_TRIGGER_RISING, SR_TRIGGER_FALLING and SR_TRIGGER_EDGE
+ * match when the signal crosses the match's value. The channel which
+ * the trigger checks is available in the instance's 'channel' field.
+ *
+ * @private
+ */
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, struct feed_queue_analog *queue)
+{
+	struct soft_trigger_analog *sta;
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	GSList *l;
+	int i;
+
+	if (!trigger || !trigger->stages)
+		return NULL;
+	stage = trigger->stages->data;
+	if (!stage->matches)
+		return NULL;
+	match = stage->matches->data;
+	if (match->channel->type != SR_CHANNEL_ANALOG) {
+		sr_err("Analog soft trigger needs an analog channel.");
+		return NULL;
+	}
+	if (pre_trigger_samples > 0 && !queue)
+		return NULL;
+
+	sta = g_malloc0(sizeof(*sta));
+	sta->sdi = sdi;
+	sta->channel = match->channel;
+	sta->queue = queue;
+	if (pre_trigger_samples > 0) {
+		sta->pre_trigger_size = pre_trigger_samples;
+		sta->pre_trigger_buffer = g_try_malloc(
+			pre_trigger_samples * sizeof(float));
+		if (!sta->pre_trigger_buffer) {
+			soft_trigger_analog_free(sta);
+			return NULL;
+		}
+	}
+
+	sta->num_stages = g_slist_length(trigger->stages);
+	sta->stages = g_malloc0(sta->num_stages * sizeof(sta->stages[0]));
+	for (l = trigger->stages, i = 0; l; l = l->next, i++) {
+		if (analog_stage_compile(sta, &sta->stages[i], l->data) != SR_OK) {
+			soft_trigger_analog_free(sta);
+			return NULL;
+		}
+	}
+
+	return sta;
+}
+
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta)
+{
+	if (!sta)
+		return;
+
+	g_free(sta->stages);
+	g_free(sta->pre_trigger_buffer);
+	g_free(sta);
+}
+
+static void analog_pre_trigger_append(struct soft_trigger_analog *sta,
+		const float *values, int count)
+{
+	int size;
+
+	/* Avoid uselessly copying more than the pre-trigger size. */
+	if (count > sta->pre_trigger_size) {
+		values += count - sta->pre_trigger_size;
+		count = sta->pre_trigger_size;
+	}
+
+	sta->pre_trigger_fill = MIN(sta->pre_trigger_fill + count,
+	                            sta->pre_trigger_size);
+
+	while (count > 0) {
+		size = MIN(sta->pre_trigger_size - sta->pre_trigger_head, count);
+		memcpy(&sta->pre_trigger_buffer[sta->pre_trigger_head],
+			values, size * sizeof(float));
+		sta->pre_trigger_head += size;
+		if (sta->pre_trigger_head == sta->pre_trigger_size)
+			sta->pre_trigger_head = 0;
+		values += size;
+		count -= size;
+	}
+}
+
+static int analog_pre_trigger_send(struct soft_trigger_analog *sta,
+		int *pre_trigger_samples)
+{
+	int idx, size, ret;
+
+	if (pre_trigger_samples)
+		*pre_trigger_samples = sta->pre_trigger_fill;
+
+	/* The oldest sample is at the head when the ring is full. */
+	idx = sta->pre_trigger_head - sta->pre_trigger_fill;
+	if (idx < 0)
+		idx += sta->pre_trigger_size;
+	while (sta->pre_trigger_fill > 0) {
+		size = MIN(sta->pre_trigger_size - idx, sta->pre_trigger_fill);
+		ret = feed_queue_analog_submit_many(sta->queue,
+			&sta->pre_trigger_buffer[idx], size, 1);
+		if (ret != SR_OK)
+			return ret;
+		idx = 0;
+		sta->pre_trigger_fill -= size;
+	}
+	sta->pre_trigger_head = 0;
+
+	return sta->queue ? feed_queue_analog_flush(sta->queue) : SR_OK;
+}
+
+static gboolean analog_stage_match(const struct soft_trigger_analog_stage *cs,
+		float value, const float *prev)
+{
+	if (!(value > cs->over && value < cs->under))
+		return FALSE;
+	if (!cs->uses_prev)
+		return TRUE;
+	if (!prev)
+		/* First sample, don't have enough for a slope yet. */
+		return FALSE;
+	if (!(*prev < cs->rise_prev && value >= cs->rise_value))
+		return FALSE;
+	if (!(*prev > cs->fall_prev && value <= cs->fall_value))
+		return FALSE;
+	if (cs->has_edge && !((*prev < cs->edge && value >= cs->edge) ||
+			(*prev > cs->edge && value <= cs->edge)))
+		return FALSE;
+
+	return TRUE;
+}
+
+/* The value which precedes values[i], possibly from an earlier call. */
+static const float *analog_prev(const struct soft_trigger_analog *sta,
+		const float *values, int i)
+{
+	if (i > 0)
+		return &values[i - 1];
+
+	return sta->have_prev ? &sta->prev_value : NULL;
+}
+
+/* Find the first value in values[start..count) which matches the stage. */
+static int analog_stage_scan(const struct soft_trigger_analog *sta,
+		const struct soft_trigger_analog_stage *cs,
+		const float *values, int start, int count)
+{
+	int i;
+#ifdef __SSE2__
+	__m128 over, under, rise_prev, rise_value, fall_prev, fall_value;
+	__m128 edge, cur, prev, hit, up, down;
+	int bits;
+#endif
+
+	if (start >= count)
+		return count;
+	if (analog_stage_match(cs, values[start],
+			analog_prev(sta, values, start)))
+		return start;
+	i = start + 1;
+
+#ifdef __SSE2__
+	/* Check four values at a time, against their predecessors. */
+	over = _mm_set1_ps(cs->over);
+	under = _mm_set1_ps(cs->under);
+	rise_prev = _mm_set1_ps(cs->rise_prev);
+	rise_value = _mm_set1_ps(cs->rise_value);
+	fall_prev = _mm_set1_ps(cs->fall_prev);
+	fall_value = _mm_set1_ps(cs->fall_value);
+	edge = _mm_set1_ps(cs->edge);
+	for (; i + 4 <= count; i += 4) {
+		cur = _mm_loadu_ps(&values[i]);
+		prev = _mm_loadu_ps(&values[i - 1]);
+		hit = _mm_and_ps(_mm_cmpgt_ps(cur, over),
+			_mm_cmplt_ps(cur, under));
+		if (cs->uses_prev) {
+			hit = _mm_and_ps(hit, _mm_and_ps(
+				_mm_cmplt_ps(prev, rise_prev),
+				_mm_cmpge_ps(cur, rise_value)));
+			hit = _mm_and_ps(hit, _mm_and_ps(
+				_mm_cmpgt_ps(prev, fall_prev),
+				_mm_cmple_ps(cur, fall_value)));
+		}
+		if (cs->has_edge) {
+			up = _mm_and_ps(_mm_cmplt_ps(prev, edge),
+				_mm_cmpge_ps(cur, edge));
+			down = _mm_and_ps(_mm_cmpgt_ps(prev, edge),
+				_mm_cmple_ps(cur, edge));
+			hit = _mm_and_ps(hit, _mm_or_ps(up, down));
+		}
+		bits = _mm_movemask_ps(hit);
+		if (bits)
+			return i + g_bit_nth_lsf(bits, -1);
+	}
+#endif
+
+	for (; i < count; i++) {
+		if (analog_stage_match(cs, values[i], &values[i - 1]))
+			return i;
+	}
+
+	return count;
+}
+
+/**
+ * Check analog values for the trigger condition.
+ *
+ * @param sta The trigger instance.
+ * @param values The channel's values.
+ * @param count The number of values.
+ * @param pre_trigger_samples Receives the number of pre-trigger samples
+ *   which were sent when the trigger fired. Can be NULL.
+ *
+ * @returns The offset (in samples) within values where the trigger
+ *   occurred, -1 if not triggered, or a negative SR_ERR code.
+ *
+ * When the trigger fires, the pre-trigger samples were submitted to
+ * the feed queue and the queue was flushed, and SR_DF_TRIGGER was sent.
+ * The caller continues by submitting values from the returned offset.
+ *
+ * @private
+ */
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const float *values, int count, int *pre_trigger_samples)
+{
+	const struct soft_trigger_analog_stage *cs;
+	gboolean match_found;
+	int i, ret;
+
+	i = 0;
+	while (i < count) {
+		cs = &sta->stages[sta->cur_stage];
+		if (sta->cur_stage == 0) {
+			/* Skip over all values which cannot start a match. */
+			i = analog_stage_scan(sta, cs, values, i, count);
+			if (i == count)
+				break;
+			match_found = TRUE;
+		} else {
+			match_found = analog_stage_match(cs, values[i],
+				analog_prev(sta, values, i));
+		}
+
+		if (!match_found) {
+			/* Resume after where the earlier stage matched. */
+			i -= sta->cur_stage;
+			if (i < -1)
+				i = -1;
+			sta->cur_stage = 0;
+		} else if (sta->cur_stage + 1 < sta->num_stages) {
+			sta->cur_stage++;
+		} else {
+			/* Matched on last stage, send pre-trigger data. */
+			sta->prev_value = values[i];
+			sta->have_prev = TRUE;
+			analog_pre_trigger_append(sta, values, i);
+			ret = analog_pre_trigger_send(sta, pre_trigger_samples);
+			if (ret != SR_OK)
+				return ret;
+			ret = std_session_send_df_trigger(sta->sdi);
+			if (ret != SR_OK)
+				return ret;
+			sta->cur_stage = 0;
+			return i;
+		}
+		i++;
+	}
+
+	if (count > 0) {
+		sta->prev_value = values[count - 1];
+		sta->have_prev = TRUE;
+	}
+	analog_pre_trigger_append(sta, values, count);
+
+	return -1;
+}
@@ -0,0 +1,505 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bulk IN streaming for USB logic analyzers. A stream owns a ring of
+ * transfers with pre-allocated buffers, all of which are kept in flight.
+ * Completed buffers get passed to the driver's data callback, and get
+ * resubmitted right after that, without re-allocation. Transfer sizes
+ * and the ring depth are derived from the data rate, unless the driver
+ * has specific requirements.
+ *
+ * Empty or failed transfers are tolerated up to a limit, after which
+ * the stream terminates. So does it when the device disappears, or
+ * when the data callback asks for it. Termination is reported to the
+ * driver's done callback after all transfers have returned. This is
+ * done from the USB event source, not from within libusb callbacks,
+ * such that drivers can communicate with the device there. Drivers
+ * which need to do periodic work of their own keep their event source,
+ * and have it call sr_usb_stream_poll().
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libusb.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "usb-stream"
+
+/* A transfer should hold about 10ms of data, the ring about 500ms. */
+#define STREAM_BUFFER_MS	10
+#define STREAM_RING_MS		500
+#define STREAM_GRANULARITY	512
+#define STREAM_MIN_TRANSFERS	2
+#define STREAM_MAX_TRANSFERS	32
+/* Event source interval when transfers don't time out. */
+#define STREAM_POLL_MS		1000
+
+struct stream_slot {
+	struct sr_usb_stream *stream;
+	struct libusb_transfer *transfer;
+	int64_t submitted_us;
+	gboolean busy;
+};
+
+struct sr_usb_stream {
+	const struct sr_dev_inst *sdi;
+	struct sr_context *ctx;
+	struct sr_usb_stream_config cfg;
+	sr_usb_stream_data_cb data_cb;
+	sr_usb_stream_done_cb done_cb;
+	void *cb_data;
+	uint8_t *buffers;
+	struct stream_slot *slots;
+	size_t in_flight;
+	size_t batch;
+	unsigned int empty_count;
+	gboolean started;
+	gboolean stopping;
+	gboolean finished;
+	int status;
+	struct sr_usb_stream_stats stats;
+};
+
+static void stream_derive_config(struct sr_usb_stream_config *cfg)
+{
+	uint64_t bytes_per_ms;
+	size_t size;
+
+	bytes_per_ms = cfg->samplerate * cfg->sample_bits / 8 / 1000;
+	if (!bytes_per_ms)
+		bytes_per_ms = 1;
+
+	if (!cfg->granularity)
+		cfg->granularity = STREAM_GRANULARITY;
+
+	size = cfg->buffer_size;
+	if (!size)
+		size = STREAM_BUFFER_MS * bytes_per_ms;
+	size += cfg->granularity - 1;
+	size -= size % cfg->granularity;
+	cfg->buffer_size = size;
+
+	if (!cfg->buffer_count) {
+		cfg->buffer_count = STREAM_RING_MS * bytes_per_ms / size;
+		if (cfg->buffer_count < STREAM_MIN_TRANSFERS)
+			cfg->buffer_count = STREAM_MIN_TRANSFERS;
+		if (cfg->buffer_count > STREAM_MAX_TRANSFERS)
+			cfg->buffer_count = STREAM_MAX_TRANSFERS;
+	}
+
+	/* Leave a headroom of 25% for the ring to become filled. */
+	if (!cfg->timeout) {
+		cfg->timeout = size * cfg->buffer_count / bytes_per_ms;
+		cfg->timeout += cfg->timeout / 4;
+	}
+
+	if (!cfg->max_empty)
+		cfg->max_empty = 2 * cfg->buffer_count;
+}
+
+static int stream_submit(struct sr_usb_stream *stream,
+	struct stream_slot *slot)
+{
+	int ret;
+
+	slot->submitted_us = g_get_monotonic_time();
+	ret = libusb_submit_transfer(slot->transfer);
+	if (ret != 0) {
+		sr_err("Failed to submit transfer: %s.",
+			libusb_error_name(ret));
+		return SR_ERR_IO;
+	}
+	slot->busy = TRUE;
+	stream->in_flight++;
+	stream->stats.submitted++;
+
+	return SR_OK;
+}
+
+/* Cancel all pending transfers, keep the first termination status. */
+static void stream_terminate(struct sr_usb_stream *stream, int status)
+{
+	size_t i;
+
+	if (!stream->stopping) {
+		stream->stopping = TRUE;
+		stream->status = status;
+	}
+	for (i = 0; i < stream->cfg.buffer_count; i++) {
+		if (stream->slots[i].busy)
+			libusb_cancel_transfer(stream->slots[i].transfer);
+	}
+	if (!stream->in_flight)
+		stream->finished = TRUE;
+}
+
+static void LIBUSB_CALL stream_receive_transfer(struct libusb_transfer *transfer)
+{
+	struct stream_slot *slot;
+	struct sr_usb_stream *stream;
+	uint64_t latency;
+	gboolean has_data;
+
+	slot = transfer->user_data;
+	stream = slot->stream;
+
+	latency = g_get_monotonic_time() - slot->submitted_us;
+	slot->busy = FALSE;
+	stream->in_flight--;
+	stream->stats.completed++;
+	stream->stats.latency_sum_us += latency;
+	if (latency > stream->stats.latency_max_us)
+		stream->stats.latency_max_us = latency;
+
+	if (stream->stopping) {
+		if (!stream->in_flight)
+			stream->finished = TRUE;
+		return;
+	}
+
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		sr_err("Device disappeared, stopping.");
+		stream_terminate(stream, SR_ERR_DEV_CLOSED);
+		return;
+	case LIBUSB_TRANSFER_COMPLETED:
+	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
+		has_data = transfer->actual_length > 0;
+		break;
+	default:
+		has_data = FALSE;
+		break;
+	}
+
+	if (!has_data) {
+		stream->stats.empty++;
+		if (++stream->empty_count > stream->cfg.max_empty) {
+			sr_err("Too many empty or failed transfers, stopping.");
+			stream_terminate(stream, SR_ERR_IO);
+			return;
+		}
+	} else {
+		stream->empty_count = 0;
+		/*
+		 * All buffers of the ring got filled before they could be
+		 * handled, the device had nowhere to put its data for a
+		 * while.
+		 */
+		if (++stream->batch > stream->stats.max_batch)
+			stream->stats.max_batch = stream->batch;
+		if (stream->batch == stream->cfg.buffer_count) {
+			if (!stream->stats.overruns)
+				sr_warn("All transfers completed at once, data may have been lost.");
+			stream->stats.overruns++;
+		}
+		stream->stats.bytes += transfer->actual_length;
+		if (!stream->data_cb(transfer->buffer,
+				transfer->actual_length, stream->cb_data)) {
+			stream_terminate(stream, SR_OK);
+			return;
+		}
+	}
+
+	if (stream_submit(stream, slot) != SR_OK)
+		stream_terminate(stream, SR_ERR_IO);
+}
+
+/* Wait for cancelled transfers to return, outside of the event source. */
+static void stream_drain(struct sr_usb_stream *stream)
+{
+	struct timeval tv;
+
+	stream_terminate(stream, SR_OK);
+	while (stream->in_flight) {
+		tv.tv_sec = 0;
+		tv.tv_usec = 100 * 1000;
+		if (libusb_handle_events_timeout(stream->ctx->libusb_ctx, &tv) != 0)
+			break;
+	}
+}
+
+static void stream_poll(struct sr_usb_stream *stream)
+{
+	struct timeval tv;
+
+	/* Count the completions of this round, to detect overruns. */
+	stream->batch = 0;
+	tv.tv_sec = tv.tv_usec = 0;
+	libusb_handle_events_timeout(stream->ctx->libusb_ctx, &tv);
+
+	if (!stream->started || !stream->finished)
+		return;
+
+	stream->started = FALSE;
+	if (!stream->cfg.driver_source)
+		usb_source_remove(stream->sdi->session, stream->ctx);
+
+	sr_dbg("Stream done, %" PRIu64 " bytes in %" PRIu64 " transfers,"
+		" max latency %" PRIu64 " us, %" PRIu64 " overruns.",
+		stream->stats.bytes, stream->stats.completed,
+		stream->stats.latency_max_us, stream->stats.overruns);
+
+	/* The done callback may release the stream. */
+	stream->done_cb(stream->status, stream->cb_data);
+}
+
+static int stream_receive_data(int fd, int revents, void *cb_data)
+{
+	(void)fd;
+	(void)revents;
+
+	stream_poll(cb_data);
+
+	return TRUE;
+}
+
+/**
+ * Create a bulk IN stream for a device.
+ *
+ * @param[in] sdi The device instance, its connection must be open.
+ * @param[in,out] cfg The stream configuration. Zero fields get filled
+ *   in with values which are derived from the data rate.
+ * @param[in] data_cb Receives completed buffers. Returns FALSE to stop.
+ * @param[in] done_cb Gets called after the stream has terminated.
+ * @param[in] cb_data Caller provided context for the callbacks.
+ *
+ * @returns The stream instance, or NULL on error.
+ *
+ * @private
+ */
+SR_PRIV struct sr_usb_stream *sr_usb_stream_new(const struct sr_dev_inst *sdi,
+	struct sr_usb_stream_config *cfg, sr_usb_stream_data_cb data_cb,
+	sr_usb_stream_done_cb done_cb, void *cb_data)
+{
+	struct sr_usb_stream *stream;
+	struct sr_usb_dev_inst *usb;
+	struct drv_context *drvc;
+	struct stream_slot *slot;
+	unsigned int timeout;
+	size_t i;
+
+	if (!sdi || !cfg || !data_cb || !done_cb)
+		return NULL;
+
+	usb = sdi->conn;
+	drvc = sdi->driver->context;
+
+	stream_derive_config(cfg);
+	timeout = cfg->timeout;
+	if (timeout == SR_USB_STREAM_NO_TIMEOUT)
+		timeout = 0;
+
+	stream = g_malloc0(sizeof(*stream));
+	stream->sdi = sdi;
+	stream->ctx = drvc->sr_ctx;
+	stream->cfg = *cfg;
+	stream->data_cb = data_cb;
+	stream->done_cb = done_cb;
+	stream->cb_data = cb_data;
+
+	stream->buffers = g_try_malloc(cfg->buffer_count * cfg->buffer_size);
+	if (!stream->buffers) {
+		sr_err("USB transfer buffer malloc failed.");
+		g_free(stream);
+		return NULL;
+	}
+	stream->slots = g_malloc0(cfg->buffer_count * sizeof(stream->slots[0]));
+	for (i = 0; i < cfg->buffer_count; i++) {
+		slot = &stream->slots[i];
+		slot->stream = stream;
+		slot->transfer = libusb_alloc_transfer(0);
+		if (!slot->transfer) {
+			sr_err("USB transfer malloc failed.");
+			sr_usb_stream_free(stream);
+			return NULL;
+		}
+		libusb_fill_bulk_transfer(slot->transfer, usb->devhdl,
+			cfg->endpoint, &stream->buffers[i * cfg->buffer_size],
+			cfg->buffer_size, stream_receive_transfer, slot,
+			timeout);
+	}
+
+	sr_dbg("%zu transfers of %zu bytes, timeout %u ms.",
+		cfg->buffer_count, cfg->buffer_size, timeout);
+
+	return stream;
+}
+
+/**
+ * Submit all transfers of a stream, and start handling USB events.
+ *
+ * @param[in] stream The stream instance.
+ *
+ * @returns SR_OK upon success, SR_ERR_ARG for invalid arguments, or
+ *   SR_ERR_IO when transfers could not get submitted.
+ *
+ * When an error is returned, the done callback will not get called.
+ * A stream can get started again after it has terminated.
+ *
+ * @private
+ */
+SR_PRIV int sr_usb_stream_start(struct sr_usb_stream *stream)
+{
+	unsigned int timeout;
+	size_t i;
+	int ret;
+
+	if (!stream || stream->started || stream->in_flight)
+		return SR_ERR_ARG;
+
+	stream->stopping = FALSE;
+	stream->finished = FALSE;
+	stream->status = SR_OK;
+	stream->empty_count = 0;
+	memset(&stream->stats, 0, sizeof(stream->stats));
+
+	for (i = 0; i < stream->cfg.buffer_count; i++) {
+		ret = stream_submit(stream, &stream->slots[i]);
+		if (ret != SR_OK) {
+			stream_drain(stream);
+			return ret;
+		}
+	}
+
+	if (!stream->cfg.driver_source) {
+		timeout = stream->cfg.timeout;
+		if (timeout == SR_USB_STREAM_NO_TIMEOUT)
+			timeout = STREAM_POLL_MS;
+		ret = usb_source_add(stream->sdi->session, stream->ctx,
+			timeout, stream_receive_data, stream);
+		if (ret != SR_OK) {
+			stream_drain(stream);
+			return ret;
+		}
+	}
+	stream->started = TRUE;
+
+	return SR_OK;
+}
+
+/**
+ * Stop a stream.
+ *
+ * @param[in] stream The stream instance, can be NULL.
+ *
+ * Pending transfers get cancelled, their data is discarded. The done
+ * callback gets called with status SR_OK after all of them returned,
+ * unless the stream had already terminated for other reasons.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_stream_stop(struct sr_usb_stream *stream)
+{
+	if (!stream || !stream->started)
+		return;
+
+	stream_terminate(stream, SR_OK);
+}
+
+/**
+ * Handle pending USB events of a stream.
+ *
+ * @param[in] stream The stream instance.
+ *
+ * @returns SR_OK upon success, SR_ERR_ARG for invalid arguments.
+ *
+ * Drivers which run the USB event source themselves call this from
+ * there, instead of handling libusb events directly. The done callback
+ * gets called from here after the stream has terminated.
+ *
+ * @private
+ */
+SR_PRIV int sr_usb_stream_poll(struct sr_usb_stream *stream)
+{
+	if (!stream)
+		return SR_ERR_ARG;
+
+	stream_poll(stream);
+
+	return SR_OK;
+}
+
+/**
+ * Get the statistics of a stream.
+ *
+ * @param[in] stream The stream instance.
+ * @param[out] stats The caller's storage for the statistics.
+ *
+ * @returns SR_OK upon success, SR_ERR_ARG for invalid arguments.
+ *
+ * The sum of latencies divided by the number of completed transfers
+ * approximates the ring's duration when the host keeps up.
+ *
+ * @private
+ */
+SR_PRIV int sr_usb_stream_stats_get(struct sr_usb_stream *stream,
+	struct sr_usb_stream_stats *stats)
+{
+	if (!stream || !stats)
+		return SR_ERR_ARG;
+
+	*stats = stream->stats;
+
+	return SR_OK;
+}
+
+/**
+ * Release a stream.
+ *
+ * @param[in] stream The stream instance, can be NULL.
+ *
+ * This is typically done from within the done callback. Streams which
+ * still have transfers in flight get stopped, without calling the
+ * done callback.
+ *
+ * @private
+ */
+SR_PRIV void sr_usb_stream_free(struct sr_usb_stream *stream)
+{
+	size_t i;
+
+	if (!stream)
+		return;
+
+	if (stream->started) {
+		stream->started = FALSE;
+		if (!stream->cfg.driver_source)
+			usb_source_remove(stream->sdi->session, stream->ctx);
+	}
+	if (stream->in_flight)
+		stream_drain(stream);
+	if (stream->in_flight) {
+		/* Cannot release transfers which libusb still holds. */
+		sr_err("Transfers still pending, leaking them.");
+		return;
+	}
+
+	if (stream->stats.overruns) {
+		sr_info("Stream overran %" PRIu64 " times in %" PRIu64
+			" transfers.", stream->stats.overruns,
+			stream->stats.completed);
+	}
+
+	for (i = 0; i < stream->cfg.buffer_count; i++)
+		libusb_free_transfer(stream->slots[i].transfer);
+	g_free(stream->slots);
+	g_free(stream->buffers);
+	g_free(stream);
+}
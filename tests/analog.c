@@ -428,6 +428,74 @@ START_TEST(test_analog_to_float_conv)
 }
 END_TEST
 
+static int test_array_value(int is_sign, size_t idx)
+{
+	return is_sign ? (int)idx * 5 - 90 : (int)idx * 7;
+}
+
+/*
+ * Check conversion of longer arrays, which exercise optimized code
+ * paths, and check the double precision variant.
+ */
+START_TEST(test_analog_to_float_array)
+{
+	static const int is_sign[] = { TRUE, FALSE, TRUE, FALSE, };
+	static const size_t unit[] = { 1, 1, 2, 2, };
+
+	int ret;
+	size_t item_idx, value_idx, byte_idx;
+	uint8_t bytes[2 * 37];
+	float f_out[37];
+	double d_out[37];
+	int value;
+	double want;
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	for (item_idx = 0; item_idx < ARRAY_SIZE(unit); item_idx++) {
+		/* Little endian input data, values in the type's range. */
+		for (value_idx = 0; value_idx < ARRAY_SIZE(f_out); value_idx++) {
+			value = test_array_value(is_sign[item_idx], value_idx);
+			for (byte_idx = 0; byte_idx < unit[item_idx]; byte_idx++)
+				bytes[value_idx * unit[item_idx] + byte_idx] =
+					(value >> (8 * byte_idx)) & 0xff;
+		}
+
+		sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+		analog.num_samples = ARRAY_SIZE(f_out);
+		analog.data = bytes;
+		encoding.unitsize = unit[item_idx];
+		encoding.is_float = FALSE;
+		encoding.is_signed = is_sign[item_idx];
+		encoding.is_bigendian = FALSE;
+		encoding.scale.p = 3;
+		encoding.scale.q = 4;
+		encoding.offset.p = -5;
+		encoding.offset.q = 2;
+		meaning.channels = g_slist_append(NULL, &ch);
+
+		ret = sr_analog_to_float(&analog, f_out);
+		fail_unless(ret == SR_OK, "sr_analog_to_float() failed: %d.", ret);
+		ret = sr_analog_to_double(&analog, d_out);
+		fail_unless(ret == SR_OK, "sr_analog_to_double() failed: %d.", ret);
+		for (value_idx = 0; value_idx < ARRAY_SIZE(f_out); value_idx++) {
+			value = test_array_value(is_sign[item_idx], value_idx);
+			want = value * 0.75 - 2.5;
+			fail_unless(f_out[value_idx] == (float)want,
+				"item %zu: %f != %f", item_idx,
+				f_out[value_idx], want);
+			fail_unless(d_out[value_idx] == want,
+				"item %zu: %f != %f", item_idx,
+				d_out[value_idx], want);
+		}
+		g_slist_free(meaning.channels);
+	}
+}
+END_TEST
+
 START_TEST(test_analog_si_prefix)
 {
 	struct {
@@ -697,6 +765,7 @@ Suite *suite_analog(void)
 	tcase_add_test(tc, test_analog_to_float);
 	tcase_add_test(tc, test_analog_to_float_null);
 	tcase_add_test(tc, test_analog_to_float_conv);
+	tcase_add_test(tc, test_analog_to_float_array);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("analog_si_unit");
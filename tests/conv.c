@@ -20,11 +20,16 @@
 #include <config.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include "lib.h"
 #include "libsigrok-internal.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 static const uint8_t buff1234[] = {
 	0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
 };
@@ -238,6 +243,444 @@ START_TEST(test_endian_write_inc)
 }
 END_TEST
 
+START_TEST(test_logic_rle_expand)
+{
+	static const uint8_t values[] = { 0x01, 0x80, 0x02, 0x00, 0x03, 0x00, };
+	static const uint8_t expect[] = {
+		0x01, 0x80, 0x01, 0x80, 0x01, 0x80,
+		0x03, 0x00, 0x03, 0x00, 0x03, 0x00, 0x03, 0x00, 0x03, 0x00,
+	};
+	uint32_t lengths[] = { 3, 0, 5, };
+	struct sr_datafeed_logic_rle rle;
+	uint8_t buff[sizeof(expect)];
+	uint64_t run, offset, count, total;
+
+	rle.run_count = ARRAY_SIZE(lengths);
+	rle.unitsize = 2;
+	rle.values = (void *)values;
+	rle.lengths = lengths;
+	fail_unless(sr_logic_rle_length(&rle) == sizeof(expect) / 2);
+
+	/* Expand in chunks which don't align with the runs. */
+	memset(buff, 0xff, sizeof(buff));
+	run = offset = 0;
+	total = 0;
+	do {
+		count = MIN(3, sizeof(expect) / 2 - total);
+		count = sr_logic_rle_expand(&rle, &run, &offset,
+			&buff[total * 2], count);
+		total += count;
+	} while (count);
+	fail_unless(total == sizeof(expect) / 2);
+	fail_unless(memcmp(buff, expect, sizeof(expect)) == 0);
+}
+END_TEST
+
+static void conv_analog_init(struct sr_datafeed_analog *analog,
+		struct sr_analog_encoding *encoding,
+		struct sr_analog_meaning *meaning,
+		void *data, uint64_t count, uint8_t unitsize,
+		gboolean is_float, gboolean is_signed)
+{
+	memset(analog, 0, sizeof(*analog));
+	memset(encoding, 0, sizeof(*encoding));
+	memset(meaning, 0, sizeof(*meaning));
+
+	analog->data = data;
+	analog->num_samples = count;
+	analog->encoding = encoding;
+	analog->meaning = meaning;
+
+	encoding->unitsize = unitsize;
+	encoding->is_float = is_float;
+	encoding->is_signed = is_signed;
+#ifdef WORDS_BIGENDIAN
+	encoding->is_bigendian = is_float;
+#endif
+	encoding->scale.p = 1;
+	encoding->scale.q = 1;
+	encoding->offset.p = 0;
+	encoding->offset.q = 1;
+}
+
+/*
+ * Check the bit at 'bitpos' of every logic sample against 'expect', and
+ * all other bits against the 'fill' pattern they were initialized with.
+ */
+static void conv_check_bits(const uint8_t *logic, size_t unitsize,
+		size_t bitpos, const uint8_t *expect, uint64_t count, uint8_t fill)
+{
+	uint64_t i;
+	size_t b;
+	uint8_t mask, want;
+
+	for (i = 0; i < count; i++) {
+		for (b = 0; b < unitsize; b++) {
+			mask = b == bitpos / 8 ? 1 << (bitpos % 8) : 0;
+			want = fill & ~mask;
+			if (expect[i])
+				want |= mask;
+			fail_unless(logic[i * unitsize + b] == want,
+				"sample %" PRIu64 " byte %zu: 0x%02x != 0x%02x",
+				i, b, logic[i * unitsize + b], want);
+		}
+	}
+}
+
+/* Partial final blocks, and more than one block of 64 samples. */
+#define A2L_COUNT	203
+
+START_TEST(test_a2l_threshold_bits_float)
+{
+	static const size_t bitpos[] = { 0, 7, 8, 13, 23, };
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	float values[A2L_COUNT];
+	uint8_t expect[A2L_COUNT], logic[A2L_COUNT * 3];
+	uint64_t i, count;
+	size_t p;
+	int ret;
+
+	for (i = 0; i < A2L_COUNT; i++)
+		values[i] = (float)((i * 37) % 101) / 10.0 - 5.0;
+	values[17] = 0.5;
+	conv_analog_init(&analog, &encoding, &meaning, values, A2L_COUNT,
+		sizeof(float), TRUE, TRUE);
+
+	ret = sr_a2l_threshold(&analog, 0.5, expect, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	fail_unless(expect[17] == 1);
+
+	/* Agree with the byte-per-sample function, at every position. */
+	for (p = 0; p < ARRAY_SIZE(bitpos); p++) {
+		for (count = A2L_COUNT - 2; count <= A2L_COUNT; count++) {
+			memset(logic, 0x5a, sizeof(logic));
+			ret = sr_a2l_threshold_bits(&analog, 0.5, logic, 3,
+				bitpos[p], count);
+			fail_unless(ret == SR_OK);
+			conv_check_bits(logic, 3, bitpos[p], expect, count, 0x5a);
+		}
+	}
+
+	/* Single byte logic samples. */
+	memset(logic, 0xff, sizeof(logic));
+	ret = sr_a2l_threshold_bits(&analog, 0.5, logic, 1, 4, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	conv_check_bits(logic, 1, 4, expect, A2L_COUNT, 0xff);
+
+	/* Invalid bit positions. */
+	ret = sr_a2l_threshold_bits(&analog, 0.5, logic, 2, 16, A2L_COUNT);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_a2l_threshold_bits(&analog, 0.5, logic, 0, 0, A2L_COUNT);
+	fail_unless(ret == SR_ERR_ARG);
+}
+END_TEST
+
+START_TEST(test_a2l_threshold_bits_int)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	int16_t s16[A2L_COUNT];
+	uint8_t u8[A2L_COUNT];
+	uint8_t expect[A2L_COUNT], logic[A2L_COUNT * 2];
+	uint64_t i;
+	int ret;
+
+	/* Signed raw samples, scaled by 1/4 with an offset of -3. */
+	for (i = 0; i < A2L_COUNT; i++)
+		s16[i] = (int16_t)(((i * 4099) % 2000) - 1000);
+	s16[5] = 52;
+	conv_analog_init(&analog, &encoding, &meaning, s16, A2L_COUNT,
+		sizeof(int16_t), FALSE, TRUE);
+	encoding.scale.q = 4;
+	encoding.offset.p = -3;
+	for (i = 0; i < A2L_COUNT; i++)
+		expect[i] = s16[i] / 4.0 - 3 >= 10.0;
+	fail_unless(expect[5] == 1);
+
+	/* Raw integer compare, must agree with the float based conversion. */
+	memset(logic, 0, sizeof(logic));
+	ret = sr_a2l_threshold_bits(&analog, 10.0, logic, 2, 9, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	conv_check_bits(logic, 2, 9, expect, A2L_COUNT, 0x00);
+	memset(logic, 0xaa, sizeof(logic));
+	ret = sr_a2l_threshold(&analog, 10.0, logic, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	fail_unless(memcmp(logic, expect, A2L_COUNT) == 0);
+
+	/* Negative scale factors turn the comparison around. */
+	encoding.scale.p = -1;
+	for (i = 0; i < A2L_COUNT; i++)
+		expect[i] = -s16[i] / 4.0 - 3 >= 10.0;
+	memset(logic, 0xff, sizeof(logic));
+	ret = sr_a2l_threshold_bits(&analog, 10.0, logic, 2, 0, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	conv_check_bits(logic, 2, 0, expect, A2L_COUNT, 0xff);
+
+	/* Unsigned bytes, thresholds inside and outside of the range. */
+	for (i = 0; i < A2L_COUNT; i++)
+		u8[i] = (uint8_t)(i * 73);
+	conv_analog_init(&analog, &encoding, &meaning, u8, A2L_COUNT,
+		sizeof(uint8_t), FALSE, FALSE);
+	for (i = 0; i < A2L_COUNT; i++)
+		expect[i] = u8[i] >= 200;
+	memset(logic, 0, sizeof(logic));
+	ret = sr_a2l_threshold_bits(&analog, 199.5, logic, 1, 7, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	conv_check_bits(logic, 1, 7, expect, A2L_COUNT, 0x00);
+	memset(expect, 1, sizeof(expect));
+	ret = sr_a2l_threshold_bits(&analog, -1.0, logic, 1, 7, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	conv_check_bits(logic, 1, 7, expect, A2L_COUNT, 0x00);
+	memset(expect, 0, sizeof(expect));
+	ret = sr_a2l_threshold_bits(&analog, 256.0, logic, 1, 7, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	conv_check_bits(logic, 1, 7, expect, A2L_COUNT, 0x00);
+}
+END_TEST
+
+START_TEST(test_a2l_schmitt_trigger_bits)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	float values[A2L_COUNT];
+	uint8_t expect[A2L_COUNT], logic[A2L_COUNT * 2];
+	uint8_t state, exp_state;
+	uint64_t i, split;
+	int ret;
+
+	/* A slow triangle with some noise, and a NaN while high. */
+	for (i = 0; i < A2L_COUNT; i++)
+		values[i] = (float)(i % 80 < 40 ? i % 80 : 80 - i % 80) / 4.0
+			+ ((i * 7) % 5) / 2.0 - 1.0;
+	values[150] = NAN;
+	conv_analog_init(&analog, &encoding, &meaning, values, A2L_COUNT,
+		sizeof(float), TRUE, TRUE);
+
+	exp_state = 0;
+	ret = sr_a2l_schmitt_trigger(&analog, 2.0, 6.0, &exp_state, expect,
+		A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	/* NaN is neither below nor above, and keeps the state. */
+	fail_unless(expect[149] == 1 && expect[150] == 1);
+
+	/* Agree with the byte-per-sample function, in one go. */
+	state = 0;
+	memset(logic, 0x33, sizeof(logic));
+	ret = sr_a2l_schmitt_trigger_bits(&analog, 2.0, 6.0, &state, logic,
+		2, 10, A2L_COUNT);
+	fail_unless(ret == SR_OK);
+	fail_unless(state == exp_state);
+	conv_check_bits(logic, 2, 10, expect, A2L_COUNT, 0x33);
+
+	/* And when split, with the state carried across calls. */
+	for (split = 1; split < A2L_COUNT; split += 29) {
+		state = 0;
+		memset(logic, 0xcc, sizeof(logic));
+		ret = sr_a2l_schmitt_trigger_bits(&analog, 2.0, 6.0, &state,
+			logic, 2, 3, split);
+		fail_unless(ret == SR_OK);
+		analog.data = &values[split];
+		ret = sr_a2l_schmitt_trigger_bits(&analog, 2.0, 6.0, &state,
+			&logic[split * 2], 2, 3, A2L_COUNT - split);
+		analog.data = values;
+		fail_unless(ret == SR_OK);
+		fail_unless(state == exp_state);
+		conv_check_bits(logic, 2, 3, expect, A2L_COUNT, 0xcc);
+	}
+}
+END_TEST
+
+/*
+ * Copies of the bit matrix transposition in src/conversion.c, which is
+ * private to the library. Both the scalar and the SSE2 variant get
+ * checked here, regardless of the one the library was built with.
+ * Keep these in sync with the library's implementation.
+ */
+static void transpose_16x16_scalar(uint16_t m[16])
+{
+	unsigned int j, k;
+	uint16_t mask, t;
+
+	for (j = 8, mask = 0x00ff; j; j >>= 1, mask ^= mask << j) {
+		for (k = 0; k < 16; k = (k + j + 1) & ~j) {
+			t = ((m[k] >> j) ^ m[k + j]) & mask;
+			m[k] ^= t << j;
+			m[k + j] ^= t;
+		}
+	}
+}
+
+static void transpose_32x32_scalar(uint32_t m[32])
+{
+	unsigned int j, k;
+	uint32_t mask, t;
+
+	for (j = 16, mask = 0x0000ffff; j; j >>= 1, mask ^= mask << j) {
+		for (k = 0; k < 32; k = (k + j + 1) & ~j) {
+			t = ((m[k] >> j) ^ m[k + j]) & mask;
+			m[k] ^= t << j;
+			m[k + j] ^= t;
+		}
+	}
+}
+
+#ifdef __SSE2__
+static void transpose_16x16_sse2(uint16_t m[16])
+{
+	__m128i a, b, lo, hi, low_bytes;
+	int bit;
+
+	a = _mm_loadu_si128((const __m128i *)&m[0]);
+	b = _mm_loadu_si128((const __m128i *)&m[8]);
+	low_bytes = _mm_set1_epi16(0x00ff);
+	lo = _mm_packus_epi16(_mm_and_si128(a, low_bytes),
+		_mm_and_si128(b, low_bytes));
+	hi = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+	for (bit = 7; bit >= 0; bit--) {
+		m[bit] = _mm_movemask_epi8(lo);
+		m[8 + bit] = _mm_movemask_epi8(hi);
+		lo = _mm_slli_epi64(lo, 1);
+		hi = _mm_slli_epi64(hi, 1);
+	}
+}
+
+static void transpose_32x32_sse2(uint32_t m[32])
+{
+	__m128i v[8], s[8], b0, b1, low_byte;
+	uint32_t t[32];
+	int i, byte, bit;
+
+	for (i = 0; i < 8; i++)
+		v[i] = _mm_loadu_si128((const __m128i *)&m[4 * i]);
+	low_byte = _mm_set1_epi32(0xff);
+	for (byte = 0; byte < 4; byte++) {
+		for (i = 0; i < 8; i++)
+			s[i] = _mm_and_si128(_mm_srli_epi32(v[i], 8 * byte),
+				low_byte);
+		b0 = _mm_packus_epi16(_mm_packs_epi32(s[0], s[1]),
+			_mm_packs_epi32(s[2], s[3]));
+		b1 = _mm_packus_epi16(_mm_packs_epi32(s[4], s[5]),
+			_mm_packs_epi32(s[6], s[7]));
+		for (bit = 7; bit >= 0; bit--) {
+			t[8 * byte + bit] = (uint32_t)_mm_movemask_epi8(b0) |
+				(uint32_t)_mm_movemask_epi8(b1) << 16;
+			b0 = _mm_slli_epi64(b0, 1);
+			b1 = _mm_slli_epi64(b1, 1);
+		}
+	}
+	memcpy(m, t, sizeof(t));
+}
+#endif
+
+#define TRANSPOSE_ROUNDS 1000
+
+/* Straight from the definition: bit j of row i becomes bit i of row j. */
+static void transpose_16x16_ref(const uint16_t in[16], uint16_t out[16])
+{
+	size_t i, j;
+
+	memset(out, 0, 16 * sizeof(out[0]));
+	for (i = 0; i < 16; i++) {
+		for (j = 0; j < 16; j++) {
+			if (in[i] & (1U << j))
+				out[j] |= 1U << i;
+		}
+	}
+}
+
+static void transpose_32x32_ref(const uint32_t in[32], uint32_t out[32])
+{
+	size_t i, j;
+
+	memset(out, 0, 32 * sizeof(out[0]));
+	for (i = 0; i < 32; i++) {
+		for (j = 0; j < 32; j++) {
+			if (in[i] & (1UL << j))
+				out[j] |= 1UL << i;
+		}
+	}
+}
+
+START_TEST(test_bits_transpose_16x16)
+{
+	GRand *rand;
+	uint16_t in[16], expect[16], m[16];
+	size_t round, i;
+
+	rand = g_rand_new_with_seed(16);
+	for (round = 0; round < TRANSPOSE_ROUNDS; round++) {
+		/* Random matrices, then single bits and an identity. */
+		for (i = 0; i < 16; i++) {
+			if (round < TRANSPOSE_ROUNDS - 17)
+				in[i] = g_rand_int(rand);
+			else if (round < TRANSPOSE_ROUNDS - 1)
+				in[i] = i == round % 16 ? 1U << (15 - i) : 0;
+			else
+				in[i] = 1U << i;
+		}
+		transpose_16x16_ref(in, expect);
+
+		memcpy(m, in, sizeof(m));
+		transpose_16x16_scalar(m);
+		fail_unless(!memcmp(m, expect, sizeof(m)),
+			"Scalar 16x16 transpose differs in round %zu.", round);
+		transpose_16x16_scalar(m);
+		fail_unless(!memcmp(m, in, sizeof(m)));
+#ifdef __SSE2__
+		memcpy(m, in, sizeof(m));
+		transpose_16x16_sse2(m);
+		fail_unless(!memcmp(m, expect, sizeof(m)),
+			"SSE2 16x16 transpose differs in round %zu.", round);
+		transpose_16x16_sse2(m);
+		fail_unless(!memcmp(m, in, sizeof(m)));
+#endif
+	}
+	g_rand_free(rand);
+}
+END_TEST
+
+START_TEST(test_bits_transpose_32x32)
+{
+	GRand *rand;
+	uint32_t in[32], expect[32], m[32];
+	size_t round, i;
+
+	rand = g_rand_new_with_seed(32);
+	for (round = 0; round < TRANSPOSE_ROUNDS; round++) {
+		/* Random matrices, then single bits and an identity. */
+		for (i = 0; i < 32; i++) {
+			if (round < TRANSPOSE_ROUNDS - 33)
+				in[i] = g_rand_int(rand);
+			else if (round < TRANSPOSE_ROUNDS - 1)
+				in[i] = i == round % 32 ? 1UL << (31 - i) : 0;
+			else
+				in[i] = 1UL << i;
+		}
+		transpose_32x32_ref(in, expect);
+
+		memcpy(m, in, sizeof(m));
+		transpose_32x32_scalar(m);
+		fail_unless(!memcmp(m, expect, sizeof(m)),
+			"Scalar 32x32 transpose differs in round %zu.", round);
+		transpose_32x32_scalar(m);
+		fail_unless(!memcmp(m, in, sizeof(m)));
+#ifdef __SSE2__
+		memcpy(m, in, sizeof(m));
+		transpose_32x32_sse2(m);
+		fail_unless(!memcmp(m, expect, sizeof(m)),
+			"SSE2 32x32 transpose differs in round %zu.", round);
+		transpose_32x32_sse2(m);
+		fail_unless(!memcmp(m, in, sizeof(m)));
+#endif
+	}
+	g_rand_free(rand);
+}
+END_TEST
+
 Suite *suite_conv(void)
 {
 	Suite *s;
@@ -253,5 +696,20 @@ Suite *suite_conv(void)
 	tcase_add_test(tc, test_endian_write_inc);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("logic_rle");
+	tcase_add_test(tc, test_logic_rle_expand);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("a2l");
+	tcase_add_test(tc, test_a2l_threshold_bits_float);
+	tcase_add_test(tc, test_a2l_threshold_bits_int);
+	tcase_add_test(tc, test_a2l_schmitt_trigger_bits);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("transpose");
+	tcase_add_test(tc, test_bits_transpose_16x16);
+	tcase_add_test(tc, test_bits_transpose_32x32);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -29,6 +29,7 @@ enum {
 	CHECK_ALL_LOW,
 	CHECK_ALL_HIGH,
 	CHECK_HELLO_WORLD,
+	CHECK_CONTENT,
 };
 
 static uint64_t df_packet_counter = 0, sample_counter = 0;
@@ -37,6 +38,7 @@ static GArray *logic_channellist = NULL;
 static int check_to_perform;
 static uint64_t expected_samples;
 static uint64_t *expected_samplerate;
+static const uint8_t *expected_data;
 
 static void check_all_low(const struct sr_datafeed_logic *logic)
 {
@@ -76,6 +78,16 @@ static void check_hello_world(const struct sr_datafeed_logic *logic)
 	}
 }
 
+static void check_content(const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *expected;
+
+	expected = expected_data + sample_counter * logic->unitsize;
+	if (memcmp(logic->data, expected, logic->length) != 0)
+		fail("Logic data differs from input at sample %" PRIu64 ".",
+		     sample_counter);
+}
+
 static void datafeed_in(const struct sr_dev_inst *sdi,
 	const struct sr_datafeed_packet *packet, void *cb_data)
 {
@@ -158,6 +170,8 @@ static void datafeed_in(const struct sr_dev_inst *sdi,
 			check_all_high(logic);
 		else if (check_to_perform == CHECK_HELLO_WORLD)
 			check_hello_world(logic);
+		else if (check_to_perform == CHECK_CONTENT)
+			check_content(logic);
 
 		sample_counter += logic->length / logic->unitsize;
 
@@ -308,6 +322,77 @@ START_TEST(test_input_binary_hello_world)
 }
 END_TEST
 
+START_TEST(test_input_binary_mapped)
+{
+	int ret;
+	struct sr_input *in;
+	const struct sr_input_module *imod;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	uint8_t *buf;
+	size_t offset, length, consumed, i;
+
+	/*
+	 * Three bytes per sample. The slice size is not a multiple of
+	 * the sample size, so samples get split across slices, and the
+	 * trailing partial sample gets dropped.
+	 */
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("numchannels"),
+			g_variant_ref_sink(g_variant_new_int32(24)));
+
+	/* An incrementing counter reveals lost, duplicated or shifted data. */
+	buf = g_malloc(BUFSIZE);
+	for (i = 0; i + 3 <= BUFSIZE; i += 3) {
+		buf[i + 0] = (i / 3) & 0xff;
+		buf[i + 1] = ((i / 3) >> 8) & 0xff;
+		buf[i + 2] = ((i / 3) >> 16) & 0xff;
+	}
+	memset(buf + i, 0xaa, BUFSIZE - i);
+
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = CHECK_CONTENT;
+	expected_samples = BUFSIZE / 3;
+	expected_samplerate = NULL;
+	expected_data = buf;
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	/* The first call only makes the device instance ready. */
+	ret = sr_input_send_mapped(in, buf, BUFSIZE, &consumed);
+	fail_unless(ret == SR_OK, "sr_input_send_mapped() error: %d", ret);
+	fail_unless(consumed == 0, "Unexpected consumed size %zu.", consumed);
+	sdi = sr_input_dev_inst_get(in);
+	fail_unless(sdi != NULL, "Device instance not ready.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sdi);
+
+	for (offset = 0; offset < BUFSIZE; offset += length) {
+		length = MIN(BUFSIZE - offset, 10007);
+		ret = sr_input_send_mapped(in, buf + offset, length, &consumed);
+		fail_unless(ret == SR_OK, "sr_input_send_mapped() error: %d", ret);
+		fail_unless(consumed == length, "Short consumed size %zu.", consumed);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(have_seen_df_end, "No SR_DF_END was seen.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_hash_table_destroy(options);
+	g_free(buf);
+}
+END_TEST
+
 Suite *suite_input_binary(void)
 {
 	Suite *s;
@@ -321,6 +406,7 @@ Suite *suite_input_binary(void)
 	tcase_add_test(tc, test_input_binary_all_high);
 	tcase_add_loop_test(tc, test_input_binary_all_high_loop, 1, 10);
 	tcase_add_test(tc, test_input_binary_hello_world);
+	tcase_add_test(tc, test_input_binary_mapped);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,212 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* Large enough for the parallel import to cut several chunks. */
+#define NUM_LINES 100000
+
+struct csv_capture {
+	GByteArray *logic;
+	GArray *analog;
+	gboolean seen_end;
+};
+
+static void datafeed_csv(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct csv_capture *cap;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	float *values;
+	int ret;
+
+	(void)sdi;
+
+	cap = cb_data;
+	fail_unless(!cap->seen_end, "Packet after SR_DF_END.");
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 2);
+		g_byte_array_append(cap->logic, logic->data, logic->length);
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		fail_unless(g_slist_length(analog->meaning->channels) == 1);
+		values = g_malloc(analog->num_samples * sizeof(values[0]));
+		ret = sr_analog_to_float(analog, values);
+		fail_unless(ret == SR_OK);
+		g_array_append_vals(cap->analog, values, analog->num_samples);
+		g_free(values);
+		break;
+	case SR_DF_END:
+		cap->seen_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Eight bits in hex, a single bit, and an analog value which is exact
+ * in both text and float representation. Some lines carry comments.
+ */
+static GString *csv_text_create(void)
+{
+	GString *text;
+	size_t i;
+
+	text = g_string_new("data,bit,value\n");
+	for (i = 0; i < NUM_LINES; i++) {
+		g_string_append_printf(text, "%02zx,%zu,%.2f",
+			i & 0xff, (i >> 8) & 1, (int)(i % 1000) * 0.25 - 100);
+		if (!(i % 7))
+			g_string_append(text, " ; comment");
+		g_string_append_c(text, '\n');
+	}
+
+	return text;
+}
+
+static void csv_import(const GString *text, uint32_t threads,
+	struct csv_capture *cap)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	GHashTable *options;
+	GString *buf;
+	size_t half;
+	int ret;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("column_formats"),
+			g_variant_ref_sink(g_variant_new_string("x8,l,a")));
+	g_hash_table_insert(options, g_strdup("threads"),
+			g_variant_ref_sink(g_variant_new_uint32(threads)));
+
+	imod = sr_input_find("csv");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	/* The first part makes the device instance ready. */
+	half = text->len / 2;
+	buf = g_string_new_len(text->str, half);
+	ret = sr_input_send(in, buf);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	g_string_free(buf, TRUE);
+	sdi = sr_input_dev_inst_get(in);
+	fail_unless(sdi != NULL, "Device instance not ready.");
+
+	cap->logic = g_byte_array_new();
+	cap->analog = g_array_new(FALSE, FALSE, sizeof(float));
+	cap->seen_end = FALSE;
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_csv, cap);
+	sr_session_dev_add(session, sdi);
+
+	buf = g_string_new_len(text->str + half, text->len - half);
+	ret = sr_input_send(in, buf);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	g_string_free(buf, TRUE);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(cap->seen_end, "No SR_DF_END was seen.");
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_hash_table_destroy(options);
+}
+
+static void csv_capture_free(struct csv_capture *cap)
+{
+	g_byte_array_free(cap->logic, TRUE);
+	g_array_free(cap->analog, TRUE);
+}
+
+/*
+ * Check that the parallel import yields the same samples in the same
+ * order as the sequential import does.
+ */
+START_TEST(test_input_csv_parallel)
+{
+	GString *text;
+	struct csv_capture seq, par;
+	const uint8_t *logic;
+	const float *analog;
+	size_t i;
+
+	text = csv_text_create();
+	csv_import(text, 0, &seq);
+	csv_import(text, 4, &par);
+
+	fail_unless(seq.logic->len == NUM_LINES * 2,
+		"Got %u bytes of logic data.", seq.logic->len);
+	fail_unless(seq.analog->len == NUM_LINES,
+		"Got %u analog samples.", seq.analog->len);
+	logic = seq.logic->data;
+	analog = (const float *)seq.analog->data;
+	for (i = 0; i < NUM_LINES; i++) {
+		fail_unless(logic[2 * i] == (i & 0xff),
+			"Bad logic data at sample %zu.", i);
+		fail_unless((logic[2 * i + 1] & 1) == ((i >> 8) & 1),
+			"Bad logic bit at sample %zu.", i);
+		fail_unless(analog[i] == (int)(i % 1000) * 0.25f - 100,
+			"Bad analog value at sample %zu.", i);
+	}
+
+	fail_unless(par.logic->len == seq.logic->len,
+		"Got %u bytes of logic data in parallel mode.", par.logic->len);
+	fail_unless(!memcmp(par.logic->data, seq.logic->data, seq.logic->len),
+		"Logic data differs in parallel mode.");
+	fail_unless(par.analog->len == seq.analog->len,
+		"Got %u analog samples in parallel mode.", par.analog->len);
+	fail_unless(!memcmp(par.analog->data, seq.analog->data,
+		seq.analog->len * sizeof(float)),
+		"Analog data differs in parallel mode.");
+
+	csv_capture_free(&seq);
+	csv_capture_free(&par);
+	g_string_free(text, TRUE);
+}
+END_TEST
+
+Suite *suite_input_csv(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-csv");
+
+	tc = tcase_create("parallel");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_csv_parallel);
+	tcase_set_timeout(tc, 30);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
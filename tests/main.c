@@ -37,9 +37,11 @@ int main(void)
 	srunner_add_suite(srunner, suite_driver_all());
 	srunner_add_suite(srunner, suite_input_all());
 	srunner_add_suite(srunner, suite_input_binary());
+	srunner_add_suite(srunner, suite_input_csv());
 	srunner_add_suite(srunner, suite_output_all());
 	srunner_add_suite(srunner, suite_transform_all());
 	srunner_add_suite(srunner, suite_session());
+	srunner_add_suite(srunner, suite_session_file());
 	srunner_add_suite(srunner, suite_strutil());
 	srunner_add_suite(srunner, suite_version());
 	srunner_add_suite(srunner, suite_device());
@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -185,6 +186,584 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+/*
+ * Check whether the datafeed thread can be configured, and whether
+ * the statistics are empty for a session which never ran.
+ */
+START_TEST(test_session_feed_thread)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_feed_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_feed_thread_set(sess, 100);
+	fail_unless(ret == SR_OK, "sr_session_feed_thread_set() failed: %d.", ret);
+	ret = sr_session_feed_stats_get(sess, &stats);
+	fail_unless(ret == SR_OK, "sr_session_feed_stats_get() failed: %d.", ret);
+	fail_unless(stats.packets == 0);
+	fail_unless(stats.overflows == 0);
+	ret = sr_session_feed_thread_set(sess, 0);
+	fail_unless(ret == SR_OK, "sr_session_feed_thread_set() failed: %d.", ret);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+START_TEST(test_session_feed_thread_bogus)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_session_feed_stats stats;
+
+	ret = sr_session_feed_thread_set(NULL, 100);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_feed_stats_get(NULL, &stats);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_feed_stats_get(sess, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+START_TEST(test_packet_is_shared)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint8_t data[4];
+
+	memset(data, 0, sizeof(data));
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	fail_unless(!sr_packet_is_shared(NULL));
+	fail_unless(!sr_packet_is_shared(&packet));
+}
+END_TEST
+
+/*
+ * Check that a borrowed packet gets copied upon sr_packet_ref(), and
+ * that references to the copy share the data.
+ */
+START_TEST(test_packet_ref_logic)
+{
+	struct sr_datafeed_packet packet, *ref, *ref2;
+	struct sr_datafeed_logic logic;
+	const struct sr_datafeed_logic *ref_logic;
+	uint8_t data[16];
+	size_t i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i;
+	logic.length = sizeof(data);
+	logic.unitsize = 2;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	ref = sr_packet_ref(&packet);
+	fail_unless(ref != NULL);
+	fail_unless(ref != &packet);
+	fail_unless(sr_packet_is_shared(ref));
+	fail_unless(!sr_packet_is_shared(&packet));
+	fail_unless(ref->type == SR_DF_LOGIC);
+	ref_logic = ref->payload;
+	fail_unless(ref_logic != &logic);
+	fail_unless(ref_logic->length == sizeof(data));
+	fail_unless(ref_logic->unitsize == 2);
+	fail_unless(ref_logic->data != data);
+
+	/* The copy must not follow changes to the original data. */
+	memset(data, 0xff, sizeof(data));
+	for (i = 0; i < sizeof(data); i++)
+		fail_unless(((uint8_t *)ref_logic->data)[i] == i);
+
+	/* References to shared packets do not copy. */
+	ref2 = sr_packet_ref(ref);
+	fail_unless(ref2 == ref);
+	sr_packet_unref(ref2);
+	fail_unless(sr_packet_is_shared(ref));
+	fail_unless(((uint8_t *)ref_logic->data)[1] == 1);
+	sr_packet_unref(ref);
+}
+END_TEST
+
+START_TEST(test_packet_ref_analog)
+{
+	struct sr_datafeed_packet packet, *ref;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	const struct sr_datafeed_analog *ref_analog;
+	float data[8];
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(data); i++)
+		data[i] = i * 0.5;
+	memset(&encoding, 0, sizeof(encoding));
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	memset(&meaning, 0, sizeof(meaning));
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	memset(&spec, 0, sizeof(spec));
+	analog.data = data;
+	analog.num_samples = G_N_ELEMENTS(data);
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+
+	ref = sr_packet_ref(&packet);
+	fail_unless(ref != NULL);
+	fail_unless(sr_packet_is_shared(ref));
+	fail_unless(ref->type == SR_DF_ANALOG);
+	ref_analog = ref->payload;
+	fail_unless(ref_analog->num_samples == G_N_ELEMENTS(data));
+	fail_unless(ref_analog->data != data);
+	fail_unless(ref_analog->encoding != &encoding);
+	fail_unless(ref_analog->encoding->unitsize == sizeof(float));
+	fail_unless(ref_analog->meaning->mq == SR_MQ_VOLTAGE);
+	fail_unless(ref_analog->meaning->unit == SR_UNIT_VOLT);
+
+	memset(data, 0, sizeof(data));
+	for (i = 0; i < G_N_ELEMENTS(data); i++)
+		fail_unless(((float *)ref_analog->data)[i] == i * 0.5);
+	sr_packet_unref(ref);
+}
+END_TEST
+
+START_TEST(test_packet_ref_end)
+{
+	struct sr_datafeed_packet packet, *ref;
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+
+	ref = sr_packet_ref(&packet);
+	fail_unless(ref != NULL);
+	fail_unless(sr_packet_is_shared(ref));
+	fail_unless(ref->type == SR_DF_END);
+	sr_packet_unref(ref);
+}
+END_TEST
+
+START_TEST(test_packet_ref_meta)
+{
+	struct sr_datafeed_packet packet, *ref;
+	struct sr_datafeed_meta meta;
+	struct sr_config cfg[2];
+	const struct sr_datafeed_meta *ref_meta;
+	const struct sr_config *src;
+	GSList *l;
+
+	cfg[0].key = SR_CONF_SAMPLERATE;
+	cfg[0].data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(2)));
+	cfg[1].key = SR_CONF_LIMIT_SAMPLES;
+	cfg[1].data = g_variant_ref_sink(g_variant_new_uint64(1000));
+	meta.config = g_slist_append(NULL, &cfg[0]);
+	meta.config = g_slist_append(meta.config, &cfg[1]);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+
+	ref = sr_packet_ref(&packet);
+	fail_unless(ref != NULL);
+	fail_unless(sr_packet_is_shared(ref));
+	fail_unless(ref->type == SR_DF_META);
+	ref_meta = ref->payload;
+	fail_unless(g_slist_length(ref_meta->config) == 2);
+	l = ref_meta->config;
+	src = l->data;
+	fail_unless(src != &cfg[0]);
+	fail_unless(src->key == SR_CONF_SAMPLERATE);
+	fail_unless(g_variant_get_uint64(src->data) == SR_MHZ(2));
+	src = l->next->data;
+	fail_unless(src->key == SR_CONF_LIMIT_SAMPLES);
+	fail_unless(g_variant_get_uint64(src->data) == 1000);
+
+	/* The copy holds references to the values. */
+	g_slist_free(meta.config);
+	g_variant_unref(cfg[0].data);
+	g_variant_unref(cfg[1].data);
+	src = ref_meta->config->data;
+	fail_unless(g_variant_get_uint64(src->data) == SR_MHZ(2));
+	sr_packet_unref(ref);
+}
+END_TEST
+
+START_TEST(test_packet_ref_frame)
+{
+	struct sr_datafeed_packet packet, *ref;
+	int types[] = { SR_DF_FRAME_BEGIN, SR_DF_FRAME_END, SR_DF_TRIGGER, };
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(types); i++) {
+		packet.type = types[i];
+		packet.payload = NULL;
+		ref = sr_packet_ref(&packet);
+		fail_unless(ref != NULL, "Cannot ref packet type %d.", types[i]);
+		fail_unless(sr_packet_is_shared(ref));
+		fail_unless(ref->type == types[i]);
+		sr_packet_unref(ref);
+	}
+}
+END_TEST
+
+START_TEST(test_packet_ref_bogus)
+{
+	fail_unless(sr_packet_ref(NULL) == NULL);
+	sr_packet_unref(NULL);
+}
+END_TEST
+
+#define PACKET_THREADS 4
+#define PACKET_ROUNDS 100000
+
+static gpointer packet_ref_thread(gpointer data)
+{
+	struct sr_datafeed_packet *packet;
+	int i;
+
+	packet = data;
+	for (i = 0; i < PACKET_ROUNDS; i++) {
+		if (sr_packet_ref(packet) != packet)
+			return GINT_TO_POINTER(FALSE);
+		sr_packet_unref(packet);
+	}
+
+	return GINT_TO_POINTER(TRUE);
+}
+
+/*
+ * Check that concurrent references from several threads neither
+ * lose a reference nor release the packet early.
+ */
+START_TEST(test_packet_ref_threads)
+{
+	struct sr_datafeed_packet packet, *ref;
+	struct sr_datafeed_logic logic;
+	const struct sr_datafeed_logic *ref_logic;
+	GThread *threads[PACKET_THREADS];
+	uint8_t data[4];
+	int i;
+
+	memset(data, 0x55, sizeof(data));
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	ref = sr_packet_ref(&packet);
+	fail_unless(ref != NULL);
+	for (i = 0; i < PACKET_THREADS; i++)
+		threads[i] = g_thread_new("packet-ref", packet_ref_thread, ref);
+	for (i = 0; i < PACKET_THREADS; i++)
+		fail_unless(GPOINTER_TO_INT(g_thread_join(threads[i])));
+
+	/* The caller's reference is still intact. */
+	fail_unless(sr_packet_is_shared(ref));
+	ref_logic = ref->payload;
+	fail_unless(((uint8_t *)ref_logic->data)[0] == 0x55);
+	sr_packet_unref(ref);
+}
+END_TEST
+
+#ifdef HAVE_HW_DEMO
+#define FEED_SAMPLES 100000
+
+struct feed_capture {
+	GThread *session_thread;
+	gboolean other_thread;
+	uint64_t packets;
+	uint64_t samples;
+	int first_type;
+	int last_type;
+	gboolean bad_order;
+	gboolean bad_content;
+};
+
+static void datafeed_feed(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_capture *cap;
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *data;
+	uint64_t i;
+
+	(void)sdi;
+
+	cap = cb_data;
+	if (g_thread_self() != cap->session_thread)
+		cap->other_thread = TRUE;
+	if (!cap->packets++)
+		cap->first_type = packet->type;
+	if (cap->last_type == SR_DF_END)
+		cap->bad_order = TRUE;
+	cap->last_type = packet->type;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	/* The "incremental" pattern has the sample number in each byte. */
+	logic = packet->payload;
+	data = logic->data;
+	for (i = 0; i < logic->length; i++) {
+		if (data[i] != ((cap->samples + i) & 0xff))
+			cap->bad_content = TRUE;
+	}
+	cap->samples += logic->length / logic->unitsize;
+
+	/*
+	 * Be slower than the acquisition, such that the ring runs full,
+	 * and the driver re-uses its buffer while packets are pending.
+	 */
+	g_usleep(5000);
+}
+
+/*
+ * Check that packets pass the datafeed thread in order, with their
+ * own copy of the data, and that SR_DF_END was processed when the
+ * session has stopped.
+ */
+/* Open a demo device with the "incremental" pattern on logic channels. */
+static struct sr_dev_inst *feed_demo_open(void)
+{
+	int ret;
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	struct sr_channel_group *cg;
+	GSList *devices, *l;
+
+	driver = srtest_driver_get("demo");
+	fail_unless(driver != NULL);
+	srtest_driver_init(srtest_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	/* One byte of logic data per sample, no analog data. */
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC)
+			sr_dev_channel_enable(ch, FALSE);
+	}
+	cg = NULL;
+	for (l = sr_dev_inst_channel_groups_get(sdi); l; l = l->next) {
+		cg = l->data;
+		if (!strcmp(cg->name, "Logic"))
+			break;
+	}
+	fail_unless(l != NULL, "No logic channel group.");
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK);
+	ret = sr_config_set(sdi, cg, SR_CONF_PATTERN_MODE,
+		g_variant_new_string("incremental"));
+	fail_unless(ret == SR_OK);
+	ret = sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+		g_variant_new_uint64(SR_MHZ(1)));
+	fail_unless(ret == SR_OK);
+
+	return sdi;
+}
+
+START_TEST(test_session_feed_thread_run)
+{
+	int ret;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	struct sr_session_feed_stats stats;
+	struct feed_capture cap;
+
+	sdi = feed_demo_open();
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(FEED_SAMPLES));
+	fail_unless(ret == SR_OK);
+
+	memset(&cap, 0, sizeof(cap));
+	cap.session_thread = g_thread_self();
+	cap.last_type = -1;
+	sr_session_new(srtest_ctx, &sess);
+	fail_unless(sr_session_dev_add(sess, sdi) == SR_OK);
+	sr_session_datafeed_callback_add(sess, datafeed_feed, &cap);
+	ret = sr_session_feed_thread_set(sess, 2);
+	fail_unless(ret == SR_OK);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "Session start failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "Session run failed: %d.", ret);
+
+	fail_unless(cap.other_thread, "Callbacks ran in the session thread.");
+	fail_unless(cap.first_type == SR_DF_HEADER);
+	fail_unless(cap.last_type == SR_DF_END, "No SR_DF_END seen.");
+	fail_unless(!cap.bad_order, "Packets after SR_DF_END.");
+	fail_unless(!cap.bad_content, "Logic data was overwritten or reordered.");
+	fail_unless(cap.samples == FEED_SAMPLES, "Got %" PRIu64 " samples.",
+		cap.samples);
+
+	ret = sr_session_feed_stats_get(sess, &stats);
+	fail_unless(ret == SR_OK);
+	fail_unless(stats.ring_size == 2);
+	fail_unless(stats.packets == cap.packets);
+	fail_unless(stats.overflows > 0, "The ring never ran full.");
+	fail_unless(stats.max_fill == 2);
+
+	sr_session_destroy(sess);
+	sr_dev_close(sdi);
+}
+END_TEST
+
+#define FEED_META_RATE SR_KHZ(125)
+
+struct feed_types {
+	const struct sr_dev_inst *demo;
+	const struct sr_dev_inst *input;
+	GThread *session_thread;
+	gboolean other_thread;
+	int frame_begin;
+	int frame_end;
+	gboolean in_frame;
+	gboolean bad_frame;
+	uint64_t frame_samples;
+	int meta;
+	uint64_t meta_samplerate;
+	int ends;
+};
+
+static void datafeed_types(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct feed_types *ft;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_config *src;
+	GSList *l;
+
+	ft = cb_data;
+	if (g_thread_self() != ft->session_thread)
+		ft->other_thread = TRUE;
+
+	switch (packet->type) {
+	case SR_DF_FRAME_BEGIN:
+		if (sdi != ft->demo || ft->in_frame)
+			ft->bad_frame = TRUE;
+		ft->in_frame = TRUE;
+		ft->frame_begin++;
+		break;
+	case SR_DF_FRAME_END:
+		if (sdi != ft->demo || !ft->in_frame)
+			ft->bad_frame = TRUE;
+		ft->in_frame = FALSE;
+		ft->frame_end++;
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (sdi == ft->demo && ft->in_frame)
+			ft->frame_samples += logic->length / logic->unitsize;
+		break;
+	case SR_DF_META:
+		fail_unless(sdi == ft->input);
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				ft->meta_samplerate = g_variant_get_uint64(src->data);
+		}
+		ft->meta++;
+		break;
+	case SR_DF_END:
+		ft->ends++;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Check that META and FRAME packets pass the datafeed thread. The demo
+ * device sends a frame, a virtual device (input module) which gets
+ * added to the running session sends META.
+ */
+START_TEST(test_session_feed_thread_meta_frame)
+{
+	int ret;
+	struct sr_dev_inst *sdi, *in_sdi;
+	struct sr_session *sess;
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct feed_types ft;
+	GHashTable *options;
+	GString *buf;
+
+	sdi = feed_demo_open();
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_FRAMES,
+		g_variant_new_uint64(1));
+	fail_unless(ret == SR_OK);
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("samplerate"),
+			g_variant_ref_sink(g_variant_new_uint64(FEED_META_RATE)));
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL);
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL);
+	in_sdi = sr_input_dev_inst_get(in);
+	fail_unless(in_sdi != NULL);
+
+	memset(&ft, 0, sizeof(ft));
+	ft.demo = sdi;
+	ft.input = in_sdi;
+	ft.session_thread = g_thread_self();
+	sr_session_new(srtest_ctx, &sess);
+	fail_unless(sr_session_dev_add(sess, sdi) == SR_OK);
+	sr_session_datafeed_callback_add(sess, datafeed_types, &ft);
+	ret = sr_session_feed_thread_set(sess, 4);
+	fail_unless(ret == SR_OK);
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "Session start failed: %d.", ret);
+
+	fail_unless(sr_session_dev_add(sess, in_sdi) == SR_OK);
+	buf = g_string_new("some logic data");
+	ret = sr_input_send(in, buf);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	g_string_free(buf, TRUE);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "Session run failed: %d.", ret);
+
+	fail_unless(ft.other_thread, "Callbacks ran in the session thread.");
+	fail_unless(ft.meta == 1, "Got %d META packets.", ft.meta);
+	fail_unless(ft.meta_samplerate == FEED_META_RATE);
+	fail_unless(ft.frame_begin == 1 && ft.frame_end == 1,
+		"Got %d FRAME_BEGIN, %d FRAME_END packets.",
+		ft.frame_begin, ft.frame_end);
+	fail_unless(!ft.bad_frame, "Unbalanced frame packets.");
+	fail_unless(ft.frame_samples > 0, "Empty frame.");
+	fail_unless(ft.ends == 2, "Got %d END packets.", ft.ends);
+
+	sr_session_destroy(sess);
+	sr_input_free(in);
+	g_hash_table_destroy(options);
+	sr_dev_close(sdi);
+}
+END_TEST
+#endif
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +788,27 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("feed_thread");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_feed_thread);
+	tcase_add_test(tc, test_session_feed_thread_bogus);
+#ifdef HAVE_HW_DEMO
+	tcase_add_test(tc, test_session_feed_thread_run);
+	tcase_add_test(tc, test_session_feed_thread_meta_frame);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("packet");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_packet_is_shared);
+	tcase_add_test(tc, test_packet_ref_logic);
+	tcase_add_test(tc, test_packet_ref_analog);
+	tcase_add_test(tc, test_packet_ref_end);
+	tcase_add_test(tc, test_packet_ref_meta);
+	tcase_add_test(tc, test_packet_ref_frame);
+	tcase_add_test(tc, test_packet_ref_bogus);
+	tcase_add_test(tc, test_packet_ref_threads);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
@@ -0,0 +1,408 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/*
+ * Summaries have SR_SUMMARY_FANOUT (16) records per level, these sizes
+ * result in three levels with a partial last block.
+ */
+#define NUM_SAMPLES	3109
+#define BLOCK_SAMPLES	64
+#define CHUNK_SAMPLES	100
+
+/* D0 rises at a block boundary, and falls at the end of a block. */
+#define D0_RISE		(21 * BLOCK_SAMPLES)
+#define D0_FALL		(33 * BLOCK_SAMPLES - 1)
+
+static uint8_t logic_sample(uint64_t idx)
+{
+	uint8_t b;
+
+	b = 0x80;
+	if (idx >= D0_RISE && idx < D0_FALL)
+		b |= 0x01;
+	if ((idx / 10) & 1)
+		b |= 0x02;
+
+	return b;
+}
+
+static float analog_sample(uint64_t idx)
+{
+	if (idx == 3000)
+		return 1000.0;
+
+	return (float)(idx % 200) - 50.5;
+}
+
+static void send_logic(const struct sr_output *o, uint64_t start,
+		uint64_t count)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *out;
+	uint8_t *data;
+	uint64_t i;
+
+	data = g_malloc(count);
+	for (i = 0; i < count; i++)
+		data[i] = logic_sample(start + i);
+	logic.length = count;
+	logic.unitsize = 1;
+	logic.data = data;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_free(data);
+}
+
+static void send_analog(const struct sr_output *o, struct sr_channel *ch,
+		uint64_t start, uint64_t count)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GString *out;
+	float *data;
+	uint64_t i;
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	encoding.unitsize = sizeof(float);
+	encoding.is_signed = TRUE;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.digits = 3;
+	encoding.is_digits_decimal = TRUE;
+	encoding.scale.p = 1;
+	encoding.scale.q = 1;
+	encoding.offset.p = 0;
+	encoding.offset.q = 1;
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = SR_UNIT_VOLT;
+	meaning.channels = g_slist_append(NULL, ch);
+	spec.spec_digits = 3;
+
+	data = g_malloc(count * sizeof(float));
+	for (i = 0; i < count; i++)
+		data[i] = analog_sample(start + i);
+	analog.data = data;
+	analog.num_samples = count;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	g_free(data);
+	g_slist_free(meaning.channels);
+}
+
+/* Write a session file with 8 logic channels and one analog channel. */
+static char *write_session_file(gboolean summary)
+{
+	const struct sr_output_module *omod;
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	GHashTable *options;
+	GSList *l;
+	GString *out;
+	char *filename, name[8];
+	uint64_t pos, count;
+	int fd, i;
+
+	fd = g_file_open_tmp("sigrok-test-XXXXXX.sr", &filename, NULL);
+	fail_unless(fd >= 0);
+	close(fd);
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 8; i++) {
+		g_snprintf(name, sizeof(name), "D%d", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+	sr_dev_inst_channel_add(sdi, 8, SR_CHANNEL_ANALOG, "A0");
+
+	omod = sr_output_find("srzip");
+	fail_unless(omod != NULL);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, "summary",
+		g_variant_ref_sink(g_variant_new_boolean(summary)));
+	g_hash_table_insert(options, "summary_block",
+		g_variant_ref_sink(g_variant_new_uint32(BLOCK_SAMPLES)));
+	o = sr_output_new(omod, options, sdi, filename);
+	fail_unless(o != NULL);
+	g_hash_table_destroy(options);
+
+	l = sr_dev_inst_channels_get(sdi);
+	for (pos = 0; pos < NUM_SAMPLES; pos += count) {
+		count = MIN(CHUNK_SAMPLES, NUM_SAMPLES - pos);
+		send_logic(o, pos, count);
+		send_analog(o, g_slist_last(l)->data, pos, count);
+	}
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	sr_output_free(o);
+
+	return filename;
+}
+
+/* The samples which the blocks overlapping a query range cover. */
+static void covered_range(uint64_t start, uint64_t count,
+		uint64_t *first, uint64_t *end)
+{
+	uint64_t last;
+
+	last = MIN(start + count, NUM_SAMPLES) - 1;
+	*first = start / BLOCK_SAMPLES * BLOCK_SAMPLES;
+	*end = MIN((last / BLOCK_SAMPLES + 1) * BLOCK_SAMPLES, NUM_SAMPLES);
+}
+
+static const uint64_t ranges[][2] = {
+	{ 0, NUM_SAMPLES },
+	{ 0, 1 },
+	{ 63, 2 },
+	{ 64, 64 },
+	{ 1024, 1024 },
+	{ 1000, 1500 },
+	{ 1023, 1026 },
+	{ NUM_SAMPLES - 1, 1 },
+	{ 3100, 100 },
+};
+
+/* Check a logic summary's per level records against the sample data. */
+START_TEST(test_summary_logic)
+{
+	struct sr_session_summary *summary;
+	char *filename;
+	uint64_t total, block, transitions, exp_transitions;
+	uint64_t first, end, i;
+	uint8_t or_mask, and_mask, exp_or, exp_and;
+	size_t unitsize, r;
+	int ret;
+
+	filename = write_session_file(TRUE);
+	ret = sr_session_summary_load(filename, "logic-1", &summary);
+	fail_unless(ret == SR_OK, "Cannot load summary: %d.", ret);
+
+	ret = sr_session_summary_info_get(summary, &total, &block, &unitsize);
+	fail_unless(ret == SR_OK);
+	fail_unless(total == NUM_SAMPLES);
+	fail_unless(block == BLOCK_SAMPLES);
+	fail_unless(unitsize == 1);
+
+	for (r = 0; r < G_N_ELEMENTS(ranges); r++) {
+		ret = sr_session_summary_logic(summary, ranges[r][0],
+			ranges[r][1], &transitions, &or_mask, &and_mask);
+		fail_unless(ret == SR_OK);
+
+		covered_range(ranges[r][0], ranges[r][1], &first, &end);
+		exp_transitions = 0;
+		exp_or = 0x00;
+		exp_and = 0xff;
+		for (i = first; i < end; i++) {
+			if (i && logic_sample(i) != logic_sample(i - 1))
+				exp_transitions++;
+			exp_or |= logic_sample(i);
+			exp_and &= logic_sample(i);
+		}
+		fail_unless(transitions == exp_transitions,
+			"Range %zu: %" PRIu64 " transitions, expected %" PRIu64 ".",
+			r, transitions, exp_transitions);
+		fail_unless(or_mask == exp_or, "Range %zu: OR 0x%02x.",
+			r, or_mask);
+		fail_unless(and_mask == exp_and, "Range %zu: AND 0x%02x.",
+			r, and_mask);
+	}
+
+	/* Empty ranges, and ranges beyond the data. */
+	ret = sr_session_summary_logic(summary, 0, 0, NULL, NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_summary_logic(summary, NUM_SAMPLES, 1, NULL, NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_summary_analog(summary, 0, 1, NULL, NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_summary_free(summary);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Check an analog summary's min, max and mean against the sample data. */
+START_TEST(test_summary_analog)
+{
+	struct sr_session_summary *summary;
+	char *filename;
+	uint64_t total, first, end, i;
+	float min, max, mean, exp_min, exp_max, v;
+	double sum;
+	size_t unitsize, r;
+	int ret;
+
+	filename = write_session_file(TRUE);
+	/* The analog channel follows the 8 logic channels. */
+	ret = sr_session_summary_load(filename, "analog-1-9", &summary);
+	fail_unless(ret == SR_OK, "Cannot load summary: %d.", ret);
+
+	ret = sr_session_summary_info_get(summary, &total, NULL, &unitsize);
+	fail_unless(ret == SR_OK);
+	fail_unless(total == NUM_SAMPLES);
+	fail_unless(unitsize == 0);
+
+	for (r = 0; r < G_N_ELEMENTS(ranges); r++) {
+		ret = sr_session_summary_analog(summary, ranges[r][0],
+			ranges[r][1], &min, &max, &mean);
+		fail_unless(ret == SR_OK);
+
+		covered_range(ranges[r][0], ranges[r][1], &first, &end);
+		exp_min = INFINITY;
+		exp_max = -INFINITY;
+		sum = 0;
+		for (i = first; i < end; i++) {
+			v = analog_sample(i);
+			exp_min = MIN(exp_min, v);
+			exp_max = MAX(exp_max, v);
+			sum += v;
+		}
+		fail_unless(min == exp_min, "Range %zu: min %f, expected %f.",
+			r, min, exp_min);
+		fail_unless(max == exp_max, "Range %zu: max %f, expected %f.",
+			r, max, exp_max);
+		fail_unless(fabs(mean - sum / (end - first)) < 1e-3,
+			"Range %zu: mean %f, expected %f.",
+			r, mean, sum / (end - first));
+	}
+
+	ret = sr_session_summary_logic(summary, 0, 1, NULL, NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_summary_find_edge(summary, 0, 0, &first);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_summary_free(summary);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Check edge search across block and level boundaries. */
+START_TEST(test_summary_find_edge)
+{
+	struct sr_session_summary *summary;
+	char *filename;
+	uint64_t pos;
+	unsigned int ch;
+	int ret;
+
+	filename = write_session_file(TRUE);
+	ret = sr_session_summary_load(filename, "logic-1", &summary);
+	fail_unless(ret == SR_OK, "Cannot load summary: %d.", ret);
+
+	/* The rise is at the start of a block, past the first level 1 record. */
+	ret = sr_session_summary_find_edge(summary, 0, 0, &pos);
+	fail_unless(ret == SR_OK);
+	fail_unless(pos == D0_RISE, "Edge at %" PRIu64 ".", pos);
+	ret = sr_session_summary_find_edge(summary, 0, D0_RISE - 1, &pos);
+	fail_unless(ret == SR_OK);
+	fail_unless(pos == D0_RISE, "Edge at %" PRIu64 ".", pos);
+
+	/* The fall is the last sample of its block. */
+	ret = sr_session_summary_find_edge(summary, 0, D0_RISE + 1, &pos);
+	fail_unless(ret == SR_OK);
+	fail_unless(pos == D0_FALL + 1 - BLOCK_SAMPLES, "Edge at %" PRIu64 ".", pos);
+	ret = sr_session_summary_find_edge(summary, 0, D0_FALL, &pos);
+	fail_unless(ret == SR_OK);
+	fail_unless(pos == D0_FALL + 1 - BLOCK_SAMPLES, "Edge at %" PRIu64 ".", pos);
+
+	/* No more edges after the fall, up to the partial last block. */
+	ret = sr_session_summary_find_edge(summary, 0, D0_FALL + 1, &pos);
+	fail_unless(ret == SR_ERR_NA);
+
+	/* D1 toggles in every block. */
+	ret = sr_session_summary_find_edge(summary, 1, 1000, &pos);
+	fail_unless(ret == SR_OK);
+	fail_unless(pos == 1000 / BLOCK_SAMPLES * BLOCK_SAMPLES);
+
+	/* Constant channels never have an edge. */
+	for (ch = 2; ch < 8; ch++) {
+		ret = sr_session_summary_find_edge(summary, ch, 0, &pos);
+		fail_unless(ret == SR_ERR_NA, "Channel %u has an edge.", ch);
+	}
+
+	ret = sr_session_summary_find_edge(summary, 0, NUM_SAMPLES, &pos);
+	fail_unless(ret == SR_ERR_NA);
+	ret = sr_session_summary_find_edge(summary, 8, 0, &pos);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_summary_free(summary);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Files which were written without a summary don't have one. */
+START_TEST(test_summary_none)
+{
+	struct sr_session_summary *summary;
+	char *filename;
+	int ret;
+
+	filename = write_session_file(FALSE);
+	ret = sr_session_summary_load(filename, "logic-1", &summary);
+	fail_unless(ret == SR_ERR_NA);
+	fail_unless(summary == NULL);
+
+	sr_session_summary_free(NULL);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+Suite *suite_session_file(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("session_file");
+
+	tc = tcase_create("summary");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_summary_logic);
+	tcase_add_test(tc, test_summary_analog);
+	tcase_add_test(tc, test_summary_find_edge);
+	tcase_add_test(tc, test_summary_none);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
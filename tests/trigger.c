@@ -20,6 +20,8 @@
 #include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -249,6 +251,185 @@ START_TEST(test_trigger_match_add_bogus)
 }
 END_TEST
 
+#ifdef HAVE_HW_DEMO
+/* One period of the demo driver's triangle pattern (channel A2). */
+static const float triangle[] = {
+	0, 2, 4, 6, 8, 10, 8, 6, 4, 2,
+	0, -2, -4, -6, -8, -10, -8, -6, -4, -2,
+};
+
+struct analog_capture {
+	struct sr_channel *ch;
+	GArray *values;
+	int trigger_pos;
+	int trigger_count;
+	int foreign_packets;
+};
+
+static void datafeed_analog(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct analog_capture *cap;
+	const struct sr_datafeed_analog *analog;
+	float *values;
+
+	(void)sdi;
+
+	cap = cb_data;
+	switch (packet->type) {
+	case SR_DF_TRIGGER:
+		cap->trigger_pos = cap->values->len;
+		cap->trigger_count++;
+		break;
+	case SR_DF_LOGIC:
+		cap->foreign_packets++;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (!analog->meaning->channels ||
+				analog->meaning->channels->data != cap->ch) {
+			cap->foreign_packets++;
+			break;
+		}
+		values = g_malloc(analog->num_samples * sizeof(float));
+		fail_unless(sr_analog_to_float(analog, values) == SR_OK);
+		g_array_append_vals(cap->values, values, analog->num_samples);
+		g_free(values);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Capture the demo driver's A2 channel with an analog trigger on it,
+ * and check that the data starts at the expected position of the
+ * triangle pattern, and that the trigger is where it's expected.
+ */
+static void check_analog_trigger(int match, float value,
+		uint64_t limit, uint64_t ratio,
+		int trigger_sample, int pre_trigger_samples)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *session;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct analog_capture cap;
+	struct sr_channel *ch;
+	GSList *devices, *l;
+	GArray *enabled;
+	gboolean was_enabled;
+	float expected;
+	unsigned int i;
+	int ret;
+
+	driver = srtest_driver_get("demo");
+	fail_unless(driver != NULL);
+	srtest_driver_init(srtest_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	memset(&cap, 0, sizeof(cap));
+	enabled = g_array_new(FALSE, FALSE, sizeof(gboolean));
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (!strcmp(ch->name, "A2"))
+			cap.ch = ch;
+		g_array_append_val(enabled, ch->enabled);
+	}
+	fail_unless(cap.ch != NULL);
+	cap.values = g_array_new(FALSE, FALSE, sizeof(float));
+	cap.trigger_pos = -1;
+
+	ret = sr_dev_open(sdi);
+	fail_unless(ret == SR_OK);
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(limit));
+	fail_unless(ret == SR_OK);
+	ret = sr_config_set(sdi, NULL, SR_CONF_CAPTURE_RATIO,
+		g_variant_new_uint64(ratio));
+	fail_unless(ret == SR_OK);
+
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	ret = sr_trigger_match_add(stage, cap.ch, match, value);
+	fail_unless(ret == SR_OK);
+
+	sr_session_new(srtest_ctx, &session);
+	fail_unless(sr_session_dev_add(session, sdi) == SR_OK);
+	fail_unless(sr_session_trigger_set(session, trigger) == SR_OK);
+	sr_session_datafeed_callback_add(session, datafeed_analog, &cap);
+	ret = sr_session_start(session);
+	fail_unless(ret == SR_OK, "Session start failed: %d.", ret);
+	ret = sr_session_run(session);
+	fail_unless(ret == SR_OK, "Session run failed: %d.", ret);
+
+	fail_unless(cap.trigger_count == 1, "Got %d triggers.",
+		cap.trigger_count);
+	fail_unless(cap.trigger_pos == pre_trigger_samples,
+		"Trigger at %d, expected %d.", cap.trigger_pos,
+		pre_trigger_samples);
+	fail_unless(cap.values->len == limit, "Got %u samples.",
+		cap.values->len);
+	fail_unless(cap.foreign_packets == 0);
+	for (i = 0; i < cap.values->len; i++) {
+		expected = triangle[(trigger_sample - pre_trigger_samples + i)
+			% ARRAY_SIZE(triangle)];
+		fail_unless(fabs(g_array_index(cap.values, float, i) - expected)
+			< 0.01, "Sample %u is %f, expected %f.", i,
+			g_array_index(cap.values, float, i), expected);
+	}
+
+	/* Other channels were left out, but their config is unchanged. */
+	i = 0;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		was_enabled = g_array_index(enabled, gboolean, i++);
+		fail_unless(ch->enabled == was_enabled,
+			"Channel %s was %s.", ch->name,
+			was_enabled ? "disabled" : "enabled");
+	}
+	g_array_free(enabled, TRUE);
+
+	sr_session_destroy(session);
+	sr_trigger_free(trigger);
+	sr_dev_close(sdi);
+	g_array_free(cap.values, TRUE);
+}
+
+/* Level crossings match the first sample beyond the level. */
+START_TEST(test_analog_trigger_level)
+{
+	check_analog_trigger(SR_TRIGGER_OVER, 9.0, 20, 20, 5, 4);
+	check_analog_trigger(SR_TRIGGER_UNDER, -9.0, 20, 20, 15, 4);
+}
+END_TEST
+
+/* Slopes match where the signal crosses the value. */
+START_TEST(test_analog_trigger_slope)
+{
+	check_analog_trigger(SR_TRIGGER_RISING, 5.0, 20, 0, 3, 0);
+	check_analog_trigger(SR_TRIGGER_FALLING, -1.0, 20, 0, 11, 0);
+	check_analog_trigger(SR_TRIGGER_EDGE, -3.0, 20, 0, 12, 0);
+}
+END_TEST
+
+/*
+ * The pre-trigger buffer keeps the most recent samples only, and it
+ * cannot return more samples than were seen before the trigger.
+ */
+START_TEST(test_analog_trigger_pre_trigger)
+{
+	check_analog_trigger(SR_TRIGGER_FALLING, -1.0, 100, 10, 11, 10);
+	check_analog_trigger(SR_TRIGGER_RISING, 5.0, 20, 10, 3, 2);
+	check_analog_trigger(SR_TRIGGER_RISING, 5.0, 20, 50, 3, 3);
+}
+END_TEST
+#endif
+
 Suite *suite_trigger(void)
 {
 	Suite *s;
@@ -276,5 +457,14 @@ Suite *suite_trigger(void)
 	tcase_add_test(tc, test_trigger_match_add_bogus);
 	suite_add_tcase(s, tc);
 
+#ifdef HAVE_HW_DEMO
+	tc = tcase_create("analog");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_analog_trigger_level);
+	tcase_add_test(tc, test_analog_trigger_slope);
+	tcase_add_test(tc, test_analog_trigger_pre_trigger);
+	suite_add_tcase(s, tc);
+#endif
+
 	return s;
 }